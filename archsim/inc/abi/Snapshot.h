@@ -0,0 +1,111 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   Snapshot.h
+ *
+ * Snapshots of the complete guest state of a system emulation, so that a
+ * simulation can be stopped at some point of interest (e.g. once the guest
+ * has booted) and any number of later simulations started from there.
+ *
+ * A snapshot contains the register file and state block of each thread, the
+ * state of each device (see Component::SaveState), and guest physical
+ * memory. Memory is stored as individually compressed pages, and pages which
+ * are entirely zero are not stored at all.
+ *
+ * The snapshot file is memory mapped on restore. Memory regions which are
+ * backed by host memory can be restored lazily: the region is protected, and
+ * each chunk of it is decompressed the first time that the guest touches it.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace archsim
+{
+	namespace abi
+	{
+		class SystemEmulationModel;
+
+		/**
+		 * Restores a region of host memory from compressed pages on demand.
+		 * The region is made inaccessible, and a fault on it is handled by
+		 * decompressing the surrounding chunk into a staging area and moving
+		 * the staging pages over the faulting ones in a single step, so that
+		 * other threads never see a partially restored chunk.
+		 */
+		class LazyMemoryRestorer
+		{
+		public:
+			static const size_t kChunkPages = 64;
+
+			struct Page {
+				uint64_t Index;
+				const uint8_t *Data;
+				uint32_t Size;
+			};
+
+			// Pages must be sorted by index. Pages which do not appear are
+			// restored as zero.
+			LazyMemoryRestorer(void *host_base, size_t size, int host_prot, const std::vector<Page> &pages);
+			~LazyMemoryRestorer();
+
+			bool Install();
+
+			// Returns true if the fault was caused by this restorer (in which
+			// case the access can be retried), or false if it is a genuine fault.
+			bool HandleFault(uintptr_t addr);
+
+			size_t GetChunksRestored() const
+			{
+				return chunks_restored_;
+			}
+
+		private:
+			bool restoreChunk(size_t chunk);
+
+			uint8_t *host_base_;
+			size_t size_;
+			int host_prot_;
+			std::vector<Page> pages_;
+
+			uint8_t *staging_;
+			std::vector<bool> restored_;
+			size_t chunks_restored_;
+			std::mutex lock_;
+		};
+
+		class Snapshot
+		{
+		public:
+			static const uint32_t kPageSize = 4096;
+
+			Snapshot();
+			~Snapshot();
+
+			static bool Save(SystemEmulationModel &model, const std::string &filename, const std::string &config_tag);
+			bool Restore(SystemEmulationModel &model, const std::string &filename, const std::string &config_tag, bool lazy);
+
+			// Compress a single page into the given buffer, which must be at
+			// least kPageSize bytes long. Returns the number of bytes used:
+			// incompressible pages are stored as they are, using kPageSize bytes.
+			static uint32_t CompressPage(const void *page, uint8_t *out);
+			static bool DecompressPage(const uint8_t *data, uint32_t size, void *page);
+			static bool IsZeroPage(const void *page);
+
+		private:
+			static const uint32_t kVersion = 1;
+
+			const uint8_t *mapping_;
+			size_t mapping_size_;
+			std::vector<std::unique_ptr<LazyMemoryRestorer>> restorers_;
+		};
+	}
+}
+
+#endif /* SNAPSHOT_H */
@@ -37,6 +37,7 @@ namespace archsim
 		{
 			class Component;
 			class MemoryComponent;
+			class DeviceState;
 
 			class IRQLine;
 			class ConsoleSerialPort;
@@ -218,6 +219,14 @@ namespace archsim
 
 				virtual bool Initialise() = 0;
 
+				// Save or restore the guest visible state of this component, for
+				// guest snapshots. By default these fail, so that a component
+				// which has not been taught to save its state stops a snapshot
+				// from being taken rather than being silently left out of it.
+				// Components with no such state override these to do nothing.
+				virtual bool SaveState(DeviceState &state);
+				virtual bool RestoreState(DeviceState &state);
+
 			private:
 				ComponentDescriptorInstance descriptor_;
 			};
@@ -383,6 +392,9 @@ namespace archsim
 				bool Read(uint32_t offset, uint8_t size, uint64_t& data) override;
 				bool Write(uint32_t offset, uint8_t size, uint64_t data) override;
 
+				bool SaveState(DeviceState &state) override;
+				bool RestoreState(DeviceState &state) override;
+
 				inline std::string GetName() const
 				{
 					return name;
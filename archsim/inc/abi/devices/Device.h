@@ -28,6 +28,7 @@ namespace archsim
 		namespace devices
 		{
 
+			class DeviceState;
 			class PeripheralManager;
 
 			class Device
@@ -49,6 +50,11 @@ namespace archsim
 				virtual bool ReadBlock(uint32_t address, void *data, unsigned int length);
 				virtual bool WriteBlock(uint32_t address, const void *data, unsigned int length);
 
+				// Save or restore the guest visible state of this device, for
+				// guest snapshots. See Component::SaveState.
+				virtual bool SaveState(DeviceState &state);
+				virtual bool RestoreState(DeviceState &state);
+
 				bool SetManager(PeripheralManager*);
 				PeripheralManager *Manager;
 			};
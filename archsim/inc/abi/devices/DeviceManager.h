@@ -40,6 +40,11 @@ namespace archsim
 					return device_bitmap.test(device_address.GetPageIndex());
 				}
 
+				const std::map<memory::guest_addr_t, MemoryComponent*> &GetDevices() const
+				{
+					return devices;
+				}
+
 			private:
 				memory::guest_addr_t min_device_address;
 
@@ -0,0 +1,122 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   DeviceState.h
+ *
+ * A flat buffer of saved device (or thread) state, as used by guest
+ * snapshots. Values are written and read back in the same order: there is
+ * no framing within the buffer, so a reader must know what its writer put
+ * there. Reads past the end of the buffer fail rather than returning junk.
+ */
+
+#ifndef DEVICESTATE_H
+#define DEVICESTATE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace archsim
+{
+	namespace abi
+	{
+		namespace devices
+		{
+			class DeviceState
+			{
+			public:
+				DeviceState() : read_offset_(0) {}
+				DeviceState(const uint8_t *data, size_t size) : data_(data, data + size), read_offset_(0) {}
+
+				template<typename T> void Write(const T &value)
+				{
+					static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be written to device state");
+					WriteBytes(&value, sizeof(value));
+				}
+
+				template<typename T> bool Read(T &value)
+				{
+					static_assert(std::is_trivially_copyable<T>::value, "Only plain values can be read from device state");
+					return ReadBytes(&value, sizeof(value));
+				}
+
+				void WriteBytes(const void *data, size_t size)
+				{
+					const uint8_t *bytes = (const uint8_t*)data;
+					data_.insert(data_.end(), bytes, bytes + size);
+				}
+
+				bool ReadBytes(void *data, size_t size)
+				{
+					if(size > data_.size() - read_offset_) {
+						return false;
+					}
+
+					memcpy(data, data_.data() + read_offset_, size);
+					read_offset_ += size;
+					return true;
+				}
+
+				void WriteString(const std::string &str)
+				{
+					Write<uint32_t>(str.size());
+					WriteBytes(str.data(), str.size());
+				}
+
+				bool ReadString(std::string &str)
+				{
+					uint32_t size;
+					if(!Read(size) || size > data_.size() - read_offset_) {
+						return false;
+					}
+
+					str.assign((const char*)data_.data() + read_offset_, size);
+					read_offset_ += size;
+					return true;
+				}
+
+				// Nested state is stored with its size, so that a reader which does
+				// not understand it can skip over it.
+				void WriteState(const DeviceState &state)
+				{
+					Write<uint64_t>(state.GetSize());
+					WriteBytes(state.GetData(), state.GetSize());
+				}
+
+				bool ReadState(DeviceState &state)
+				{
+					uint64_t size;
+					if(!Read(size) || size > data_.size() - read_offset_) {
+						return false;
+					}
+
+					state = DeviceState(data_.data() + read_offset_, size);
+					read_offset_ += size;
+					return true;
+				}
+
+				const uint8_t *GetData() const
+				{
+					return data_.data();
+				}
+				size_t GetSize() const
+				{
+					return data_.size();
+				}
+
+				bool AtEnd() const
+				{
+					return read_offset_ == data_.size();
+				}
+
+			private:
+				std::vector<uint8_t> data_;
+				size_t read_offset_;
+			};
+		}
+	}
+}
+
+#endif /* DEVICESTATE_H */
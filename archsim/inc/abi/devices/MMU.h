@@ -13,6 +13,11 @@
 #include "define.h"
 #include "abi/devices/Device.h"
 #include "abi/devices/PeripheralManager.h"
+#include "abi/devices/SoftwareTLB.h"
+#include "util/PubSubSync.h"
+
+#include <atomic>
+#include <memory>
 
 namespace archsim
 {
@@ -85,6 +90,17 @@ namespace archsim
 
 				virtual const PageInfo GetInfo(Address virt_addr) = 0;
 
+				// Translate an access through this thread's TLB, falling back to
+				// Translate (and filling the TLB) on a miss.
+				TranslateResult TranslateCached(archsim::core::thread::ThreadInstance *cpu, Address virt_addr, Address &phys_addr, const struct AccessInfo info);
+
+				// TLB maintenance. These must only be called by the thread which
+				// owns this MMU.
+				void InvalidateTLB();
+				void InvalidateTLBPage(Address virt_addr);
+				void InvalidateTLBPage(Address virt_addr, uint64_t asid);
+				void InvalidateTLBASID(uint64_t asid);
+
 				virtual void FlushCaches();
 				virtual void Evict(Address virt_addr);
 
@@ -107,10 +123,43 @@ namespace archsim
 					return phys_mem;
 				}
 
+				// Get the TLB tag for the given access, or return false if the
+				// translation should not be cached. Translations are not cached
+				// unless an MMU overrides this.
+				virtual bool GetTLBContext(archsim::core::thread::ThreadInstance *cpu, const struct AccessInfo &info, TLBContext &context);
+
+				// Called by Translate to describe a successful translation so that
+				// it can be entered into the TLB.
+				inline void SetTLBFill(Address::underlying_t offset_mask, bool global)
+				{
+					tlb_fill_valid_ = true;
+					tlb_fill_offset_mask_ = offset_mask;
+					tlb_fill_global_ = global;
+				}
+
+				// Return true if the TLB is maintained only through the Invalidate
+				// functions. Otherwise, it is flushed whenever any thread publishes
+				// a TLB flush event.
+				virtual bool HasExplicitTLBMaintenance() const;
+
 			private:
+				static void TLBFlushCallback(PubSubType::PubSubType type, void *context, const void *data);
+				void applyPendingTLBFlushes();
+
 				bool should_be_enabled;
 
 				memory::MemoryModel *phys_mem;
+
+				SoftwareTLB itlb_, dtlb_;
+
+				bool tlb_fill_valid_;
+				Address::underlying_t tlb_fill_offset_mask_;
+				bool tlb_fill_global_;
+
+				// Flush events can be published by any thread, so they are
+				// recorded here and applied by the owning thread.
+				std::unique_ptr<util::PubSubscriber> tlb_subscriber_;
+				std::atomic<uint32_t> tlb_pending_flushes_;
 			};
 
 		}
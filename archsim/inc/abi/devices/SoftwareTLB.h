@@ -0,0 +1,105 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   SoftwareTLB.h
+ *
+ * A small set-associative cache of completed MMU translations. Entries are
+ * tagged with an address space identifier and with any other state which
+ * affects the outcome of a page table walk (e.g. the page table base or
+ * permission control bits), so that they do not need to be thrown away
+ * whenever that state changes.
+ *
+ * Each entry also records which kinds of access (read, write or fetch, in
+ * each ring) have been permitted through it: an entry only satisfies a
+ * lookup for an access which the MMU has already checked in full.
+ *
+ * A TLB is only ever accessed by the thread which owns it.
+ */
+
+#ifndef SOFTWARETLB_H
+#define SOFTWARETLB_H
+
+#include "abi/Address.h"
+
+#include <cstdint>
+
+namespace archsim
+{
+	namespace abi
+	{
+		namespace devices
+		{
+			struct AccessInfo;
+
+			struct TLBContext {
+				// The address space that non-global translations belong to
+				uint64_t ASID;
+				// Everything else that the translation depends on
+				uint64_t State;
+			};
+
+			class SoftwareTLB
+			{
+			public:
+				static const unsigned kSets = 64;
+				static const unsigned kWays = 4;
+
+				SoftwareTLB();
+
+				bool Lookup(Address virt_addr, const TLBContext &context, const AccessInfo &info, Address &phys_addr);
+
+				// Record a translation of the given access. offset_mask is the mask
+				// of the address bits which are passed through unchanged (i.e. the
+				// size of the page or superpage minus one).
+				void Insert(Address virt_addr, Address phys_addr, Address::underlying_t offset_mask, const TLBContext &context, bool global, const AccessInfo &info);
+
+				void Flush();
+				// Flush every translation of the given address.
+				void FlushPage(Address virt_addr);
+				// Flush the non-global translations of the given address in the
+				// given address space.
+				void FlushPage(Address virt_addr, uint64_t asid);
+				// Flush every non-global translation in the given address space.
+				void FlushASID(uint64_t asid);
+
+			private:
+				struct Entry {
+					Address::underlying_t VirtBase;
+					Address::underlying_t PhysBase;
+					Address::underlying_t OffsetMask;
+					uint64_t ASID;
+					uint64_t State;
+
+					// One bit for each kind of access (see GetAccessBit). An entry
+					// with no permitted accesses is invalid.
+					uint16_t Permitted;
+					bool Global;
+
+					bool Covers(Address::underlying_t virt_addr) const
+					{
+						return Permitted && (virt_addr & ~OffsetMask) == VirtBase;
+					}
+				};
+
+				static uint16_t GetAccessBit(const AccessInfo &info);
+
+				Entry *GetSet(Address::underlying_t virt_addr)
+				{
+					return entries_[(virt_addr / Address::PageSize) % kSets];
+				}
+
+				template<typename Predicate> void flushIf(Address::underlying_t virt_addr, Predicate pred);
+
+				Entry entries_[kSets][kWays];
+				uint8_t next_victim_[kSets];
+
+				// Superpage entries are filed under whichever small page was being
+				// accessed, so flushing an address needs to search every set if
+				// there might be any.
+				bool has_superpages_;
+			};
+		}
+	}
+}
+
+#endif /* SOFTWARETLB_H */
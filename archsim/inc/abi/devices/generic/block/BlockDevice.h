@@ -13,6 +13,10 @@
 #include "define.h"
 #include "util/Counter.h"
 
+#include <mutex>
+
+#include <sys/uio.h>
+
 namespace archsim
 {
 	namespace abi
@@ -34,6 +38,15 @@ namespace archsim
 						virtual bool WriteBlock(uint64_t block_idx, const uint8_t *buffer) = 0;
 						virtual bool WriteBlocks(uint64_t block_idx, uint32_t count, const uint8_t *buffer) = 0;
 
+						// Scatter/gather transfers of consecutive blocks, starting at
+						// block_idx. Each segment must be a whole number of blocks long.
+						// These may be called from several threads at once: the default
+						// implementations serialise calls to the single buffer
+						// functions above, devices which can do better should override
+						// them.
+						virtual bool ReadBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt);
+						virtual bool WriteBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt);
+
 						virtual uint64_t GetBlockSize() const = 0;
 						virtual uint64_t GetBlockCount() const = 0;
 
@@ -49,6 +62,9 @@ namespace archsim
 							return GetBlockSize() * block_idx;
 						}
 
+					private:
+						std::mutex vector_lock_;
+
 					};
 				}
 			}
@@ -39,6 +39,8 @@ namespace archsim
 						bool ReadBlocks(uint64_t block_idx, uint32_t count, uint8_t* buffer) override;
 						bool WriteBlock(uint64_t block_idx, const uint8_t* buffer) override;
 						bool WriteBlocks(uint64_t block_idx, uint32_t count, const uint8_t* buffer) override;
+						bool ReadBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt) override;
+						bool WriteBlocksV(uint64_t block_idx, const struct iovec *iov, int iovcnt) override;
 
 						bool Open(std::string filename, bool read_only = false);
 						void Close();
@@ -56,6 +58,8 @@ namespace archsim
 					private:
 						bool use_mmap;
 
+						bool CheckVectorRange(uint64_t block_idx, const struct iovec *iov, int iovcnt, uint64_t &count) const;
+
 						inline void *GetDataPtr(uint64_t block_idx) const
 						{
 							return (void *)((unsigned long)file_data + CalculateByteOffset(block_idx));
@@ -68,6 +72,7 @@ namespace archsim
 						bool read_only;
 
 						std::unique_ptr<BlockCache> cache;
+						std::mutex cache_lock;
 					};
 				}
 			}
@@ -0,0 +1,107 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   EventScheduler.h
+ *
+ * A discrete event scheduler for device timers. Rather than being told
+ * about every tick and checking whether it has anything to do, a device
+ * schedules an event for the tick at which it next needs to act, and the
+ * scheduler fires it once time reaches that tick. Pending events are kept
+ * in a min-heap ordered by deadline, so a tick source can always tell how
+ * long it is until something next happens. Events with the same deadline
+ * fire in the order in which they were scheduled.
+ */
+
+#ifndef EVENTSCHEDULER_H
+#define EVENTSCHEDULER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+namespace archsim
+{
+	namespace abi
+	{
+		namespace devices
+		{
+			namespace timing
+			{
+				class EventScheduler;
+
+				class ScheduledEvent
+				{
+				public:
+					ScheduledEvent();
+					virtual ~ScheduledEvent();
+
+					// Called (without any scheduler locks held) once time
+					// has reached the event's deadline. The event is no
+					// longer scheduled, so it may schedule itself again.
+					virtual void Fire(uint64_t now) = 0;
+
+					bool IsScheduled() const
+					{
+						return heap_index_ != kNotScheduled;
+					}
+
+					uint64_t GetDeadline() const
+					{
+						return deadline_;
+					}
+
+				private:
+					friend class EventScheduler;
+
+					static const size_t kNotScheduled = (size_t)-1;
+
+					uint64_t deadline_;
+					uint64_t sequence_;
+					size_t heap_index_;
+				};
+
+				class EventScheduler
+				{
+				public:
+					static const uint64_t kNoDeadline = (uint64_t)-1;
+
+					EventScheduler();
+					~EventScheduler();
+
+					EventScheduler(const EventScheduler &) = delete;
+					EventScheduler &operator=(const EventScheduler &) = delete;
+
+					// Schedule an event to fire at the given tick, moving it
+					// if it is already scheduled. Returns true if this made
+					// the event the next one to fire.
+					bool Schedule(ScheduledEvent &event, uint64_t deadline);
+					void Cancel(ScheduledEvent &event);
+
+					// Fire every event whose deadline is at or before now, in
+					// deadline order. Returns the number of events fired.
+					uint32_t Advance(uint64_t now);
+
+					// The deadline of the next event, or kNoDeadline if
+					// nothing is scheduled.
+					uint64_t GetNextDeadline() const;
+
+					size_t GetPendingCount() const;
+
+				private:
+					void remove(size_t index);
+					void siftUp(size_t index);
+					void siftDown(size_t index);
+					void place(ScheduledEvent *event, size_t index);
+					static bool before(const ScheduledEvent *a, const ScheduledEvent *b);
+
+					mutable std::mutex lock_;
+					std::vector<ScheduledEvent *> heap_;
+					uint64_t next_sequence_;
+				};
+			}
+		}
+	}
+}
+
+#endif /* EVENTSCHEDULER_H */
@@ -10,9 +10,13 @@
 #ifndef TICKSOURCE_H_
 #define TICKSOURCE_H_
 
+#include "abi/devices/generic/timing/EventScheduler.h"
 #include "concurrent/Thread.h"
 #include "util/PubSubSync.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <cstdint>
 #include <mutex>
 #include <unordered_set>
@@ -27,6 +31,13 @@ namespace archsim
 			{
 				class TickConsumer;
 
+				/*
+				 * A source of simulated time, counted in ticks. Consumers
+				 * are told about every tick, which is only worthwhile for
+				 * devices with something to do on each one: devices which
+				 * are waiting for a particular tick should schedule an
+				 * event for it instead.
+				 */
 				class TickSource
 				{
 				public:
@@ -39,19 +50,51 @@ namespace archsim
 					void Start();
 					void Stop();
 
-					inline uint64_t GetCounter()
+					virtual uint64_t GetCounter()
 					{
 						return tick_count_;
 					}
 
+					// Fire the event once the counter reaches the deadline
+					void ScheduleEvent(ScheduledEvent &event, uint64_t deadline);
+					void CancelEvent(ScheduledEvent &event);
+
+					// The number of ticks until the next scheduled event, or
+					// EventScheduler::kNoDeadline if none is scheduled
+					uint64_t GetTicksUntilNextEvent();
+
+					// The host time, in microseconds, until the next scheduled
+					// event is due, or EventScheduler::kNoDeadline if none is
+					// scheduled or the source does not follow host time
+					virtual uint64_t GetMicrosecondsUntilNextEvent()
+					{
+						return EventScheduler::kNoDeadline;
+					}
+
 				protected:
 					void Tick(uint32_t tick_periods);
+					// Move the counter on to a later tick, telling consumers
+					// and firing any events which are now due
+					void AdvanceTo(uint64_t tick_count);
+
+					// Called when an event is scheduled ahead of every other
+					virtual void NextDeadlineChanged() {}
+
+					bool HasConsumers();
+
+					float GetTicksPerPeriod() const
+					{
+						return microtick_scale_;
+					}
+
 				private:
-					uint64_t tick_count_;
+					std::atomic<uint64_t> tick_count_;
 					float microticks_;
 					float microtick_scale_;
 					bool running_;
 
+					EventScheduler scheduler_;
+
 				private:
 					std::mutex consumers_lock_;
 					std::unordered_set<TickConsumer*> consumers;
@@ -63,6 +106,8 @@ namespace archsim
 					MicrosecondTickSource(uint32_t useconds);
 					~MicrosecondTickSource() override;
 
+					uint64_t GetMicrosecondsUntilNextEvent() override;
+
 				protected:
 					void tick() override;
 
@@ -74,6 +119,76 @@ namespace archsim
 					uint32_t calibrated_ticks;
 				};
 
+				/*
+				 * Counts ticks of a fixed length of host time, but rather
+				 * than waking up for every tick, sleeps until the next
+				 * scheduled event is due (or until the next tick, while
+				 * there are consumers which need to see every tick).
+				 */
+				class HostTimeTickSource : public archsim::concurrent::LoopThread, public TickSource
+				{
+				public:
+					HostTimeTickSource(uint32_t useconds);
+					~HostTimeTickSource() override;
+
+					uint64_t GetCounter() override;
+					uint64_t GetMicrosecondsUntilNextEvent() override;
+
+				protected:
+					void tick() override;
+					void NextDeadlineChanged() override;
+
+				private:
+					typedef std::chrono::steady_clock clock_t;
+
+					clock_t::time_point GetTickTime(uint64_t tick);
+
+					std::chrono::microseconds period_;
+					clock_t::time_point start_;
+
+					std::mutex wait_lock_;
+					std::condition_variable wait_cond_;
+					bool deadline_changed_;
+					bool stopping_;
+				};
+
+				/*
+				 * Counts retired guest instructions. Threads retire
+				 * instructions in batches, which are sized so that a batch
+				 * does not run past the next scheduled event.
+				 */
+				class InstructionTickSource : public TickSource
+				{
+				public:
+					// The most instructions a thread retires at once, which
+					// bounds how far the counter can lag behind execution
+					static const uint64_t kMaxBatch = 10000;
+
+					InstructionTickSource();
+					~InstructionTickSource() override;
+
+					void RetireInstructions(uint64_t count);
+
+					// The number of instructions which can be retired before
+					// the next event is due, between 1 and kMaxBatch
+					uint64_t GetInstructionsUntilNextEvent();
+
+					// Bumped whenever an event is scheduled ahead of every
+					// other, so that threads part way through a batch can
+					// tell that it now runs past the next event.
+					const std::atomic<uint64_t> &GetDeadlineGeneration() const
+					{
+						return deadline_generation_;
+					}
+
+				protected:
+					void NextDeadlineChanged() override;
+
+				private:
+					std::mutex retire_lock_;
+					std::atomic<uint64_t> deadline_generation_;
+				};
+
 				class CallbackTickSource : public TickSource
 				{
 				public:
@@ -13,7 +13,7 @@
 #include "abi/devices/Component.h"
 #include "abi/devices/IRQController.h"
 #include "abi/devices/SerialPort.h"
-#include "abi/devices/generic/timing/TickConsumer.h"
+#include "abi/devices/generic/timing/EventScheduler.h"
 #include "abi/devices/generic/timing/TickSource.h"
 #include "system.h"
 
@@ -29,14 +29,16 @@ namespace archsim
 
 				/*
 				 * Class which manages mtimecmp and the associated interrupt
-				 * for a single hart.
+				 * for a single hart. Rather than comparing against mtime on
+				 * every tick, the timer schedules an event for the tick at
+				 * which mtime passes mtimecmp.
 				 */
-				class CLINTTimer : public archsim::abi::devices::timing::TickConsumer
+				class CLINTTimer : public archsim::abi::devices::timing::ScheduledEvent
 				{
 				public:
 					CLINTTimer(archsim::core::thread::ThreadInstance *hart, SifiveCLINT *clint);
 
-					void Tick(uint32_t tick_periods) override;
+					void Fire(uint64_t now) override;
 					void SetCmp(uint64_t cmp);
 					uint64_t GetCmp() const;
 
@@ -58,9 +60,20 @@ namespace archsim
 					bool Read(uint32_t offset, uint8_t size, uint64_t& data) override;
 					bool Write(uint32_t offset, uint8_t size, uint64_t data) override;
 
+					bool SaveState(DeviceState &state) override;
+					bool RestoreState(DeviceState &state) override;
+
 					uint64_t GetTimer();
+					// The first tick at which the timer will be greater than
+					// the given value
+					uint64_t GetTickAfter(uint64_t timer);
 					CLINTTimer *GetHartTimer(int i);
 
+					archsim::abi::devices::timing::TickSource &GetTickSource()
+					{
+						return *tick_source_;
+					}
+
 					archsim::core::thread::ThreadInstance *GetHart(int i);
 					archsim::arch::riscv::RiscVSystemCoprocessor *GetCoprocessor(int i);
 				private:
@@ -70,6 +83,9 @@ namespace archsim
 					COMPONENT_PARAMETER_THREAD_LIST(Harts);
 
 					archsim::abi::devices::timing::TickSource *tick_source_;
+					// Added to the tick count so that mtime carries on from where it
+					// was when a snapshot was taken.
+					uint64_t timer_offset_;
 
 					std::vector<CLINTTimer*> timers_;
 
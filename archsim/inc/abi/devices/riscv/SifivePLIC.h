@@ -34,6 +34,9 @@ namespace archsim
 					bool AssertLine(uint32_t line) override;
 					bool RescindLine(uint32_t line) override;
 
+					bool SaveState(DeviceState &state) override;
+					bool RestoreState(DeviceState &state) override;
+
 				private:
 					archsim::core::thread::ThreadInstance *GetHart(int i);
 					int GetHartCount() const
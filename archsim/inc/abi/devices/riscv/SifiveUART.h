@@ -34,6 +34,9 @@ namespace archsim
 					bool Read(uint32_t offset, uint8_t size, uint64_t& data) override;
 					bool Write(uint32_t offset, uint8_t size, uint64_t data) override;
 
+					bool SaveState(DeviceState &state) override;
+					bool RestoreState(DeviceState &state) override;
+
 					bool EnqueueChar(char c);
 
 				private:
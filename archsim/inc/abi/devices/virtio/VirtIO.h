@@ -16,6 +16,7 @@
 
 #include <vector>
 #include <array>
+#include <mutex>
 
 #define VRING_DESC_F_INDIRECT 4
 
@@ -94,6 +95,9 @@ namespace archsim
 
 					bool Initialise() override;
 
+					bool SaveState(DeviceState &state) override;
+					bool RestoreState(DeviceState &state) override;
+
 				protected:
 					virtual void ResetDevice() = 0;
 					virtual uint8_t *GetConfigArea() const = 0;
@@ -118,6 +122,11 @@ namespace archsim
 						}
 					}
 
+					// Return a batch of processed events to the guest, raising a single
+					// interrupt for all of them, and delete them. This may be called
+					// from any thread.
+					void CompleteEvents(const std::vector<VirtIOQueueEvent *> &events);
+
 					MemoryRegister HostFeaturesSel;
 					MemoryRegister HostFeatures;
 
@@ -131,6 +140,10 @@ namespace archsim
 
 					IRQLine& irq;
 
+					// Serialises updates to the used rings and the interrupt status
+					// between the guest and any device threads completing events.
+					std::mutex completion_lock_;
+
 					MemoryRegister MagicValue;
 					MemoryRegister Version;
 					MemoryRegister DeviceID;
@@ -12,6 +12,14 @@
 
 #include "abi/devices/virtio/VirtIO.h"
 
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/uio.h>
+
 namespace archsim
 {
 	namespace abi
@@ -38,6 +46,8 @@ namespace archsim
 
 					void WriteRegister(MemoryRegister& reg, uint32_t value) override;
 
+					bool SaveState(DeviceState &state) override;
+
 				protected:
 					uint8_t *GetConfigArea() const override;
 					uint32_t GetConfigAreaSize() const override;
@@ -51,9 +61,36 @@ namespace archsim
 						uint64_t sector;
 					};
 
+					// A read or write request, taken apart on the guest CPU thread so
+					// that it can be serviced by any thread.
+					struct BlockRequest {
+						VirtIOQueueEvent *evt;
+						uint32_t type;
+						uint64_t sector;
+						std::vector<struct iovec> data;
+						uint32_t data_size;
+						uint8_t *status;
+					};
+
+					// The most requests which an I/O thread takes on at once.
+					static const uint32_t kMaxBatch = 32;
+
+					uint32_t host_features_;
+
+					std::vector<std::thread> io_threads_;
+					std::deque<BlockRequest *> pending_;
+					std::mutex pending_lock_;
+					std::condition_variable pending_cond_;
+					std::condition_variable idle_cond_;
+					uint32_t in_flight_;
+					bool terminate_;
+
 					void ProcessEvent(VirtIOQueueEvent* evt) override;
-					bool HandleRead(uint64_t sector, uint8_t *buffer, uint32_t len);
-					bool HandleWrite(uint64_t sector, uint8_t *buffer, uint32_t len);
+					void Submit(BlockRequest *request);
+					void ServiceRequests();
+					void ProcessBatch(const std::vector<BlockRequest *> &batch);
+					bool Transfer(uint32_t type, uint64_t sector, const std::vector<struct iovec> &data);
+					void WaitForIdle();
 
 					struct {
 						uint64_t capacity; // 0
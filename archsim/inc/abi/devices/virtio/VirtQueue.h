@@ -13,6 +13,8 @@
 #include "define.h"
 #include "util/LogContext.h"
 
+#include <mutex>
+
 UseLogContext(LogVirtIO);
 
 namespace archsim
@@ -124,6 +126,33 @@ namespace archsim
 						this->size = size;
 					}
 
+					inline uint32_t GetAlign() const
+					{
+						return align;
+					}
+
+					inline uint32_t GetSize() const
+					{
+						return size;
+					}
+
+					inline uint16_t GetLastAvailIdx() const
+					{
+						return last_avail_idx;
+					}
+
+					inline void SetLastAvailIdx(uint16_t idx)
+					{
+						last_avail_idx = idx;
+					}
+
+					// Held while descriptor chains are taken from the queue, since
+					// several guest CPUs may notify the same queue at once.
+					inline std::mutex &GetLock()
+					{
+						return lock;
+					}
+
 					inline const VirtRing::VirtRingDesc *PopDescriptorChainHead(uint16_t& out_idx)
 					{
 						uint16_t num_heads = ring.GetAvailable()->idx - last_avail_idx;
@@ -174,6 +203,8 @@ namespace archsim
 					uint16_t last_avail_idx;
 
 					uint32_t _self_index;
+
+					std::mutex lock;
 				};
 			}
 		}
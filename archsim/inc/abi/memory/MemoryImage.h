@@ -0,0 +1,87 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   MemoryImage.h
+ *
+ * A read-only image of guest physical memory which is used as the base
+ * layer of guest memory. The image is a raw file in which the byte at
+ * offset N is the initial contents of guest address N (holes in a sparse
+ * file read as zero).
+ *
+ * Guest memory is mapped privately from the image, so every simulation
+ * using the same image shares its pages through the host page cache, and
+ * only pages which a simulation writes to are copied. Discarding those
+ * copies returns the memory to the image, which is much cheaper than
+ * reloading it.
+ */
+
+#ifndef MEMORYIMAGE_H
+#define MEMORYIMAGE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace archsim
+{
+	namespace abi
+	{
+		namespace memory
+		{
+			class RegionBasedMemoryModel;
+
+			class MemoryImage
+			{
+			public:
+				static const size_t kPageSize = 4096;
+
+				MemoryImage();
+				~MemoryImage();
+
+				MemoryImage(const MemoryImage &) = delete;
+				MemoryImage &operator=(const MemoryImage &) = delete;
+
+				// The image can be any file which can be mapped, including a
+				// memfd passed down by a parent process as /dev/fd/N.
+				bool Open(const std::string &filename);
+				void Close();
+
+				bool IsOpen() const
+				{
+					return fd_ >= 0;
+				}
+
+				// The size of the image, rounded up to a whole page
+				uint64_t GetSize() const
+				{
+					return size_;
+				}
+
+				// Map guest memory at a page aligned host address. The part
+				// covered by the image is mapped copy-on-write from it, and
+				// the rest is mapped as anonymous memory.
+				bool Map(void *host_addr, uint64_t guest_addr, uint64_t size, int prot) const;
+
+				// Throw away every change to memory which was mapped by Map,
+				// returning it to the contents of the image (or to zero where
+				// there is no image).
+				static bool Reset(void *host_addr, uint64_t size);
+
+				// Copy data into mapped memory, skipping pages whose contents
+				// are unchanged so that they stay shared with the image.
+				// Returns the number of pages which were written.
+				static size_t Write(void *host_addr, const void *data, size_t size);
+
+				// Write the memory of every region of a memory model to a new
+				// image. Zero pages are left as holes.
+				static bool Save(RegionBasedMemoryModel &model, const std::string &filename);
+
+			private:
+				int fd_;
+				uint64_t size_;
+			};
+		}
+	}
+}
+
+#endif /* MEMORYIMAGE_H */
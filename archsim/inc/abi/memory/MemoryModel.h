@@ -14,6 +14,7 @@
 
 #include "translate/profile/CodeRegionTracker.h"
 #include "abi/devices/Component.h"
+#include "abi/memory/MemoryImage.h"
 
 #include <string.h>
 #include <string>
@@ -385,6 +386,14 @@ namespace archsim
 
 				virtual MappingManager *GetMappingManager() override;
 
+				typedef std::map<guest_addr_t, GuestVMA *> GuestVMAMap;
+
+				// All of the currently mapped regions, in address order.
+				const GuestVMAMap &GetVMAs() const
+				{
+					return guest_vmas;
+				}
+
 			protected:
 				bool HasIntersectingRegions(guest_addr_t addr, guest_size_t size);
 				bool VMAIntersects(GuestVMA& vma, guest_size_t size);
@@ -402,8 +411,6 @@ namespace archsim
 					return result ? cached_vma : NULL;
 				}
 
-				typedef std::map<guest_addr_t, GuestVMA *> GuestVMAMap;
-
 			private:
 				bool AllocateRegion(archsim::Address addr, uint64_t size);
 				bool DeallocateRegion(archsim::Address addr, uint64_t size);
@@ -453,6 +460,11 @@ namespace archsim
 				MemoryTranslationModel &GetTranslationModel() override;
 				host_addr_t mem_base;
 
+				// Throw away every change to guest memory, returning it to the
+				// base memory image (or to zero if there isn't one), so that
+				// the model can be reused for another run.
+				bool ResetToBase();
+
 			protected:
 				bool AllocateVMA(GuestVMA &vma) override;
 				bool DeallocateVMA(GuestVMA &vma) override;
@@ -464,6 +476,10 @@ namespace archsim
 
 				bool is_initialised;
 
+				// Guest memory is mapped copy-on-write from this image, if
+				// one is open
+				MemoryImage image;
+
 				inline host_addr_t GuestToHost(guest_addr_t addr) const
 				{
 					return (host_addr_t)((unsigned long)mem_base + (unsigned long)addr.Get());
@@ -82,8 +82,15 @@ namespace archsim
 
 				uint64_t GetSATP() const;
 				void SetSATP(uint64_t new_satp);
+
+				bool SaveState(archsim::abi::devices::DeviceState &state) override;
+				bool RestoreState(archsim::abi::devices::DeviceState &state) override;
 				int GetPTLevels(Mode mode) const;
 
+			protected:
+				bool GetTLBContext(archsim::core::thread::ThreadInstance *cpu, const archsim::abi::devices::AccessInfo &info, archsim::abi::devices::TLBContext &context) override;
+				bool HasExplicitTLBMaintenance() const override;
+
 			private:
 				using PTEInfo = std::tuple<archsim::Address, archsim::abi::devices::PageInfo>;
 				PTEInfo GetInfoLevel(Address virt_addr, Address table, int level);
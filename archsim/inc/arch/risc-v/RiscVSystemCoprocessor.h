@@ -48,6 +48,9 @@ namespace archsim
 				virtual bool Read64(uint32_t address, uint64_t& data);
 				virtual bool Write64(uint32_t address, uint64_t data);
 
+				bool SaveState(archsim::abi::devices::DeviceState &state) override;
+				bool RestoreState(archsim::abi::devices::DeviceState &state) override;
+
 				void MachinePendInterrupt(uint64_t mask);
 				void MachineUnpendInterrupt(uint64_t mask);
 
@@ -102,7 +105,7 @@ namespace archsim
 				class STATUS_t
 				{
 				public:
-					STATUS_t(archsim::util::PubSubContext &pubsub);
+					STATUS_t(archsim::util::PubSubContext &pubsub, archsim::core::thread::ThreadInstance *hart);
 					bool SD;
 					uint8_t SXL;
 					uint8_t UXL;
@@ -131,6 +134,7 @@ namespace archsim
 
 				private:
 					archsim::util::PubSubContext &pubsub_;
+					archsim::core::thread::ThreadInstance *hart_;
 				};
 				STATUS_t STATUS;
 
@@ -16,6 +16,7 @@
 #include "core/thread/ProcessorFeatures.h"
 
 #include <array>
+#include <cstddef>
 #include <cstring>
 
 namespace archsim
@@ -28,102 +29,122 @@ namespace archsim
 		struct BlockCacheEntry {
 			uint64_t virt_tag;
 			block_txln_fn ptr;
-		};
-
-// Need BlockCacheEntry to be 16 bytes to be compatible with block trampoline assembly and dispatch logic
-		static_assert(sizeof(struct BlockCacheEntry) == 16, "Block Cache Entry must be 16 bytes!");
-
-// don't care how big the features set is though
-		class BlockFeaturesEntry
-		{
-		public:
-			BlockFeaturesEntry() : feature_required_mask(0), feature_level(0) {}
 
-			uint64_t feature_required_mask;
-			uint64_t feature_level;
+			// The entry is only valid if this matches the cache's current
+			// generation
+			uint64_t generation;
+			uint64_t reserved;
 		};
 
+// Need BlockCacheEntry to be 32 bytes, so that the dispatch logic can index the cache with a shift
+		static_assert(sizeof(struct BlockCacheEntry) == 32, "Block Cache Entry must be 32 bytes!");
+		// The dispatch logic compares the tag at the start of the entry
+		static_assert(offsetof(BlockCacheEntry, virt_tag) == 0, "Block cache entry tag must come first");
+
+		/**
+		 * A direct mapped cache of translations, indexed by virtual address.
+		 *
+		 * Every entry is tagged with the generation in which it was
+		 * inserted, so invalidating the whole cache only has to start a new
+		 * generation, rather than rewrite every entry. Translated code checks
+		 * the generation too: it is stored just before the entries, at
+		 * kGenerationOffset from GetPtr().
+		 */
 		class BlockCache
 		{
 		public:
-			BlockCache()
+			static const uint32_t kCacheBits = BLOCKCACHE_SIZE_BITS;
+			static const uint32_t kCacheSize = BLOCKCACHE_SIZE;
+			static const uint32_t kEntryShift = 5;
+			static const int32_t kGenerationOffset = -8;
+
+			// XXX ARM HAX
+			static const uint32_t kInstructionShift = BLOCKCACHE_INSTRUCTION_SHIFT;
+
+			BlockCache() : generation_(kInvalidGeneration)
 			{
-				Invalidate();
+				// Translated code finds the generation relative to the entries
+				static_assert((int32_t)(offsetof(BlockCache, cache_) - offsetof(BlockCache, generation_)) == -kGenerationOffset, "Block cache generation must be just before the entries");
+
+				Reset();
 			}
 
 			bool Contains(Address address) const
 			{
 				const auto &entry = GetEntry(address);
-				return entry.virt_tag == address.Get();
+				return entry.virt_tag == address.Get() && entry.generation == generation_;
 			}
 
 			block_txln_fn Lookup(Address address) const
 			{
 				const auto &entry = GetEntry(address);
-				if(entry.virt_tag == address.Get()) return entry.ptr;
+				if(entry.virt_tag == address.Get() && entry.generation == generation_) return entry.ptr;
 				return NULL;
 			}
 
 			void Insert(Address address, block_txln_fn ptr, const archsim::ProcessorFeatureSet &required_features)
 			{
-				auto &entry = GetEntry(address);
+				uint32_t index = GetIndex(address);
+
+				auto &entry = cache_[index];
 				entry.virt_tag = address.Get();
 				entry.ptr = ptr;
+				entry.generation = generation_;
 
-				auto &features = GetFeatures(address);
-				features.feature_required_mask = required_features.GetRequiredMask();
-				features.feature_level = required_features.GetLevelMask();
+				feature_required_masks_[index] = required_features.GetRequiredMask();
+				feature_levels_[index] = required_features.GetLevelMask();
 			}
 
-			void Invalidate();
-
-			void InvalidateFeatures(uint64_t current_mask)
+			// Invalidate every entry, by starting a new generation
+			void Invalidate()
 			{
-				for(unsigned i = 0; i < kCacheSize; ++i) {
-					const auto &features = feature_cache_[i];
-					__builtin_prefetch((void*)&(cache_[i+1]));
-					__builtin_prefetch((void*)&(feature_cache_[i+1]));
-					if((current_mask & features.feature_required_mask) != features.feature_level) {
-						cache_[i].virt_tag = 1;
-					}
+				if(++generation_ == kInvalidGeneration) {
+					Reset();
 				}
 			}
 
+			// Invalidate the entries which need features that are not in
+			// current_mask
+			void InvalidateFeatures(uint64_t current_mask);
+
 			struct BlockCacheEntry *GetPtr()
 			{
 				return cache_.data();
 			}
 
-			static const uint32_t kCacheBits = BLOCKCACHE_SIZE_BITS;
-			static const uint32_t kCacheSize = BLOCKCACHE_SIZE;
-
-			// XXX ARM HAX
-			static const uint32_t kInstructionShift = BLOCKCACHE_INSTRUCTION_SHIFT;
-
-
+			uint64_t GetGeneration() const
+			{
+				return generation_;
+			}
 
 			const BlockCacheEntry &GetEntry(Address address) const
 			{
-				return cache_[(address.Get() >> kInstructionShift) % kCacheSize];
+				return cache_[GetIndex(address)];
 			}
 			BlockCacheEntry &GetEntry(Address address)
 			{
-				return cache_[(address.Get() >> kInstructionShift) % kCacheSize];
+				return cache_[GetIndex(address)];
 			}
+
 		private:
-			const BlockFeaturesEntry &GetFeatures(Address address) const
-			{
-				return feature_cache_[(address.Get() >> kInstructionShift) % kCacheSize];
-			}
-			BlockFeaturesEntry &GetFeatures(Address address)
+			static const uint64_t kInvalidGeneration = 0;
+
+			static uint32_t GetIndex(Address address)
 			{
-				return feature_cache_[(address.Get() >> kInstructionShift) % kCacheSize];
+				return (address.Get() >> kInstructionShift) % kCacheSize;
 			}
 
-			// We really want the BlockCacheEntry struct to be 16 bytes
+			// Clear every entry and start again from the first generation
+			void Reset();
 
+			// Must come immediately before cache_ (see kGenerationOffset)
+			uint64_t generation_;
 			std::array<BlockCacheEntry, kCacheSize> cache_;
-			std::array<BlockFeaturesEntry, kCacheSize> feature_cache_;
+
+			// The features required by each entry are kept apart from the
+			// entries, so that they can be scanned without touching them
+			alignas(16) std::array<uint64_t, kCacheSize> feature_required_masks_;
+			alignas(16) std::array<uint64_t, kCacheSize> feature_levels_;
 		};
 
 	}
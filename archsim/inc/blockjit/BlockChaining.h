@@ -0,0 +1,99 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * BlockChaining.h
+ *
+ * Direct jumps between block JIT translations. A translation which ends in
+ * a direct branch contains a patchable jump for each of its successors. The
+ * jumps are linked to the successors' translations once both exist, and are
+ * unlinked again when either translation is retired.
+ */
+
+#ifndef INC_BLOCKJIT_BLOCKCHAINING_H_
+#define INC_BLOCKJIT_BLOCKCHAINING_H_
+
+#include "abi/Address.h"
+#include "blockjit/ir.h"
+#include "core/thread/ProcessorFeatures.h"
+
+#include <unordered_map>
+#include <vector>
+
+namespace archsim
+{
+	using captive::shared::block_txln_fn;
+
+	namespace blockjit
+	{
+		class BlockProfile;
+		class BlockTranslation;
+
+		/**
+		 * A patchable jump in a translation. Offset is the position of the
+		 * 32 bit displacement of an x86 jmp, which is aligned so that it can
+		 * be rewritten while other threads are executing the code. While the
+		 * slot is unlinked, it jumps to ExitOffset, which returns to the
+		 * execution engine.
+		 */
+		struct ChainSlot {
+			uint32_t Offset;
+			uint32_t ExitOffset;
+			uint64_t TargetPC;
+		};
+
+		/**
+		 * Keeps track of every chain slot in the translations of a block
+		 * profile. Slots can only be linked to translations on the same
+		 * physical page, since a translation is only reached through a
+		 * virtual PC which maps to its page. Translations which continue
+		 * onto other pages can only be linked to themselves, since other
+		 * translations do not check that those pages are still mapped.
+		 *
+		 * This class is not thread safe: it must only be used while holding
+		 * the owning BlockProfile's lock.
+		 */
+		class BlockChainTable
+		{
+		public:
+			// Record the slots of a newly inserted translation, and link any
+			// slots (its own or other translations') which target it.
+			void Insert(Address phys_addr, const BlockTranslation &txln, const std::vector<ChainSlot> &slots, const BlockProfile &profile);
+
+			// Unlink every slot in, or targeting, a translation which is
+			// being retired. The code must not have been freed yet.
+			void Retire(block_txln_fn fn);
+
+			uint64_t GetLinkCount() const
+			{
+				return link_count_;
+			}
+
+		private:
+			struct Link {
+				ChainSlot Slot;
+				Address Target;
+				block_txln_fn Linked;
+			};
+
+			struct ChainedTranslation {
+				Address PhysAddr;
+				ProcessorFeatureSet Features;
+				bool MultiPage;
+				std::vector<Link> Links;
+			};
+
+			void linkSlot(block_txln_fn owner, const ChainedTranslation &chained, Link &link, block_txln_fn target);
+			void unlinkSlot(block_txln_fn owner, Link &link);
+
+			std::unordered_map<block_txln_fn, ChainedTranslation> translations_;
+
+			// The translations with at least one slot targeting each address
+			std::unordered_map<Address, std::vector<block_txln_fn>> waiting_;
+
+			uint64_t link_count_ = 0;
+		};
+
+	}
+}
+
+#endif /* INC_BLOCKJIT_BLOCKCHAINING_H_ */
@@ -13,8 +13,11 @@
 #include "abi/Address.h"
 #include "translate/profile/Region.h"
 #include "blockjit/translation-context.h"
+#include "blockjit/BlockChaining.h"
+#include "blockjit/BlockProfile.h"
 #include "blockjit/IRBuilder.h"
 #include "core/thread/ProcessorFeatures.h"
+#include "translate/TranslationStore.h"
 
 #include "arch/arm/ARMDecodeContext.h"
 
@@ -85,6 +88,18 @@ namespace gensim
 				_decode_ctx = dec;
 			}
 
+			// The host pointers embedded in the most recently translated block
+			const std::vector<archsim::translate::HostRelocation> &GetLastRelocations() const
+			{
+				return _last_relocations;
+			}
+
+			// The chain slots in the most recently translated block
+			const std::vector<archsim::blockjit::ChainSlot> &GetLastChainSlots() const
+			{
+				return _last_chain_slots;
+			}
+
 		private:
 
 			std::map<uint32_t, uint32_t> _feature_levels;
@@ -108,10 +123,27 @@ namespace gensim
 
 			bool _should_be_dumped;
 
+			std::vector<archsim::translate::HostRelocation> _last_relocations;
+			std::vector<archsim::blockjit::ChainSlot> _last_chain_slots;
+
+			// The PC which the block being translated starts at, the other
+			// pages which it continues onto, the cache lines of the first
+			// page which it has been decoded from, and the number of guest
+			// instructions in it so far
+			archsim::Address _entry_pc;
+			std::vector<archsim::blockjit::TranslationPage> _trace_pages;
+			uint64_t _entry_code_lines;
+			uint32_t _trace_length;
+
 			bool compile_block(archsim::core::thread::ThreadInstance *cpu, archsim::Address block_address, captive::arch::jit::TranslationContext &ctx, archsim::blockjit::BlockTranslation &fn, wulib::MemAllocator &allocator);
 
 			bool emit_block(archsim::core::thread::ThreadInstance *cpu, archsim::Address block_address, captive::shared::IRBuilder &ctx, std::unordered_set<archsim::Address> &block_heads);
 			bool emit_chain(archsim::core::thread::ThreadInstance *cpu, archsim::Address block_address, gensim::BaseDecode *insn, captive::shared::IRBuilder &ctx);
+			void emit_side_exit(archsim::Address site_pc, archsim::Address next_pc, captive::shared::IRBuilder &ctx);
+
+			bool can_continue_trace(archsim::core::thread::ThreadInstance *cpu, archsim::Address pc);
+			void mark_code(archsim::Address pc, uint32_t length);
+			bool predict_branch(gensim::BaseDecode *decode, archsim::Address pc, archsim::Address &predicted, archsim::Address &other);
 
 			bool can_merge_jump(archsim::core::thread::ThreadInstance *cpu, gensim::BaseDecode *decode, archsim::Address pc);
 			archsim::Address get_jump_target(archsim::core::thread::ThreadInstance *cpu, gensim::BaseDecode *decode, archsim::Address pc);
@@ -11,6 +11,7 @@
 #define INC_BLOCKJIT_BLOCKPROFILE_H_
 
 #include "blockjit/ir.h"
+#include "blockjit/BlockChaining.h"
 #include "abi/Address.h"
 #include "util/MemAllocator.h"
 #include "util/LogContext.h"
@@ -18,10 +19,11 @@
 #include "core/thread/ProcessorFeatures.h"
 
 #include <array>
-#include <bitset>
-#include <map>
+#include <atomic>
+#include <cassert>
+#include <mutex>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 UseLogContext(LogBlockProfile);
 
@@ -33,18 +35,39 @@ namespace archsim
 	namespace blockjit
 	{
 
+		/**
+		 * A page, other than the one it starts on, which a translation
+		 * continues onto. The virtual page is kept relative to the page the
+		 * translation starts on, since the same code can be entered through
+		 * different virtual mappings. The translation is only valid while
+		 * that virtual page still maps to the same physical page.
+		 */
+		struct TranslationPage {
+			uint64_t VirtualOffset;
+			Address Physical;
+			uint64_t CodeLines;
+		};
+
 		class BlockTranslation
 		{
 		public:
-			BlockTranslation() : fn_(nullptr), features_required_(nullptr), size_(0) {}
+			static const uint32_t kMaxExtraPages = 3;
+			static const uint64_t kAllLines = ~0ull;
+
+			BlockTranslation() : fn_(nullptr), features_required_(nullptr), size_(0), code_lines_(kAllLines), extra_page_count_(0) {}
 			BlockTranslation(const BlockTranslation &other) :
 				fn_(other.fn_),
 				features_required_(nullptr),
-				size_(other.size_)
+				size_(other.size_),
+				code_lines_(other.code_lines_),
+				extra_page_count_(other.extra_page_count_)
 			{
 				if(other.features_required_ != nullptr) {
 					features_required_ = new ProcessorFeatureSet(*other.features_required_);
 				}
+				for(uint32_t i = 0; i < extra_page_count_; ++i) {
+					extra_pages_[i] = other.extra_pages_[i];
+				}
 			}
 
 			~BlockTranslation()
@@ -83,13 +106,15 @@ namespace archsim
 			void Invalidate()
 			{
 				fn_ = nullptr;
+				code_lines_ = kAllLines;
+				extra_page_count_ = 0;
 				if(features_required_) {
 					delete features_required_;
 					features_required_ = nullptr;
 				}
 			}
 
-			archsim::ProcessorFeatureSet GetFeatures()
+			archsim::ProcessorFeatureSet GetFeatures() const
 			{
 				if(features_required_)
 					return *features_required_;
@@ -105,27 +130,85 @@ namespace archsim
 				return size_;
 			}
 
+			// The cache lines of the first page which the translation was
+			// decoded from (see CodeRegionTracker). Unless they are known,
+			// the whole page is assumed to be code.
+			void SetCodeLines(uint64_t lines)
+			{
+				code_lines_ = lines;
+			}
+			uint64_t GetCodeLines() const
+			{
+				return code_lines_;
+			}
+
+			void AddExtraPage(uint64_t virt_offset, Address phys_page, uint64_t code_lines = kAllLines)
+			{
+				assert(extra_page_count_ < kMaxExtraPages);
+				extra_pages_[extra_page_count_++] = { virt_offset, phys_page.PageBase(), code_lines };
+			}
+			uint32_t GetExtraPageCount() const
+			{
+				return extra_page_count_;
+			}
+			const TranslationPage &GetExtraPage(uint32_t index) const
+			{
+				return extra_pages_[index];
+			}
+
 			void Dump(const std::string &filename);
 
 		private:
 			block_txln_fn fn_;
 			archsim::ProcessorFeatureSet *features_required_;
 			size_t size_;
+			uint64_t code_lines_;
+
+			uint32_t extra_page_count_;
+			TranslationPage extra_pages_[kMaxExtraPages];
 		};
 
+		/**
+		 * A translation which has been removed from the profile, but which
+		 * may still be referenced by a thread's virtual block cache (or be
+		 * executing). It can only be freed once every thread has passed
+		 * through a quiescent point after the epoch in which it was retired.
+		 */
+		struct RetiredTranslation {
+			uint64_t epoch;
+			BlockTranslation *txln;
+		};
+
+		/**
+		 * The translations for a single physical page. Lookups are lock free:
+		 * translations are published through atomic pointers and are never
+		 * modified once published. All modifications must be performed while
+		 * holding the owning BlockProfile's lock.
+		 */
 		class BlockPageProfile
 		{
 		public:
-			BlockPageProfile(wulib::MemAllocator &allocator);
+			BlockPageProfile();
 			~BlockPageProfile();
 
-			void Insert(Address address, const BlockTranslation &txln);
-			void InvalidateTxln(Address address);
-			void Invalidate();
+			void Insert(Address address, BlockTranslation *txln, std::vector<BlockTranslation*> &retired);
+
+			// Remove the translations which were decoded from any of the
+			// given lines of this page, and clear the page's dirty lines.
+			void Invalidate(std::vector<BlockTranslation*> &retired, uint64_t lines = BlockTranslation::kAllLines);
 
-			BlockTranslation &Get(Address address)
+			// Remove the translation at an address, if it is still the given one.
+			void Remove(Address address, block_txln_fn fn, std::vector<BlockTranslation*> &retired);
+
+			BlockTranslation Get(Address address) const
 			{
-				return getChunk(address)[(address.GetPageOffset() >> kInstructionAlignment) % kBlocksPerChunk];
+				const table_chunk_t *chunk = getChunkPtr(address).load(std::memory_order_acquire);
+				if(chunk == nullptr) return BlockTranslation();
+
+				const BlockTranslation *txln = (*chunk)[getChunkIndex(address)].load(std::memory_order_acquire);
+				if(txln == nullptr) return BlockTranslation();
+
+				return *txln;
 			}
 
 			static const size_t kInstructionAlignment = 0;
@@ -133,11 +216,15 @@ namespace archsim
 
 			bool IsDirty() const
 			{
-				return _dirty;
+				return GetDirtyLines() != 0;
+			}
+			uint64_t GetDirtyLines() const
+			{
+				return _dirty_lines.load(std::memory_order_relaxed);
 			}
-			void MakeDirty()
+			void MakeDirty(uint64_t lines)
 			{
-				_dirty = true;
+				_dirty_lines.fetch_or(lines, std::memory_order_relaxed);
 			}
 
 		private:
@@ -146,99 +233,118 @@ namespace archsim
 			static const uint32_t kMaxBlocksPerPage = kPageSize / kInstructionSize;
 			static const uint32_t kBlocksPerChunk = 128;
 
-			typedef std::unordered_map<uint32_t, BlockTranslation> table_chunk_t;
+			typedef std::array<std::atomic<BlockTranslation*>, kBlocksPerChunk> table_chunk_t;
 
-			table_chunk_t *&getChunkPtr(Address address)
+			static uint32_t getChunkIndex(Address address)
+			{
+				return (address.GetPageOffset() >> kInstructionAlignment) % kBlocksPerChunk;
+			}
+			std::atomic<table_chunk_t*> &getChunkPtr(Address address)
 			{
 				return _table.at((address.GetPageOffset() >> kInstructionAlignment) / kBlocksPerChunk);
 			}
-			table_chunk_t &getChunk(Address address)
+			const std::atomic<table_chunk_t*> &getChunkPtr(Address address) const
 			{
-				table_chunk_t *&ptr = getChunkPtr(address);
-				if(ptr == nullptr) ptr = new table_chunk_t();
-				return *ptr;
+				return _table.at((address.GetPageOffset() >> kInstructionAlignment) / kBlocksPerChunk);
 			}
+			table_chunk_t &getChunk(Address address);
 
-			std::array<table_chunk_t*, kMaxBlocksPerPage/kBlocksPerChunk> _table;
-
-			std::unordered_set<block_txln_fn> _txlns;
-
-			wulib::MemAllocator &_allocator;
-
-			bool _dirty:1;
-			bool _valid:1;
+			std::array<std::atomic<table_chunk_t*>, kMaxBlocksPerPage/kBlocksPerChunk> _table;
+			std::atomic<uint64_t> _dirty_lines;
 		};
 
-
+		/**
+		 * The physical block profile is shared between every thread attached
+		 * to an execution engine. Lookups never take a lock, so a translation
+		 * produced by one thread becomes visible to every other thread as soon
+		 * as it is inserted. Translations which are invalidated are retired
+		 * rather than freed, and are reclaimed by the execution engine once
+		 * no thread can still be holding a reference to them.
+		 */
 		class BlockProfile
 		{
 		public:
 			BlockProfile(wulib::MemAllocator &allocator);
+			~BlockProfile();
 
-			void Insert(Address address, const BlockTranslation &txln);
-			void InvalidatePage(Address address);
-			void Invalidate();
+			// Returns the size of the code retired to make way for the new
+			// translation, which can't be reclaimed until retire_epoch has
+			// been started.
+			size_t Insert(Address address, const BlockTranslation &txln, uint64_t retire_epoch, const std::vector<ChainSlot> &chain_slots = std::vector<ChainSlot>());
+			void InvalidatePage(Address address, uint64_t epoch);
+			void Invalidate(uint64_t epoch);
 
-			uint64_t GetTotalCodeSize()
+			uint64_t GetTotalCodeSize() const
 			{
-				return code_size_;
+				return code_size_.load(std::memory_order_relaxed);
 			}
 
-			bool IsPageDirty(Address addr)
+			bool IsPageDirty(Address addr) const
 			{
-				return getProfile(addr).IsDirty();
+				auto profile = getProfilePtr(addr);
+				return profile != nullptr && profile->IsDirty();
 			}
-			void MarkPageDirty(Address addr)
+			void MarkPageDirty(Address addr, uint64_t lines = BlockTranslation::kAllLines);
+
+			// Retire the translations of all pages which have been marked as
+			// dirty. Returns true if anything was retired.
+			bool GarbageCollect(uint64_t epoch);
+
+			// Free all retired translations which were retired in or before
+			// the given epoch. The caller must ensure that nothing else is
+			// using the memory allocator.
+			void Reclaim(uint64_t safe_epoch);
+			bool HasRetired() const
 			{
-				LC_DEBUG1(LogBlockProfile) << "Marking page " << std::hex << addr.GetPageBase() << " as dirty";
-				getProfile(addr).MakeDirty();
-				_dirty_pages.push_back({addr.PageBase(), &getProfile(addr)});
+				return has_retired_.load(std::memory_order_acquire);
 			}
 
-			void GarbageCollect();
-
 			// XXX ARM HAX
 			static const size_t kInstructionSize = BlockPageProfile::kInstructionSize;
 
-			BlockTranslation Get(Address address, const archsim::ProcessorFeatureSet &features)
+			BlockTranslation Get(Address address, const archsim::ProcessorFeatureSet &features) const
 			{
-				auto txln = getProfile(address).Get(address);
-
-				if(txln.IsValid(features)) {
-					return txln;
-				} else {
-					getProfile(address).InvalidateTxln(address);
-					return txln;
-				}
+				auto profile = getProfilePtr(address);
+				if(profile == nullptr) return BlockTranslation();
+				return profile->Get(address);
 			}
 
 		private:
-			static const size_t kTableCount = archsim::translate::profile::RegionArch::PageCount;
-			static const size_t kTablePageBits = 12;
-			static const size_t kTablePageSize = 1 << kTablePageBits;
-			static const size_t kTablePageCount = kTableCount / kTablePageSize;
-
 			static const size_t kProfileCount = archsim::translate::profile::RegionArch::PageCount;
 
-			BlockPageProfile &getProfile(Address address)
+			const BlockPageProfile *getProfilePtr(Address address) const
 			{
-				if(!hasProfile(address)) {
-					_page_profiles[address.GetPageIndex()] = new BlockPageProfile(_allocator);
-				}
-				return *_page_profiles[address.GetPageIndex()];
-			}
-			bool hasProfile(Address address)
-			{
-				return _page_profiles[address.GetPageIndex()] != nullptr;
+				return _page_profiles[address.GetPageIndex()].load(std::memory_order_acquire);
 			}
+			BlockPageProfile &getProfile(Address address);
+			void retire(std::vector<BlockTranslation*> &txlns, uint64_t epoch);
 
-			std::bitset<kTablePageCount> _table_pages_dirty;
+			// Remove the translations from other pages which continue onto
+			// the given lines of a page.
+			void invalidateSpanning(Address page, uint64_t lines, std::vector<BlockTranslation*> &retired);
+			void invalidateDirty(Address page, BlockPageProfile &profile, std::vector<BlockTranslation*> &retired);
 
+			std::mutex _lock;
 			std::vector<std::pair<Address, BlockPageProfile *> > _dirty_pages;
+			std::vector<RetiredTranslation> _retired;
+
+			// For each physical page, the translations which start on another
+			// page but continue onto it, by the address they start at.
+			struct SpanningTranslation {
+				Address Entry;
+				block_txln_fn Fn;
+				uint64_t CodeLines;
+			};
+			std::unordered_map<Address, std::vector<SpanningTranslation>> _spanning;
+			std::atomic<bool> has_retired_;
+
+			std::atomic<uint64_t> code_size_;
 
-			uint64_t code_size_;
+			// Retired translations are unlinked from (and by) the others as
+			// soon as they are retired, rather than when they are freed.
+			BlockChainTable _chains;
 
-			BlockPageProfile *_page_profiles[kProfileCount];
+			std::atomic<BlockPageProfile*> *_page_profiles;
 			wulib::MemAllocator &_allocator;
 		};
 
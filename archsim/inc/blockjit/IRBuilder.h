@@ -181,7 +181,7 @@ namespace captive
 			INSN5(call, CALL);
 			INSN6(call, CALL);
 
-			INSN4(dispatch, DISPATCH);
+			INSN5(dispatch, DISPATCH);
 			INSN2(set_cpu_feature, SET_CPU_FEATURE);
 			INSN1(set_cpu_mode, SET_CPU_MODE);
 
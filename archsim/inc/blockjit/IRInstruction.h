@@ -168,6 +168,17 @@ namespace captive
 				_END
 			};
 
+			// Flags describing the branch which ends a block, for dispatch
+			// instructions. Direct branches to the target (and fallthrough,
+			// if it is nonzero) are chained; indirect branches go through
+			// the thread's indirect target cache.
+			enum DispatchKind : uint8_t {
+				DISPATCH_DIRECT = 0,
+				DISPATCH_INDIRECT = 1,
+				DISPATCH_CALL = 2,
+				DISPATCH_RETURN = 4
+			};
+
 			util::FastVector<IROperand, 2> operands;
 			IRBlockId ir_block;
 			IRInstructionType type;
@@ -199,10 +210,13 @@ namespace captive
 			{
 				return IRInstruction(RET);
 			}
-			static IRInstruction dispatch(const IROperand &target, const IROperand &fallthrough, const IROperand &target_block, const IROperand &fallthrough_block)
+			// For calls, the fallthrough is the return address. The site is
+			// the PC of the branch, and the entry is the PC that the
+			// translation starts at: only PCs on the entry's page are chained.
+			static IRInstruction dispatch(const IROperand &target, const IROperand &fallthrough, const IROperand &kind, const IROperand &site, const IROperand &entry)
 			{
-				assert(target.is_constant() && fallthrough.is_constant());
-				return IRInstruction(DISPATCH, target, fallthrough, target_block, fallthrough_block);
+				assert(target.is_constant() && fallthrough.is_constant() && kind.is_constant() && site.is_constant() && entry.is_constant());
+				return IRInstruction(DISPATCH, target, fallthrough, kind, site, entry);
 			}
 			static IRInstruction trap()
 			{
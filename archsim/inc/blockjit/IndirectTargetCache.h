@@ -0,0 +1,132 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * IndirectTargetCache.h
+ *
+ * Per-thread caches which let block JIT translations follow indirect
+ * branches without returning to the execution engine. Each indirect branch
+ * site hashes to a set of two {PC, translation} entries, most recently used
+ * first, which are filled from the block cache by the translated code itself.
+ * Calls also push their return address onto a small return stack, along with
+ * a chained jump in the calling translation which continues at that address,
+ * so that the matching return can go straight back to it.
+ *
+ * Entries are either copied from the thread's block cache or point into live
+ * translations, so the whole cache must be invalidated whenever the block
+ * cache is. As in the block cache, every entry is tagged with the generation
+ * in which it was filled, so invalidating only starts a new generation.
+ */
+
+#ifndef INC_BLOCKJIT_INDIRECTTARGETCACHE_H_
+#define INC_BLOCKJIT_INDIRECTTARGETCACHE_H_
+
+#include "abi/Address.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace archsim
+{
+	namespace blockjit
+	{
+		class IndirectTargetCache
+		{
+		public:
+			struct Entry {
+				uint64_t virt_tag;
+				void *ptr;
+				// Only valid if this matches the cache's current generation
+				uint64_t generation;
+				uint64_t reserved;
+			};
+
+			static_assert(sizeof(Entry) == 32, "Indirect target cache entries must be 32 bytes");
+
+			static const uint32_t kEntryShift = 5;
+			static const uint32_t kSiteBits = 9;
+			static const uint32_t kSiteCount = 1 << kSiteBits;
+			static const uint32_t kSiteWays = 2;
+			static const uint32_t kReturnStackSize = 16;
+
+			IndirectTargetCache()
+			{
+				static_assert(sizeof(Entry) == 1 << kEntryShift, "Entry shift must match the entry size");
+				Reset();
+			}
+
+			// Invalidate every entry, by starting a new generation
+			void Invalidate()
+			{
+				if(++generation_ == kInvalidGeneration) {
+					Reset();
+				}
+				return_top_ = 0;
+			}
+
+			uint64_t GetGeneration() const
+			{
+				return generation_;
+			}
+
+			// The set of entries used by the branch at the end of the block
+			// at the given PC.
+			static uint32_t GetSiteIndex(Address site_pc)
+			{
+				uint64_t pc = site_pc.Get();
+				return (pc ^ (pc >> kSiteBits)) % kSiteCount;
+			}
+
+			const Entry &GetSiteEntry(uint32_t site, uint32_t way) const
+			{
+				return sites_[site][way];
+			}
+
+			const Entry &GetReturnEntry(uint32_t index) const
+			{
+				return return_stack_[index % kReturnStackSize];
+			}
+
+			uint32_t GetReturnTop() const
+			{
+				return return_top_;
+			}
+
+			// Offsets for translated code, which has a pointer to the cache
+			// in the state block.
+			static size_t GetSiteOffset(uint32_t site)
+			{
+				return offsetof(IndirectTargetCache, sites_) + site * sizeof(Entry) * kSiteWays;
+			}
+
+			static size_t GetReturnStackOffset()
+			{
+				return offsetof(IndirectTargetCache, return_stack_);
+			}
+
+			static size_t GetReturnTopOffset()
+			{
+				return offsetof(IndirectTargetCache, return_top_);
+			}
+
+			static size_t GetGenerationOffset()
+			{
+				return offsetof(IndirectTargetCache, generation_);
+			}
+
+		private:
+			static const uint64_t kInvalidGeneration = 0;
+
+			// Clear every entry and start again from the first generation
+			void Reset();
+
+			uint64_t generation_;
+			Entry sites_[kSiteCount][kSiteWays];
+			Entry return_stack_[kReturnStackSize];
+			uint32_t return_top_;
+		};
+
+		static_assert((IndirectTargetCache::kReturnStackSize & (IndirectTargetCache::kReturnStackSize - 1)) == 0, "Return stack size must be a power of two");
+	}
+}
+
+#endif /* INC_BLOCKJIT_INDIRECTTARGETCACHE_H_ */
@@ -12,9 +12,11 @@
 
 #include "blockjit/block-compiler/block-compiler.h"
 #include "blockjit/ir.h"
+#include "blockjit/BlockChaining.h"
 #include "core/thread/ThreadInstance.h"
 #include <wutils/vbitset.h>
 #include "util/MemAllocator.h"
+#include "translate/TranslationStore.h"
 
 #include <string.h>
 
@@ -32,9 +34,17 @@ namespace captive
 				{
 				public:
 					LoweringResult(captive::shared::block_txln_fn fn, size_t size) : Function(fn), Size(size) {}
+					LoweringResult(captive::shared::block_txln_fn fn, size_t size, const std::vector<archsim::translate::HostRelocation> &relocations) : Function(fn), Size(size), Relocations(relocations) {}
+					LoweringResult(captive::shared::block_txln_fn fn, size_t size, const std::vector<archsim::translate::HostRelocation> &relocations, const std::vector<archsim::blockjit::ChainSlot> &chain_slots) : Function(fn), Size(size), Relocations(relocations), ChainSlots(chain_slots) {}
 
 					captive::shared::block_txln_fn Function;
 					size_t Size;
+
+					// Absolute host pointers embedded in the generated code
+					std::vector<archsim::translate::HostRelocation> Relocations;
+
+					// Jumps which can be linked directly to other translations
+					std::vector<archsim::blockjit::ChainSlot> ChainSlots;
 				};
 
 				LoweringResult NativeLowering(TranslationContext &ctx, wulib::MemAllocator &allocator, const archsim::ArchDescriptor &arch, const archsim::StateBlockDescriptor &state, const CompileResult &compile_result);
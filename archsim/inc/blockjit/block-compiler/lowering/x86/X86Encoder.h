@@ -12,7 +12,9 @@
 
 #include "define.h"
 #include "util/MemAllocator.h"
+#include "translate/TranslationStore.h"
 #include <malloc.h>
+#include <vector>
 
 namespace captive
 {
@@ -145,6 +147,11 @@ namespace captive
 						void invlpg(const X86Memory& addr);
 						void lea(const X86Memory& addr, const X86Register& dst);
 
+						// Load the address of a position in this code into a register,
+						// using a RIP-relative displacement which is patched like the
+						// displacement of a jmp_reloc.
+						void lea_reloc(const X86Register& dst, uint32_t& reloc_offset);
+
 						void bswap(const X86Register &dst);
 
 						// No encoding for register src, memory dst
@@ -217,6 +224,11 @@ namespace captive
 						void mov(const X86Register& src, const X86Memory& dst);
 						void mov(uint64_t src, const X86Register& dst);
 
+						// Load an absolute host pointer (e.g. a helper function) into a
+						// register. The pointer is always emitted as a full 64 bit
+						// immediate, and is recorded so that the code can be relocated.
+						void mov_host_ptr(const void *src, const X86Register& dst);
+
 						void movfs(uint32_t off, const X86Register& dst);
 
 						void mov8(uint64_t imm, const X86Memory& dst);
@@ -663,6 +675,9 @@ namespace captive
 
 						void int3();
 						void intt(uint8_t irq);
+
+						// Makes the following read-modify-write instruction atomic
+						void lock();
 						void leave();
 						void ret();
 						void hlt();
@@ -687,6 +702,11 @@ namespace captive
 							_support_relocation = enabled;
 						}
 
+						const std::vector<archsim::translate::HostRelocation> &get_host_relocations() const
+						{
+							return _host_relocations;
+						}
+
 					private:
 						uint8_t *_buffer;
 						uint32_t _buffer_size;
@@ -695,6 +715,7 @@ namespace captive
 						wulib::MemAllocator &_allocator;
 
 						bool _support_relocation;
+						std::vector<archsim::translate::HostRelocation> _host_relocations;
 
 						inline void ensure_buffer(int extra=0)
 						{
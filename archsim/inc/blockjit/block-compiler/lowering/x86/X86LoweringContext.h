@@ -15,6 +15,7 @@
 #include "blockjit/block-compiler/lowering/x86/X86Encoder.h"
 #include "blockjit/block-compiler/lowering/x86/X86BlockjitABI.h"
 #include "blockjit/block-compiler/lowering/x86/X86Encoder.h"
+#include "blockjit/BlockChaining.h"
 #include "core/thread/ThreadInstance.h"
 
 #include "util/MemAllocator.h"
@@ -155,6 +156,16 @@ namespace captive
 						void EmitEpilogue();
 
 						bool ABICalleeSave(const X86Register &reg);
+
+						// The patchable jumps emitted by dispatch instructions
+						void AddChainSlot(const archsim::blockjit::ChainSlot &slot)
+						{
+							_chain_slots.push_back(slot);
+						}
+						const std::vector<archsim::blockjit::ChainSlot> &GetChainSlots() const
+						{
+							return _chain_slots;
+						}
 					protected:
 						virtual bool LowerHeader(const TranslationContext &ctx) override;
 						virtual bool PerformRelocations(const TranslationContext &ctx) override;
@@ -163,6 +174,7 @@ namespace captive
 						stack_map_t _stack_map;
 						X86Encoder &_encoder;
 						bool _stack_fixed;
+						std::vector<archsim::blockjit::ChainSlot> _chain_slots;
 
 						struct reg_assignment {
 							const x86::X86Register *b1;
@@ -0,0 +1,111 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   MPSCQueue.h
+ *
+ * A bounded, lock-free queue with any number of producers and a single
+ * consumer. Each slot carries a sequence number which says whether it is
+ * ready to be written (sequence == position) or read (sequence ==
+ * position + 1), so producers only contend on claiming a position, and
+ * the consumer never contends at all.
+ */
+
+#ifndef MPSCQUEUE_H
+#define MPSCQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace archsim
+{
+	namespace concurrent
+	{
+		template<typename T, size_t Size> class MPSCQueue
+		{
+			static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "MPSCQueue size must be a power of two");
+
+		public:
+			MPSCQueue() : enqueue_pos_(0), dequeue_pos_(0)
+			{
+				for(size_t i = 0; i < Size; ++i) {
+					slots_[i].sequence.store(i, std::memory_order_relaxed);
+				}
+			}
+
+			MPSCQueue(const MPSCQueue &) = delete;
+			MPSCQueue &operator=(const MPSCQueue &) = delete;
+
+			// Returns false if the queue is full. May be called from any
+			// thread.
+			bool TryPush(const T &value)
+			{
+				size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+
+				while(true) {
+					Slot &slot = slots_[pos & (Size - 1)];
+					intptr_t diff = (intptr_t)slot.sequence.load(std::memory_order_acquire) - (intptr_t)pos;
+
+					if(diff == 0) {
+						if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+							slot.value = value;
+							slot.sequence.store(pos + 1, std::memory_order_release);
+							return true;
+						}
+					} else if(diff < 0) {
+						// The consumer has not yet emptied this slot
+						return false;
+					} else {
+						pos = enqueue_pos_.load(std::memory_order_relaxed);
+					}
+				}
+			}
+
+			// Returns false if the queue is empty, or if the next entry has
+			// been claimed but not yet written. Only the consumer may call
+			// this.
+			bool TryPop(T &value)
+			{
+				size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+				Slot &slot = slots_[pos & (Size - 1)];
+
+				if(slot.sequence.load(std::memory_order_acquire) != pos + 1) {
+					return false;
+				}
+
+				value = slot.value;
+				slot.sequence.store(pos + Size, std::memory_order_release);
+				dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+				return true;
+			}
+
+			// Whether anything has been pushed which has not been popped.
+			// Only exact when called by the consumer with no producers
+			// running.
+			bool IsEmpty() const
+			{
+				return enqueue_pos_.load(std::memory_order_acquire) == dequeue_pos_.load(std::memory_order_acquire);
+			}
+
+		private:
+			struct Slot {
+				std::atomic<size_t> sequence;
+				T value;
+			};
+
+			static const size_t kCacheLineSize = 64;
+
+			// Keep the producers' and consumer's positions on separate cache
+			// lines from each other and from the slots. Padding is used
+			// rather than alignas, as queues are members of heap allocated
+			// objects which new does not over-align.
+			std::atomic<size_t> enqueue_pos_;
+			char enqueue_pad_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+			std::atomic<size_t> dequeue_pos_;
+			char dequeue_pad_[kCacheLineSize - sizeof(std::atomic<size_t>)];
+			Slot slots_[Size];
+		};
+	}
+}
+
+#endif /* MPSCQUEUE_H */
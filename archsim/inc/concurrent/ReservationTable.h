@@ -0,0 +1,122 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   ReservationTable.h
+ *
+ * A table of exclusive access reservations, used to implement load-linked /
+ * store-conditional style instructions without a global lock.
+ *
+ * Memory is divided into reservation granules (one per host cache line),
+ * which are hashed into a fixed table of version counters. A reservation
+ * records the version of its granule, and a conditional store succeeds only
+ * if it can atomically move the granule from that version to an odd
+ * ('being written') version. Finishing the store makes the version even
+ * again, which causes every other reservation on the granule to fail.
+ * Because granules are hashed, unrelated addresses can occasionally cause
+ * spurious failures, which guest code must tolerate anyway.
+ *
+ * Address-less exclusive sections (used for atomic read-modify-write
+ * instructions) are still serialised by a mutex. A thread taking that mutex
+ * waits for conditional stores in progress to drain, and new conditional
+ * stores back off while it is held. The section doesn't know which addresses
+ * it wrote to, so leaving it breaks every reservation taken before it ended.
+ */
+
+#ifndef RESERVATIONTABLE_H
+#define RESERVATIONTABLE_H
+
+#include "abi/Address.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+namespace archsim
+{
+	namespace concurrent
+	{
+		class ReservationTable
+		{
+		public:
+			static const unsigned kGranuleBits = 6;
+			static const unsigned kTableSize = 4096;
+			static const unsigned kMaxThreads = 256;
+
+			ReservationTable();
+
+			// Reserve the granule containing the given address for the given thread,
+			// replacing any existing reservation held by that thread.
+			void Reserve(int thread_id, Address addr);
+
+			// Drop the given thread's reservation, if it has one.
+			void Clear(int thread_id);
+
+			// Try to begin a conditional store to the given address. This succeeds
+			// if the thread holds a reservation on exactly that address which has
+			// not been broken, in which case no other thread can complete a
+			// conditional store to the granule until EndConditionalStore is called.
+			// The thread's reservation is consumed either way.
+			bool BeginConditionalStore(int thread_id, Address addr);
+			void EndConditionalStore(int thread_id);
+
+			// Break all reservations on the granule containing the given address.
+			void Invalidate(Address addr);
+
+			// Record that the given thread has written to the given address. This
+			// is free for the target of a conditional store in progress, since
+			// ending the store breaks the other reservations anyway.
+			void NotifyWrite(int thread_id, Address addr);
+
+			// Enter or leave the (re-entrant) exclusive section. Leaving also ends
+			// any conditional store the thread has in progress, and breaks all
+			// reservations.
+			void LockExclusive(int thread_id);
+			void UnlockExclusive(int thread_id);
+
+			uint64_t GetStoresSucceeded() const;
+			uint64_t GetStoresFailed() const;
+
+		private:
+			struct alignas(64) Granule {
+				std::atomic<uint64_t> Version;
+			};
+
+			struct alignas(64) ThreadSlot {
+				// Only accessed by the owning thread
+				Address ReservedAddress;
+				uint64_t ReservedVersion;
+				uint64_t ReservedSections;
+				bool Reserved;
+				Granule *Held;
+
+				// Read by threads entering the exclusive section
+				std::atomic<bool> Storing;
+
+				// Only written by the owning thread
+				std::atomic<uint64_t> Succeeded;
+				std::atomic<uint64_t> Failed;
+			};
+
+			Granule &getGranule(Address addr)
+			{
+				uint64_t line = addr.Get() >> kGranuleBits;
+				return granules_[(line ^ (line >> 12)) % kTableSize];
+			}
+
+			ThreadSlot &getSlot(int thread_id);
+
+			Granule granules_[kTableSize];
+			ThreadSlot slots_[kMaxThreads];
+			std::atomic<int> max_thread_id_;
+
+			std::mutex exclusive_lock_;
+			std::atomic<bool> exclusive_;
+			std::atomic<int> exclusive_owner_;
+
+			// The number of exclusive sections which have ended
+			std::atomic<uint64_t> exclusive_sections_;
+		};
+	}
+}
+
+#endif /* RESERVATIONTABLE_H */
@@ -13,6 +13,7 @@
 
 #include "core/arch/ArchDescriptor.h"
 #include "core/MemoryMonitor.h"
+#include "core/thread/StateBlock.h"
 #include "abi/Address.h"
 #include "abi/memory/MemoryModel.h"
 #include "abi/devices/MMU.h"
@@ -180,7 +181,7 @@ namespace archsim
 
 		archsim::abi::memory::MemoryModel &mem_model_;
 		archsim::core::thread::ThreadInstance *thread_;
-		uint64_t cache_offset_;
+		StateBlockEntry<Cache> cache_entry_;
 		std::mutex cache_lock_;
 	};
 
@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include "concurrent/ReservationTable.h"
 #include "core/thread/ThreadInstance.h"
 
 #include <map>
@@ -55,5 +56,30 @@ namespace archsim
 			archsim::core::thread::ThreadInstance *locked_thread_;
 		};
 
+		/*
+		 * A monitor which tracks reservations per cache line in a hashed table of
+		 * version counters, so that exclusive loads and stores on different
+		 * addresses do not contend on a single lock.
+		 */
+		class ReservationMemoryMonitor : public MemoryMonitor
+		{
+		public:
+			virtual void AcquireMonitor(archsim::core::thread::ThreadInstance *thread, Address addr);
+			virtual bool LockMonitor(archsim::core::thread::ThreadInstance *thread, Address addr);
+			virtual void UnlockMonitor(archsim::core::thread::ThreadInstance *thread, Address addr);
+			virtual void Notify(archsim::core::thread::ThreadInstance *thread, Address addr);
+
+			virtual void Lock(archsim::core::thread::ThreadInstance *thread);
+			virtual void Unlock(archsim::core::thread::ThreadInstance *thread);
+
+			const archsim::concurrent::ReservationTable &GetReservations() const
+			{
+				return reservations_;
+			}
+
+		private:
+			archsim::concurrent::ReservationTable reservations_;
+		};
+
 	}
 }
\ No newline at end of file
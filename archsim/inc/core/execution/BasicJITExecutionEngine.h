@@ -13,6 +13,13 @@
 #include "ExecutionEngine.h"
 #include "blockjit/BlockCache.h"
 #include "blockjit/BlockProfile.h"
+#include "blockjit/IndirectTargetCache.h"
+#include "core/thread/ThreadInstance.h"
+#include "util/PubSubSync.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
 
 namespace archsim
 {
@@ -21,6 +28,80 @@ namespace archsim
 		namespace execution
 		{
 
+			class BasicJITExecutionEngine;
+
+			/**
+			 * Each thread executing under a JIT engine has its own virtual
+			 * block cache and indirect branch target cache, which are exposed
+			 * to translated code through the thread's state block. Invalidations requested by other threads
+			 * are deferred until this thread next reaches a safe point.
+			 *
+			 * A context may also be owned by another engine's context, when
+			 * block JIT is used as one tier of a larger engine. In that case
+			 * the owner's worker thread and execution state are used.
+			 */
+			class BasicJITExecutionEngineThreadContext : public ExecutionEngineThreadContext
+			{
+			public:
+				BasicJITExecutionEngineThreadContext(BasicJITExecutionEngine *engine, thread::ThreadInstance *thread);
+				BasicJITExecutionEngineThreadContext(BasicJITExecutionEngine *engine, thread::ThreadInstance *thread, ExecutionEngineThreadContext *owner);
+				~BasicJITExecutionEngineThreadContext();
+
+				BasicJITExecutionEngine *GetJITEngine()
+				{
+					return jit_engine_;
+				}
+				archsim::blockjit::BlockCache &GetBlockCache()
+				{
+					return block_cache_;
+				}
+				archsim::blockjit::IndirectTargetCache &GetTargetCache()
+				{
+					return target_cache_;
+				}
+
+				void InvalidateBlockCache();
+				void InvalidateBlockCacheFeatures();
+
+				// Apply any invalidations requested by other threads and
+				// record that this thread holds no stale translations from
+				// before the given epoch.
+				void EnterQuiescentState(uint64_t epoch);
+				uint64_t GetQuiescentEpoch() const
+				{
+					return quiescent_epoch_.load(std::memory_order_acquire);
+				}
+
+				ExecutionState GetOwnerState()
+				{
+					return owner_->GetState();
+				}
+
+				// Add the chains taken and missed by translated code since the
+				// last call to the thread's metrics.
+				void UpdateChainMetrics();
+
+			private:
+				bool isOwningThread();
+
+				BasicJITExecutionEngine *jit_engine_;
+				ExecutionEngineThreadContext *owner_;
+				archsim::blockjit::BlockCache block_cache_;
+
+				// Holds entries copied from the block cache, so is always
+				// invalidated along with it.
+				archsim::blockjit::IndirectTargetCache target_cache_;
+
+				// Dispatches attempted, and dispatches which did not chain
+				StateBlockEntry<uint64_t> chain_counters_;
+
+				std::atomic<bool> invalidate_pending_;
+				std::atomic<bool> invalidate_features_pending_;
+				std::atomic<uint64_t> quiescent_epoch_;
+
+				util::PubSubscriber subscriber_;
+			};
+
 			class BasicJITExecutionEngine : public ExecutionEngine
 			{
 			public:
@@ -28,21 +109,28 @@ namespace archsim
 
 				ExecutionResult Execute(ExecutionEngineThreadContext* thread) override;
 
-				virtual ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) = 0;
+				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
+
+				// Execute the single translated block at the thread's current
+				// PC, translating it first if necessary. This is used by
+				// engines which run block JIT code as one of several tiers.
+				ExecutionResult StepBlock(BasicJITExecutionEngineThreadContext *ctx);
 
 				void FlushTxlns();
-				void FlushTxlnsFeature();
-				void FlushTxlnCache();
 				void FlushAllTxlns();
-				void InvalidateRegion(Address addr);
+				// Mark the translations decoded from the given cache lines of
+				// a physical page for removal at the next flush.
+				void InvalidateRegion(Address addr, uint64_t lines);
 
 			protected:
+				friend class BasicJITExecutionEngineThreadContext;
+
 				virtual bool translateBlock(thread::ThreadInstance *thread, archsim::Address block_pc, bool support_chaining, bool support_profiling) = 0;
 				virtual bool lookupBlock(thread::ThreadInstance *thread, Address addr, captive::shared::block_txln_fn &);
 
-				void checkFlushTxlns();
+				void checkFlushTxlns(BasicJITExecutionEngineThreadContext *ctx);
 				void checkCodeSize();
-				void registerTranslation(Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation &txln);
+				void registerTranslation(thread::ThreadInstance *thread, Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation &txln, const std::vector<archsim::blockjit::ChainSlot> &chain_slots = std::vector<archsim::blockjit::ChainSlot>());
 
 				wulib::MemAllocator &GetMemAllocator()
 				{
@@ -50,20 +138,42 @@ namespace archsim
 				}
 
 			private:
-				template<typename PC_t> ExecutionResult ExecuteLoop(ExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
-				template<typename PC_t> void ExecuteInnerLoop(ExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
+				template<typename PC_t> ExecutionResult ExecuteLoop(BasicJITExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
+				template<typename PC_t> void ExecuteInnerLoop(BasicJITExecutionEngineThreadContext *ctx, PC_t* pc_ptr);
+
+				archsim::blockjit::BlockCache &getBlockCache(thread::ThreadInstance *thread)
+				{
+					return **block_cache_entry_.Get(thread->GetStateBlock());
+				}
+
+				void registerContext(BasicJITExecutionEngineThreadContext *ctx);
+				void unregisterContext(BasicJITExecutionEngineThreadContext *ctx);
+				void startFlushEpoch(bool flush_all);
+				// Must be called with contexts_lock_ held
+				void advanceEpoch(uint64_t epoch);
+				void reclaimTxlns();
 
 				archsim::blockjit::BlockProfile phys_block_profile_;
-				archsim::blockjit::BlockCache virt_block_cache_;
 				wulib::SimpleZoneMemAllocator mem_allocator_;
 
 				uint64_t max_code_size_;
 
-				bool flush_txlns_;
-				bool flush_all_txlns_;
-				bool subscribed_;
+				// Translation is serialised, since neither the translators nor
+				// the memory allocator are thread safe.
+				std::mutex translate_lock_;
+
+				std::mutex contexts_lock_;
+				std::vector<BasicJITExecutionEngineThreadContext*> contexts_;
+				std::atomic<uint64_t> flush_epoch_;
 
+				// Code replaced by a newer translation is retired into the
+				// next epoch, which is only started early once this much of
+				// it has built up, rather than for every replacement.
+				static const size_t kMaxReplacedCodeSize = 1024 * 1024;
+				size_t replaced_code_size_;
 
+				// Resolved when the first context is registered
+				StateBlockEntry<archsim::blockjit::BlockCache*> block_cache_entry_;
 			};
 
 		}
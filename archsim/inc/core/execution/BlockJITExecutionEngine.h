@@ -20,6 +20,7 @@
 #include "blockjit/BlockProfile.h"
 #include "blockjit/BlockCache.h"
 #include "module/ModuleManager.h"
+#include "translate/TranslationStore.h"
 
 namespace archsim
 {
@@ -39,8 +40,6 @@ namespace archsim
 					return translator_;
 				}
 
-				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
-
 				virtual bool translateBlock(thread::ThreadInstance *thread, archsim::Address block_pc, bool support_chaining, bool support_profiling);
 
 
@@ -51,6 +50,11 @@ namespace archsim
 				gensim::blockjit::BaseBlockJITTranslate *translator_;
 
 				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
+
+			private:
+				static bool canStoreTranslations();
+				archsim::translate::TranslationStoreKey getStoreKey(thread::ThreadInstance *thread, archsim::Address physaddr, archsim::Address block_pc, bool support_chaining, bool support_profiling);
+				bool loadStoredBlock(thread::ThreadInstance *thread, const archsim::translate::TranslationStoreKey &key, archsim::blockjit::BlockTranslation &txln);
 			};
 		}
 	}
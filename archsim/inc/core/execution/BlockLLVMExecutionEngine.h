@@ -39,8 +39,6 @@ namespace archsim
 
 				BlockLLVMExecutionEngine(gensim::BaseLLVMTranslate *translator);
 
-				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
-
 				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
 
 				llvm::LLVMContext &GetContext()
@@ -13,8 +13,11 @@
 
 #include "core/execution/ExecutionEngine.h"
 #include "core/execution/ExecutionState.h"
+#include "core/execution/QuantumScheduler.h"
 #include "core/thread/ThreadInstance.h"
 
+#include <memory>
+
 namespace archsim
 {
 	namespace core
@@ -49,6 +52,17 @@ namespace archsim
 					return trace_sink_;
 				}
 
+				// Schedule every thread in fixed quanta. Takes ownership of
+				// the scheduler.
+				void SetQuantumScheduler(QuantumScheduler *scheduler)
+				{
+					quantum_scheduler_.reset(scheduler);
+				}
+				QuantumScheduler *GetQuantumScheduler()
+				{
+					return quantum_scheduler_.get();
+				}
+
 				void Start();
 				void Halt();
 				void Join();
@@ -67,6 +81,7 @@ namespace archsim
 				ExecutionState state_;
 
 				libtrace::TraceSink *trace_sink_;
+				std::unique_ptr<QuantumScheduler> quantum_scheduler_;
 			};
 		}
 	}
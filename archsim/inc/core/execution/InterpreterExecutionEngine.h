@@ -13,6 +13,7 @@
 
 #include "core/execution/ExecutionEngine.h"
 #include "interpret/Interpreter.h"
+#include "interpret/PredecodedBlockCache.h"
 #include "module/Module.h"
 
 namespace archsim
@@ -32,8 +33,20 @@ namespace archsim
 					return decode_ctx_;
 				}
 
+				interpret::PredecodedBlockCache &GetPredecodedBlocks()
+				{
+					return predecoded_blocks_;
+				}
+				bool UsePredecodedBlocks() const
+				{
+					return use_predecoded_blocks_;
+				}
+
 			private:
 				gensim::DecodeContext *decode_ctx_;
+
+				interpret::PredecodedBlockCache predecoded_blocks_;
+				bool use_predecoded_blocks_;
 			};
 
 			class InterpreterExecutionEngine : public ExecutionEngine
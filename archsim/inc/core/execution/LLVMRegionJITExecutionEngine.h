@@ -102,7 +102,10 @@ namespace archsim
 
 				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
 
-			private:
+			protected:
+				// Execute a single block of code which has no region translation.
+				virtual ExecutionResult executeColdBlock(LLVMRegionJITExecutionEngineContext *ctx, archsim::translate::profile::Region &region);
+
 				interpret::Interpreter *interpreter_;
 				gensim::BaseLLVMTranslate *translator_;
 			};
@@ -0,0 +1,135 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   QuantumScheduler.h
+ *
+ * Deterministic scheduling of guest threads. Each thread runs for a fixed
+ * number of instructions (a quantum) and then waits at a barrier until
+ * every other thread has finished its quantum too. Between quanta, with
+ * every thread stopped, the instruction clock is advanced by all of the
+ * instructions retired in the quantum, so timer events always fire at the
+ * same point, and anything one thread did to another during the quantum
+ * (raising or lowering an IRQ line, sending a message) is delivered in
+ * order of the sending thread's ID.
+ *
+ * By default threads take turns to run their quanta, in order of thread
+ * ID, which makes the whole simulation reproducible. Threads can instead
+ * run their quanta in parallel, which is reproducible only as long as they
+ * interact through devices and interrupts: accesses to shared guest memory
+ * (and so exclusive monitors) still race with each other.
+ */
+
+#ifndef QUANTUMSCHEDULER_H
+#define QUANTUMSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+
+namespace archsim
+{
+	namespace abi
+	{
+		namespace devices
+		{
+			namespace timing
+			{
+				class InstructionTickSource;
+			}
+		}
+	}
+
+	namespace core
+	{
+		namespace thread
+		{
+			class ThreadInstance;
+		}
+
+		namespace execution
+		{
+			class QuantumScheduler
+			{
+			public:
+				using DeferredAction = std::function<void()>;
+
+				QuantumScheduler(archsim::abi::devices::timing::InstructionTickSource &tick_source, uint32_t quantum, bool parallel);
+				~QuantumScheduler();
+
+				QuantumScheduler(const QuantumScheduler &) = delete;
+				QuantumScheduler &operator=(const QuantumScheduler &) = delete;
+
+				uint32_t GetQuantum() const
+				{
+					return quantum_;
+				}
+				bool IsParallel() const
+				{
+					return parallel_;
+				}
+				uint64_t GetQuantumCount() const
+				{
+					return generation_;
+				}
+
+				// Make a thread take part in scheduling. A thread added while
+				// others are running joins them at the next quantum.
+				void AddThread(archsim::core::thread::ThreadInstance *thread);
+
+				// Called on a thread's own host thread before and after it
+				// executes. Enter blocks until the thread may run.
+				void Enter(archsim::core::thread::ThreadInstance *thread);
+				void Leave(archsim::core::thread::ThreadInstance *thread);
+
+				// Called by a thread once it has retired a quantum's worth of
+				// instructions. Blocks until the thread may run its next
+				// quantum.
+				void EndQuantum(archsim::core::thread::ThreadInstance *thread, uint64_t retired);
+
+				// Hold back an action which the calling thread takes on another
+				// thread until the end of the quantum. Returns false (and
+				// does nothing) if the action should be taken immediately,
+				// i.e. if it does not come from another running guest thread.
+				bool Defer(archsim::core::thread::ThreadInstance *target, const DeferredAction &action);
+
+			private:
+				bool isParticipant(archsim::core::thread::ThreadInstance *thread) const;
+				bool mayRun(archsim::core::thread::ThreadInstance *thread) const;
+				void admitPending();
+				void endQuantum();
+
+				archsim::abi::devices::timing::InstructionTickSource &tick_source_;
+				const uint32_t quantum_;
+				const bool parallel_;
+
+				std::mutex lock_;
+				std::condition_variable quantum_end_;
+
+				// Running threads, in thread ID order, and threads waiting to
+				// join them
+				std::vector<archsim::core::thread::ThreadInstance *> participants_;
+				std::vector<archsim::core::thread::ThreadInstance *> pending_;
+
+				std::atomic<uint64_t> generation_;
+				size_t arrived_;
+				// The index of the thread whose turn it is, when threads run
+				// their quanta one at a time
+				size_t turn_;
+				uint64_t retired_;
+
+				// Set while the last thread to reach the barrier finishes the
+				// quantum, during which nothing is deferred
+				std::atomic<bool> ending_quantum_;
+
+				std::mutex deferred_lock_;
+				std::map<int, std::vector<DeferredAction>> deferred_;
+			};
+		}
+	}
+}
+
+#endif /* QUANTUMSCHEDULER_H */
@@ -0,0 +1,59 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   TieredExecutionEngine.h
+ *
+ * An execution engine which runs code in up to three tiers. Code which has no
+ * region translation runs through the block JIT, which compiles quickly, once
+ * its region has been profiled JitTierUpThreshold times (and through the
+ * interpreter until then). The region profiler promotes hot regions to the
+ * asynchronous LLVM workers exactly as in the LLVM region JIT.
+ *
+ * The engine is registered below the block JIT, so it is only used when
+ * selected by name (--mode Tiered).
+ */
+
+#ifndef TIEREDEXECUTIONENGINE_H
+#define TIEREDEXECUTIONENGINE_H
+
+#include "core/execution/BlockJITExecutionEngine.h"
+#include "core/execution/LLVMRegionJITExecutionEngine.h"
+
+namespace archsim
+{
+	namespace core
+	{
+		namespace execution
+		{
+			class TieredExecutionEngine;
+
+			class TieredExecutionEngineContext : public LLVMRegionJITExecutionEngineContext
+			{
+			public:
+				TieredExecutionEngineContext(TieredExecutionEngine *engine, archsim::core::thread::ThreadInstance *thread);
+
+				BasicJITExecutionEngineThreadContext BlockJIT;
+			};
+
+			class TieredExecutionEngine : public LLVMRegionJITExecutionEngine
+			{
+			public:
+				friend class TieredExecutionEngineContext;
+
+				TieredExecutionEngine(interpret::Interpreter *interp, gensim::BaseLLVMTranslate *translate, gensim::blockjit::BaseBlockJITTranslate *blockjit_translate);
+
+				ExecutionEngineThreadContext* GetNewContext(thread::ThreadInstance* thread) override;
+
+				static ExecutionEngine *Factory(const archsim::module::ModuleInfo *module, const std::string &cpu_prefix);
+
+			protected:
+				ExecutionResult executeColdBlock(LLVMRegionJITExecutionEngineContext *ctx, archsim::translate::profile::Region &region) override;
+
+			private:
+				BlockJITExecutionEngine blockjit_;
+			};
+		}
+	}
+}
+
+#endif /* TIEREDEXECUTIONENGINE_H */
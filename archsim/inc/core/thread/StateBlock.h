@@ -15,7 +15,10 @@
 #include <vector>
 #include <cstring>
 #include <map>
+#include <set>
 #include <cstdint>
+#include <ostream>
+#include <unordered_map>
 
 namespace archsim
 {
@@ -32,36 +35,130 @@ namespace archsim
 	 * This way, JIT systems can keep a pointer to the state block and
 	 * still be able to quickly look up information by using the block
 	 * offsets.
+	 *
+	 * Entries which only make sense within the current simulator process
+	 * (e.g. host pointers and caches) should be added as host-only, so that
+	 * they are left out of guest snapshots.
+	 *
+	 * The block is cache line aligned, and every entry is naturally
+	 * aligned. The first kHotSize bytes are kept for hot entries, which JIT
+	 * code touches on every block (such as the message flag and the block
+	 * cache pointer), so that they share as few cache lines as possible.
+	 * Other entries, and hot entries which do not fit, follow them.
 	 */
 
 	class StateBlockDescriptor
 	{
 	public:
+		static const uint32_t kCacheLineSize = 64;
+		static const uint32_t kHotSize = 2 * kCacheLineSize;
+
+		struct Entry {
+			std::string Name;
+			uint32_t Offset;
+			uint32_t Size;
+			bool HostOnly;
+			bool Hot;
+		};
+
 		StateBlockDescriptor();
 
-		uint32_t AddBlock(const std::string &name, size_t size_in_bytes);
+		// Returns the offset of the new entry
+		uint32_t AddBlock(const std::string &name, size_t size_in_bytes, bool host_only = false, bool hot = false);
 		size_t GetBlockOffset(const std::string &name) const;
 		size_t GetBlockSizeInBytes(const std::string &name) const;
 		bool HasEntry(const std::string &name) const
 		{
-			return block_offsets_.count(name);
+			return entry_index_.count(name);
+		}
+		bool IsHostOnly(const std::string &name) const
+		{
+			return getEntry(name).HostOnly;
 		}
 
+		// Every entry, in the order in which they were added
+		const std::vector<Entry> &GetEntries() const
+		{
+			return entries_;
+		}
+
+		uint32_t GetSize() const
+		{
+			return total_size_;
+		}
+
+		// Print every entry in offset order, with the cache line it starts on
+		void Dump(std::ostream &str) const;
+
 	private:
-		std::map<std::string, uint64_t> block_offsets_;
-		std::map<std::string, uint64_t> block_sizes_in_bytes_;
+		const Entry &getEntry(const std::string &name) const;
+
+		std::vector<Entry> entries_;
+		std::unordered_map<std::string, size_t> entry_index_;
+		uint32_t hot_size_;
 		uint32_t total_size_;
 	};
 
+	/**
+	 * A typed handle to a state block entry, resolved once when the entry
+	 * is added, so that accesses do not need to look the entry up by name.
+	 */
+	template<typename T> class StateBlockEntry
+	{
+	public:
+		StateBlockEntry() : offset_(kInvalidOffset) {}
+		explicit StateBlockEntry(uint32_t offset) : offset_(offset) {}
+
+		bool IsValid() const
+		{
+			return offset_ != kInvalidOffset;
+		}
+		uint32_t GetOffset() const
+		{
+			return offset_;
+		}
+
+		inline T *Get(StateBlock &state_block) const;
+		inline const T *Get(const StateBlock &state_block) const;
+
+	private:
+		static const uint32_t kInvalidOffset = (uint32_t)-1;
+
+		uint32_t offset_;
+	};
+
 	class StateBlock
 	{
 	public:
-		uint32_t AddBlock(const std::string &name, size_t size_in_bytes);
+		StateBlock();
+		~StateBlock();
+
+		StateBlock(const StateBlock &) = delete;
+		StateBlock &operator=(const StateBlock &) = delete;
+
+		// Returns the offset of the new entry. Adding an entry may move the
+		// block, so pointers into it are only stable once every entry has
+		// been added.
+		uint32_t AddBlock(const std::string &name, size_t size_in_bytes, bool host_only = false, bool hot = false);
+
+		template<typename T> StateBlockEntry<T> AddEntry(const std::string &name, bool host_only = false, bool hot = false)
+		{
+			return StateBlockEntry<T>(AddBlock(name, sizeof(T), host_only, hot));
+		}
+		template<typename T> StateBlockEntry<T> GetEntryHandle(const std::string &name) const
+		{
+			assert(descriptor_.GetBlockSizeInBytes(name) >= sizeof(T));
+			return StateBlockEntry<T>(descriptor_.GetBlockOffset(name));
+		}
 
 		StateBlockDescriptor &GetDescriptor()
 		{
 			return descriptor_;
 		}
+		const StateBlockDescriptor &GetDescriptor() const
+		{
+			return descriptor_;
+		}
 
 		uint32_t GetBlockOffset(const std::string &name) const
 		{
@@ -69,16 +166,16 @@ namespace archsim
 		}
 		void *GetData()
 		{
-			return data_.data();
+			return data_;
 		}
 		const void *GetData() const
 		{
-			return data_.data();
+			return data_;
 		}
 
 		template<typename T> T GetEntry(const std::string &entryname) const
 		{
-			return *(T*)(data_.data() + descriptor_.GetBlockOffset(entryname));
+			return *GetEntryPointer<T>(entryname);
 		}
 		template<typename T> void GetEntry(const std::string &entryname, T* target) const
 		{
@@ -92,18 +189,28 @@ namespace archsim
 
 		template<typename T> T* GetEntryPointer(const std::string &entryname)
 		{
-			return (T*)(((char*)GetData()) + descriptor_.GetBlockOffset(entryname));
+			return (T*)(data_ + descriptor_.GetBlockOffset(entryname));
 		}
 		template<typename T> const T* GetEntryPointer(const std::string &entryname) const
 		{
-			return (T*)(((char*)GetData()) + descriptor_.GetBlockOffset(entryname));
+			return (T*)(data_ + descriptor_.GetBlockOffset(entryname));
 		}
 
 	private:
 		StateBlockDescriptor descriptor_;
-		std::vector<unsigned char> data_;
+		unsigned char *data_;
+		uint32_t capacity_;
 	};
 
+	template<typename T> T *StateBlockEntry<T>::Get(StateBlock &state_block) const
+	{
+		return (T*)((unsigned char*)state_block.GetData() + offset_);
+	}
+	template<typename T> const T *StateBlockEntry<T>::Get(const StateBlock &state_block) const
+	{
+		return (const T*)((const unsigned char*)state_block.GetData() + offset_);
+	}
+
 }
 
 #endif /* STATEBLOCK_H */
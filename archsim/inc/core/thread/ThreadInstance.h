@@ -20,12 +20,13 @@
 #include "abi/devices/PeripheralManager.h"
 #include "core/thread/ProcessorFeatures.h"
 #include "core/thread/ThreadMetrics.h"
+#include "concurrent/MPSCQueue.h"
 
 #include <libtrace/TraceSource.h>
 
 #include <atomic>
+#include <functional>
 #include <mutex>
-#include <queue>
 #include <setjmp.h>
 
 #define CreateThreadExecutionSafepoint(thread) do { setjmp(thread->Safepoint); } while(0)
@@ -48,6 +49,11 @@ namespace archsim
 
 	namespace core
 	{
+		namespace execution
+		{
+			class QuantumScheduler;
+		}
+
 		namespace thread
 		{
 
@@ -206,18 +212,18 @@ namespace archsim
 				// Functions to do with execution modes
 				uint32_t GetModeID() const
 				{
-					return *(uint32_t*)(((char*)GetStateBlock().GetData()) + mode_offset_);
+					return *mode_entry_.Get(state_block_);
 				}
 				void SetModeID(uint32_t new_mode)
 				{
-					GetStateBlock().SetEntry<uint32_t>("ModeID", new_mode);
+					*mode_entry_.Get(state_block_) = new_mode;
 				}
 
 				// Execution ring is very frequently accessed so it's necessary
 				// to provide an optimised implementation.
 				uint32_t GetExecutionRing() const
 				{
-					return *(uint32_t*)(((char*)GetStateBlock().GetData()) + ring_offset_);
+					return *ring_entry_.Get(state_block_);
 				}
 				void SetExecutionRing(uint32_t new_ring);
 
@@ -273,6 +279,13 @@ namespace archsim
 					trace_source_ = source;
 				}
 
+				archsim::core::execution::QuantumScheduler *GetQuantumScheduler()
+				{
+					return quantum_scheduler_;
+				}
+				// Run the thread in fixed quanta under the given scheduler
+				void SetQuantumScheduler(archsim::core::execution::QuantumScheduler *scheduler);
+
 				// External functions. I don't like that these are here.
 				void fn_flush_itlb_entry(Address::underlying_t entry)
 				{
@@ -473,29 +486,47 @@ namespace archsim
 				void PendIRQ();
 				// Acknowledge an IRQ and take an interrupt
 				void HandleIRQ();
+				// Park the thread until an IRQ line is asserted, a message is
+				// sent to it, or the wait deadline passes
+				void WaitForInterrupt();
+
+				// Count an instruction against an instruction based clock.
+				// Instructions are retired to the clock in batches which end
+				// when the next timer event is due. A batch is cut short if
+				// an earlier event is scheduled while it is running.
+				inline void InstructionTick()
+				{
+					if(--instructions_until_retire_ == 0 || (deadline_generation_ != nullptr && deadline_generation_->load(std::memory_order_relaxed) != batch_generation_)) {
+						RetireInstructions();
+					}
+				}
 
-				// Functions to do with sending messages to a running thread
+				// Functions to do with sending messages to a running thread.
+				// Sending never takes a lock, and an Interrupt message sent
+				// while another is still waiting to be handled is folded into
+				// it, so raising an interrupt on another core costs a single
+				// atomic increment when one is already on its way. Nop
+				// messages are folded together in the same way.
 				void SendMessage(ThreadMessage message)
 				{
-					std::unique_lock<std::mutex> lock(message_lock_);
-					message_queue_.push(message);
-					*(uint32_t*)(((char*)GetStateBlock().GetData()) + message_waiting_offset_) = true;
+					if(!DeferAction([this, message]() { QueueMessage(message); })) {
+						QueueMessage(message);
+					}
 				}
 
+				// Under a quantum scheduler, hold back an action which another
+				// guest thread takes on this one until the end of the
+				// quantum. Returns true if the action was deferred, in which
+				// case the caller must not take it now.
+				bool DeferAction(const std::function<void()> &action);
+
 				bool HasMessage() const
 				{
-					return *(uint32_t*)(((char*)GetStateBlock().GetData()) + message_waiting_offset_);
-				}
-				ThreadMessage GetNextMessage()
-				{
-					std::unique_lock<std::mutex> lock(message_lock_);
-					auto message = message_queue_.front();
-					message_queue_.pop();
-
-					*(uint32_t*)(((char*)GetStateBlock().GetData()) + message_waiting_offset_) = !message_queue_.empty();
-
-					return message;
+					return *message_waiting_entry_.Get(state_block_);
 				}
+				// Only called by the thread itself. Returns Nop if a message
+				// is still being sent.
+				ThreadMessage GetNextMessage();
 
 				core::execution::ExecutionResult HandleMessage();
 
@@ -515,6 +546,11 @@ namespace archsim
 				jmp_buf Safepoint;
 				void ReturnToSafepoint();
 			private:
+				// Wake the thread if it is parked in WaitForInterrupt
+				void Wake();
+				void RetireInstructions();
+				void QueueMessage(ThreadMessage message);
+
 				const ArchDescriptor &descriptor_;
 				memory_interface_collection_t memory_interfaces_;
 				MemoryInterface *fetch_mi_;
@@ -528,17 +564,40 @@ namespace archsim
 
 				int thread_id_;
 
-				uint32_t mode_offset_;
-				uint32_t ring_offset_;
-				uint32_t message_waiting_offset_;
+				StateBlockEntry<uint32_t> mode_entry_;
+				StateBlockEntry<uint32_t> ring_entry_;
+				StateBlockEntry<uint32_t> message_waiting_entry_;
 
 				void *pc_ptr_;
 				bool pc_is_64bit_;
 
-				std::mutex message_lock_;
-				std::queue<ThreadMessage> message_queue_;
+				static const size_t kMessageQueueSize = 64;
+
+				archsim::concurrent::MPSCQueue<ThreadMessage, kMessageQueueSize> message_queue_;
 				std::atomic<uint32_t> pending_irqs_;
 
+				// The number of times an interrupt has been sent since the
+				// queued Interrupt message was sent, and when it was sent
+				std::atomic<uint32_t> interrupt_posts_;
+				std::atomic<uint64_t> interrupt_post_time_;
+
+				// Whether a Nop message is queued. Nops sent while one is
+				// queued are dropped.
+				std::atomic<bool> nop_queued_;
+
+				// Futex word which is bumped every time the thread is sent
+				// something which should end a wait for interrupt
+				std::atomic<uint32_t> wake_sequence_;
+				std::atomic<bool> waiting_;
+
+				uint64_t instruction_batch_;
+				uint64_t instructions_until_retire_;
+				// The tick source's deadline generation when the current
+				// batch was sized. Not used under a quantum scheduler.
+				const std::atomic<uint64_t> *deadline_generation_;
+				uint64_t batch_generation_;
+				archsim::core::execution::QuantumScheduler *quantum_scheduler_;
+
 				StateBlock state_block_;
 				libtrace::TraceSource *trace_source_;
 
@@ -18,6 +18,7 @@
 
 #include <functional>
 #include <ostream>
+#include <vector>
 
 namespace archsim
 {
@@ -42,11 +43,24 @@ namespace archsim
 				archsim::util::Counter64 WriteHits;
 				archsim::util::Counter64 Writes;
 
+				archsim::util::Counter64 ITLBHits;
+				archsim::util::Counter64 ITLBMisses;
+				archsim::util::Counter64 DTLBHits;
+				archsim::util::Counter64 DTLBMisses;
+
 				archsim::util::Counter64 JITInstructionCount;
 				archsim::util::CounterTimer JITTime;
 
 				archsim::util::CounterTimer InterpretTime;
 
+				archsim::util::Counter64 IdleWaits;
+				archsim::util::CounterTimer IdleTime;
+
+				// Interrupts which were folded into one already on its way,
+				// and the time from sending an interrupt to handling it
+				archsim::util::Counter64 InterruptsCoalesced;
+				archsim::util::Histogram IRQLatency;
+
 				archsim::util::Counter64 JITSuccessfulChains;
 				archsim::util::Counter64 JITFailedChains;
 				archsim::util::Histogram JITExitReasons;
@@ -56,6 +70,12 @@ namespace archsim
 			{
 			public:
 				void PrintStats(const ArchDescriptor &arch, const ThreadMetrics &metrics, std::ostream &str);
+
+				// Print the profiles of a group of threads, merged together
+				void PrintProfiles(const ArchDescriptor &arch, const std::vector<const ThreadMetrics *> &metrics, std::ostream &str);
+
+			private:
+				void PrintInstructionProfile(const ArchDescriptor &arch, const archsim::util::Histogram &opcodes, std::ostream &str);
 			};
 
 			class HistogramPrinter
@@ -63,11 +63,16 @@ namespace gensim
 	class JumpInfo
 	{
 	public:
-		JumpInfo() : IsJump(false), IsIndirect(false), IsConditional(false), JumpTarget(0) {}
+		JumpInfo() : IsJump(false), IsIndirect(false), IsConditional(false), IsCall(false), IsReturn(false), JumpTarget(0) {}
 
 		bool IsJump;
 		bool IsIndirect;
 		bool IsConditional;
+
+		// Whether the jump calls a function (and so the next instruction is
+		// where it will return to), or returns from one.
+		bool IsCall;
+		bool IsReturn;
 		archsim::Address JumpTarget;
 	};
 
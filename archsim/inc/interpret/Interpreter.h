@@ -12,6 +12,7 @@
 
 #include "core/execution/InterpreterExecutionEngine.h"
 #include "core/execution/ExecutionResult.h"
+#include "interpret/PredecodedBlockCache.h"
 #include "util/LogContext.h"
 
 UseLogContext(LogInterpreter)
@@ -37,6 +38,34 @@ namespace archsim
 			virtual ~Interpreter();
 			virtual core::execution::ExecutionResult StepBlock(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread) = 0;
 
+			/**
+			 * Get the handler which executes the given decoded instruction,
+			 * or nullptr if this interpreter does not support pre-decoded
+			 * execution.
+			 */
+			virtual instruction_handler_t GetInstructionHandler(const gensim::BaseDecode &decode, uint32_t isa_mode, bool trace);
+
+			/**
+			 * Execute a single guest basic block. Blocks are decoded once and
+			 * cached in the thread context, falling back to StepBlock when a
+			 * block cannot be pre-decoded.
+			 */
+			core::execution::ExecutionResult ExecuteBlock(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread);
+
+		private:
+			PredecodedBlock *predecodeBlock(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread_ctx, Address virt_pc, Address phys_pc);
+			/**
+			 * Run a pre-decoded block by calling each instruction's handler in
+			 * turn. This is call threading rather than computed goto or tail
+			 * call dispatch: the handlers are separate functions in the
+			 * generated interpreter, so there are no labels to jump between,
+			 * and C++ compilers don't guarantee that a handler's call to the
+			 * next one would become a jump. Messages, instruction ticks and
+			 * self-modifying code must be checked between instructions
+			 * anyway, so the loop is specialised on the options instead.
+			 */
+			core::execution::ExecutionResult executePredecodedBlock(archsim::core::thread::ThreadInstance *thread, const PredecodedBlock &block);
+			template<bool instruction_tick, bool verbose> core::execution::ExecutionResult executePredecodedBlock(archsim::core::thread::ThreadInstance *thread, const PredecodedBlock &block);
 		};
 	}
 }
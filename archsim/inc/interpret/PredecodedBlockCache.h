@@ -0,0 +1,157 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   PredecodedBlockCache.h
+ *
+ * Guest basic blocks which have been decoded once into a contiguous array of
+ * instruction records, each holding a direct pointer to the handler for that
+ * instruction. Blocks are cached by physical address, and are invalidated a
+ * page at a time when the underlying code is modified.
+ *
+ * Each cache belongs to the thread which executes its blocks, but may be
+ * invalidated from any thread. The owning thread looks blocks up in a direct
+ * mapped table first, which it alone reads and writes, so the lock is only
+ * taken on a miss.
+ */
+
+#ifndef PREDECODEDBLOCKCACHE_H
+#define PREDECODEDBLOCKCACHE_H
+
+#include "abi/Address.h"
+#include "core/execution/ExecutionResult.h"
+#include "util/PubSubSync.h"
+
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace gensim
+{
+	class BaseDecode;
+}
+
+namespace archsim
+{
+	namespace core
+	{
+		namespace thread
+		{
+			class ThreadInstance;
+		}
+	}
+
+	namespace interpret
+	{
+		typedef core::execution::ExecutionResult (*instruction_handler_t)(core::thread::ThreadInstance *thread, gensim::BaseDecode &decode);
+
+		struct PredecodedInstruction {
+			instruction_handler_t Handler;
+			gensim::BaseDecode *Decode;
+		};
+
+		class PredecodedBlock
+		{
+		public:
+			PredecodedBlock(Address phys_addr, uint32_t isa_mode) : phys_addr_(phys_addr), isa_mode_(isa_mode), valid_(true) {}
+			~PredecodedBlock();
+
+			Address GetPhysicalAddress() const
+			{
+				return phys_addr_;
+			}
+			uint32_t GetISAMode() const
+			{
+				return isa_mode_;
+			}
+
+			bool IsValid() const
+			{
+				return valid_.load(std::memory_order_relaxed);
+			}
+			void Invalidate()
+			{
+				valid_ = false;
+			}
+
+			// Takes ownership of (a reference to) the decode.
+			void AddInstruction(instruction_handler_t handler, gensim::BaseDecode *decode)
+			{
+				instructions_.push_back({handler, decode});
+			}
+
+			const PredecodedInstruction *begin() const
+			{
+				return instructions_.data();
+			}
+			const PredecodedInstruction *end() const
+			{
+				return instructions_.data() + instructions_.size();
+			}
+			size_t size() const
+			{
+				return instructions_.size();
+			}
+
+		private:
+			Address phys_addr_;
+			uint32_t isa_mode_;
+			std::atomic<bool> valid_;
+
+			std::vector<PredecodedInstruction> instructions_;
+		};
+
+		class PredecodedBlockCache
+		{
+		public:
+			PredecodedBlockCache(util::PubSubContext &pubsub);
+			~PredecodedBlockCache();
+
+			// Only called by the owning thread
+			PredecodedBlock *Lookup(Address phys_addr, uint32_t isa_mode);
+			void Insert(PredecodedBlock *block);
+
+			void InvalidatePage(Address phys_page);
+			void InvalidateAll();
+
+			// Free blocks which have been invalidated. This must only be called
+			// by the thread which executes blocks from this cache, between
+			// blocks, since an invalidation can happen while a block is running.
+			void Reclaim();
+
+		private:
+			static void InvalidateCallback(PubSubType::PubSubType type, void *context, const void *data);
+
+			static const uint32_t kLookupCacheSize = 1024;
+
+			struct LookupEntry {
+				uint64_t Key;
+				PredecodedBlock *Block;
+			};
+
+			static uint64_t getKey(Address phys_addr, uint32_t isa_mode)
+			{
+				return phys_addr.Get() | ((uint64_t)isa_mode << 60);
+			}
+			static uint32_t getLookupIndex(uint64_t key)
+			{
+				return (key >> 1) % kLookupCacheSize;
+			}
+
+			// Entries may point at blocks which have since been invalidated,
+			// but never at freed blocks, since the owner clears them in
+			// Reclaim() before freeing anything.
+			std::array<LookupEntry, kLookupCacheSize> lookup_cache_;
+
+			std::mutex lock_;
+			std::unordered_map<Address::underlying_t, std::unordered_map<uint64_t, PredecodedBlock *>> pages_;
+			std::vector<PredecodedBlock *> retired_;
+			std::atomic<bool> has_retired_;
+
+			util::PubSubscriber subscriber_;
+		};
+	}
+}
+
+#endif /* PREDECODEDBLOCKCACHE_H */
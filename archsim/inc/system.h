@@ -26,6 +26,7 @@
 #include <ostream>
 #include <set>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include <unistd.h>
@@ -48,6 +49,7 @@ namespace archsim
 	namespace abi
 	{
 		class EmulationModel;
+		class Snapshot;
 
 		namespace devices
 		{
@@ -242,6 +244,11 @@ private:
 	archsim::abi::EmulationModel *emulation_model;
 	archsim::uarch::uArch *uarch;
 
+	// The snapshot which the simulation was started from, if any. This must
+	// outlive the simulation, since guest memory may be restored from it on
+	// demand.
+	std::unique_ptr<archsim::abi::Snapshot> snapshot_;
+
 
 	archsim::abi::devices::timing::TickSource *_tick_source;
 };
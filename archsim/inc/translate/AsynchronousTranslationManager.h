@@ -11,6 +11,7 @@
 #define	ASYNCHRONOUSTRANSLATIONMANAGER_H
 
 #include "translate/TranslationManager.h"
+#include "translate/WorkUnitQueue.h"
 #include "blockjit/BlockJitTranslate.h"
 #include "gensim/gensim_translate.h"
 
@@ -38,12 +39,6 @@ namespace archsim
 
 		class AsynchronousTranslationWorker;
 
-		class WorkUnitQueueComparator
-		{
-		public:
-			bool operator()(const TranslationWorkUnit* lhs, const TranslationWorkUnit* rhs) const;
-		};
-
 		class AsynchronousTranslationManager : public TranslationManager
 		{
 			friend class AsynchronousTranslationWorker;
@@ -67,14 +62,12 @@ namespace archsim
 			 */
 			std::list<AsynchronousTranslationWorker *> workers;
 
-			/**
-			 * Lock and condition protecting the work unit queue.
-			 */
-			std::mutex work_unit_queue_lock;
-			std::condition_variable work_unit_queue_cond;
 			llvm::LLVMContext ctx_;
 
-			std::vector<TranslationWorkUnit *> work_unit_queue_;
+			/**
+			 * Heat-ordered queue of work units, sharded between the workers.
+			 */
+			std::unique_ptr<WorkUnitQueue> work_unit_queue_;
 		};
 	}
 }
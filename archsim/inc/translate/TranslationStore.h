@@ -0,0 +1,166 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   TranslationStore.h
+ *
+ * A persistent store of host code produced by the JITs. Translations are
+ * keyed on the contents of the guest page they were produced from (along
+ * with the ISA mode and processor features in effect) so that they can be
+ * reused by later simulations of the same guest code.
+ *
+ * The store file is memory mapped on load. Host code containing absolute
+ * pointers into the simulator is stored along with a list of relocations,
+ * which are expressed relative to the shared object containing the target
+ * and are relinked when the translation is loaded.
+ */
+
+#ifndef TRANSLATIONSTORE_H
+#define TRANSLATIONSTORE_H
+
+#include "core/thread/ProcessorFeatures.h"
+#include "core/thread/StateBlock.h"
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace archsim
+{
+	namespace translate
+	{
+		/**
+		 * The location of an absolute host pointer embedded within a piece of
+		 * generated code.
+		 */
+		struct HostRelocation {
+			uint32_t Offset;
+			const void *Target;
+		};
+
+		enum class StoredTranslationKind : uint32_t {
+			BlockJIT = 0,
+			LLVMObject = 1
+		};
+
+		struct TranslationStoreKey {
+			uint64_t PageHash;
+			uint64_t Address;
+			uint64_t FeatureHash;
+			uint64_t ShapeHash;
+			uint32_t ISAMode;
+			StoredTranslationKind Kind;
+
+			bool operator==(const TranslationStoreKey &other) const
+			{
+				return PageHash == other.PageHash && Address == other.Address && FeatureHash == other.FeatureHash && ShapeHash == other.ShapeHash && ISAMode == other.ISAMode && Kind == other.Kind;
+			}
+
+			std::string ToString() const;
+		};
+
+		struct TranslationStoreKeyHash {
+			size_t operator()(const TranslationStoreKey &key) const;
+		};
+
+		/**
+		 * A translation which has been found in the store. The code has not
+		 * yet been relocated: use Relocate() once it has been copied into
+		 * executable memory.
+		 */
+		class StoredTranslation
+		{
+		public:
+			const uint8_t *GetCode() const
+			{
+				return code_;
+			}
+			size_t GetSize() const
+			{
+				return size_;
+			}
+			const archsim::ProcessorFeatureSet &GetRequiredFeatures() const
+			{
+				return features_;
+			}
+
+			// Patch the host pointers in the given copy of this translation's
+			// code. Returns false if any target could not be resolved.
+			bool Relocate(uint8_t *code) const;
+
+		private:
+			friend class TranslationStore;
+
+			struct Relocation {
+				uint32_t Offset;
+				std::string Object;
+				uint64_t ObjectOffset;
+			};
+
+			const uint8_t *code_;
+			size_t size_;
+			std::vector<Relocation> relocations_;
+			archsim::ProcessorFeatureSet features_;
+		};
+
+		class TranslationStore
+		{
+		public:
+			TranslationStore();
+			~TranslationStore();
+
+			// Open the store file. If the file does not exist, or was written
+			// by a different version of the simulator, the store starts empty.
+			bool Open(const std::string &filename, const std::string &config_tag);
+			bool Save();
+
+			bool IsOpen() const
+			{
+				return open_;
+			}
+
+			bool Lookup(const TranslationStoreKey &key, StoredTranslation &txln);
+			bool Contains(const TranslationStoreKey &key);
+			bool Insert(const TranslationStoreKey &key, const void *code, size_t size, const std::vector<HostRelocation> &relocations, const archsim::ProcessorFeatureSet &required_features);
+
+			static uint64_t Hash(const void *data, size_t size, uint64_t seed = 0xcbf29ce484222325ULL);
+			static uint64_t HashFeatures(const archsim::ProcessorFeatureSet &features);
+			// Translated code has state block offsets built into it, so is
+			// only valid for a state block laid out in the same way.
+			static uint64_t HashStateBlock(const archsim::StateBlockDescriptor &descriptor);
+
+			static TranslationStore Singleton;
+
+		private:
+			static const uint32_t kVersion = 1;
+
+			struct EntryHeader;
+
+			void close();
+			bool loadIndex(const uint8_t *data, size_t size);
+			bool isValidEntry(const uint8_t *entry) const;
+			uint32_t getObjectIndex(const std::string &name);
+			void readEntry(const uint8_t *entry, StoredTranslation &txln);
+
+			std::mutex lock_;
+			bool open_;
+
+			std::string filename_;
+			std::string config_tag_;
+
+			const uint8_t *mapping_;
+			size_t mapping_size_;
+
+			std::vector<std::string> objects_;
+			std::unordered_map<TranslationStoreKey, const uint8_t *, TranslationStoreKeyHash> index_;
+			std::vector<std::unique_ptr<std::vector<uint8_t>>> pending_;
+
+			uint64_t hits_, misses_;
+		};
+	}
+}
+
+#endif /* TRANSLATIONSTORE_H */
@@ -177,8 +177,16 @@ namespace archsim
 				return emit_trace_calls;
 			}
 
+			// How many times the region's blocks have been interpreted since
+			// the unit was built
 			uint32_t GetWeight() const;
 
+			// The weight the region was given when it was profiled
+			inline uint32_t GetProfileWeight() const
+			{
+				return weight;
+			}
+
 			inline uint32_t GetGeneration() const
 			{
 				return generation;
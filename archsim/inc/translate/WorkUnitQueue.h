@@ -0,0 +1,125 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   WorkUnitQueue.h
+ *
+ * A concurrent, heat-ordered queue of translation work units. Each worker
+ * thread owns a shard, organised as an indexed max-heap on unit weight, and
+ * steals from the other shards when its own is empty. A unit's weight grows
+ * as its region is interpreted while it waits, so every so often a shard's
+ * weights are brought up to date (and the heap rebuilt) before a unit is
+ * popped. Units are assigned to shards by region, so a region which is
+ * enqueued again while it is still waiting replaces (and re-weights) its
+ * existing entry rather than being queued twice.
+ *
+ * Units whose regions have been invalidated are dropped lazily, when they
+ * reach the top of a heap.
+ */
+
+#ifndef WORKUNITQUEUE_H
+#define WORKUNITQUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+namespace archsim
+{
+	namespace translate
+	{
+		namespace profile
+		{
+			class Region;
+		}
+
+		class TranslationWorkUnit;
+
+		class WorkUnitQueue
+		{
+		public:
+			WorkUnitQueue(unsigned int shard_count);
+			~WorkUnitQueue();
+
+			// Add a unit to the queue, taking ownership of it.
+			void Push(TranslationWorkUnit *unit);
+
+			// Remove the hottest valid unit, preferring the given shard. Blocks
+			// until a unit is available, or until Terminate() is called, in
+			// which case nullptr is returned.
+			TranslationWorkUnit *Pop(unsigned int shard);
+
+			// Remove the hottest valid unit without blocking.
+			TranslationWorkUnit *TryPop(unsigned int shard);
+
+			// Wake up all waiting workers and stop them from waiting again.
+			void Terminate();
+
+			// Delete all queued units.
+			void Clear();
+
+			size_t Size() const
+			{
+				return size_;
+			}
+
+			void PrintStatistics(std::ostream &stream) const;
+
+			// The weight the unit is ordered by
+			static uint32_t GetWeight(const TranslationWorkUnit &unit);
+
+		private:
+			typedef std::chrono::steady_clock clock_t;
+
+			struct Entry {
+				TranslationWorkUnit *Unit;
+				uint32_t Weight;
+				clock_t::time_point EnqueueTime;
+			};
+
+			// Re-weighting a shard takes time in the number of waiting
+			// units, while holding its lock, so is done at most this often
+			static constexpr std::chrono::milliseconds kRefreshInterval {10};
+
+			struct Shard {
+				std::mutex Lock;
+				std::vector<Entry> Heap;
+				std::unordered_map<const profile::Region *, size_t> Index;
+				clock_t::time_point LastRefresh;
+
+				void SiftUp(size_t i);
+				void SiftDown(size_t i);
+				void Swap(size_t a, size_t b);
+				void Refresh();
+				Entry RemoveTop();
+			};
+
+			Shard &getShard(const profile::Region &region);
+			bool popFrom(Shard &shard, bool wait_for_lock, Entry &entry);
+			void recordLatency(const Entry &entry);
+
+			std::vector<std::unique_ptr<Shard>> shards_;
+
+			std::atomic<size_t> size_;
+			std::atomic<bool> terminate_;
+
+			std::mutex wait_lock_;
+			std::condition_variable wait_cond_;
+
+			// Statistics
+			std::atomic<uint64_t> dequeued_;
+			std::atomic<uint64_t> stolen_;
+			std::atomic<uint64_t> dropped_;
+			std::atomic<uint64_t> reweighted_;
+			std::atomic<uint64_t> total_latency_us_;
+			std::atomic<uint64_t> max_latency_us_;
+		};
+	}
+}
+
+#endif /* WORKUNITQUEUE_H */
@@ -13,6 +13,9 @@
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Module.h>
 
+#include <llvm/Target/TargetMachine.h>
+
+#include <memory>
 #include <string>
 
 #include "blockjit/translation-context.h"
@@ -36,6 +39,7 @@ namespace archsim
 
 			private:
 				::llvm::LLVMContext &ctx_;
+				std::unique_ptr<::llvm::TargetMachine> target_machine_;
 				translate_llvm::LLVMOptimiser optimiser_;
 			};
 		}
@@ -57,6 +57,7 @@ extern "C" {
 
 	void cpuReturnToSafepoint(gensim::Processor *cpu);
 	void cpuPendInterrupt(archsim::core::thread::ThreadInstance *cpu);
+	void cpuWaitForInterrupt(archsim::core::thread::ThreadInstance *cpu);
 
 	uint32_t cpuTranslate(gensim::Processor *cpu, uint32_t virt_addr, uint32_t *phys_addr);
 	void cpuTrap(archsim::core::thread::ThreadInstance *cpu);
@@ -5,6 +5,7 @@
 
 #include "translate/llvm/LLVMTranslation.h"
 #include "translate/llvm/LLVMMemoryManager.h"
+#include "translate/llvm/LLVMObjectCache.h"
 #include "translate/TranslationWorkUnit.h"
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
@@ -53,12 +54,23 @@ namespace archsim
 				{
 					return ctx_;
 				}
+
+				LLVMObjectCache &GetObjectCache()
+				{
+					return object_cache_;
+				}
+
+				llvm::TargetMachine &GetTargetMachine()
+				{
+					return *target_machine_;
+				}
 			private:
 				void initJitSymbols();
 
 				using SymbolResolver = std::function<llvm::JITSymbol(std::string)>;
 
 				std::unique_ptr<llvm::TargetMachine> target_machine_;
+				LLVMObjectCache object_cache_;
 				llvm::orc::ExecutionSession session_;
 				LinkLayer linker_;
 				std::unique_ptr<CompileLayer> compiler_;
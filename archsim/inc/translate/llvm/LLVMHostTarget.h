@@ -0,0 +1,91 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   LLVMHostTarget.h
+ *
+ * The host CPU which translations are compiled for. By default this is the
+ * CPU that the simulator is running on, with all of the features that it
+ * reports. The CPU and individual features can be overridden (--jit-host-cpu
+ * and --jit-host-features), e.g. to produce stored translations which can be
+ * used on a mix of hosts.
+ */
+
+#ifndef LLVMHOSTTARGET_H
+#define LLVMHOSTTARGET_H
+
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace llvm
+{
+	class Module;
+	class TargetMachine;
+}
+
+namespace archsim
+{
+	namespace translate
+	{
+		namespace translate_llvm
+		{
+			class LLVMHostTarget
+			{
+			public:
+				static LLVMHostTarget &Get();
+
+				const std::string &GetCPU() const
+				{
+					return cpu_;
+				}
+
+				// Features are given as "+name" or "-name", as LLVM expects them.
+				const std::vector<std::string> &GetFeatures() const
+				{
+					return features_;
+				}
+				std::string GetFeatureString() const;
+
+				bool HasFeature(const std::string &name) const;
+
+				// The width of the widest vector registers, in bits.
+				unsigned GetMaxVectorWidth() const;
+
+				// Identifies the code which is generated for this target, so that
+				// it is not used on a different one.
+				std::string GetDescription() const;
+
+				// Each call creates a new target machine, which is then owned by
+				// the caller. Target machines must not be shared between threads.
+				llvm::TargetMachine *CreateTargetMachine(bool fast_isel = false) const;
+
+				// Tag each function in the module with the host CPU and features,
+				// so that the optimiser and code generator can make use of them.
+				void Specialise(llvm::Module &module) const;
+
+				// Work out which host features the code in an optimised module
+				// depends on, and add them to the statistics.
+				std::vector<std::string> RecordFeatureUsage(const llvm::Module &module);
+
+				void PrintStatistics(std::ostream &stream);
+
+			private:
+				LLVMHostTarget();
+
+				void ApplyFeatureOverrides(const std::string &overrides);
+
+				std::string cpu_;
+				std::vector<std::string> features_;
+				std::vector<std::string> enabled_;
+
+				std::mutex usage_lock_;
+				std::map<std::string, uint64_t> usage_;
+				uint64_t translations_;
+			};
+		}
+	}
+}
+
+#endif /* LLVMHOSTTARGET_H */
@@ -0,0 +1,64 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * LLVMObjectCache.h
+ *
+ * Connects the LLVM compiler to the persistent translation store. Compiled
+ * region objects are written to the store, and are loaded back (rather than
+ * being regenerated and recompiled) when the same region is seen again. The
+ * objects are relinked against the simulator's JIT symbols when loaded.
+ */
+
+#ifndef LLVMOBJECTCACHE_H_
+#define LLVMOBJECTCACHE_H_
+
+#include "translate/TranslationStore.h"
+
+#include <llvm/ExecutionEngine/ObjectCache.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace archsim
+{
+	namespace translate
+	{
+		class TranslationWorkUnit;
+
+		namespace translate_llvm
+		{
+
+			class LLVMObjectCache : public ::llvm::ObjectCache
+			{
+			public:
+				static TranslationStoreKey GetStoreKey(TranslationWorkUnit &unit);
+
+				// Returns true if a compiled object for the given key can be
+				// loaded from the store.
+				bool HasObject(const TranslationStoreKey &key);
+
+				// Create a module which defines the same symbols as the
+				// translation with the given key, but with no real code. The
+				// compiled object will be provided by the store.
+				::llvm::Module *CreateStubModule(const TranslationStoreKey &key, TranslationWorkUnit &unit, ::llvm::LLVMContext &ctx);
+
+				// Tag a freshly generated module so that its compiled object is
+				// saved to the store. Modules which embed host addresses are
+				// not tagged, as their code is only valid in this process.
+				void AttachKey(::llvm::Module *module, const TranslationStoreKey &key);
+
+				void notifyObjectCompiled(const ::llvm::Module *module, ::llvm::MemoryBufferRef object) override;
+				std::unique_ptr<::llvm::MemoryBuffer> getObject(const ::llvm::Module *module) override;
+
+			private:
+				std::mutex lock_;
+				std::map<std::string, TranslationStoreKey> keys_;
+			};
+		}
+	}
+}
+
+#endif /* LLVMOBJECTCACHE_H_ */
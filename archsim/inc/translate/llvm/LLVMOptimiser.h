@@ -18,6 +18,7 @@ namespace llvm
 	class Module;
 	class DataLayout;
 	class Pass;
+	class TargetMachine;
 }
 
 namespace archsim
@@ -42,7 +43,9 @@ namespace archsim
 			class LLVMOptimiser
 			{
 			public:
-				LLVMOptimiser();
+				// If a target machine is given then the optimisations are tuned
+				// for it, and the vectorisers are enabled.
+				LLVMOptimiser(::llvm::TargetMachine *target = nullptr);
 				~LLVMOptimiser();
 
 				bool Optimise(::llvm::Module *module, const ::llvm::DataLayout &data_layout);
@@ -54,6 +57,7 @@ namespace archsim
 
 				::llvm::legacy::PassManager pm;
 				ArchSimAA *my_aa_;
+				::llvm::TargetMachine *target_;
 				bool isInitialised;
 			};
 		}
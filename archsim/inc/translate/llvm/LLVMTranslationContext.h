@@ -76,7 +76,7 @@ namespace archsim
 					llvm::Function *blkRead8, *blkRead16, *blkRead32, *blkRead64;
 					llvm::Function *cpuWrite8, *cpuWrite16, *cpuWrite32, *cpuWrite64;
 
-					llvm::Function *cpuEnterUser, *cpuEnterKernel, *cpuPendIRQ, *cpuPushInterrupt;
+					llvm::Function *cpuEnterUser, *cpuEnterKernel, *cpuPendIRQ, *cpuWaitForInterrupt, *cpuPushInterrupt;
 
 					llvm::Function *cpuTraceInstruction;
 
@@ -19,7 +19,9 @@
 
 UseLogContext(LogProfile);
 
+#include <atomic>
 #include <bitset>
+#include <ostream>
 
 namespace archsim
 {
@@ -28,23 +30,52 @@ namespace archsim
 		namespace profile
 		{
 
+			/*
+			 * The cache lines of a physical page which have been written to, published with
+			 * CodeLinesInvalidatePhysical. Bit n of Lines covers the n'th line of the page.
+			 */
+			struct CodeLineInvalidation {
+				uint64_t PageBase;
+				uint64_t Lines;
+			};
+
 			/*
 			 * This class is in charge of keeping track of which pages contain translated code, and generating invalidation events
 			 * when these pages are invalidated.
+			 *
+			 * Code is tracked at the granularity of cache lines, so that writes to data which shares a page with code (e.g. guest
+			 * JITs, or kernel trampolines) don't invalidate translations of the code. A write to a page with code in it publishes
+			 * RegionInvalidatePhysical, for translators which only track whole pages, and CodeLinesInvalidatePhysical, only if the
+			 * write overlaps a line which contains code.
 			 */
 			class CodeRegionTracker
 			{
 			public:
-				CodeRegionTracker(archsim::util::PubSubContext &pubsub) : pubsub(pubsub)
+				static const uint32_t kLineBits = 6;
+				static const uint32_t kLineSize = 1 << kLineBits;
+				static const uint64_t kAllLines = ~0ull;
+
+				static_assert(RegionArch::PageSize / kLineSize == 64, "Each line of a page must have a bit in a 64 bit mask");
+
+				CodeRegionTracker(archsim::util::PubSubContext &pubsub);
+				~CodeRegionTracker();
+
+				// The lines of a page covered by size bytes starting at the given page offset. The range must not
+				// cross the end of the page.
+				static uint64_t GetLineMask(uint64_t page_offset, uint64_t size)
 				{
-					Invalidate();
+					uint64_t first = page_offset >> kLineBits;
+					uint64_t last = (page_offset + size - 1) >> kLineBits;
+					uint64_t count = last - first + 1;
+					return (count >= 64 ? kAllLines : ((1ull << count) - 1)) << first;
 				}
 
 				void MarkRegionAsCode(PhysicalAddress region_base)
 				{
-					code_regions.set(region_base.GetPageIndex());
-					pubsub.Publish(PubSubType::RegionDispatchedForTranslationPhysical, (void*)(uint64_t)region_base.GetPageBase());
+					MarkLinesAsCode(region_base, kAllLines);
 				}
+				void MarkLinesAsCode(PhysicalAddress page_base, uint64_t lines);
+
 				bool IsRegionCode(PhysicalAddress region_base)
 				{
 					return code_regions.test(region_base.GetPageIndex());
@@ -52,20 +83,50 @@ namespace archsim
 
 				void InvalidateRegion(PhysicalAddress region_base)
 				{
-					if(IsRegionCode(region_base)) {
-						LC_DEBUG1(LogProfile) << "Invalidating code region at " << std::hex << region_base.Get();
-						pubsub.Publish(PubSubType::RegionInvalidatePhysical, (void*)(uint64_t)region_base.GetPageBase());
+					InvalidateLines(region_base, kAllLines);
+				}
+
+				// Called for every write to guest memory which might contain code. Only writes to pages with code on
+				// them take the slow path.
+				void InvalidateWrite(PhysicalAddress addr, uint64_t size)
+				{
+					if(IsRegionCode(addr) || (addr.GetPageOffset() + size > RegionArch::PageSize && IsRegionCode(PhysicalAddress(addr.GetPageBase() + RegionArch::PageSize)))) {
+						invalidateWrite(addr, size);
 					}
-					code_regions.reset(region_base.GetPageIndex());
 				}
-				void Invalidate()
+				void InvalidateLines(PhysicalAddress page_base, uint64_t lines);
+
+				void Invalidate();
+
+				// Writes to pages containing code, and how many of those missed the code on the page
+				uint64_t GetCodeWrites() const
+				{
+					return code_writes_.load(std::memory_order_relaxed);
+				}
+				uint64_t GetAvoidedInvalidations() const
 				{
-					code_regions.reset();
+					return avoided_invalidations_.load(std::memory_order_relaxed);
 				}
 
+				void PrintStatistics(std::ostream &stream) const;
+
 			private:
+				// Line masks are allocated in chunks of pages, so that memory is only used for the parts of the
+				// physical address space which contain code.
+				static const uint32_t kPagesPerChunk = 512;
+				static const uint32_t kChunkCount = RegionArch::PageCount / kPagesPerChunk;
+
+				std::atomic<uint64_t> &getLines(PhysicalAddress page_base);
+				std::atomic<uint64_t> *getLinesPtr(PhysicalAddress page_base) const;
+
+				void invalidateWrite(PhysicalAddress addr, uint64_t size);
+
 				std::bitset<RegionArch::PageCount> code_regions;
+				std::atomic<std::atomic<uint64_t>*> code_lines[kChunkCount];
 				archsim::util::PubSubscriber pubsub;
+
+				std::atomic<uint64_t> code_writes_;
+				std::atomic<uint64_t> avoided_invalidations_;
 			};
 
 		}
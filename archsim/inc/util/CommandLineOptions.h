@@ -24,6 +24,13 @@ DefineLongFlag(ProfileIrFreq, "profile-ir");
 
 DefineLongFlag(EnablePerfMap, "enable-perf-map");
 
+DefineLongRequiredArgument(std::string, SnapshotSave, "snapshot-save");
+DefineLongRequiredArgument(std::string, SnapshotRestore, "snapshot-restore");
+DefineLongFlag(SnapshotEagerRestore, "snapshot-eager-restore");
+
+DefineLongRequiredArgument(std::string, MemoryImage, "memory-image");
+DefineLongRequiredArgument(std::string, MemoryImageSave, "memory-image-save");
+
 DefineRequiredArgument(uint32_t, LogLevel, 'g', "log-level");
 DefineLongRequiredArgument(std::string, LogSpec, "logspec");
 DefineLongRequiredArgument(std::string, LogTarget, "log-target");
@@ -62,12 +69,15 @@ DefineLongRequiredArgument(std::string, JitInterruptScheme, "icp");
 DefineLongRequiredArgument(std::string, JitEngine, "engine");
 DefineLongRequiredArgument(uint32_t, JitThreads, "fast-num-threads");
 DefineLongRequiredArgument(std::string, JitOptString, "jit-opts");
+DefineLongRequiredArgument(std::string, JitHostCPU, "jit-host-cpu");
+DefineLongRequiredArgument(std::string, JitHostFeatures, "jit-host-features");
 DefineLongRequiredArgument(std::string, Mode, "mode");
 DefineLongFlag(JitDisableAA, "no-aa");
 DefineLongFlag(JitDebugAA, "debug-aa");
 DefineLongFlag(JitUseIJ, "jit-use-ij");
 DefineLongRequiredArgument(uint32_t, JitHotspotThreshold, "hotspot-threshold");
 DefineLongRequiredArgument(uint32_t, JitProfilingInterval, "profiling-interval");
+DefineLongRequiredArgument(uint32_t, JitTierUpThreshold, "tier-up-threshold");
 DefineRequiredArgument(uint32_t, JitOptLevel, 'O', "opt-level");
 
 DefineLongFlag(JitExtraCounters, "extra-counters");
@@ -82,6 +92,8 @@ DefineLongRequiredArgument(std::string, DeviceTreeFile, "device-tree");
 DefineLongRequiredArgument(std::string, RootFS, "root-fs");
 DefineLongRequiredArgument(std::string, BlockDeviceFile, "bdev-file");
 DefineLongFlag(CopyOnWrite, "copy-on-write");
+DefineLongRequiredArgument(uint32_t, BlockIOThreads, "bdev-io-threads");
+DefineLongRequiredArgument(uint32_t, BlockQueues, "bdev-queues");
 DefineLongRequiredArgument(std::string, KernelArgs, "kernel-args");
 DefineLongRequiredArgument(std::string, Bootloader, "bootloader");
 DefineLongRequiredArgument(std::string, SystemMemoryModel, "sys-model");
@@ -91,9 +103,13 @@ DefineLongFlag(SerialGrab, "grab-serial");
 
 DefineLongRequiredArgument(std::string, JitTranslationManager, "txln-mgr");
 DefineLongFlag(JitDisableBranchOpt, "disable-branch-opt");
+DefineLongFlag(JitDisableTargetCache, "disable-target-cache");
+DefineLongRequiredArgument(uint32_t, JitTracePages, "jit-trace-pages");
+DefineLongFlag(InterpDisablePredecode, "interp-no-predecode");
 
 DefineLongFlag(JitLoadTranslations, "jit-load-txlns");
 DefineLongFlag(JitSaveTranslations, "jit-save-txlns");
+DefineLongRequiredArgument(std::string, JitTranslationStore, "txln-store");
 
 // Special Options
 DefineLongFlag(Doom, "doom");
@@ -12,7 +12,9 @@
 //
 // The Histogram is extremely powerful, efficient and easy to use. It grows
 // on demand and fully automatic and it integrates very well with our JIT
-// compiler.
+// compiler. Updates are lock-free, so profiling can stay enabled when
+// many guest threads are running, with one Histogram per thread which
+// are merged when the results are reported.
 //
 // There is also a HistogramIter iterator that allows for easy iteration
 // over histogram entries in a Histogram:
@@ -36,10 +38,10 @@
 
 #include "concurrent/Mutex.h"
 
-#include <set>
+#include <atomic>
 #include <map>
-#include <stack>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 namespace archsim
@@ -127,8 +129,20 @@ namespace archsim
 		};
 
 // -------------------------------------------------------------------------
-// Histogram  maintains HistogramEntries allowing fast access and
+// Histogram maintains HistogramEntries allowing fast access and
 // increment operations.
+//
+// Entries live in a flat open-addressed table, which grows by adding
+// segments of twice the size rather than by rehashing, so a pointer to an
+// entry's value stays valid for the lifetime of the Histogram and can be
+// baked into translated code.
+//
+// Looking up and updating existing entries never takes a lock. Only the
+// first touch of an index does, to add its entry. Each Histogram is meant
+// to be updated mostly by one thread (e.g. one per guest thread), but
+// values are updated atomically, because translated code which counts into
+// it may be run by other threads. Histograms can be read and merged while
+// they are being updated.
 //
 		class Histogram
 		{
@@ -147,9 +161,6 @@ namespace archsim
 			// case the MultiHistogram is container (i.e. CounterManager) managed.
 			//
 
-			// No args constructor creating an empty Histogram without unique ID
-			// assignment and a name
-			//
 			// Set histogram ID
 			//
 			void set_id(uint32_t id)
@@ -158,15 +169,18 @@ namespace archsim
 			}
 
 		public:
-			typedef std::map<HistogramEntry::histogram_key_t, HistogramEntry::histogram_value_t*> hist_map_key_ptr_t;
+			typedef std::map<HistogramEntry::histogram_key_t, HistogramEntry::histogram_value_t> hist_map_key_value_t;
 
-			// Default HistogramEntry allocation size
+			// Default number of entries in the first segment of the table
 			//
 			static const int kHistogramEntryDefaultAllocSize = 64;
 
 			explicit Histogram();
 			explicit Histogram(uint32_t alloc_size);
 
+			Histogram(const Histogram &) = delete;
+			Histogram &operator=(const Histogram &) = delete;
+
 			// Destructor
 			//
 			~Histogram();
@@ -202,6 +216,11 @@ namespace archsim
 			void inc(HistogramEntry::histogram_key_t idx);
 			void inc(HistogramEntry::histogram_key_t idx, HistogramEntry::histogram_value_t val);
 
+			// Add every entry of another Histogram to this one. The other
+			// Histogram may still be being updated.
+			//
+			void merge(const Histogram &other);
+
 			// Reset everything to 0
 			//
 			void clear();
@@ -213,52 +232,67 @@ namespace archsim
 			// Return histogram with entries formatted as specified
 			std::string to_string(const char* const);
 
-			inline const hist_map_key_ptr_t &get_value_map() const
-			{
-				return hist_map_index_value_;
-			}
+			// Return a copy of the entries, ordered by index
+			//
+			hist_map_key_value_t get_value_map() const;
 
 		private:
 			uint32_t id_;
 			static const uint32_t kInitialHistogramId = 0xFFFFFFFF;
 
-			uint32_t alloc_size_;
+			struct Slot {
+				// kEmptyKey until the entry has been added
+				std::atomic<uint64_t> key;
+				HistogramEntry::histogram_value_t value;
+			};
 
-			// Set of ALL HistogramEntries for this Histogram
-			//
-			std::set<HistogramEntry*> hist_entries_;
+			struct Segment {
+				uint32_t size;
+				uint32_t used;
+				Slot *slots;
+			};
 
-			// Map for fast lookup/increment of HistogramEntry values:
-			// key: hist index
-			// val: pointer to hist value
-			//
-			hist_map_key_ptr_t hist_map_index_value_;
+			static const uint64_t kEmptyKey = ~0ULL;
 
-			// In order to allow for allocation to happen in chunks we use an allocation
-			// pool that looks like a stack. When adding a new HistogramEntry to the
-			// hist_entries_ set we pop a pre-allocated element from the hist_alloc_pool_
-			// stack. Should the hist_alloc_pool_ become empty we will allocate another
-			// chunk of HistogramEntries and put them on a stack.
+			// Segment N has alloc_size_ << N slots, which is plenty
 			//
-			std::stack<HistogramEntry*> hist_entries_alloc_pool_;
+			static const uint32_t kMaxSegments = 32;
 
-			// Stack of ALL allocated HistogramEntry chunks
-			//
-			std::stack<HistogramEntry*> hist_entries_alloc_chunks_;
+			uint32_t alloc_size_;
+			std::atomic<Segment*> segments_[kMaxSegments];
 
-			// Mutex that must be acquired before modifying HistogramEntry book keeping
-			// structures
+			// Mutex that must be acquired before adding an entry
 			//
 			archsim::concurrent::Mutex hist_entries_mutex_;
 
-			// Re-fills allocation pool and returns number of instantiated HistogramEntries
+			// Returns a pointer to the value at index, or null if there isn't
+			// an entry for it
 			//
-			uint32_t refill_historgram_allocation_pool();
+			HistogramEntry::histogram_value_t* lookup(HistogramEntry::histogram_key_t idx) const;
 
-			// Returns pointer to new HistogramEntry and maintains all lookup
-			// structures
+			// Returns pointer to the value of a new entry
 			//
-			HistogramEntry* new_histogram_entry(HistogramEntry::histogram_key_t idx);
+			HistogramEntry::histogram_value_t* new_histogram_entry(HistogramEntry::histogram_key_t idx);
+
+			// Call fn(index, value) for each entry
+			//
+			template<typename Fn> void for_each_entry(Fn fn) const
+			{
+				for(uint32_t s = 0; s < kMaxSegments; ++s) {
+					Segment *segment = segments_[s].load(std::memory_order_acquire);
+					if(segment == nullptr) {
+						break;
+					}
+
+					for(uint32_t i = 0; i < segment->size; ++i) {
+						const Slot &slot = segment->slots[i];
+						uint64_t key = slot.key.load(std::memory_order_acquire);
+						if(key != kEmptyKey) {
+							fn((HistogramEntry::histogram_key_t)key, __atomic_load_n(&slot.value, __ATOMIC_RELAXED));
+						}
+					}
+				}
+			}
 		};
 
 // -------------------------------------------------------------------------
@@ -268,8 +302,10 @@ namespace archsim
 		{
 		private:
 			const Histogram& hist;
-			std::set<HistogramEntry*, HistogramEntryComparator> entries;
-			std::set<HistogramEntry*>::const_iterator iter;
+			std::vector<HistogramEntry> entries;
+			std::vector<HistogramEntry>::const_iterator iter;
+
+			void fill_entries();
 
 		public:
 			HistogramIter(const Histogram& h);
@@ -22,6 +22,7 @@ DeclarePubType(RegionDispatchedForTranslationVirtual)
 DeclarePubType(RegionTranslationComleted)
 
 DeclarePubType(RegionInvalidatePhysical)
+DeclarePubType(CodeLinesInvalidatePhysical)
 
 DeclarePubType(L1ICacheFlush)
 DeclarePubType(L1DCacheFlush)
@@ -33,6 +33,7 @@ DefineIntSetting(General, LogLevel, "Defines minimum logging level", 0);
 DefineSetting(General, LogTarget, "Specifies default logging target", "console");
 DefineFlag(General, Debug, "Enables debugging output", false);
 DefineFlag(General, LogTreeDump, "Dumps the logging context tree", false);
+DefineFlag(General, StateBlockDump, "Dumps the state block layout of each thread before it starts", false);
 
 DefineFlag(General, Quiet, "Suppresses display of the ArcSim banner.", false);
 DefineFlag(General, Verbose, "Enables verbose output reporting", false);
@@ -51,7 +52,7 @@ DefineInt64Setting(Tracing, TraceSkip, "Skip instruction count", 0);
 DefineFlag(Tracing, SimpleTrace, "Simplified tracing", false);
 DefineFlag(Tracing, TraceSymbols, "Enables symbol resolution in tracing output", false);
 DefineFlag(Tracing, SuppressTracing, "Suppress tracing output at system startup", false);
-DefineSetting(Tracing, TraceMode, "Selects tracing output mode", "binary");
+DefineSetting(Tracing, TraceMode, "Selects tracing output mode (binary or compressed)", "binary");
 DefineSetting(Tracing, TraceFile, "Redirects tracing output to a file", "trace.out");
 DefineSetting(Tracing, StdOutFile, "Redirects stdout to a file", "stdout");
 DefineSetting(Tracing, StdErrFile, "Redirects stderr to a file", "stderr");
@@ -66,6 +67,13 @@ DefineFlag(System, LazyMemoryModelInvalidation, "Uses lazy invalidation for the
 DefineFlag(System, MemoryCheckAlignment, "Enforce strict alignment on memory accesses", true);
 DefineFlag(System, EnablePerfMap, "Enable Perf-compatible JIT map", false);
 
+DefineSetting(System, SnapshotSave, "Save a snapshot of the guest to this file when the simulation ends", "");
+DefineSetting(System, SnapshotRestore, "Start the simulation from the guest snapshot in this file", "");
+DefineFlag(System, SnapshotEagerRestore, "Restore all of guest memory from the snapshot before starting, rather than on demand", false);
+
+DefineSetting(System, MemoryImage, "Map guest memory copy-on-write from this raw memory image, which is shared with other simulations using it", "");
+DefineSetting(System, MemoryImageSave, "Write guest memory to this raw memory image when the simulation ends", "");
+
 DefineFloatSetting(System, TickScale, "Scale timer tick length to be x times longer", 1);
 
 DefineSetting(System, Mode, "Selects the simulation mode to use", "interp");
@@ -79,10 +87,15 @@ DefineSetting(System, ZImageSymbolMap, "Symbol Map for a ZIMAGE binary", "");
 DefineSetting(System, SCPText, "Text to pass into the simulator cache coprocessor", "");
 
 DefineFlag(System, InstructionTick, "Use an instruction-based clock", false);
+DefineIntSetting(System, WaitForInterruptTimeout, "How long, in microseconds, a thread waiting for an interrupt is parked when the time of the next timer event is not known", 10000);
+DefineFlag(System, Deterministic, "Run guest threads in fixed instruction quanta, so that multi-core simulations are reproducible (implies InstructionTick)", false);
+DefineIntSetting(System, DeterministicQuantum, "The number of instructions in each quantum of a deterministic simulation", 10000);
+DefineFlag(System, DeterministicParallel, "Run the quanta of a deterministic simulation in parallel. Only interactions through devices and interrupts are then reproducible", false);
 
 DefineListSetting(System, Breakpoints, "List of functions to insert breakpoints on", new std::list<std::string>());
 
 DefineIntSetting(Simulation, SimulationPeriod, "Runs the simulation for the specified number of blocks", 10000);
+DefineFlag(Simulation, InterpDisablePredecode, "Decode every instruction as it is interpreted, rather than caching pre-decoded blocks", false);
 
 DefineFlag(LIR, LirDisableChain, "Disables chaining in the LIR JIT", false);
 DefineSetting(LIR, LirRegisterAllocator, "Selects the register allocator to use", "graph-colouring");
@@ -94,18 +107,25 @@ DefineSetting(JIT, JitEngine, "Selects the type of JIT engine to use", "llvm");
 DefineIntSetting(JIT, JitThreads, "Chooses the number of threads to employ for JIT compilation", 1);
 DefineSetting(JIT, JitInterruptScheme, "Selects the interrupt checking scheme to use when using the JIT", "full");
 DefineSetting(JIT, JitOptString, "Selects the optimisation passes to use with LLVM", "");
+DefineSetting(JIT, JitHostCPU, "Selects the host CPU to generate code for, instead of the one the simulator is running on", "");
+DefineSetting(JIT, JitHostFeatures, "Comma separated host CPU features to enable (+feature) or disable (-feature) when generating code", "");
 DefineFlag(JIT, JitDisableAA, "Disables custom alias-analysis in the JIT", false);
 DefineIntSetting(JIT, JitHotspotThreshold, "Chooses the number of times a region must be profiled to become hot", 20);
+DefineIntSetting(JIT, JitTierUpThreshold, "Chooses the number of times a region must be profiled before the tiered engine compiles it with the block JIT", 5);
 DefineIntSetting(JIT, JitProfilingInterval, "Chooses the number of basic-blocks to execute before considering regions for compilation", 30000);
 DefineIntSetting(JIT, TransCacheSize, "Sets the size of the translation cache", 8192);
 DefineIntSetting(JIT, JitOptLevel, "Sets the optimisation level for translation", 3);
 DefineFlag(JIT, JitDisableBranchOpt, "Disable branch optimisations", false);
+DefineFlag(JIT, JitDisableTargetCache, "Return to the execution engine after every indirect branch, rather than using the inline target cache", false);
+DefineIntSetting(JIT, JitTracePages, "Sets the maximum number of guest pages which a block JIT translation can span", 4);
+DefineIntSetting(JIT, JitTraceLength, "Sets the maximum number of guest instructions in a block JIT translation", 128);
 DefineFlag(JIT, JitExtraCounters, "Enable extra JIT counters", false);
 DefineFlag(JIT, JitDebugAA, "Produce alias-analysis debugging output", false);
 DefineFlag(JIT, JitUseIJ, "Use the instruction JIT to perform non-native execution", false);
 DefineFlag(JIT, JitChecksumPages, "Produce and check checksums of JITed code on generation and execution", false);
 DefineFlag(JIT, JitSaveTranslations, "Keep JIT translations between simulation runs", false);
 DefineFlag(JIT, JitLoadTranslations, "Keep JIT translations between simulation runs", false);
+DefineSetting(JIT, JitTranslationStore, "Sets the file used to keep JIT translations between simulation runs", "archsim.txlns");
 
 DefineFlag(JIT, AggressiveCodeInvalidation, "Invalidate all code on a cache flush, rather than just detected modifications", false);
 
@@ -122,6 +142,8 @@ DefineSetting(Platform, KernelArgs, "Arguments to pass into the linux kernel", "
 DefineSetting(Platform, RootFS, "Path to initrd rootfs", "");
 DefineSetting(Platform, BlockDeviceFile, "Path to block device file", "");
 DefineFlag(Platform, CopyOnWrite, "Copy on write block device", false);
+DefineIntSetting(Platform, BlockIOThreads, "Number of host threads servicing virtio block requests (0 services them on the guest CPU thread)", 2);
+DefineIntSetting(Platform, BlockQueues, "Number of request queues offered by virtio block devices", 1);
 DefineIntSetting(Platform, RootFSLocation, "Physical memory location to write initrd to", 0x800000);
 DefineSetting(Platform, Bootloader, "Bootloader for ELF system emulation", "");
 DefineFlag(Platform, SerialGrab, "Take control of the terminal for use as a serial port", false);
@@ -9,13 +9,16 @@
 #define SP804_H
 
 #include "PrimecellRegisterDevice.h"
-#include "abi/devices/generic/timing/TickConsumer.h"
+#include "abi/devices/generic/timing/EventScheduler.h"
 #include "abi/devices/IRQController.h"
-#include "util/TimerManager.h"
-#include "concurrent/Thread.h"
+
+#include <mutex>
 
 // ARM Dual Timer Module (SP804)
-// Consists of two 32/16 bit count-down timers which generate interrupts on reaching 0
+// Consists of two 32/16 bit count-down timers which generate interrupts on reaching 0.
+// Rather than counting down on every tick, each timer schedules an event for
+// the tick at which it will reach 0, and works out its current value from
+// the tick counter when it is read.
 
 namespace archsim
 {
@@ -24,13 +27,18 @@ namespace archsim
 		namespace devices
 		{
 			class IRQLine;
+
+			namespace timing
+			{
+				class TickSource;
+			}
 		}
 
 		namespace external
 		{
 			namespace arm
 			{
-				class SP804 : public PrimecellRegisterDevice, public timing::TickConsumer
+				class SP804 : public PrimecellRegisterDevice
 				{
 				public:
 					SP804(EmulationModel &parent, Address base_address);
@@ -50,7 +58,7 @@ namespace archsim
 						suspended = false;
 					};
 
-					class InternalTimer
+					class InternalTimer : public timing::ScheduledEvent
 					{
 					public:
 						uint8_t id;
@@ -60,10 +68,6 @@ namespace archsim
 						bool ReadRegister(uint32_t offset, uint64_t& data);
 						bool WriteRegister(uint32_t offset, uint32_t data);
 
-						inline void SetManager(util::timing::TimerManager& mgr)
-						{
-							this->mgr = &mgr;
-						}
 						inline void SetOwner(SP804& owner)
 						{
 							this->owner = &owner;
@@ -78,32 +82,30 @@ namespace archsim
 							return control_reg.bits.int_en;
 						}
 
-						void Tick(uint32_t ticks);
-						void TickFile();
+						void Fire(uint64_t now) override;
 
 						inline bool IsEnabled() const
 						{
 							return enabled;
 						}
 
-						void GetNextFileTick();
-
 					private:
 						void Update();
-						void InitialisePeriod();
+						void InitialisePeriod(uint64_t now);
+						void StartPeriod(uint32_t value, uint64_t now);
+						uint32_t GetCurrentValue(uint64_t now) const;
 
-						util::timing::TimerManager *mgr;
 						SP804 *owner;
 
-						volatile bool enabled;
+						bool enabled;
 
 						uint32_t load_value;
-						uint32_t current_value;
-						uint32_t internal_prescale;
-
-						uint64_t ticker, next_irq;
+						// The value of the counter at the start of the current
+						// period, and the tick at which the period started
+						uint32_t period_value;
+						uint64_t period_start;
 
-						volatile uint32_t isr;
+						uint32_t isr;
 
 						union {
 							uint32_t value;
@@ -119,22 +121,22 @@ namespace archsim
 						} control_reg;
 					};
 
-					void Tick(uint32_t tick_periods) override;
-
-				protected:
-					void tick();
-
 				private:
+					// The timers count down this many times per tick
+					static const uint32_t kCountsPerTick = 1000;
+
 					void UpdateIRQ();
 
 					COMPONENT_PARAMETER_ENTRY(IRQLine, IRQLine, IRQLine);
 					InternalTimer timers[2];
 
-					uint32_t ticks, calibrated_ticks, recalibrate, total_overshoot, overshoot_samples;
 					bool suspended;
-					uint32_t prescale;
 
 					EmulationModel &emu_model;
+					timing::TickSource *tick_source;
+
+					// Held while the timers are read, written or fired
+					std::mutex lock;
 				};
 			}
 		}
@@ -16,24 +16,19 @@ using namespace archsim::abi::external::arm;
 static ComponentDescriptor sp804_descriptor ("SP804", {{"IRQLine", ComponentParameter_Component}});
 SP804::SP804(EmulationModel &parent, Address base_address)
 	: PrimecellRegisterDevice(parent, base_address, 0x1000, 0x00141804, 0xb105f00d, "sp804"), Component(sp804_descriptor),
-	  ticks(1000), calibrated_ticks(0), recalibrate(0), total_overshoot(0), overshoot_samples(0), suspended(false), emu_model(parent),prescale(0)
+	  suspended(false), emu_model(parent), tick_source(parent.GetSystem().GetTickSource())
 {
-
-	timers[0].SetManager(parent.timer_mgr);
 	timers[0].id = 0;
 	timers[0].SetOwner(*this);
 
-	timers[1].SetManager(parent.timer_mgr);
 	timers[1].id = 1;
 	timers[1].SetOwner(*this);
-
-	parent.GetSystem().GetTickSource()->AddConsumer(*this);
-
 }
 
 SP804::~SP804()
 {
-	emu_model.GetSystem().GetTickSource()->RemoveConsumer(*this);
+	tick_source->CancelEvent(timers[0]);
+	tick_source->CancelEvent(timers[1]);
 }
 
 bool SP804::Initialise()
@@ -45,6 +40,8 @@ bool SP804::Read(uint32_t offset, uint8_t size, uint64_t& data)
 {
 	LC_DEBUG1(LogSP804) << "["<< std::hex  << GetBaseAddress() << "] Read "<< offset << " = ...";
 
+	std::lock_guard<std::mutex> l(lock);
+
 //	fprintf(stderr, "SP804 Read: offset: %x", offset);
 	if (offset < 0x20) {
 		assert(size == 4);
@@ -61,6 +58,9 @@ bool SP804::Write(uint32_t offset, uint8_t size, uint64_t data)
 {
 //	fprintf(stderr, "SP804 Write offset: %x, size: %x, data: %x\n", offset, size, data);
 	LC_DEBUG1(LogSP804) << "["<< std::hex  << GetBaseAddress() << "] Write "<< offset << " = " << data;
+
+	std::lock_guard<std::mutex> l(lock);
+
 	if (offset < 0x20) {
 		assert(size == 4);
 		return timers[0].WriteRegister(offset, data);
@@ -85,25 +85,14 @@ void SP804::UpdateIRQ()
 	}
 }
 
-void SP804::Tick(uint32_t tick_periods)
-{
-	tick();
-}
-
-void SP804::tick()
-{
-	if (timers[0].IsEnabled()) timers[0].Tick(ticks);
-	if (timers[1].IsEnabled()) timers[1].Tick(ticks);
-}
-
 
 SP804::InternalTimer::InternalTimer() :
-	load_value(0),
-	current_value(0xffffffff),
-	isr(0),
+	owner(nullptr),
 	enabled(false),
-	internal_prescale(0),
-	ticker(0)
+	load_value(0),
+	period_value(0xffffffff),
+	period_start(0),
+	isr(0)
 {
 	control_reg.value = 0x20;
 }
@@ -116,7 +105,7 @@ bool SP804::InternalTimer::ReadRegister(uint32_t offset, uint64_t& data)
 			data = load_value;
 			return true;
 		case 0x4:						// VALUE
-			data = current_value;
+			data = GetCurrentValue(owner->tick_source->GetCounter());
 			return true;
 
 		case 0x08:						// CONTROL
@@ -143,8 +132,7 @@ bool SP804::InternalTimer::WriteRegister(uint32_t offset, uint32_t data)
 	switch (offset) {
 		case 0x0:						// LOAD
 			load_value = data;
-			current_value = data;
-			internal_prescale = 0;
+			StartPeriod(data, owner->tick_source->GetCounter());
 			return true;
 		case 0x08:						// CONTROL
 			control_reg.value = data;
@@ -162,12 +150,6 @@ bool SP804::InternalTimer::WriteRegister(uint32_t offset, uint32_t data)
 	return false;
 }
 
-/*static void TimerElapsed(archsim::util::timing::TimerCtx timerctx, void *state)
-{
-	auto timer = (SP804::InternalTimer *)state;
-	timer->Tick();
-}*/
-
 void SP804::InternalTimer::Update()
 {
 //	fprintf(stderr, "*** TIMER %d SETTINGS: %x enable=%d, int_en=%d, mode=%d, one_shot=%d, prescale=%d, rsvd=%d, size=%d\n",
@@ -181,89 +163,91 @@ void SP804::InternalTimer::Update()
 //			control_reg.bits.size
 //			);
 
-	if (control_reg.bits.enable && !enabled) {
-//		assert(!control_reg.bits.one_shot);
-
-		InitialisePeriod();
-		internal_prescale = 0;
-
-		LC_DEBUG1(LogSP804) << "Timer Enabled with current value=" << current_value;
+	uint64_t now = owner->tick_source->GetCounter();
 
+	if (control_reg.bits.enable && !enabled) {
 		enabled = true;
+		InitialisePeriod(now);
+
+		LC_DEBUG1(LogSP804) << "Timer Enabled with current value=" << period_value;
 	} else if (!control_reg.bits.enable && enabled) {
+		// The counter holds its value while the timer is disabled
+		StartPeriod(GetCurrentValue(now), now);
 		enabled = false;
+		owner->tick_source->CancelEvent(*this);
+
 		LC_DEBUG1(LogSP804) << "Timer Disabled";
 	}
 
 	owner->UpdateIRQ();
 }
 
-void SP804::InternalTimer::TickFile()
+void SP804::InternalTimer::Fire(uint64_t now)
 {
-	ticker++;
-	if(ticker == (next_irq)) {
-		assert(this->IsEnabled());
-		isr |= 1;
-		if (control_reg.bits.int_en)
-			owner->UpdateIRQ();
-		InitialisePeriod();
-//			fprintf(stderr, "PING IRQ\n");
-	}
+	std::lock_guard<std::mutex> l(owner->lock);
 
-}
-
-void SP804::InternalTimer::Tick(uint32_t ticks)
-{
-//	fprintf(stderr, "SP804 Internal Timer Tick\n");
-	if (!enabled)
+	// The timer may have been disabled or reloaded after the event was
+	// taken off the schedule, but before it fired.
+	if (!enabled || IsScheduled()) {
 		return;
+	}
 
-	/*
-	//	if(!internal_qemu_hack) {
-	//		internal_qemu_hack = true;
-	//		return;
-	//	}
-
-		uint32_t prescale_val = 10 * 100;
-
-		internal_prescale += 1;
-		if(internal_prescale < prescale_val) {
-			return;
-		}
-
-		internal_prescale = 0;
-	*/
-	// Check to see if we've reached zero.
-	if (current_value <= ticks) {
-		isr |= 1;
-
-		// If the interrupt is enabled, post it.
-		if (control_reg.bits.int_en)
-			owner->UpdateIRQ();
+	isr |= 1;
 
-		// Recalibrate the timer.
-		InitialisePeriod();
+	// If the interrupt is enabled, post it.
+	if (control_reg.bits.int_en)
+		owner->UpdateIRQ();
 
-		// If this is a one-shot timer, then don't restart it.
-		if (control_reg.bits.one_shot) {
-			return;
-		}
+	// If this is a one-shot timer, then it stops at zero. Otherwise, start
+	// counting down again.
+	if (control_reg.bits.one_shot) {
+		period_value = 0;
+		period_start = now;
 	} else {
-		current_value -= ticks;
+		InitialisePeriod(now);
 	}
 }
 
-void SP804::InternalTimer::InitialisePeriod()
+void SP804::InternalTimer::InitialisePeriod(uint64_t now)
 {
 //	fprintf(stderr, "SP804 Initialise Period\n");
 	if (control_reg.bits.mode == 0) {
 		if (control_reg.bits.size == 0) {
-			current_value = 0xffff;
+			StartPeriod(0xffff, now);
 		} else {
-			current_value = 0xffffffff;
+			StartPeriod(0xffffffff, now);
 		}
 	} else {
-		current_value = load_value;
-		internal_prescale = 0;
+		StartPeriod(load_value, now);
+	}
+}
+
+void SP804::InternalTimer::StartPeriod(uint32_t value, uint64_t now)
+{
+	period_value = value;
+	period_start = now;
+
+	if (enabled) {
+		// The timer reaches zero during the tick in which the count runs
+		// out, which is never the tick it started in.
+		uint64_t ticks = ((uint64_t)value + kCountsPerTick - 1) / kCountsPerTick;
+		if (ticks == 0) {
+			ticks = 1;
+		}
+
+		owner->tick_source->ScheduleEvent(*this, now + ticks);
+	}
+}
+
+uint32_t SP804::InternalTimer::GetCurrentValue(uint64_t now) const
+{
+	if (!enabled) {
+		return period_value;
+	}
+
+	uint64_t elapsed = (now - period_start) * kCountsPerTick;
+	if (elapsed >= period_value) {
+		return 0;
 	}
+	return period_value - elapsed;
 }
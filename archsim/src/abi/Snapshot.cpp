@@ -0,0 +1,673 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "abi/Snapshot.h"
+#include "abi/SystemEmulationModel.h"
+#include "abi/devices/Component.h"
+#include "abi/devices/Device.h"
+#include "abi/devices/DeviceManager.h"
+#include "abi/devices/DeviceState.h"
+#include "abi/devices/PeripheralManager.h"
+#include "abi/memory/MemoryModel.h"
+#include "core/thread/ThreadInstance.h"
+#include "util/LogContext.h"
+#include "system.h"
+#include "lz4.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <set>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DeclareLogContext(LogSnapshot, "Snapshot");
+
+using namespace archsim::abi;
+using archsim::abi::devices::DeviceState;
+using archsim::abi::memory::GuestVMA;
+using archsim::abi::memory::RegionBasedMemoryModel;
+using archsim::core::thread::ThreadInstance;
+
+static const char kMagic[8] = { 'A', 'S', 'I', 'M', 'S', 'N', 'P', 0 };
+const uint32_t Snapshot::kPageSize;
+const size_t LazyMemoryRestorer::kChunkPages;
+
+static const size_t kChunkSize = LazyMemoryRestorer::kChunkPages * Snapshot::kPageSize;
+
+// The last fault on this host thread which was retried because another
+// thread had already restored the chunk
+static thread_local uintptr_t last_retried_fault = 0;
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t tag_size;
+	uint64_t state_offset;
+	uint64_t state_size;
+};
+
+struct StoredPage {
+	uint64_t index;
+	uint64_t offset;
+	uint32_t size;
+	uint32_t reserved;
+};
+
+static size_t align8(size_t size)
+{
+	return (size + 7) & ~7;
+}
+
+static int HostProtection(archsim::abi::memory::RegionFlags prot)
+{
+	int flags = PROT_NONE;
+	if(prot & (archsim::abi::memory::RegFlagRead | archsim::abi::memory::RegFlagExecute)) flags |= PROT_READ;
+	if(prot & archsim::abi::memory::RegFlagWrite) flags |= PROT_WRITE;
+	return flags;
+}
+
+static bool HandleRestoreFault(void *ctx, const System::segfault_data &data)
+{
+	return ((LazyMemoryRestorer*)ctx)->HandleFault(data.addr);
+}
+
+LazyMemoryRestorer::LazyMemoryRestorer(void *host_base, size_t size, int host_prot, const std::vector<Page> &pages) : host_base_((uint8_t*)host_base), size_(size), host_prot_(host_prot), pages_(pages), staging_(nullptr), restored_((size + kChunkSize - 1) / kChunkSize, false), chunks_restored_(0)
+{
+
+}
+
+LazyMemoryRestorer::~LazyMemoryRestorer()
+{
+	// Chunks which have been restored have already been moved out of the
+	// staging area, which just leaves holes in it.
+	if(staging_ != nullptr) {
+		munmap(staging_, size_);
+	}
+}
+
+bool LazyMemoryRestorer::Install()
+{
+	if((size_t)getpagesize() != Snapshot::kPageSize || ((uintptr_t)host_base_ & (Snapshot::kPageSize - 1))) {
+		return false;
+	}
+
+	void *staging = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if(staging == MAP_FAILED) {
+		return false;
+	}
+	staging_ = (uint8_t*)staging;
+
+	// Throw away whatever is in the region at the moment, and catch the first
+	// access to each chunk of it.
+	return !madvise(host_base_, size_, MADV_DONTNEED) && !mprotect(host_base_, size_, PROT_NONE);
+}
+
+bool LazyMemoryRestorer::HandleFault(uintptr_t addr)
+{
+	if(addr < (uintptr_t)host_base_ || addr >= (uintptr_t)host_base_ + size_) {
+		return false;
+	}
+
+	size_t chunk = (addr - (uintptr_t)host_base_) / kChunkSize;
+
+	std::lock_guard<std::mutex> lock(lock_);
+	if(restored_[chunk]) {
+		// Another thread restored the chunk while this one was waiting for
+		// it, so retry the access. If the retry faults in the same place, the
+		// fault has nothing to do with restoring memory, so leave it to the
+		// other handlers.
+		if(last_retried_fault == addr) {
+			last_retried_fault = 0;
+			return false;
+		}
+
+		last_retried_fault = addr;
+		return true;
+	}
+
+	last_retried_fault = 0;
+	return restoreChunk(chunk);
+}
+
+bool LazyMemoryRestorer::restoreChunk(size_t chunk)
+{
+	size_t offset = chunk * kChunkSize;
+	size_t length = std::min(kChunkSize, size_ - offset);
+	uint8_t *staging = staging_ + offset;
+
+	uint64_t first_page = offset / Snapshot::kPageSize;
+	uint64_t end_page = first_page + (length / Snapshot::kPageSize);
+
+	auto page = std::lower_bound(pages_.begin(), pages_.end(), first_page, [](const Page &page, uint64_t index) {
+		return page.Index < index;
+	});
+	for(; page != pages_.end() && page->Index < end_page; ++page) {
+		if(!Snapshot::DecompressPage(page->Data, page->Size, staging + (page->Index - first_page) * Snapshot::kPageSize)) {
+			return false;
+		}
+	}
+
+	if(host_prot_ != (PROT_READ | PROT_WRITE) && mprotect(staging, length, host_prot_)) {
+		return false;
+	}
+
+	// Replace the protected pages with the restored ones in one go.
+	if(mremap(staging, length, length, MREMAP_MAYMOVE | MREMAP_FIXED, host_base_ + offset) == MAP_FAILED) {
+		return false;
+	}
+
+	restored_[chunk] = true;
+	chunks_restored_++;
+	return true;
+}
+
+uint32_t Snapshot::CompressPage(const void *page, uint8_t *out)
+{
+	// Big enough for LZ4_compressBound(kPageSize)
+	char buffer[kPageSize + (kPageSize / 255) + 16];
+	int size = LZ4_compress((const char*)page, buffer, kPageSize);
+
+	if(size <= 0 || (uint32_t)size >= kPageSize) {
+		memcpy(out, page, kPageSize);
+		return kPageSize;
+	}
+
+	memcpy(out, buffer, size);
+	return size;
+}
+
+bool Snapshot::DecompressPage(const uint8_t *data, uint32_t size, void *page)
+{
+	if(size == kPageSize) {
+		memcpy(page, data, kPageSize);
+		return true;
+	}
+
+	return LZ4_uncompress_unknownOutputSize((const char*)data, (char*)page, size, kPageSize) == (int)kPageSize;
+}
+
+bool Snapshot::IsZeroPage(const void *page)
+{
+	const uint64_t *words = (const uint64_t*)page;
+	for(uint32_t i = 0; i < kPageSize / sizeof(uint64_t); ++i) {
+		if(words[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+Snapshot::Snapshot() : mapping_(nullptr), mapping_size_(0)
+{
+
+}
+
+Snapshot::~Snapshot()
+{
+	restorers_.clear();
+
+	if(mapping_ != nullptr) {
+		munmap((void*)mapping_, mapping_size_);
+	}
+}
+
+static std::string GetComponentKey(devices::MemoryComponent &component)
+{
+	std::ostringstream str;
+	str << "memory@" << std::hex << component.GetBaseAddress().Get();
+	return str.str();
+}
+
+static std::vector<devices::MemoryComponent *> GetMemoryComponents(SystemEmulationModel &model)
+{
+	// Devices can be installed at more than one address, but only need to be
+	// saved once.
+	std::vector<devices::MemoryComponent *> components;
+	std::set<devices::MemoryComponent *> seen;
+	for(auto i : model.GetDeviceManager().GetDevices()) {
+		if(seen.insert(i.second).second) {
+			components.push_back(i.second);
+		}
+	}
+	return components;
+}
+
+static bool SaveThread(ThreadInstance &thread, DeviceState &state)
+{
+	size_t register_file_size = thread.GetArch().GetRegisterFileDescriptor().GetSize();
+	state.Write<uint64_t>(register_file_size);
+	state.WriteBytes(thread.GetRegisterFile(), register_file_size);
+
+	const auto &state_block = thread.GetStateBlock();
+	const auto &descriptor = state_block.GetDescriptor();
+	std::vector<const archsim::StateBlockDescriptor::Entry *> entries;
+	for(const auto &entry : descriptor.GetEntries()) {
+		if(!entry.HostOnly) {
+			entries.push_back(&entry);
+		}
+	}
+
+	state.Write<uint32_t>(entries.size());
+	for(auto entry : entries) {
+		state.WriteString(entry->Name);
+		state.Write<uint64_t>(entry->Size);
+		state.WriteBytes((const uint8_t*)state_block.GetData() + entry->Offset, entry->Size);
+	}
+
+	const auto &features = thread.GetArch().GetFeaturesDescriptor().GetFeatures();
+	state.Write<uint32_t>(features.size());
+	for(const auto &feature : features) {
+		state.WriteString(feature.GetName());
+		state.Write<uint32_t>(thread.GetFeatures().GetFeatureLevel(feature.GetID()));
+	}
+
+	auto &peripherals = thread.GetPeripherals().Peripherals;
+	state.Write<uint32_t>(peripherals.size());
+	for(auto peripheral : peripherals) {
+		DeviceState peripheral_state;
+		if(!peripheral.second->SaveState(peripheral_state)) {
+			LC_ERROR(LogSnapshot) << "Could not save the state of peripheral " << peripheral.first << " of thread " << thread.GetThreadID();
+			return false;
+		}
+
+		state.WriteString(peripheral.first);
+		state.WriteState(peripheral_state);
+	}
+
+	return true;
+}
+
+static bool RestoreThread(ThreadInstance &thread, DeviceState &state)
+{
+	uint64_t register_file_size;
+	if(!state.Read(register_file_size) || register_file_size != thread.GetArch().GetRegisterFileDescriptor().GetSize()) {
+		LC_ERROR(LogSnapshot) << "Register file layout of thread " << thread.GetThreadID() << " does not match the snapshot";
+		return false;
+	}
+	if(!state.ReadBytes(thread.GetRegisterFile(), register_file_size)) {
+		return false;
+	}
+
+	auto &state_block = thread.GetStateBlock();
+	const auto &descriptor = state_block.GetDescriptor();
+	uint32_t entry_count;
+	if(!state.Read(entry_count)) {
+		return false;
+	}
+	for(uint32_t i = 0; i < entry_count; ++i) {
+		std::string name;
+		uint64_t size;
+		if(!state.ReadString(name) || !state.Read(size)) {
+			return false;
+		}
+
+		std::vector<uint8_t> data (size);
+		if(!state.ReadBytes(data.data(), size)) {
+			return false;
+		}
+
+		if(!descriptor.HasEntry(name) || descriptor.IsHostOnly(name) || descriptor.GetBlockSizeInBytes(name) != size) {
+			LC_WARNING(LogSnapshot) << "Ignoring state block entry " << name << " of thread " << thread.GetThreadID();
+			continue;
+		}
+		memcpy((uint8_t*)state_block.GetData() + descriptor.GetBlockOffset(name), data.data(), size);
+	}
+
+	uint32_t feature_count;
+	if(!state.Read(feature_count)) {
+		return false;
+	}
+	const auto &features = thread.GetArch().GetFeaturesDescriptor().GetFeatures();
+	for(uint32_t i = 0; i < feature_count; ++i) {
+		std::string name;
+		uint32_t level;
+		if(!state.ReadString(name) || !state.Read(level)) {
+			return false;
+		}
+
+		for(const auto &feature : features) {
+			if(feature.GetName() == name) {
+				thread.GetFeatures().SetFeatureLevel(feature.GetID(), level);
+			}
+		}
+	}
+
+	uint32_t peripheral_count;
+	if(!state.Read(peripheral_count)) {
+		return false;
+	}
+	auto &peripherals = thread.GetPeripherals().Peripherals;
+	for(uint32_t i = 0; i < peripheral_count; ++i) {
+		std::string name;
+		DeviceState peripheral_state;
+		if(!state.ReadString(name) || !state.ReadState(peripheral_state)) {
+			return false;
+		}
+
+		auto peripheral = peripherals.find(name);
+		if(peripheral == peripherals.end()) {
+			LC_WARNING(LogSnapshot) << "Ignoring state of unknown peripheral " << name << " of thread " << thread.GetThreadID();
+			continue;
+		}
+		if(!peripheral->second->RestoreState(peripheral_state)) {
+			LC_ERROR(LogSnapshot) << "Could not restore peripheral " << name << " of thread " << thread.GetThreadID();
+			return false;
+		}
+	}
+
+	// Let anything which depends on the privilege level know about the new
+	// one.
+	thread.SetExecutionRing(thread.GetExecutionRing());
+
+	return true;
+}
+
+bool Snapshot::Save(SystemEmulationModel &model, const std::string &filename, const std::string &config_tag)
+{
+	RegionBasedMemoryModel *memory = dynamic_cast<RegionBasedMemoryModel*>(&model.GetMemoryModel());
+	if(memory == nullptr) {
+		LC_ERROR(LogSnapshot) << "The selected memory model does not support snapshots";
+		return false;
+	}
+
+	// Save the threads and devices first, so that nothing is written if any
+	// of them cannot be saved.
+	std::vector<DeviceState> thread_states (model.GetNumThreads());
+	for(int i = 0; i < model.GetNumThreads(); ++i) {
+		if(!SaveThread(model.GetThread(i), thread_states[i])) {
+			return false;
+		}
+	}
+
+	auto components = GetMemoryComponents(model);
+	std::vector<DeviceState> component_states (components.size());
+	for(size_t i = 0; i < components.size(); ++i) {
+		if(!components[i]->SaveState(component_states[i])) {
+			LC_ERROR(LogSnapshot) << "Could not save the state of device " << GetComponentKey(*components[i]);
+			return false;
+		}
+	}
+
+	std::string temp_filename = filename + ".tmp";
+	FILE *file = fopen(temp_filename.c_str(), "wb");
+	if(file == nullptr) {
+		LC_ERROR(LogSnapshot) << "Could not open " << temp_filename << " for writing";
+		return false;
+	}
+
+	const uint8_t padding[8] = {0};
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.tag_size = config_tag.size();
+
+	size_t offset = 0;
+	offset += fwrite(&header, 1, sizeof(header), file);
+	offset += fwrite(config_tag.data(), 1, config_tag.size(), file);
+	offset += fwrite(padding, 1, align8(offset) - offset, file);
+
+	DeviceState state;
+
+	// Memory pages go straight into the file, and the page tables go into
+	// the state, which is written at the end.
+	uint8_t buffer[kPageSize];
+	uint8_t compressed[kPageSize];
+	uint64_t total_pages = 0;
+
+	state.Write<uint64_t>(memory->GetVMAs().size());
+	for(const auto &i : memory->GetVMAs()) {
+		const GuestVMA &vma = *i.second;
+		bool direct = vma.host_base != nullptr && (vma.protection & archsim::abi::memory::RegFlagRead);
+
+		std::vector<StoredPage> pages;
+		for(uint64_t page_offset = 0; page_offset < vma.size; page_offset += kPageSize) {
+			uint64_t page_size = std::min<uint64_t>(kPageSize, vma.size - page_offset);
+
+			const uint8_t *data;
+			if(direct && page_size == kPageSize) {
+				data = (const uint8_t*)vma.host_base + page_offset;
+			} else {
+				memset(buffer, 0, sizeof(buffer));
+				memory->Peek(Address(vma.base.Get() + page_offset), buffer, page_size);
+				data = buffer;
+			}
+
+			if(IsZeroPage(data)) {
+				continue;
+			}
+
+			StoredPage page;
+			memset(&page, 0, sizeof(page));
+			page.index = page_offset / kPageSize;
+			page.offset = offset;
+			page.size = CompressPage(data, compressed);
+			pages.push_back(page);
+
+			offset += fwrite(compressed, 1, page.size, file);
+		}
+
+		state.Write<uint64_t>(vma.base.Get());
+		state.Write<uint64_t>(vma.size);
+		state.Write<uint64_t>(pages.size());
+		state.WriteBytes(pages.data(), pages.size() * sizeof(StoredPage));
+
+		total_pages += pages.size();
+	}
+
+	state.Write<uint32_t>(thread_states.size());
+	for(const auto &thread_state : thread_states) {
+		state.WriteState(thread_state);
+	}
+
+	state.Write<uint32_t>(components.size());
+	for(size_t i = 0; i < components.size(); ++i) {
+		state.WriteString(GetComponentKey(*components[i]));
+		state.WriteState(component_states[i]);
+	}
+
+	header.state_offset = offset;
+	header.state_size = state.GetSize();
+	offset += fwrite(state.GetData(), 1, state.GetSize(), file);
+
+	fseek(file, 0, SEEK_SET);
+	fwrite(&header, 1, sizeof(header), file);
+
+	bool success = !ferror(file);
+	fclose(file);
+
+	if(!success || rename(temp_filename.c_str(), filename.c_str())) {
+		LC_ERROR(LogSnapshot) << "Failed to write snapshot " << filename;
+		unlink(temp_filename.c_str());
+		return false;
+	}
+
+	LC_INFO(LogSnapshot) << "Saved snapshot of " << model.GetNumThreads() << " threads, " << components.size() << " devices and " << total_pages << " pages of memory to " << filename << " (" << offset << " bytes)";
+	return true;
+}
+
+bool Snapshot::Restore(SystemEmulationModel &model, const std::string &filename, const std::string &config_tag, bool lazy)
+{
+	RegionBasedMemoryModel *memory = dynamic_cast<RegionBasedMemoryModel*>(&model.GetMemoryModel());
+	if(memory == nullptr) {
+		LC_ERROR(LogSnapshot) << "The selected memory model does not support snapshots";
+		return false;
+	}
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		LC_ERROR(LogSnapshot) << "Could not open snapshot " << filename;
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) || st.st_size < (off_t)sizeof(FileHeader)) {
+		::close(fd);
+		LC_ERROR(LogSnapshot) << "Snapshot " << filename << " is invalid";
+		return false;
+	}
+
+	void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if(mapping == MAP_FAILED) {
+		LC_ERROR(LogSnapshot) << "Could not map snapshot " << filename;
+		return false;
+	}
+
+	mapping_ = (const uint8_t*)mapping;
+	mapping_size_ = st.st_size;
+
+	const FileHeader *header = (const FileHeader*)mapping_;
+	if(memcmp(header->magic, kMagic, sizeof(kMagic)) || header->version != kVersion || sizeof(FileHeader) + header->tag_size > mapping_size_) {
+		LC_ERROR(LogSnapshot) << "Snapshot " << filename << " is invalid";
+		return false;
+	}
+	if(std::string((const char*)mapping_ + sizeof(FileHeader), header->tag_size) != config_tag) {
+		LC_ERROR(LogSnapshot) << "Snapshot " << filename << " was produced by a different configuration";
+		return false;
+	}
+	if(header->state_offset > mapping_size_ || header->state_size > mapping_size_ - header->state_offset) {
+		LC_ERROR(LogSnapshot) << "Snapshot " << filename << " is truncated";
+		return false;
+	}
+
+	DeviceState state (mapping_ + header->state_offset, header->state_size);
+
+	uint64_t region_count;
+	if(!state.Read(region_count)) {
+		return false;
+	}
+
+	uint64_t total_pages = 0;
+	for(uint64_t region = 0; region < region_count; ++region) {
+		uint64_t base, size, page_count;
+		if(!state.Read(base) || !state.Read(size) || !state.Read(page_count)) {
+			return false;
+		}
+
+		std::vector<LazyMemoryRestorer::Page> pages;
+		for(uint64_t i = 0; i < page_count; ++i) {
+			StoredPage page;
+			if(!state.Read(page)) {
+				return false;
+			}
+			if(page.size > kPageSize || page.offset > mapping_size_ || page.size > mapping_size_ - page.offset || page.index * kPageSize >= size) {
+				LC_ERROR(LogSnapshot) << "Snapshot " << filename << " is corrupt";
+				return false;
+			}
+
+			pages.push_back({page.index, mapping_ + page.offset, page.size});
+		}
+		total_pages += pages.size();
+
+		auto vma_entry = memory->GetVMAs().find(Address(base));
+		if(vma_entry == memory->GetVMAs().end() || vma_entry->second->size != size) {
+			LC_ERROR(LogSnapshot) << "Guest memory region " << Address(base) << " in the snapshot does not match the guest memory layout";
+			return false;
+		}
+		const GuestVMA &vma = *vma_entry->second;
+
+		if(lazy && vma.host_base != nullptr && size % kPageSize == 0) {
+			std::unique_ptr<LazyMemoryRestorer> restorer (new LazyMemoryRestorer(vma.host_base, vma.size, HostProtection(vma.protection), pages));
+			if(!restorer->Install()) {
+				LC_ERROR(LogSnapshot) << "Could not set up lazy restore of guest memory region " << vma.base;
+				return false;
+			}
+
+			model.GetSystem().RegisterSegFaultHandler((uint64_t)vma.host_base, vma.size, restorer.get(), HandleRestoreFault);
+			restorers_.push_back(std::move(restorer));
+			continue;
+		}
+
+		// Restore the whole region now, page by page.
+		bool direct = vma.host_base != nullptr && (vma.protection & archsim::abi::memory::RegFlagWrite);
+		if(direct) {
+			madvise(vma.host_base, vma.size, MADV_DONTNEED);
+		}
+
+		uint8_t buffer[kPageSize], current[kPageSize];
+		auto page = pages.begin();
+		for(uint64_t page_offset = 0; page_offset < size; page_offset += kPageSize) {
+			uint64_t page_size = std::min<uint64_t>(kPageSize, size - page_offset);
+			bool stored = page != pages.end() && page->Index == page_offset / kPageSize;
+
+			if(stored) {
+				if(!DecompressPage(page->Data, page->Size, buffer)) {
+					LC_ERROR(LogSnapshot) << "Snapshot " << filename << " is corrupt";
+					return false;
+				}
+				++page;
+			} else if(direct) {
+				// Already zeroed
+				continue;
+			} else {
+				memory->Peek(Address(vma.base.Get() + page_offset), current, page_size);
+				if(IsZeroPage(current)) {
+					continue;
+				}
+				memset(buffer, 0, sizeof(buffer));
+			}
+
+			if(direct && page_size == kPageSize) {
+				memcpy((uint8_t*)vma.host_base + page_offset, buffer, kPageSize);
+			} else {
+				memory->Poke(Address(vma.base.Get() + page_offset), buffer, page_size);
+			}
+		}
+	}
+
+	uint32_t thread_count;
+	if(!state.Read(thread_count) || thread_count != (uint32_t)model.GetNumThreads()) {
+		LC_ERROR(LogSnapshot) << "Snapshot " << filename << " has a different number of threads to the guest";
+		return false;
+	}
+	for(int i = 0; i < model.GetNumThreads(); ++i) {
+		DeviceState thread_state;
+		if(!state.ReadState(thread_state) || !RestoreThread(model.GetThread(i), thread_state)) {
+			LC_ERROR(LogSnapshot) << "Could not restore thread " << i;
+			return false;
+		}
+	}
+
+	std::map<std::string, devices::MemoryComponent *> components;
+	for(auto component : GetMemoryComponents(model)) {
+		components[GetComponentKey(*component)] = component;
+	}
+
+	uint32_t component_count;
+	if(!state.Read(component_count)) {
+		return false;
+	}
+	for(uint32_t i = 0; i < component_count; ++i) {
+		std::string key;
+		DeviceState component_state;
+		if(!state.ReadString(key) || !state.ReadState(component_state)) {
+			return false;
+		}
+
+		auto component = components.find(key);
+		if(component == components.end()) {
+			LC_WARNING(LogSnapshot) << "Ignoring state of unknown device " << key;
+			continue;
+		}
+		if(!component->second->RestoreState(component_state)) {
+			LC_ERROR(LogSnapshot) << "Could not restore device " << key;
+			return false;
+		}
+	}
+
+	// Anything cached from the guest state before the restore is now stale.
+	model.GetSystem().GetPubSub().Publish(PubSubType::FlushTranslations, nullptr);
+	model.GetSystem().GetPubSub().Publish(PubSubType::FlushAllTranslations, nullptr);
+	model.GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, nullptr);
+	model.GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, nullptr);
+
+	LC_INFO(LogSnapshot) << "Restored snapshot of " << thread_count << " threads, " << component_count << " devices and " << total_pages << " pages of memory from " << filename << (restorers_.empty() ? "" : " (memory will be restored on demand)");
+	return true;
+}
@@ -35,7 +35,7 @@ using namespace archsim::core::thread;
 UseLogContext(LogEmulationModel);
 DeclareChildLogContext(LogSystemEmulationModel, LogEmulationModel, "System");
 
-SystemEmulationModel::SystemEmulationModel(bool is64bit) : is_64bit_(is64bit), monitor_(std::make_shared<archsim::core::BaseMemoryMonitor>())
+SystemEmulationModel::SystemEmulationModel(bool is64bit) : is_64bit_(is64bit), monitor_(std::make_shared<archsim::core::ReservationMemoryMonitor>())
 {
 }
 
@@ -23,7 +23,7 @@ using archsim::Address;
 
 UserEmulationModel::UserEmulationModel(const user::arch_descriptor_t &arch, bool is_64bit_binary, const AuxVectorEntries &auxvs) : syscall_handler_(user::SyscallHandlerProvider::Singleton().Get(arch)), is_64bit_(is_64bit_binary), auxvs_(auxvs)
 {
-	monitor_ = std::make_shared<archsim::core::BaseMemoryMonitor>();
+	monitor_ = std::make_shared<archsim::core::ReservationMemoryMonitor>();
 }
 
 UserEmulationModel::~UserEmulationModel() { }
@@ -8,6 +8,7 @@
 #include "abi/devices/generic/ps2/PS2Device.h"
 #include "abi/devices/gfx/VirtualScreen.h"
 #include "abi/devices/Component.h"
+#include "abi/devices/DeviceState.h"
 #include "util/LogContext.h"
 
 #include <set>
@@ -174,6 +175,16 @@ namespace archsim
 
 Component::~Component() {}
 
+bool Component::SaveState(DeviceState& state)
+{
+	return false;
+}
+
+bool Component::RestoreState(DeviceState& state)
+{
+	return false;
+}
+
 // TODO: do this more nicely
 #define CASTTOCOMPONENT(x) static_cast<Component*>(x)
 template<> void Component::SetParameter(const std::string &parameter, archsim::abi::devices::IRQLine *value)
@@ -256,6 +267,46 @@ bool RegisterBackedMemoryComponent::Write(uint32_t offset, uint8_t size, uint64_
 	return true;
 }
 
+bool RegisterBackedMemoryComponent::SaveState(DeviceState& state)
+{
+	// Registers are saved in offset order, so that the state doesn't depend
+	// on the layout of the register map.
+	std::map<uint32_t, MemoryRegister *> ordered (registers.begin(), registers.end());
+
+	state.Write<uint32_t>(ordered.size());
+	for(auto rg : ordered) {
+		state.Write<uint32_t>(rg.first);
+		state.Write<uint32_t>(rg.second->Get());
+	}
+
+	return true;
+}
+
+bool RegisterBackedMemoryComponent::RestoreState(DeviceState& state)
+{
+	uint32_t count;
+	if(!state.Read(count)) {
+		return false;
+	}
+
+	for(uint32_t i = 0; i < count; ++i) {
+		uint32_t offset, value;
+		if(!state.Read(offset) || !state.Read(value)) {
+			return false;
+		}
+
+		MemoryRegister *rg = GetRegister(offset);
+		if(!rg) {
+			LC_WARNING(LogMemoryComponent) << "Device: " << name << " @ " << std::hex << GetBaseAddress() << ", saved state contains unknown register: offset=" << std::hex << offset;
+			continue;
+		}
+
+		rg->Set(value);
+	}
+
+	return true;
+}
+
 void RegisterBackedMemoryComponent::AddRegister(MemoryRegister& rg)
 {
 	assert(rg.GetOffset() < GetSize());
@@ -3,6 +3,7 @@
 
 #include "abi/devices/Device.h"
 #include "abi/devices/Component.h"
+#include "abi/devices/DeviceState.h"
 
 #include "util/LogContext.h"
 
@@ -79,6 +80,16 @@ namespace archsim
 				return false;
 			}
 
+			bool Device::SaveState(DeviceState& state)
+			{
+				return false;
+			}
+
+			bool Device::RestoreState(DeviceState& state)
+			{
+				return false;
+			}
+
 			bool Device::SetManager(PeripheralManager* new_manager)
 			{
 				if (Manager) return false;
@@ -28,4 +28,14 @@ bool EmptyDevice::Read(uint32_t offset, uint8_t size, uint64_t& data)
 bool EmptyDevice::Write(uint32_t offset, uint8_t size, uint64_t data)
 {
 	return true;
-}
\ No newline at end of file
+}
+bool EmptyDevice::SaveState(DeviceState& state)
+{
+	// An empty device has no state
+	return true;
+}
+
+bool EmptyDevice::RestoreState(DeviceState& state)
+{
+	return true;
+}
@@ -82,6 +82,10 @@ namespace archsim
 
 			void CPUIRQLine::Assert()
 			{
+				if(CPU->DeferAction([this]() { Assert(); })) {
+					return;
+				}
+
 				if(IsAsserted() && !IsAcknowledged()) {
 					LC_WARNING(LogIRQ) << "An IRQ is pending, but has been reasserted (IRQ possibly stuck?)";
 				}
@@ -100,6 +104,10 @@ namespace archsim
 
 			void CPUIRQLine::Rescind()
 			{
+				if(CPU->DeferAction([this]() { Rescind(); })) {
+					return;
+				}
+
 				ClearAsserted();
 
 				switch(state_) {
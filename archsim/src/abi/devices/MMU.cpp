@@ -11,6 +11,7 @@
 #include "system.h"
 #include "abi/devices/MMU.h"
 #include "abi/EmulationModel.h"
+#include "core/thread/ThreadInstance.h"
 #include "util/LogContext.h"
 
 UseLogContext(LogDevice)
@@ -21,7 +22,7 @@ using archsim::Address;
 
 PageInfo::PageInfo() : phys_addr(0), mask(0), Present(0), UserCanRead(0), UserCanWrite(0), KernelCanRead(0), KernelCanWrite(0) {}
 
-MMU::MMU() : should_be_enabled(false) { }
+MMU::MMU() : should_be_enabled(false), tlb_fill_valid_(false), tlb_fill_offset_mask_(0), tlb_fill_global_(false), tlb_pending_flushes_(0) { }
 
 MMU::~MMU() {}
 
@@ -47,11 +48,124 @@ void MMU::set_enabled(bool enabled)
 
 		should_be_enabled = enabled;
 
-		Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+		Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 		Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 	}
 }
 
+MMU::TranslateResult MMU::TranslateCached(archsim::core::thread::ThreadInstance* cpu, Address virt_addr, Address& phys_addr, const struct AccessInfo info)
+{
+	TLBContext context;
+	if(cpu == nullptr || !GetTLBContext(cpu, info, context)) {
+		return Translate(cpu, virt_addr, phys_addr, info);
+	}
+
+	// Nothing can be in the TLB until the first cached translation, so we
+	// don't need to hear about flushes until then either.
+	if(!tlb_subscriber_ && !HasExplicitTLBMaintenance()) {
+		tlb_subscriber_.reset(new util::PubSubscriber(Manager->GetEmulationModel()->GetSystem().GetPubSub()));
+		tlb_subscriber_->Subscribe(PubSubType::ITlbFullFlush, TLBFlushCallback, this);
+		tlb_subscriber_->Subscribe(PubSubType::ITlbEntryFlush, TLBFlushCallback, this);
+		tlb_subscriber_->Subscribe(PubSubType::DTlbFullFlush, TLBFlushCallback, this);
+		tlb_subscriber_->Subscribe(PubSubType::DTlbEntryFlush, TLBFlushCallback, this);
+	}
+	if(tlb_pending_flushes_.load(std::memory_order_relaxed)) {
+		applyPendingTLBFlushes();
+	}
+
+	SoftwareTLB &tlb = info.Fetch ? itlb_ : dtlb_;
+	auto &metrics = cpu->GetMetrics();
+
+	if(tlb.Lookup(virt_addr, context, info, phys_addr)) {
+		if(info.Fetch) {
+			metrics.ITLBHits.inc();
+		} else {
+			metrics.DTLBHits.inc();
+		}
+		return TXLN_OK;
+	}
+
+	if(info.Fetch) {
+		metrics.ITLBMisses.inc();
+	} else {
+		metrics.DTLBMisses.inc();
+	}
+
+	tlb_fill_valid_ = false;
+	TranslateResult result = Translate(cpu, virt_addr, phys_addr, info);
+	if(result == TXLN_OK && tlb_fill_valid_) {
+		tlb.Insert(virt_addr, phys_addr, tlb_fill_offset_mask_, context, tlb_fill_global_, info);
+	}
+
+	return result;
+}
+
+bool MMU::GetTLBContext(archsim::core::thread::ThreadInstance* cpu, const struct AccessInfo& info, TLBContext& context)
+{
+	return false;
+}
+
+bool MMU::HasExplicitTLBMaintenance() const
+{
+	return false;
+}
+
+void MMU::InvalidateTLB()
+{
+	itlb_.Flush();
+	dtlb_.Flush();
+}
+
+void MMU::InvalidateTLBPage(Address virt_addr)
+{
+	itlb_.FlushPage(virt_addr);
+	dtlb_.FlushPage(virt_addr);
+}
+
+void MMU::InvalidateTLBPage(Address virt_addr, uint64_t asid)
+{
+	itlb_.FlushPage(virt_addr, asid);
+	dtlb_.FlushPage(virt_addr, asid);
+}
+
+void MMU::InvalidateTLBASID(uint64_t asid)
+{
+	itlb_.FlushASID(asid);
+	dtlb_.FlushASID(asid);
+}
+
+void MMU::TLBFlushCallback(PubSubType::PubSubType type, void* context, const void* data)
+{
+	MMU *mmu = (MMU*)context;
+
+	// Entry flushes are treated as full flushes, since the address can't be
+	// passed safely to the owning thread.
+	switch(type) {
+		case PubSubType::ITlbFullFlush:
+		case PubSubType::ITlbEntryFlush:
+			mmu->tlb_pending_flushes_.fetch_or(1, std::memory_order_relaxed);
+			break;
+		case PubSubType::DTlbFullFlush:
+		case PubSubType::DTlbEntryFlush:
+			mmu->tlb_pending_flushes_.fetch_or(2, std::memory_order_relaxed);
+			break;
+		default:
+			break;
+	}
+}
+
+void MMU::applyPendingTLBFlushes()
+{
+	uint32_t pending = tlb_pending_flushes_.exchange(0, std::memory_order_acquire);
+
+	if(pending & 1) {
+		itlb_.Flush();
+	}
+	if(pending & 2) {
+		dtlb_.Flush();
+	}
+}
+
 Address MMU::TranslateUnsafe(archsim::core::thread::ThreadInstance* cpu, Address virt_addr)
 {
 	Address phys_addr;
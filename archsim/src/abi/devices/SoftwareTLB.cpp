@@ -0,0 +1,139 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "abi/devices/SoftwareTLB.h"
+#include "abi/devices/MMU.h"
+
+using namespace archsim::abi::devices;
+using archsim::Address;
+
+SoftwareTLB::SoftwareTLB()
+{
+	Flush();
+}
+
+uint16_t SoftwareTLB::GetAccessBit(const AccessInfo& info)
+{
+	uint32_t kind = info.Fetch ? 2 : info.Write ? 1 : 0;
+	return 1 << (((info.Ring & 3) * 3) + kind);
+}
+
+bool SoftwareTLB::Lookup(Address virt_addr, const TLBContext& context, const AccessInfo& info, Address& phys_addr)
+{
+	uint16_t access = GetAccessBit(info);
+	Entry *set = GetSet(virt_addr.Get());
+
+	for(unsigned way = 0; way < kWays; ++way) {
+		Entry &entry = set[way];
+
+		if((entry.Permitted & access) && (virt_addr.Get() & ~entry.OffsetMask) == entry.VirtBase && entry.State == context.State && (entry.Global || entry.ASID == context.ASID)) {
+			phys_addr = Address(entry.PhysBase | (virt_addr.Get() & entry.OffsetMask));
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void SoftwareTLB::Insert(Address virt_addr, Address phys_addr, Address::underlying_t offset_mask, const TLBContext& context, bool global, const AccessInfo& info)
+{
+	Address::underlying_t virt_base = virt_addr.Get() & ~offset_mask;
+	Address::underlying_t phys_base = phys_addr.Get() & ~offset_mask;
+
+	uint64_t set_index = (virt_addr.Get() / Address::PageSize) % kSets;
+	Entry *set = entries_[set_index];
+	Entry *victim = nullptr;
+
+	for(unsigned way = 0; way < kWays; ++way) {
+		Entry &entry = set[way];
+
+		if(!entry.Permitted) {
+			if(victim == nullptr) {
+				victim = &entry;
+			}
+			continue;
+		}
+
+		// If we already have this translation then just record that another
+		// kind of access is allowed through it.
+		if(entry.VirtBase == virt_base && entry.PhysBase == phys_base && entry.OffsetMask == offset_mask && entry.State == context.State && entry.Global == global && (global || entry.ASID == context.ASID)) {
+			entry.Permitted |= GetAccessBit(info);
+			return;
+		}
+	}
+
+	if(victim == nullptr) {
+		victim = &set[next_victim_[set_index]];
+		next_victim_[set_index] = (next_victim_[set_index] + 1) % kWays;
+	}
+
+	victim->VirtBase = virt_base;
+	victim->PhysBase = phys_base;
+	victim->OffsetMask = offset_mask;
+	victim->ASID = context.ASID;
+	victim->State = context.State;
+	victim->Global = global;
+	victim->Permitted = GetAccessBit(info);
+
+	if(offset_mask >= Address::PageSize) {
+		has_superpages_ = true;
+	}
+}
+
+template<typename Predicate> void SoftwareTLB::flushIf(Address::underlying_t virt_addr, Predicate pred)
+{
+	if(has_superpages_) {
+		for(auto &set : entries_) {
+			for(auto &entry : set) {
+				if(entry.Covers(virt_addr) && pred(entry)) {
+					entry.Permitted = 0;
+				}
+			}
+		}
+	} else {
+		Entry *set = GetSet(virt_addr);
+		for(unsigned way = 0; way < kWays; ++way) {
+			if(set[way].Covers(virt_addr) && pred(set[way])) {
+				set[way].Permitted = 0;
+			}
+		}
+	}
+}
+
+void SoftwareTLB::Flush()
+{
+	for(auto &set : entries_) {
+		for(auto &entry : set) {
+			entry.Permitted = 0;
+		}
+	}
+	for(auto &victim : next_victim_) {
+		victim = 0;
+	}
+
+	has_superpages_ = false;
+}
+
+void SoftwareTLB::FlushPage(Address virt_addr)
+{
+	flushIf(virt_addr.Get(), [](const Entry &entry) {
+		return true;
+	});
+}
+
+void SoftwareTLB::FlushPage(Address virt_addr, uint64_t asid)
+{
+	flushIf(virt_addr.Get(), [asid](const Entry &entry) {
+		return !entry.Global && entry.ASID == asid;
+	});
+}
+
+void SoftwareTLB::FlushASID(uint64_t asid)
+{
+	for(auto &set : entries_) {
+		for(auto &entry : set) {
+			if(!entry.Global && entry.ASID == asid) {
+				entry.Permitted = 0;
+			}
+		}
+	}
+}
@@ -274,6 +274,22 @@ public:
 		// TODO
 	}
 
+protected:
+	bool GetTLBContext(archsim::core::thread::ThreadInstance *cpu, const struct AccessInfo &info, TLBContext &context) override
+	{
+		if(!is_enabled()) {
+			return false;
+		}
+
+		// Translations depend on the translation table base, the domain
+		// access control register and the R/S protection bits.
+		context.ASID = 0;
+		context.State = ((uint64_t)(cocoprocessor->get_ttbr() & ~0x3fff) << 32) | ((uint64_t)cocoprocessor->get_cp1_R() << 33) | ((uint64_t)cocoprocessor->get_cp1_S() << 32) | get_dacr();
+		return true;
+	}
+
+public:
+
 	void handle_result(TranslateResult result, archsim::core::thread::ThreadInstance *cpu, Address mva, const struct AccessInfo info)
 	{
 		uint32_t new_fsr = 0;
@@ -646,7 +662,7 @@ private:
 		}
 
 		out_phys_addr = Address(section_base_addr | section_index);
-//		update_tlb_entry(mva, out_phys_addr, kernel_mode, !is_write);
+		SetTLBFill(0xfffff, false);
 		return TXLN_OK;
 	}
 
@@ -695,10 +711,12 @@ private:
 			case tx_l2_descriptor::TXE_Large:
 				LC_DEBUG2(LogArmMMUTxln) << "L2 lookup resulted in large page descriptor";
 				out_phys_addr = Address((l2_desc.base_addr & 0xffff0000) | (mva.Get() & 0x0000ffff));
+				SetTLBFill(0xffff, false);
 				break;
 			case tx_l2_descriptor::TXE_Small:
 				LC_DEBUG2(LogArmMMUTxln) << "L2 lookup resulted in small page descriptor";
 				out_phys_addr = Address((l2_desc.base_addr & 0xfffff000) | (mva.Get() & 0x00000fff));
+				SetTLBFill(0xfff, false);
 				break;
 			default:
 				assert(false);
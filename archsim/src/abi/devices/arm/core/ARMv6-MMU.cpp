@@ -550,6 +550,20 @@ namespace archsim
 					}
 				}
 
+			protected:
+				bool GetTLBContext(archsim::core::thread::ThreadInstance *cpu, const struct AccessInfo &info, TLBContext &context) override
+				{
+					if(!is_enabled()) {
+						return false;
+					}
+
+					// Translations depend on the translation table base and the
+					// domain access control register.
+					context.ASID = 0;
+					context.State = ((uint64_t)(cocoprocessor->get_ttbr() & ~0x3fff) << 32) | get_dacr();
+					return true;
+				}
+
 			private:
 
 				ArmControlCoprocessorv6 *cocoprocessor;
@@ -609,7 +623,7 @@ namespace archsim
 					}
 
 					out_phys_addr = Address(section_base_addr | section_index);
-					//		update_tlb_entry(mva, out_phys_addr, kernel_mode, !is_write);
+					SetTLBFill(0xfffff, false);
 					return TXLN_OK;
 				}
 
@@ -657,6 +671,7 @@ namespace archsim
 								}
 							}
 							out_phys_addr = Address((l2_desc.base_addr & 0xfffff000) | (mva & 0x00000fff));
+							SetTLBFill(0xfff, false);
 							break;
 						case tx_l2_descriptor::TXE_Large:
 							LC_DEBUG2(LogArmMMUTxlnv6) << "L2 lookup resulted in large page descriptor";
@@ -666,6 +681,7 @@ namespace archsim
 								}
 							}
 							out_phys_addr = Address((l2_desc.base_addr & 0xffff0000) | (mva & 0x0000ffff));
+							SetTLBFill(0xffff, false);
 							break;
 						default:
 							assert(false);
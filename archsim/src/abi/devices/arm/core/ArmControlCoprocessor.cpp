@@ -260,7 +260,7 @@ bool ArmControlCoprocessor::access_cp2(bool is_read, uint32_t &data)
 			case 0:
 				ttbr = data;
 
-				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
 				LC_DEBUG1(LogArmCoprocessorTlb)
@@ -566,7 +566,7 @@ bool ArmControlCoprocessor::access_cp8(bool is_read, uint32_t &data)
 			//TODO: change this to actually produce correct behaviour
 			//		assert(Manager->cpu.in_kernel_mode());
 
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
 			switch (opc2) {
@@ -589,7 +589,7 @@ bool ArmControlCoprocessor::access_cp8(bool is_read, uint32_t &data)
 			}
 			break;
 		case 5:
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 			switch (opc2) {
 				case 0:
 					LC_DEBUG1(LogArmCoprocessorTlb)
@@ -318,7 +318,7 @@ bool ArmControlCoprocessorv6::access_cp2(bool is_read, uint32_t &data)
 				ttbr_switch++;
 				ttbr0 = data;
 
-				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
 				LC_DEBUG1(LogArmCoprocessorTlb)
@@ -327,7 +327,7 @@ bool ArmControlCoprocessorv6::access_cp2(bool is_read, uint32_t &data)
 				break;
 			case 1:
 				ttbr1 = data;
-				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
 				LC_DEBUG1(LogArmCoprocessorTlb)
@@ -336,7 +336,7 @@ bool ArmControlCoprocessorv6::access_cp2(bool is_read, uint32_t &data)
 				break;
 			case 2:
 				ttbcr = data;
-				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
 //			fprintf(stderr, "Wrote to TTBCR! %x\n", ttbcr);
@@ -382,7 +382,7 @@ bool ArmControlCoprocessorv6::access_cp3(bool is_read, uint32_t &data)
 		LC_DEBUG1(LogArmCoprocessorDomain) << "Write of domain access control register";
 
 		if(dacr != data) {
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 		}
 
@@ -570,7 +570,7 @@ bool ArmControlCoprocessorv6::access_cp8(bool is_read, uint32_t &data)
 			//TODO: change this to actually produce correct behaviour
 			//		assert(Manager->cpu.in_kernel_mode());
 
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
 			switch (opc2) {
@@ -593,7 +593,7 @@ bool ArmControlCoprocessorv6::access_cp8(bool is_read, uint32_t &data)
 			}
 			break;
 		case 5:
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 			switch (opc2) {
 				case 0:
 					LC_DEBUG1(LogArmCoprocessorTlb)
@@ -755,7 +755,7 @@ bool ArmControlCoprocessorv6::access_cp13(bool is_read, uint32_t &data)
 			case 1:
 				contextidr = data;
 
-				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, 0);
+				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, &Manager->cpu);
 				Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, 0);
 
 //				if(Manager->cpu.HasTraceManager())
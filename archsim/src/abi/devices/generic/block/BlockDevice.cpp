@@ -17,3 +17,33 @@ BlockDevice::~BlockDevice()
 {
 
 }
+
+bool BlockDevice::ReadBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	std::lock_guard<std::mutex> lock(vector_lock_);
+
+	for(int i = 0; i < iovcnt; ++i) {
+		uint32_t count = iov[i].iov_len / GetBlockSize();
+		if(!ReadBlocks(block_idx, count, (uint8_t *)iov[i].iov_base)) {
+			return false;
+		}
+		block_idx += count;
+	}
+
+	return true;
+}
+
+bool BlockDevice::WriteBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	std::lock_guard<std::mutex> lock(vector_lock_);
+
+	for(int i = 0; i < iovcnt; ++i) {
+		uint32_t count = iov[i].iov_len / GetBlockSize();
+		if(!WriteBlocks(block_idx, count, (const uint8_t *)iov[i].iov_base)) {
+			return false;
+		}
+		block_idx += count;
+	}
+
+	return true;
+}
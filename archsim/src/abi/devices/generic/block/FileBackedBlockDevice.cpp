@@ -5,6 +5,9 @@
 
 UseLogContext(LogBlockDevice);
 
+#include <vector>
+
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 #include <fcntl.h>
@@ -146,6 +149,7 @@ bool FileBackedBlockDevice::ReadBlocks(uint64_t block_idx, uint32_t count, uint8
 		void *data_ptr = GetDataPtr(block_idx);
 		memcpy(buffer, data_ptr, GetBlockSize() * count);
 	} else {
+		std::lock_guard<std::mutex> lock(cache_lock);
 		for(uint32_t i = 0; i < count; ++i) {
 			if(cache->HasBlock(block_idx + i)) {
 				cache->ReadBlock(block_idx + i, buffer);
@@ -209,6 +213,7 @@ bool FileBackedBlockDevice::WriteBlocks(uint64_t block_idx, uint32_t count, cons
 		void *data_ptr = GetDataPtr(block_idx);
 		memcpy(data_ptr, buffer, GetBlockSize() * count);
 	} else {
+		std::lock_guard<std::mutex> lock(cache_lock);
 		for(uint32_t i = 0; i < count; ++i) {
 			cache->WriteBlock(block_idx+i, buffer);
 			WriteBlock(block_idx+i, buffer);
@@ -218,3 +223,143 @@ bool FileBackedBlockDevice::WriteBlocks(uint64_t block_idx, uint32_t count, cons
 
 	return true;
 }
+
+bool FileBackedBlockDevice::CheckVectorRange(uint64_t block_idx, const struct iovec* iov, int iovcnt, uint64_t& count) const
+{
+	count = 0;
+	for(int i = 0; i < iovcnt; ++i) {
+		if(iov[i].iov_len % GetBlockSize()) {
+			LC_WARNING(LogBlockDevice) << "Attempted a transfer which is not a whole number of blocks";
+			return false;
+		}
+		count += iov[i].iov_len / GetBlockSize();
+	}
+
+	if(block_idx >= block_count || count > block_count - block_idx) {
+		LC_WARNING(LogBlockDevice) << "Attempted to transfer blocks past end of device";
+		return false;
+	}
+
+	return true;
+}
+
+bool FileBackedBlockDevice::ReadBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	uint64_t count;
+	if(!CheckVectorRange(block_idx, iov, iovcnt, count)) {
+		return false;
+	}
+
+	reads.inc(count);
+	LC_DEBUG1(LogBlockDevice) << "Reading " << count << " blocks " << block_idx << " in " << iovcnt << " segments";
+
+	if (use_mmap) {
+		uint8_t *data_ptr = (uint8_t *)GetDataPtr(block_idx);
+		for(int i = 0; i < iovcnt; ++i) {
+			memcpy(iov[i].iov_base, data_ptr, iov[i].iov_len);
+			data_ptr += iov[i].iov_len;
+		}
+		return true;
+	}
+
+	// The block cache is kept up to date by writes, so the file always holds
+	// the current contents of the device and reads can bypass the cache.
+	std::vector<struct iovec> remaining (iov, iov + iovcnt);
+	struct iovec *next = remaining.data();
+	int next_count = iovcnt;
+	off64_t offset = CalculateByteOffset(block_idx);
+
+	while(next_count > 0) {
+		ssize_t actually_read = preadv64(file_descr, next, next_count, offset);
+		if(actually_read < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			LC_ERROR(LogBlockDevice) << "Failed to read from file: " << strerror(errno);
+			return false;
+		}
+
+		if(actually_read == 0) {
+			// The last block of the device may extend past the end of the file
+			for(int i = 0; i < next_count; ++i) {
+				bzero(next[i].iov_base, next[i].iov_len);
+			}
+			break;
+		}
+
+		offset += actually_read;
+		while(next_count > 0 && (size_t)actually_read >= next->iov_len) {
+			actually_read -= next->iov_len;
+			next++;
+			next_count--;
+		}
+		if(next_count > 0) {
+			next->iov_base = (uint8_t *)next->iov_base + actually_read;
+			next->iov_len -= actually_read;
+		}
+	}
+
+	return true;
+}
+
+bool FileBackedBlockDevice::WriteBlocksV(uint64_t block_idx, const struct iovec* iov, int iovcnt)
+{
+	assert(!read_only);
+
+	uint64_t count;
+	if(!CheckVectorRange(block_idx, iov, iovcnt, count)) {
+		return false;
+	}
+
+	writes.inc(count);
+	LC_DEBUG1(LogBlockDevice) << "Writing " << count << " blocks " << block_idx << " in " << iovcnt << " segments";
+
+	if (use_mmap) {
+		uint8_t *data_ptr = (uint8_t *)GetDataPtr(block_idx);
+		for(int i = 0; i < iovcnt; ++i) {
+			memcpy(data_ptr, iov[i].iov_base, iov[i].iov_len);
+			data_ptr += iov[i].iov_len;
+		}
+		return true;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(cache_lock);
+
+		uint64_t cache_idx = block_idx;
+		for(int i = 0; i < iovcnt; ++i) {
+			for(size_t offset = 0; offset < iov[i].iov_len; offset += GetBlockSize()) {
+				cache->WriteBlock(cache_idx++, (const uint8_t *)iov[i].iov_base + offset);
+			}
+		}
+	}
+
+	std::vector<struct iovec> remaining (iov, iov + iovcnt);
+	struct iovec *next = remaining.data();
+	int next_count = iovcnt;
+	off64_t offset = CalculateByteOffset(block_idx);
+
+	while(next_count > 0) {
+		ssize_t actually_written = pwritev64(file_descr, next, next_count, offset);
+		if(actually_written < 0) {
+			if(errno == EINTR) {
+				continue;
+			}
+			LC_ERROR(LogBlockDevice) << "Failed to write to file: " << strerror(errno);
+			return false;
+		}
+
+		offset += actually_written;
+		while(next_count > 0 && (size_t)actually_written >= next->iov_len) {
+			actually_written -= next->iov_len;
+			next++;
+			next_count--;
+		}
+		if(next_count > 0) {
+			next->iov_base = (uint8_t *)next->iov_base + actually_written;
+			next->iov_len -= actually_written;
+		}
+	}
+
+	return true;
+}
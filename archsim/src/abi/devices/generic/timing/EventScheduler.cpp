@@ -0,0 +1,172 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "abi/devices/generic/timing/EventScheduler.h"
+
+using namespace archsim::abi::devices::timing;
+
+const size_t ScheduledEvent::kNotScheduled;
+const uint64_t EventScheduler::kNoDeadline;
+
+ScheduledEvent::ScheduledEvent() : deadline_(EventScheduler::kNoDeadline), sequence_(0), heap_index_(kNotScheduled)
+{
+
+}
+
+ScheduledEvent::~ScheduledEvent()
+{
+
+}
+
+EventScheduler::EventScheduler() : next_sequence_(0)
+{
+
+}
+
+EventScheduler::~EventScheduler()
+{
+	for(auto event : heap_) {
+		event->heap_index_ = ScheduledEvent::kNotScheduled;
+	}
+}
+
+bool EventScheduler::Schedule(ScheduledEvent& event, uint64_t deadline)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	// Moving an event always puts it behind others with the same deadline
+	event.sequence_ = next_sequence_++;
+
+	if(event.IsScheduled()) {
+		uint64_t old_deadline = event.deadline_;
+		event.deadline_ = deadline;
+
+		if(deadline < old_deadline) {
+			siftUp(event.heap_index_);
+		} else {
+			siftDown(event.heap_index_);
+		}
+	} else {
+		event.deadline_ = deadline;
+		heap_.push_back(&event);
+		event.heap_index_ = heap_.size() - 1;
+		siftUp(event.heap_index_);
+	}
+
+	return event.heap_index_ == 0;
+}
+
+void EventScheduler::Cancel(ScheduledEvent& event)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	if(event.IsScheduled()) {
+		remove(event.heap_index_);
+	}
+}
+
+uint32_t EventScheduler::Advance(uint64_t now)
+{
+	uint32_t fired = 0;
+
+	std::unique_lock<std::mutex> lock(lock_);
+	while(!heap_.empty() && heap_.front()->deadline_ <= now) {
+		ScheduledEvent *event = heap_.front();
+		remove(0);
+
+		// Events are fired without the lock held, so that they can
+		// schedule themselves (or other events) again.
+		lock.unlock();
+		event->Fire(now);
+		fired++;
+		lock.lock();
+	}
+
+	return fired;
+}
+
+uint64_t EventScheduler::GetNextDeadline() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	if(heap_.empty()) {
+		return kNoDeadline;
+	}
+	return heap_.front()->deadline_;
+}
+
+size_t EventScheduler::GetPendingCount() const
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return heap_.size();
+}
+
+void EventScheduler::remove(size_t index)
+{
+	ScheduledEvent *event = heap_[index];
+	event->heap_index_ = ScheduledEvent::kNotScheduled;
+
+	ScheduledEvent *last = heap_.back();
+	heap_.pop_back();
+
+	if(index < heap_.size()) {
+		place(last, index);
+		siftUp(index);
+		siftDown(last->heap_index_);
+	}
+}
+
+void EventScheduler::siftUp(size_t index)
+{
+	ScheduledEvent *event = heap_[index];
+
+	while(index > 0) {
+		size_t parent = (index - 1) / 2;
+		if(!before(event, heap_[parent])) {
+			break;
+		}
+
+		place(heap_[parent], index);
+		index = parent;
+	}
+
+	place(event, index);
+}
+
+void EventScheduler::siftDown(size_t index)
+{
+	ScheduledEvent *event = heap_[index];
+	size_t size = heap_.size();
+
+	while(true) {
+		size_t child = index * 2 + 1;
+		if(child >= size) {
+			break;
+		}
+
+		if(child + 1 < size && before(heap_[child + 1], heap_[child])) {
+			child++;
+		}
+		if(!before(heap_[child], event)) {
+			break;
+		}
+
+		place(heap_[child], index);
+		index = child;
+	}
+
+	place(event, index);
+}
+
+void EventScheduler::place(ScheduledEvent* event, size_t index)
+{
+	heap_[index] = event;
+	event->heap_index_ = index;
+}
+
+bool EventScheduler::before(const ScheduledEvent* a, const ScheduledEvent* b)
+{
+	if(a->deadline_ != b->deadline_) {
+		return a->deadline_ < b->deadline_;
+	}
+	return a->sequence_ < b->sequence_;
+}
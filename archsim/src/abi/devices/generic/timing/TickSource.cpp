@@ -12,7 +12,9 @@
 #include "util/SimOptions.h"
 
 #include <unistd.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
 
 using namespace archsim::abi::devices::timing;
 
@@ -36,8 +38,14 @@ void TickSource::RemoveConsumer(TickConsumer &consumer)
 
 void TickSource::Start()
 {
-	std::lock_guard<std::mutex>  lock(consumers_lock_);
-	running_ = true;
+	{
+		std::lock_guard<std::mutex>  lock(consumers_lock_);
+		running_ = true;
+	}
+
+	// Events which were scheduled before the source started may already
+	// be due
+	NextDeadlineChanged();
 }
 
 void TickSource::Stop()
@@ -47,20 +55,192 @@ void TickSource::Stop()
 }
 
 
+bool TickSource::HasConsumers()
+{
+	std::lock_guard<std::mutex>  lock(consumers_lock_);
+	return !consumers.empty();
+}
+
+void TickSource::ScheduleEvent(ScheduledEvent& event, uint64_t deadline)
+{
+	if(scheduler_.Schedule(event, deadline)) {
+		NextDeadlineChanged();
+	}
+}
+
+void TickSource::CancelEvent(ScheduledEvent& event)
+{
+	scheduler_.Cancel(event);
+}
+
+uint64_t TickSource::GetTicksUntilNextEvent()
+{
+	uint64_t deadline = scheduler_.GetNextDeadline();
+	if(deadline == EventScheduler::kNoDeadline) {
+		return EventScheduler::kNoDeadline;
+	}
+
+	uint64_t now = GetCounter();
+	return deadline > now ? deadline - now : 0;
+}
+
 void TickSource::Tick(uint32_t tick_periods)
 {
 	microticks_ += tick_periods * microtick_scale_;
 
 	if(microticks_ >= 1.0f) {
-		tick_count_ += microticks_;
+		uint32_t ticks = microticks_;
+		microticks_ -= ticks;
+
+		AdvanceTo(tick_count_ + ticks);
+	}
+}
+
+void TickSource::AdvanceTo(uint64_t tick_count)
+{
+	uint32_t ticks = tick_count - tick_count_;
+	tick_count_ = tick_count;
+
+	bool running;
+	{
 		std::lock_guard<std::mutex>  lock(consumers_lock_);
+		running = running_;
 		if(running_) {
 			for(auto *consumer : consumers) {
-				consumer->Tick(microticks_);
+				consumer->Tick(ticks);
 			}
 		}
 	}
-	microticks_ -= (int)microticks_;
+
+	if(running) {
+		scheduler_.Advance(tick_count);
+	}
+}
+
+HostTimeTickSource::HostTimeTickSource(uint32_t useconds) : LoopThread("Host Time Source"), period_(useconds), start_(clock_t::now()), deadline_changed_(false), stopping_(false)
+{
+	start();
+}
+
+HostTimeTickSource::~HostTimeTickSource()
+{
+	{
+		std::lock_guard<std::mutex> lock(wait_lock_);
+		stopping_ = true;
+	}
+	wait_cond_.notify_all();
+
+	stop();
+}
+
+uint64_t HostTimeTickSource::GetCounter()
+{
+	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now() - start_);
+	return (elapsed.count() / period_.count()) * GetTicksPerPeriod();
+}
+
+HostTimeTickSource::clock_t::time_point HostTimeTickSource::GetTickTime(uint64_t tick)
+{
+	// The first period at whose end the counter reaches the tick
+	uint64_t periods = std::ceil(tick / GetTicksPerPeriod());
+	return start_ + period_ * periods;
+}
+
+uint64_t HostTimeTickSource::GetMicrosecondsUntilNextEvent()
+{
+	uint64_t ticks = GetTicksUntilNextEvent();
+	if(ticks == EventScheduler::kNoDeadline) {
+		return EventScheduler::kNoDeadline;
+	}
+
+	auto now = clock_t::now();
+	auto due = GetTickTime(GetCounter() + ticks);
+	if(due <= now) {
+		return 0;
+	}
+
+	// Round up, so that a thread sleeping until the deadline wakes after it
+	// rather than just before
+	auto remaining = due - now;
+	auto us = std::chrono::duration_cast<std::chrono::microseconds>(remaining);
+	if(us < remaining) {
+		us += std::chrono::microseconds(1);
+	}
+	return us.count();
+}
+
+void HostTimeTickSource::tick()
+{
+	uint64_t now = GetCounter();
+	if(now > TickSource::GetCounter()) {
+		AdvanceTo(now);
+	}
+
+	// Consumers have to see every tick, but otherwise there is nothing to
+	// do until the next event.
+	clock_t::time_point wake;
+	if(HasConsumers()) {
+		wake = GetTickTime(now + 1);
+	} else {
+		uint64_t ticks = GetTicksUntilNextEvent();
+		if(ticks == EventScheduler::kNoDeadline) {
+			wake = clock_t::time_point::max();
+		} else {
+			wake = GetTickTime(now + std::max<uint64_t>(ticks, 1));
+		}
+	}
+
+	std::unique_lock<std::mutex> lock(wait_lock_);
+	auto woken = [this] { return deadline_changed_ || stopping_; };
+	if(wake == clock_t::time_point::max()) {
+		wait_cond_.wait(lock, woken);
+	} else {
+		wait_cond_.wait_until(lock, wake, woken);
+	}
+	deadline_changed_ = false;
+}
+
+void HostTimeTickSource::NextDeadlineChanged()
+{
+	{
+		std::lock_guard<std::mutex> lock(wait_lock_);
+		deadline_changed_ = true;
+	}
+	wait_cond_.notify_one();
+}
+
+const uint64_t InstructionTickSource::kMaxBatch;
+
+InstructionTickSource::InstructionTickSource() : deadline_generation_(0)
+{
+
+}
+
+InstructionTickSource::~InstructionTickSource()
+{
+
+}
+
+void InstructionTickSource::RetireInstructions(uint64_t count)
+{
+	std::lock_guard<std::mutex> lock(retire_lock_);
+	Tick(count);
+}
+
+void InstructionTickSource::NextDeadlineChanged()
+{
+	deadline_generation_.fetch_add(1, std::memory_order_release);
+}
+
+uint64_t InstructionTickSource::GetInstructionsUntilNextEvent()
+{
+	uint64_t ticks = GetTicksUntilNextEvent();
+	if(ticks == EventScheduler::kNoDeadline) {
+		return kMaxBatch;
+	}
+
+	uint64_t instructions = std::ceil(ticks / GetTicksPerPeriod());
+	return std::min(std::max<uint64_t>(instructions, 1), kMaxBatch);
 }
 
 MicrosecondTickSource::MicrosecondTickSource(uint32_t tick) : LoopThread("Microsecond Source"), ticks(tick), recalibrate(0), total_overshoot(0), overshoot_samples(0), calibrated_ticks(0)
@@ -73,6 +253,18 @@ MicrosecondTickSource::~MicrosecondTickSource()
 	stop();
 }
 
+uint64_t MicrosecondTickSource::GetMicrosecondsUntilNextEvent()
+{
+	uint64_t ticks = GetTicksUntilNextEvent();
+	if(ticks == EventScheduler::kNoDeadline) {
+		return EventScheduler::kNoDeadline;
+	}
+
+	// One period of this source lasts 'ticks' microseconds
+	uint64_t periods = std::ceil(ticks / GetTicksPerPeriod());
+	return periods * this->ticks;
+}
+
 void MicrosecondTickSource::tick()
 {
 	Tick(1);
@@ -3,6 +3,7 @@
 #include "core/thread/ThreadInstance.h"
 #include "arch/risc-v/RiscVSystemCoprocessor.h"
 #include "abi/devices/riscv/SifiveCLINT.h"
+#include "abi/devices/DeviceState.h"
 
 using namespace archsim::abi::devices::riscv;
 
@@ -10,14 +11,17 @@ DeclareLogContext(LogRiscVCLINT, "RISCV-CLINT");
 
 using namespace archsim::abi::devices;
 static ComponentDescriptor SifiveCLINTDescriptor ("SifiveCLINT", {{"Hart0", ComponentParameter_Thread}, {"Harts", ComponentParameterDescriptor::Container(ComponentParameter_Thread)}});
-SifiveCLINT::SifiveCLINT(EmulationModel& parent, Address base_address) : MemoryComponent(parent, base_address, 0x10000), Component(SifiveCLINTDescriptor)
+SifiveCLINT::SifiveCLINT(EmulationModel& parent, Address base_address) : MemoryComponent(parent, base_address, 0x10000), Component(SifiveCLINTDescriptor), timer_offset_(0)
 {
 	tick_source_ = parent.GetSystem().GetTickSource();
 }
 
 SifiveCLINT::~SifiveCLINT()
 {
-
+	for(auto i : timers_) {
+		tick_source_->CancelEvent(*i);
+		delete i;
+	}
 }
 
 bool SifiveCLINT::Initialise()
@@ -28,10 +32,6 @@ bool SifiveCLINT::Initialise()
 		timers_.push_back(new CLINTTimer(hart, this));
 	}
 
-	for(auto i : timers_) {
-		tick_source_->AddConsumer(*i);
-	}
-
 	return true;
 }
 
@@ -131,7 +131,48 @@ void SifiveCLINT::SetMSIP(archsim::core::thread::ThreadInstance* thread, bool P)
 
 uint64_t SifiveCLINT::GetTimer()
 {
-	return tick_source_->GetCounter() * 1000;
+	return tick_source_->GetCounter() * 1000 + timer_offset_;
+}
+
+uint64_t SifiveCLINT::GetTickAfter(uint64_t timer)
+{
+	if(timer < timer_offset_) {
+		return 0;
+	}
+	return (timer - timer_offset_) / 1000 + 1;
+}
+
+bool SifiveCLINT::SaveState(DeviceState& state)
+{
+	state.Write<uint64_t>(GetTimer());
+	state.Write<uint32_t>(timers_.size());
+	for(auto timer : timers_) {
+		state.Write<uint64_t>(timer->GetCmp());
+	}
+
+	return true;
+}
+
+bool SifiveCLINT::RestoreState(DeviceState& state)
+{
+	uint64_t timer;
+	uint32_t timer_count;
+	if(!state.Read(timer) || !state.Read(timer_count) || timer_count != timers_.size()) {
+		return false;
+	}
+
+	timer_offset_ = 0;
+	timer_offset_ = timer - GetTimer();
+
+	for(auto hart_timer : timers_) {
+		uint64_t cmp;
+		if(!state.Read(cmp)) {
+			return false;
+		}
+		hart_timer->SetCmp(cmp);
+	}
+
+	return true;
 }
 
 
@@ -154,19 +195,20 @@ uint64_t CLINTTimer::GetCmp() const
 void CLINTTimer::CheckTick()
 {
 	if(clint_->GetTimer() > cmp_) {
-		// pend interrupt if it is enabled
-		if(clint_->GetCoprocessor(hart_->GetThreadID())->GetMTIE()) {
-			clint_->GetCoprocessor(hart_->GetThreadID())->MachinePendInterrupt(1 << 7);
-		}
+		// pend interrupt (the coprocessor only raises it if MTIE is set,
+		// and raises it later if MTIE is set later)
+		clint_->GetCoprocessor(hart_->GetThreadID())->MachinePendInterrupt(1 << 7);
+		clint_->GetTickSource().CancelEvent(*this);
 
 	} else {
-		// unpend interrupt
+		// unpend interrupt, and wait for the timer to pass mtimecmp
 		clint_->GetCoprocessor(hart_->GetThreadID())->MachineUnpendInterrupt(1 << 7);
+		clint_->GetTickSource().ScheduleEvent(*this, clint_->GetTickAfter(cmp_));
 	}
 }
 
 
-void CLINTTimer::Tick(uint32_t tick_periods)
+void CLINTTimer::Fire(uint64_t now)
 {
 	CheckTick();
 }
@@ -2,6 +2,7 @@
 
 #include "arch/risc-v/RiscVSystemCoprocessor.h"
 #include "abi/devices/riscv/SifivePLIC.h"
+#include "abi/devices/DeviceState.h"
 #include "core/thread/ThreadInstance.h"
 #include "util/LogContext.h"
 
@@ -277,6 +278,63 @@ bool SifivePLIC::RescindLine(uint32_t line)
 	return true;
 }
 
+static void SaveWords(DeviceState &state, const std::vector<uint32_t> &words)
+{
+	state.Write<uint32_t>(words.size());
+	state.WriteBytes(words.data(), words.size() * sizeof(uint32_t));
+}
+
+static bool RestoreWords(DeviceState &state, std::vector<uint32_t> &words)
+{
+	uint32_t size;
+	return state.Read(size) && size == words.size() && state.ReadBytes(words.data(), size * sizeof(uint32_t));
+}
+
+bool SifivePLIC::SaveState(DeviceState& state)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+
+	// Pending interrupts aren't saved: they reflect the levels of the
+	// interrupt lines, which are reasserted by the source devices when they
+	// are restored.
+	SaveWords(state, interrupt_priorities_);
+	SaveWords(state, interrupt_claimed_);
+
+	state.Write<uint32_t>(hart_config_.size());
+	for(const auto &context : hart_config_) {
+		state.Write<uint32_t>(context.threshold);
+		state.Write<uint8_t>(context.busy);
+		SaveWords(state, context.enable);
+	}
+
+	return true;
+}
+
+bool SifivePLIC::RestoreState(DeviceState& state)
+{
+	std::lock_guard<std::mutex> guard(lock_);
+
+	uint32_t context_count;
+	if(!RestoreWords(state, interrupt_priorities_) || !RestoreWords(state, interrupt_claimed_) || !state.Read(context_count) || context_count != hart_config_.size()) {
+		return false;
+	}
+
+	for(auto &context : hart_config_) {
+		uint8_t busy;
+		if(!state.Read(context.threshold) || !state.Read(busy) || !RestoreWords(state, context.enable)) {
+			return false;
+		}
+		context.busy = busy;
+	}
+
+	for(auto &word : interrupt_pending_) {
+		word = 0;
+	}
+
+	UpdateIRQ();
+	return true;
+}
+
 void SifivePLIC::UpdateIRQ()
 {
 	// figure out, for each hart, which EIP bits should be set
@@ -1,6 +1,7 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "abi/devices/riscv/SifiveUART.h"
+#include "abi/devices/DeviceState.h"
 
 using namespace archsim::abi::devices::riscv;
 
@@ -125,6 +126,28 @@ bool SifiveUART::Write(uint32_t offset, uint8_t size, uint64_t data)
 	return true;
 }
 
+bool SifiveUART::SaveState(DeviceState& state)
+{
+	// Received characters which the guest hasn't read yet belong to the host
+	// session, so they are not saved.
+	for(uint32_t reg : { txctrl_, rxctrl_, ie_, div_ }) {
+		state.Write(reg);
+	}
+	return true;
+}
+
+bool SifiveUART::RestoreState(DeviceState& state)
+{
+	for(uint32_t *reg : { &txctrl_, &rxctrl_, &ie_, &div_ }) {
+		if(!state.Read(*reg)) {
+			return false;
+		}
+	}
+
+	UpdateIRQ();
+	return true;
+}
+
 void SifiveUART::UpdateIRQ()
 {
 	uint32_t old_ip = ip_;
@@ -3,6 +3,7 @@
 #include "abi/devices/virtio/VirtIO.h"
 #include "abi/devices/virtio/VirtQueue.h"
 #include "abi/devices/IRQController.h"
+#include "abi/devices/DeviceState.h"
 #include "abi/EmulationModel.h"
 #include "abi/memory/MemoryModel.h"
 #include "util/LogContext.h"
@@ -85,6 +86,63 @@ VirtIO::~VirtIO()
 	}
 }
 
+bool VirtIO::SaveState(DeviceState& state)
+{
+	if(!RegisterBackedMemoryComponent::SaveState(state)) {
+		return false;
+	}
+
+	// The queues live in guest memory (which is saved separately), so only
+	// their locations and our position in each of them need to be saved.
+	state.Write<uint8_t>(guest_page_shift);
+	state.Write<uint32_t>(queues.size());
+	for(auto queue : queues) {
+		state.Write<uint64_t>(queue->GetPhysAddr().Get());
+		state.Write<uint32_t>(queue->GetSize());
+		state.Write<uint32_t>(queue->GetAlign());
+		state.Write<uint16_t>(queue->GetLastAvailIdx());
+	}
+
+	return true;
+}
+
+bool VirtIO::RestoreState(DeviceState& state)
+{
+	uint32_t queue_count;
+	if(!RegisterBackedMemoryComponent::RestoreState(state) || !state.Read(guest_page_shift) || !state.Read(queue_count) || queue_count != queues.size()) {
+		return false;
+	}
+
+	for(auto queue : queues) {
+		uint64_t phys_addr;
+		uint32_t size, align;
+		uint16_t last_avail_idx;
+		if(!state.Read(phys_addr) || !state.Read(size) || !state.Read(align) || !state.Read(last_avail_idx)) {
+			return false;
+		}
+
+		queue->SetSize(size);
+		queue->SetAlign(align);
+
+		if(phys_addr != 0) {
+			host_addr_t queue_host_addr;
+			if(!GetParentModel().GetMemoryModel().LockRegion(Address(phys_addr), 0x2000, queue_host_addr)) {
+				LC_ERROR(LogVirtIO) << "[" << GetName() << "] Could not restore queue at " << Address(phys_addr);
+				return false;
+			}
+			queue->SetBaseAddress(Address(phys_addr), queue_host_addr);
+		}
+
+		queue->SetLastAvailIdx(last_avail_idx);
+	}
+
+	if(InterruptStatus.Get()) {
+		irq.Assert();
+	}
+
+	return true;
+}
+
 bool VirtIO::Read(uint32_t offset, uint8_t size, uint64_t& data)
 {
 	LC_DEBUG3(LogVirtIO) << "[" << GetName() << "] Register Read offset=" << std::hex << offset << ", size=" << std::dec << (uint32_t)size;
@@ -169,7 +227,11 @@ void VirtIO::WriteRegister(MemoryRegister& reg, uint32_t value)
 		LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Queue Notify " << std::dec << QueueSel.Get();
 		ProcessQueue(GetQueue(value));
 		LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Queue Notification Complete, ISR=" << std::hex << InterruptStatus.Get();
-	} else if (reg == InterruptACK) {
+	}
+
+	std::lock_guard<std::mutex> lock(completion_lock_);
+
+	if (reg == InterruptACK) {
 		InterruptStatus.Set(InterruptStatus.Get() & ~value);
 		if (value != 0 && irq.IsAsserted()) {
 			LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Rescinding Interrupt";
@@ -187,10 +249,30 @@ void VirtIO::WriteRegister(MemoryRegister& reg, uint32_t value)
 	RegisterBackedMemoryComponent::WriteRegister(reg, value);
 }
 
+void VirtIO::CompleteEvents(const std::vector<VirtIOQueueEvent *>& events)
+{
+	if(events.empty()) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(completion_lock_);
+
+	for(auto evt : events) {
+		evt->owner.Push(evt->Index(), evt->response_size);
+		LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Pushed a descriptor chain head " << std::dec << evt->Index() << ", length=" << evt->response_size;
+
+		delete evt;
+	}
+
+	AssertInterrupt(1);
+}
+
 void VirtIO::ProcessQueue(VirtQueue *queue)
 {
 	LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Processing Queue";
 
+	std::lock_guard<std::mutex> lock(queue->GetLock());
+
 	uint16_t head_idx;
 	const VirtRing::VirtRingDesc *descr;
 	while ((descr = queue->PopDescriptorChainHead(head_idx)) != NULL) {
@@ -6,6 +6,9 @@
 #include "util/LogContext.h"
 #include "abi/devices/virtio/VirtQueue.h"
 #include "abi/devices/IRQController.h"
+#include "util/SimOptions.h"
+
+#include <limits.h>
 #include <string.h>
 
 UseLogContext(LogVirtIO);
@@ -15,8 +18,28 @@ using namespace archsim::abi::devices::virtio;
 using namespace archsim::abi::devices;
 
 static ComponentDescriptor virtioblock_descriptor ("VirtioBlock");
+
+#define VIRTIO_BLK_F_BLK_SIZE (1 << 6)
+#define VIRTIO_BLK_F_MQ (1 << 12)
+
+#define VIRTIO_BLK_T_IN 0
+#define VIRTIO_BLK_T_OUT 1
+#define VIRTIO_BLK_T_GET_ID 8
+
+#define VIRTIO_BLK_S_OK 0
+#define VIRTIO_BLK_S_IOERR 1
+#define VIRTIO_BLK_S_UNSUPP 2
+
+static uint8_t GetQueueCount()
+{
+	uint32_t queues = archsim::options::BlockQueues;
+	if(queues < 1) return 1;
+	if(queues > 16) return 16;
+	return queues;
+}
+
 VirtIOBlock::VirtIOBlock(EmulationModel& parent_model, IRQLine& irq, Address base_address, std::string name, generic::block::BlockDevice& bdev)
-	: VirtIO(parent_model, irq, base_address, 0x1000, name, 1, 2, 1), bdev(bdev), Component(virtioblock_descriptor)
+	: VirtIO(parent_model, irq, base_address, 0x1000, name, 1, 2, GetQueueCount()), bdev(bdev), Component(virtioblock_descriptor), in_flight_(0), terminate_(false)
 {
 	bzero(&config, sizeof(config));
 	config.capacity = bdev.GetBlockCount();
@@ -25,14 +48,38 @@ VirtIOBlock::VirtIOBlock(EmulationModel& parent_model, IRQLine& irq, Address bas
 	config.seg_max = 128-2;
 	config.wce = 1;
 
-	HostFeatures.Set(1 << 6);
+	// Each guest CPU can submit requests through its own queue.
+	config.num_queues = GetQueueCount();
+
+	host_features_ = VIRTIO_BLK_F_BLK_SIZE;
+	if(config.num_queues > 1) {
+		host_features_ |= VIRTIO_BLK_F_MQ;
+	}
+	HostFeatures.Set(host_features_);
+
+	for(uint32_t i = 0; i < archsim::options::BlockIOThreads; ++i) {
+		io_threads_.push_back(std::thread(&VirtIOBlock::ServiceRequests, this));
+	}
 
-	LC_DEBUG1(LogBlock) << "Configured block device with capacity " << std::hex << config.capacity;
+	LC_DEBUG1(LogBlock) << "Configured block device with capacity " << std::hex << config.capacity << ", " << std::dec << (uint32_t)config.num_queues << " queues and " << io_threads_.size() << " I/O threads";
 }
 
 VirtIOBlock::~VirtIOBlock()
 {
+	{
+		std::lock_guard<std::mutex> lock(pending_lock_);
+		terminate_ = true;
+	}
+	pending_cond_.notify_all();
+
+	for(auto &thread : io_threads_) {
+		thread.join();
+	}
 
+	for(auto request : pending_) {
+		delete request->evt;
+		delete request;
+	}
 }
 
 void VirtIOBlock::ResetDevice()
@@ -44,7 +91,7 @@ void VirtIOBlock::WriteRegister(MemoryRegister& reg, uint32_t value)
 {
 	if(reg == HostFeaturesSel) {
 		if(value == 0) {
-			HostFeatures.Set(0x00000040);
+			HostFeatures.Set(host_features_);
 		} else {
 			HostFeatures.Set(0);
 		}
@@ -53,20 +100,29 @@ void VirtIOBlock::WriteRegister(MemoryRegister& reg, uint32_t value)
 	}
 }
 
+bool VirtIOBlock::SaveState(DeviceState& state)
+{
+	// Requests which are still in progress would otherwise complete into
+	// guest memory which has already been saved.
+	WaitForIdle();
+
+	return VirtIO::SaveState(state);
+}
 
 void VirtIOBlock::ProcessEvent(VirtIOQueueEvent* evt_)
 {
 	VirtIOQueueEvent &evt = *evt_;
 	LC_DEBUG1(LogBlock) << "Processing Event";
 
-	if (evt.read_buffers.size() == 0 && evt.write_buffers.size() == 0)
+	if (evt.read_buffers.size() == 0 || evt.write_buffers.size() == 0) {
+		LC_DEBUG1(LogBlock) << "Discarding event with missing buffers";
+		delete evt_;
 		return;
-
-	assert(evt.read_buffers.size() > 0);
-	assert(evt.write_buffers.size() > 0);
+	}
 
 	if (evt.read_buffers.front().size < sizeof(struct virtio_blk_req)) {
 		LC_DEBUG1(LogBlock) << "Discarding event with invalid header";
+		delete evt_;
 		return;
 	}
 
@@ -74,75 +130,188 @@ void VirtIOBlock::ProcessEvent(VirtIOQueueEvent* evt_)
 
 	uint8_t *status = (uint8_t *)evt.write_buffers.back().data;
 	switch (req->type) {
-		case 0: // Read
-			assert(evt.write_buffers.size() == 2);
-
-			if (HandleRead(req->sector, (uint8_t *)evt.write_buffers.front().data, evt.write_buffers.front().size)) {
-				*status = 0;
-			} else {
-				*status = 1;
+		case VIRTIO_BLK_T_IN:
+		case VIRTIO_BLK_T_OUT: {
+			BlockRequest *request = new BlockRequest();
+			request->evt = evt_;
+			request->type = req->type;
+			request->sector = req->sector;
+			request->status = status;
+			request->data_size = 0;
+
+			// Reads fill every buffer but the status byte, writes take every
+			// buffer but the request header.
+			auto begin = req->type == VIRTIO_BLK_T_IN ? evt.write_buffers.begin() : evt.read_buffers.begin() + 1;
+			auto end = req->type == VIRTIO_BLK_T_IN ? evt.write_buffers.end() - 1 : evt.read_buffers.end();
+			for(auto buffer = begin; buffer != end; ++buffer) {
+				struct iovec iov;
+				iov.iov_base = buffer->data;
+				iov.iov_len = buffer->size;
+				request->data.push_back(iov);
+				request->data_size += buffer->size;
 			}
 
-			evt.response_size = evt.write_buffers.front().size + 1;
-			break;
-
-		case 1: // Write
-			assert(evt.read_buffers.size() == 2);
-
-			if (HandleWrite(req->sector, (uint8_t *)evt.read_buffers.back().data, evt.read_buffers.back().size)) {
-				*status = 0;
-			} else {
-				*status = 1;
-			}
+			Submit(request);
+			return;
+		}
 
-			evt.response_size = 1;
-			break;
-		case 8: { // Get ID
+		case VIRTIO_BLK_T_GET_ID: {
 			assert(evt.write_buffers.size() == 2);
 
 			char *serial_number = (char *)evt.write_buffers.front().data;
 			strncpy(serial_number, "virtio", evt.write_buffers.front().size);
 
 			evt.response_size = 1 + 7;
-			*status = 0;
+			*status = VIRTIO_BLK_S_OK;
 
 			break;
 		}
 		default:
 			LC_ERROR(LogBlock) << "Rejecting event with unsupported type " << (uint32_t)req->type;
 
-			*status = 2;
+			*status = VIRTIO_BLK_S_UNSUPP;
 			evt.response_size = 1;
 			break;
 	}
 
-	evt.owner.Push(evt.Index(), evt.response_size);
-	LC_DEBUG1(LogVirtIO) << "[" << GetName() << "] Pushed a descriptor chain head " << std::dec << evt.Index() << ", length=" << evt.response_size;
+	CompleteEvents({ evt_ });
+}
 
-	AssertInterrupt(1);
+void VirtIOBlock::Submit(BlockRequest* request)
+{
+	if(io_threads_.empty()) {
+		ProcessBatch({ request });
+		return;
+	}
 
-	// We're done with the event descriptor so delete it
-	delete evt_;
+	{
+		std::lock_guard<std::mutex> lock(pending_lock_);
+		pending_.push_back(request);
+	}
+	pending_cond_.notify_one();
 }
 
-uint8_t *VirtIOBlock::GetConfigArea() const
+void VirtIOBlock::ServiceRequests()
 {
-	return (uint8_t *)&config;
+	std::vector<BlockRequest *> batch;
+
+	while(true) {
+		{
+			std::unique_lock<std::mutex> lock(pending_lock_);
+			if(!batch.empty()) {
+				in_flight_ -= batch.size();
+				batch.clear();
+				if(pending_.empty() && in_flight_ == 0) {
+					idle_cond_.notify_all();
+				}
+			}
+
+			pending_cond_.wait(lock, [this] { return terminate_ || !pending_.empty(); });
+			if(terminate_) {
+				return;
+			}
+
+			while(!pending_.empty() && batch.size() < kMaxBatch) {
+				batch.push_back(pending_.front());
+				pending_.pop_front();
+			}
+			in_flight_ += batch.size();
+		}
+
+		ProcessBatch(batch);
+	}
 }
 
-uint32_t VirtIOBlock::GetConfigAreaSize() const
+void VirtIOBlock::WaitForIdle()
 {
-	return sizeof(config);
+	std::unique_lock<std::mutex> lock(pending_lock_);
+	idle_cond_.wait(lock, [this] { return terminate_ || (pending_.empty() && in_flight_ == 0); });
+}
+
+static void PrefaultBuffer(const struct iovec &iov)
+{
+	// Guest memory which is being restored lazily from a snapshot is only
+	// filled in when it is touched from user space: the kernel would just fail
+	// the transfer. This is cheap for memory which is already there.
+	volatile uint8_t *data = (volatile uint8_t *)iov.iov_base;
+	for(size_t offset = 0; offset < iov.iov_len; offset += 4096) {
+		(void)data[offset];
+	}
+	if(iov.iov_len) {
+		(void)data[iov.iov_len - 1];
+	}
 }
 
-bool VirtIOBlock::HandleRead(uint64_t sector, uint8_t* buffer, uint32_t len)
+bool VirtIOBlock::Transfer(uint32_t type, uint64_t sector, const std::vector<struct iovec>& data)
 {
-	LC_DEBUG1(LogBlock) << "Handling read sector=" << std::hex << sector << ", len=" << std::dec << len;
-	return bdev.ReadBlocks(sector, len / bdev.GetBlockSize(), buffer);
+	for(const auto &iov : data) {
+		PrefaultBuffer(iov);
+	}
+
+	if(type == VIRTIO_BLK_T_IN) {
+		LC_DEBUG1(LogBlock) << "Handling read sector=" << std::hex << sector << ", segments=" << std::dec << data.size();
+		return bdev.ReadBlocksV(sector, data.data(), data.size());
+	} else {
+		LC_DEBUG1(LogBlock) << "Handling write sector=" << std::hex << sector << ", segments=" << std::dec << data.size();
+		return bdev.WriteBlocksV(sector, data.data(), data.size());
+	}
 }
 
-bool VirtIOBlock::HandleWrite(uint64_t sector, uint8_t* buffer, uint32_t len)
+void VirtIOBlock::ProcessBatch(const std::vector<BlockRequest *>& batch)
 {
-	LC_DEBUG1(LogBlock) << "Handling write sector=" << std::hex << sector << ", len=" << std::dec << len;
-	return bdev.WriteBlocks(sector, len / bdev.GetBlockSize(), buffer);
+	std::vector<VirtIOQueueEvent *> completed;
+	std::vector<struct iovec> data;
+
+	// Requests which carry on from where the previous one left off are
+	// merged into a single host transfer.
+	for(size_t first = 0; first < batch.size();) {
+		BlockRequest *request = batch[first];
+		data = request->data;
+
+		size_t last = first + 1;
+		uint64_t next_sector = request->sector + (request->data_size / bdev.GetBlockSize());
+		while(last < batch.size()) {
+			BlockRequest *next = batch[last];
+			if(next->type != request->type || next->sector != next_sector || data.size() + next->data.size() > IOV_MAX) {
+				break;
+			}
+
+			data.insert(data.end(), next->data.begin(), next->data.end());
+			next_sector += next->data_size / bdev.GetBlockSize();
+			last++;
+		}
+
+		bool success = Transfer(request->type, request->sector, data);
+
+		for(size_t i = first; i < last; ++i) {
+			BlockRequest *done = batch[i];
+
+			// If a merged transfer failed, find out which of its requests
+			// were actually at fault.
+			bool done_success = success;
+			if(!success && last - first > 1) {
+				done_success = Transfer(done->type, done->sector, done->data);
+			}
+
+			*done->status = done_success ? VIRTIO_BLK_S_OK : VIRTIO_BLK_S_IOERR;
+			done->evt->response_size = (done->type == VIRTIO_BLK_T_IN ? done->data_size : 0) + 1;
+
+			completed.push_back(done->evt);
+			delete done;
+		}
+
+		first = last;
+	}
+
+	CompleteEvents(completed);
+}
+
+uint8_t *VirtIOBlock::GetConfigArea() const
+{
+	return (uint8_t *)&config;
+}
+
+uint32_t VirtIOBlock::GetConfigAreaSize() const
+{
+	return sizeof(config);
 }
@@ -76,6 +76,11 @@ bool ContiguousMemoryModel::Initialise()
 		return false;
 	}
 
+	if(archsim::options::MemoryImage.IsSpecified() && !image.Open(archsim::options::MemoryImage)) {
+		munmap(mem_base, CONTIGUOUS_MEMORY_SIZE);
+		return false;
+	}
+
 	is_initialised = true;
 
 #if ARCHSIM_SIMULATION_HOST_IS_x86_64
@@ -101,6 +106,8 @@ bool ContiguousMemoryModel::Initialise()
 
 void ContiguousMemoryModel::Destroy()
 {
+	image.Close();
+
 #ifndef DIRECT
 	munmap(mem_base, CONTIGUOUS_MEMORY_SIZE);
 #endif
@@ -133,11 +140,11 @@ bool ContiguousMemoryModel::UnlockRegion(guest_addr_t guest_addr, guest_size_t g
 
 bool ContiguousMemoryModel::AllocateVMA(GuestVMA &vma)
 {
-	void *host_addr = mmap(GuestToHost(vma.base), vma.size, ProtFlags(vma.protection), MAP_ANONYMOUS | MAP_FIXED | MAP_PRIVATE, -1, 0);
+	void *host_addr = GuestToHost(vma.base);
 
-	LC_DEBUG1(LogContiguousMemory) << "Allocated " << host_addr << " for vma " << vma.base;
+	LC_DEBUG1(LogContiguousMemory) << "Allocating " << host_addr << " for vma " << vma.base;
 
-	if (host_addr == MAP_FAILED) {
+	if (!image.Map(host_addr, vma.base.Get(), vma.size, ProtFlags(vma.protection))) {
 		LC_DEBUG1(LogContiguousMemory) << " - Failed! " << strerror(errno);
 		return false;
 	}
@@ -161,9 +168,12 @@ bool ContiguousMemoryModel::ResizeVMA(GuestVMA &vma, guest_size_t new_size)
 	vma.size = new_size;
 	mprotect(vma.host_base, vma.size, ProtFlags(vma.protection));
 
-	// Zero new memory
+	// Zero new memory, or map it from the image
 	if (new_size > old_size) {
-		bzero((void *)((unsigned long)vma.host_base + old_size), (new_size - old_size));
+		void *new_base = (void *)((unsigned long)vma.host_base + old_size);
+		if (!image.IsOpen() || !image.Map(new_base, vma.base.Get() + old_size, new_size - old_size, ProtFlags(vma.protection))) {
+			bzero(new_base, (new_size - old_size));
+		}
 	}
 
 	return true;
@@ -175,6 +185,17 @@ bool ContiguousMemoryModel::SynchroniseVMAProtection(GuestVMA &vma)
 	return true;
 }
 
+bool ContiguousMemoryModel::ResetToBase()
+{
+	for (const auto &i : GetVMAs()) {
+		if (!MemoryImage::Reset(i.second->host_base, i.second->size)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 MemoryTranslationModel &ContiguousMemoryModel::GetTranslationModel()
 {
 	return *translation_model;
@@ -246,7 +267,13 @@ uint32_t ContiguousMemoryModel::Poke(guest_addr_t addr, uint8_t *data, int size)
 	}
 
 	ProtectRegion(addr, size, RegFlagReadWrite);
-	memcpy((void *)((uintptr_t)mem_base + addr.Get()), (void *)data, size);
+	if (image.IsOpen()) {
+		// Loading a binary which is already in the image leaves its pages
+		// shared
+		MemoryImage::Write((void *)((uintptr_t)mem_base + addr.Get()), data, size);
+	} else {
+		memcpy((void *)((uintptr_t)mem_base + addr.Get()), (void *)data, size);
+	}
 	ProtectRegion(addr, size, old_flags);
 
 	return 0;
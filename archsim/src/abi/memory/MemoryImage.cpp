@@ -0,0 +1,180 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "abi/memory/MemoryImage.h"
+#include "abi/memory/MemoryModel.h"
+#include "util/LogContext.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+UseLogContext(LogMemoryModel);
+DeclareChildLogContext(LogMemoryImage, LogMemoryModel, "MemoryImage");
+
+using namespace archsim::abi::memory;
+
+const size_t MemoryImage::kPageSize;
+
+MemoryImage::MemoryImage() : fd_(-1), size_(0)
+{
+
+}
+
+MemoryImage::~MemoryImage()
+{
+	Close();
+}
+
+bool MemoryImage::Open(const std::string &filename)
+{
+	Close();
+
+	int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+	if(fd < 0) {
+		LC_ERROR(LogMemoryImage) << "Unable to open memory image " << filename << ": " << strerror(errno);
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st)) {
+		close(fd);
+		return false;
+	}
+
+	fd_ = fd;
+	size_ = ((uint64_t)st.st_size + kPageSize - 1) & ~(uint64_t)(kPageSize - 1);
+
+	LC_DEBUG1(LogMemoryImage) << "Opened memory image " << filename << " (" << size_ << " bytes)";
+	return true;
+}
+
+void MemoryImage::Close()
+{
+	if(fd_ >= 0) {
+		close(fd_);
+		fd_ = -1;
+		size_ = 0;
+	}
+}
+
+bool MemoryImage::Map(void *host_addr, uint64_t guest_addr, uint64_t size, int prot) const
+{
+	if(((uintptr_t)host_addr | guest_addr) & (kPageSize - 1)) {
+		return false;
+	}
+
+	uint8_t *host = (uint8_t*)host_addr;
+	uint64_t image_end = guest_addr;
+	if(IsOpen() && guest_addr < size_) {
+		image_end = std::min(guest_addr + size, size_);
+	}
+
+	// Pages past the end of the file would fault, so only the part which
+	// the image covers is mapped from it
+	uint64_t image_size = image_end - guest_addr;
+	if(image_size > 0) {
+		if(mmap(host, image_size, prot, MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, fd_, guest_addr) == MAP_FAILED) {
+			LC_ERROR(LogMemoryImage) << "Unable to map memory image: " << strerror(errno);
+			return false;
+		}
+	}
+
+	if(image_size < size) {
+		if(mmap(host + image_size, size - image_size, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool MemoryImage::Reset(void *host_addr, uint64_t size)
+{
+	// Private pages are dropped: file backed pages go back to the (shared)
+	// image, and anonymous pages go back to zero.
+	return !madvise(host_addr, size, MADV_DONTNEED);
+}
+
+size_t MemoryImage::Write(void *host_addr, const void *data, size_t size)
+{
+	uint8_t *host = (uint8_t*)host_addr;
+	const uint8_t *src = (const uint8_t*)data;
+	size_t pages_written = 0;
+
+	while(size > 0) {
+		size_t chunk = std::min<size_t>(size, kPageSize - ((uintptr_t)host & (kPageSize - 1)));
+
+		// Reading the page doesn't copy it, but writing to it does
+		if(memcmp(host, src, chunk)) {
+			memcpy(host, src, chunk);
+			pages_written++;
+		}
+
+		host += chunk;
+		src += chunk;
+		size -= chunk;
+	}
+
+	return pages_written;
+}
+
+static bool IsZero(const uint8_t *data, size_t size)
+{
+	for(size_t i = 0; i < size; ++i) {
+		if(data[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool MemoryImage::Save(RegionBasedMemoryModel &model, const std::string &filename)
+{
+	int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if(fd < 0) {
+		LC_ERROR(LogMemoryImage) << "Unable to create memory image " << filename << ": " << strerror(errno);
+		return false;
+	}
+
+	uint8_t buffer[kPageSize];
+	uint64_t end = 0;
+
+	for(const auto &i : model.GetVMAs()) {
+		const GuestVMA &vma = *i.second;
+		bool direct = vma.host_base != nullptr && (vma.protection & RegFlagRead);
+
+		for(uint64_t page_offset = 0; page_offset < vma.size; page_offset += kPageSize) {
+			uint64_t page_size = std::min<uint64_t>(kPageSize, vma.size - page_offset);
+
+			const uint8_t *data;
+			if(direct) {
+				data = (const uint8_t*)vma.host_base + page_offset;
+			} else {
+				model.Peek(Address(vma.base.Get() + page_offset), buffer, page_size);
+				data = buffer;
+			}
+
+			if(IsZero(data, page_size)) {
+				continue;
+			}
+
+			if(pwrite(fd, data, page_size, vma.base.Get() + page_offset) != (ssize_t)page_size) {
+				LC_ERROR(LogMemoryImage) << "Unable to write memory image " << filename << ": " << strerror(errno);
+				close(fd);
+				return false;
+			}
+		}
+
+		end = std::max(end, vma.base.Get() + vma.size);
+	}
+
+	// Make sure trailing zero pages are part of the image
+	bool ok = !ftruncate(fd, end);
+	close(fd);
+
+	return ok;
+}
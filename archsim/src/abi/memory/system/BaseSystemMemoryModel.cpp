@@ -53,7 +53,7 @@ bool BaseSystemMemoryModel::ResolveGuestAddress(host_const_addr_t, guest_addr_t&
 
 uint32_t BaseSystemMemoryModel::PerformTranslation(Address virt_addr, Address &out_phys_addr, const struct archsim::abi::devices::AccessInfo &info)
 {
-	return GetMMU()->Translate(GetThread(), virt_addr, out_phys_addr, info);
+	return GetMMU()->TranslateCached(GetThread(), virt_addr, out_phys_addr, info);
 }
 
 MemoryTranslationModel &BaseSystemMemoryModel::GetTranslationModel()
@@ -91,7 +91,7 @@ uint32_t BaseSystemMemoryModel::DoRead(guest_addr_t virt_addr, uint8_t *data, in
 	}
 
 	Address phys_addr;
-	uint32_t fault = GetMMU()->Translate(GetThread(), virt_addr, phys_addr, MMUACCESSINFO2(use_perms ? GetThread()->GetExecutionRing() : false, false, is_fetch, side_effects));
+	uint32_t fault = GetMMU()->TranslateCached(GetThread(), virt_addr, phys_addr, MMUACCESSINFO2(use_perms ? GetThread()->GetExecutionRing() : false, false, is_fetch, side_effects));
 
 	LC_DEBUG4(LogSystemMemoryModel) << "DoRead Fault: " << fault;
 
@@ -172,7 +172,7 @@ uint32_t BaseSystemMemoryModel::DoWrite(guest_addr_t virt_addr, uint8_t *data, i
 	}
 
 	Address phys_addr;
-	uint32_t fault = GetMMU()->Translate(GetThread(), virt_addr, phys_addr, MMUACCESSINFO2(use_perms ? GetThread()->GetExecutionRing() : false, true, 0, side_effects));
+	uint32_t fault = GetMMU()->TranslateCached(GetThread(), virt_addr, phys_addr, MMUACCESSINFO2(use_perms ? GetThread()->GetExecutionRing() : false, true, 0, side_effects));
 
 	LC_DEBUG4(LogSystemMemoryModel) << "DoWrite Fault: " << fault;
 
@@ -237,9 +237,7 @@ uint32_t BaseSystemMemoryModel::DoWrite(guest_addr_t virt_addr, uint8_t *data, i
 				break;
 		}
 
-		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
-		}
+		GetCodeRegions().InvalidateWrite(PhysicalAddress(phys_addr.Get()), size);
 
 		return 0;
 
@@ -268,14 +268,15 @@ void CacheBasedSystemMemoryModel::InstallCaches()
 		std::string read_name = "mem_cache_" + std::to_string(mode.first.first) + "_" + std::to_string(mode.first.second) + "_read";
 		std::string write_name = "mem_cache_" + std::to_string(mode.first.first) + "_" + std::to_string(mode.first.second) + "_write";
 
+		// JIT memory accesses go through these, so keep them hot
 		if(!stateblock.GetDescriptor().HasEntry(read_name)) {
-			stateblock.AddBlock(read_name, 8);
+			stateblock.AddBlock(read_name, 8, true, true);
 		}
 		if(!stateblock.GetDescriptor().HasEntry(write_name)) {
-			stateblock.AddBlock(write_name, 8);
+			stateblock.AddBlock(write_name, 8, true, true);
 		}
-		GetThread()->GetStateBlock().SetEntry<void*>(read_name, GetCache(mode.first.first, mode.first.second, 0).GetCachePtr());
-		GetThread()->GetStateBlock().SetEntry<void*>(write_name,GetCache(mode.first.first, mode.first.second, 1).GetCachePtr());
+		*stateblock.GetEntryHandle<void*>(read_name).Get(stateblock) = GetCache(mode.first.first, mode.first.second, 0).GetCachePtr();
+		*stateblock.GetEntryHandle<void*>(write_name).Get(stateblock) = GetCache(mode.first.first, mode.first.second, 1).GetCachePtr();
 
 	}
 }
@@ -359,9 +360,7 @@ uint32_t CacheBasedSystemMemoryModel::Write(guest_addr_t virt_addr, uint8_t *dat
 		}
 	}
 
-	if (GetCodeRegions().IsRegionCode(PhysicalAddress(entry->GetPhysAddr().Get()))) {
-		GetCodeRegions().InvalidateRegion(PhysicalAddress(entry->GetPhysAddr().Get()));
-	}
+	GetCodeRegions().InvalidateWrite(PhysicalAddress(entry->GetPhysAddr().GetPageBase() | va.GetPageOffset()), size);
 
 	uint8_t *page_base = (uint8_t*)entry->GetMemory();
 	switch(size) {
@@ -404,9 +403,7 @@ uint32_t CacheBasedSystemMemoryModel::Poke(guest_addr_t virt_addr, uint8_t *data
 	if (UNLIKELY(rc)) {
 		return rc;
 	} else {
-		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
-		}
+		GetCodeRegions().InvalidateWrite(PhysicalAddress(phys_addr.Get()), size);
 
 		return GetPhysMem()->Poke(phys_addr, data, size);
 	}
@@ -437,9 +434,7 @@ uint32_t CacheBasedSystemMemoryModel::Write8User(guest_addr_t guest_addr, uint8_
 
 	if(UNLIKELY(rc)) return rc;
 	else {
-		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
-		}
+		GetCodeRegions().InvalidateWrite(PhysicalAddress(phys_addr.Get()), 1);
 		return GetPhysMem()->Write8(phys_addr, data);
 	}
 }
@@ -451,9 +446,7 @@ uint32_t CacheBasedSystemMemoryModel::Write32User(guest_addr_t guest_addr, uint3
 
 	if(UNLIKELY(rc)) return rc;
 	else {
-		if (GetCodeRegions().IsRegionCode(PhysicalAddress(phys_addr.Get()))) {
-			GetCodeRegions().InvalidateRegion(PhysicalAddress(phys_addr.Get()));
-		}
+		GetCodeRegions().InvalidateWrite(PhysicalAddress(phys_addr.Get()), 4);
 		return GetPhysMem()->Write32(phys_addr, data);
 	}
 }
@@ -472,14 +465,14 @@ uint32_t CacheBasedSystemMemoryModel::PerformTranslation(Address virt_addr, Addr
 		return 0;
 	}
 
-	uint32_t rc = (uint32_t)GetMMU()->Translate(GetThread(), virt_addr, out_phys_addr, info);
+	uint32_t rc = (uint32_t)GetMMU()->TranslateCached(GetThread(), virt_addr, out_phys_addr, info);
 	return rc;
 }
 
 uint32_t CacheBasedSystemMemoryModel::UpdateCacheEntry(guest_addr_t addr, SMMCacheEntry *entry, bool isWrite, bool isFetch, bool allow_side_effects)
 {
 	Address phys_addr;
-	uint32_t rc = (uint32_t)GetMMU()->Translate(GetThread(), addr, phys_addr, MMUACCESSINFO2(GetThread()->GetExecutionRing(), isWrite,isFetch, allow_side_effects));
+	uint32_t rc = (uint32_t)GetMMU()->TranslateCached(GetThread(), addr, phys_addr, MMUACCESSINFO2(GetThread()->GetExecutionRing(), isWrite,isFetch, allow_side_effects));
 	if(rc) {
 		entry->Invalidate();
 		return rc;
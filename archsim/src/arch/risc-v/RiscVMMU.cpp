@@ -1,6 +1,7 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "arch/risc-v/RiscVMMU.h"
+#include "abi/devices/DeviceState.h"
 #include "abi/memory/MemoryModel.h"
 #include "core/thread/ThreadInstance.h"
 #include "util/LogContext.h"
@@ -97,7 +98,25 @@ uint64_t RiscVMMU::GetSATP() const
 	}
 
 	// construct satp from parts
-	return page_table_ppn_ | (uint64_t)asid_ << 22 | (uint64_t)mode_bits << 60;
+	return page_table_ppn_ | (uint64_t)asid_ << 44 | (uint64_t)mode_bits << 60;
+}
+
+bool RiscVMMU::SaveState(archsim::abi::devices::DeviceState& state)
+{
+	state.Write<uint64_t>(GetSATP());
+	return true;
+}
+
+bool RiscVMMU::RestoreState(archsim::abi::devices::DeviceState& state)
+{
+	uint64_t satp;
+	if(!state.Read(satp)) {
+		return false;
+	}
+
+	SetSATP(satp);
+	InvalidateTLB();
+	return true;
 }
 
 void RiscVMMU::SetSATP(uint64_t new_satp)
@@ -107,9 +126,7 @@ void RiscVMMU::SetSATP(uint64_t new_satp)
 	uint64_t new_mode = new_satp >> 60;
 
 	page_table_ppn_ = new_pt_ppn;
-
-	// do not implement asid
-	asid_ = 0;
+	asid_ = new_asid;
 
 	switch(new_mode) {
 		case 0:
@@ -146,6 +163,37 @@ int RiscVMMU::GetPTLevels(Mode mode) const
 	}
 }
 
+bool RiscVMMU::GetTLBContext(archsim::core::thread::ThreadInstance* cpu, const AccessInfo& info, TLBContext& context)
+{
+	if(GetMode() == NoTxln) {
+		return false;
+	}
+
+	uint64_t mstatus;
+	Manager->GetDevice(0)->Read64(0x300, mstatus);
+
+	// Machine mode accesses are not translated (unless MPRV is set), so
+	// there's nothing to cache.
+	if(info.Ring == 3 && (info.Fetch || !((mstatus >> 17) & 1))) {
+		return false;
+	}
+
+	// Translations depend on the page table, SUM, MPRV and MPP. Entries are
+	// kept across changes to any of them, since sfence.vma is only needed
+	// after the page table itself is modified.
+	context.ASID = asid_;
+	context.State = page_table_ppn_ | ((uint64_t)mode_ << 44) | (((mstatus >> 11) & 3) << 48) | (((mstatus >> 17) & 3) << 50);
+
+	return true;
+}
+
+bool RiscVMMU::HasExplicitTLBMaintenance() const
+{
+	// sfence.vma only affects the executing hart: remote fences are
+	// performed by the other harts themselves.
+	return true;
+}
+
 MMU::TranslateResult RiscVMMU::Translate(archsim::core::thread::ThreadInstance* cpu, Address virt_addr, Address& phys_addr, AccessInfo info)
 {
 	auto satp = GetSATP();
@@ -251,6 +299,7 @@ MMU::TranslateResult RiscVMMU::Translate(archsim::core::thread::ThreadInstance*
 		}
 
 		phys_addr = pageinfo.phys_addr.PageBase() | (virt_addr & ~pageinfo.mask);
+		SetTLBFill(~pageinfo.mask, (pte >> 5) & 1);
 
 		// check dirty/access bits (should this be done in hardware? configurable?)
 	} else {
@@ -1,6 +1,7 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "abi/devices/generic/timing/TickSource.h"
+#include "abi/devices/DeviceState.h"
 #include "abi/devices/IRQController.h"
 #include "arch/risc-v/RiscVSystemCoprocessor.h"
 #include "core/thread/ThreadInstance.h"
@@ -10,7 +11,7 @@
 DeclareLogContext(LogRiscVSystem, "RV-System");
 using namespace archsim::arch::riscv;
 
-RiscVSystemCoprocessor::RiscVSystemCoprocessor(archsim::core::thread::ThreadInstance* hart, RiscVMMU* mmu) : hart_(hart), mmu_(mmu), STATUS(hart->GetEmulationModel().GetSystem().GetPubSub())
+RiscVSystemCoprocessor::RiscVSystemCoprocessor(archsim::core::thread::ThreadInstance* hart, RiscVMMU* mmu) : hart_(hart), mmu_(mmu), STATUS(hart->GetEmulationModel().GetSystem().GetPubSub(), hart)
 {
 	BitLockGuard guard(lock_);
 	true_pending_interrupts_ = 0;
@@ -255,7 +256,7 @@ bool RiscVSystemCoprocessor::Write64(uint32_t address, uint64_t data)
 		case 0x180: //SATP
 			mmu_->SetSATP(data);
 			// flush tlb
-			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, nullptr);
+			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::ITlbFullFlush, hart_);
 			Manager->GetEmulationModel()->GetSystem().GetPubSub().Publish(PubSubType::DTlbFullFlush, nullptr);
 			break;
 
@@ -352,6 +353,68 @@ bool RiscVSystemCoprocessor::Write64(uint32_t address, uint64_t data)
 	return true;
 }
 
+bool RiscVSystemCoprocessor::SaveState(archsim::abi::devices::DeviceState& state)
+{
+	BitLockGuard guard(lock_);
+
+	for(uint64_t csr : { MTVEC, MSCRATCH, MEPC, MCAUSE, MTVAL, MIDELEG, MEDELEG, SIDELEG, SEDELEG, STVEC, SSCRATCH, SEPC, SCAUSE, STVAL, MCOUNTEREN, SCOUNTEREN }) {
+		state.Write(csr);
+	}
+
+	// MSTATUS doesn't round trip through WriteMSTATUS, so save each field.
+	for(uint8_t field : { STATUS.SD, STATUS.TSR, STATUS.TW, STATUS.TVM, STATUS.MXR, STATUS.SUM, STATUS.MPRV, STATUS.SPP, STATUS.MPIE, STATUS.SPIE, STATUS.UPIE, STATUS.MIE, STATUS.SIE, STATUS.UIE }) {
+		state.Write(field);
+	}
+	for(uint8_t field : { STATUS.SXL, STATUS.UXL, STATUS.XS, STATUS.FS, STATUS.MPP }) {
+		state.Write(field);
+	}
+
+	// PendMask and WriteMIE cover every bit of MIP and MIE respectively
+	state.Write<uint64_t>(IP.ReadMIP());
+	state.Write<uint64_t>(IE.ReadMIE());
+
+	return true;
+}
+
+bool RiscVSystemCoprocessor::RestoreState(archsim::abi::devices::DeviceState& state)
+{
+	BitLockGuard guard(lock_);
+
+	for(uint64_t *csr : { &MTVEC, &MSCRATCH, &MEPC, &MCAUSE, &MTVAL, &MIDELEG, &MEDELEG, &SIDELEG, &SEDELEG, &STVEC, &SSCRATCH, &SEPC, &SCAUSE, &STVAL, &MCOUNTEREN, &SCOUNTEREN }) {
+		if(!state.Read(*csr)) {
+			return false;
+		}
+	}
+
+	for(bool *field : { &STATUS.SD, &STATUS.TSR, &STATUS.TW, &STATUS.TVM, &STATUS.MXR, &STATUS.SUM, &STATUS.MPRV, &STATUS.SPP, &STATUS.MPIE, &STATUS.SPIE, &STATUS.UPIE, &STATUS.MIE, &STATUS.SIE, &STATUS.UIE }) {
+		uint8_t value;
+		if(!state.Read(value)) {
+			return false;
+		}
+		*field = value;
+	}
+	for(uint8_t *field : { &STATUS.SXL, &STATUS.UXL, &STATUS.XS, &STATUS.FS, &STATUS.MPP }) {
+		if(!state.Read(*field)) {
+			return false;
+		}
+	}
+
+	uint64_t mip, mie;
+	if(!state.Read(mip) || !state.Read(mie)) {
+		return false;
+	}
+	IP.Reset();
+	IP.PendMask(mip);
+	IE.WriteMIE(mie);
+
+	// None of the hart's interrupt lines have been asserted yet in this
+	// simulation, so work out which should be from scratch.
+	true_pending_interrupts_ = 0;
+	CheckForInterrupts();
+
+	return true;
+}
+
 void RiscVSystemCoprocessor::MachinePendInterrupt(uint64_t mask)
 {
 	std::lock_guard<std::recursive_mutex> lock(lock_);
@@ -491,7 +554,7 @@ bool RiscVSystemCoprocessor::CanTakeInterrupt(uint8_t ring, uint32_t irq)
 	return false;
 }
 
-RiscVSystemCoprocessor::STATUS_t::STATUS_t(archsim::util::PubSubContext& pubsub) : pubsub_(pubsub)
+RiscVSystemCoprocessor::STATUS_t::STATUS_t(archsim::util::PubSubContext& pubsub, archsim::core::thread::ThreadInstance *hart) : pubsub_(pubsub), hart_(hart)
 {
 	SD = 0;
 	SXL = 0;
@@ -577,7 +640,7 @@ void RiscVSystemCoprocessor::STATUS_t::WriteMSTATUS(uint64_t data)
 	UIE = BITSEL(data, 0);
 
 	if(should_flush_tlb) {
-		pubsub_.Publish(PubSubType::ITlbFullFlush, nullptr);
+		pubsub_.Publish(PubSubType::ITlbFullFlush, hart_);
 		pubsub_.Publish(PubSubType::DTlbFullFlush, nullptr);
 	}
 }
@@ -622,7 +685,7 @@ void RiscVSystemCoprocessor::STATUS_t::WriteSSTATUS(uint64_t data)
 	UIE = BITSEL(data, 0);
 
 	if(should_flush_tlb) {
-		pubsub_.Publish(PubSubType::ITlbFullFlush, nullptr);
+		pubsub_.Publish(PubSubType::ITlbFullFlush, hart_);
 		pubsub_.Publish(PubSubType::DTlbFullFlush, nullptr);
 	}
 }
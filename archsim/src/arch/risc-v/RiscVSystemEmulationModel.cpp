@@ -4,6 +4,7 @@
 #include "arch/risc-v/RiscVSystemEmulationModel.h"
 #include "arch/risc-v/RiscVSystemCoprocessor.h"
 #include "arch/risc-v/RiscVDecodeContext.h"
+#include "arch/risc-v/RiscVMMU.h"
 #include "core/thread/ThreadInstance.h"
 #include "util/LogContext.h"
 #include "core/MemoryInterface.h"
@@ -46,13 +47,30 @@ ExceptionAction RiscVSystemEmulationModel::HandleException(archsim::core::thread
 	// possibly handle special internal exceptions
 	switch(category) {
 		case 1024: { // fence.i
-			cpu->GetPubsub().Publish(PubSubType::ITlbFullFlush, nullptr);
+			cpu->GetPubsub().Publish(PubSubType::ITlbFullFlush, cpu);
 			cpu->GetPubsub().Publish(PubSubType::DTlbFullFlush, nullptr);
 			return ExceptionAction::ResumeNext;
 		}
-		case 1025: { // fence.vma
+		case 1025: // sfence.vma
+		case 1026: // sfence.vma with an address
+		case 1027: { // sfence.vma with an ASID
+			auto mmu = (RiscVMMU*)cpu->GetPeripherals().GetDeviceByName("mmu");
+			switch(category) {
+				case 1025:
+					mmu->InvalidateTLB();
+					break;
+				case 1026:
+					mmu->InvalidateTLBPage(archsim::Address(data));
+					break;
+				case 1027:
+					mmu->InvalidateTLBASID(data);
+					break;
+			}
+
+			// The other translation caches are not tagged with an ASID, so
+			// still flush them entirely.
 			cpu->GetPubsub().Publish(PubSubType::FlushTranslations, nullptr);
-			cpu->GetPubsub().Publish(PubSubType::ITlbFullFlush, nullptr);
+			cpu->GetPubsub().Publish(PubSubType::ITlbFullFlush, cpu);
 			cpu->GetPubsub().Publish(PubSubType::DTlbFullFlush, nullptr);
 			return ExceptionAction::ResumeNext;
 		}
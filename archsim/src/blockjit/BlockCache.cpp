@@ -3,9 +3,68 @@
 
 #include "blockjit/BlockCache.h"
 
+#include <cstddef>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 using namespace archsim::blockjit;
 
-void BlockCache::Invalidate()
+const uint32_t BlockCache::kEntryShift;
+const int32_t BlockCache::kGenerationOffset;
+const uint64_t BlockCache::kInvalidGeneration;
+
+static_assert((1 << BlockCache::kEntryShift) == sizeof(BlockCacheEntry), "Block cache entry shift must match entry size");
+
+void BlockCache::Reset()
+{
+	for(auto &entry : cache_) {
+		entry.virt_tag = ~0ULL;
+		entry.ptr = nullptr;
+		entry.generation = kInvalidGeneration;
+		entry.reserved = 0;
+	}
+	feature_required_masks_.fill(0);
+	feature_levels_.fill(0);
+
+	generation_ = kInvalidGeneration + 1;
+}
+
+void BlockCache::InvalidateFeatures(uint64_t current_mask)
 {
-	memset(cache_.data(), 0xff, sizeof(BlockCacheEntry) * kCacheSize);
+	unsigned i = 0;
+
+#ifdef __SSE2__
+	// Compare four entries at a time. Entries nearly always keep their
+	// features, so only look at the individual entries if any have changed.
+	const __m128i current = _mm_set1_epi64x(current_mask);
+	const __m128i zero = _mm_setzero_si128();
+
+	for(; i + 4 <= kCacheSize; i += 4) {
+		const __m128i *required = (const __m128i*)&feature_required_masks_[i];
+		const __m128i *level = (const __m128i*)&feature_levels_[i];
+
+		__m128i diff_lo = _mm_xor_si128(_mm_and_si128(current, _mm_load_si128(required)), _mm_load_si128(level));
+		__m128i diff_hi = _mm_xor_si128(_mm_and_si128(current, _mm_load_si128(required + 1)), _mm_load_si128(level + 1));
+
+		// One bit per byte of the two differences which is zero
+		uint32_t same = _mm_movemask_epi8(_mm_cmpeq_epi8(diff_lo, zero)) | (_mm_movemask_epi8(_mm_cmpeq_epi8(diff_hi, zero)) << 16);
+		if(same == 0xffffffff) {
+			continue;
+		}
+
+		for(unsigned j = 0; j < 4; ++j) {
+			if(((same >> (j * 8)) & 0xff) != 0xff) {
+				cache_[i + j].generation = kInvalidGeneration;
+			}
+		}
+	}
+#endif
+
+	for(; i < kCacheSize; ++i) {
+		if((current_mask & feature_required_masks_[i]) != feature_levels_[i]) {
+			cache_[i].generation = kInvalidGeneration;
+		}
+	}
 }
@@ -0,0 +1,167 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "blockjit/BlockChaining.h"
+#include "blockjit/BlockProfile.h"
+#include "util/LogContext.h"
+
+#include <algorithm>
+#include <climits>
+
+UseLogContext(LogBlockProfile);
+DeclareChildLogContext(LogBlockChaining, LogBlockProfile, "Chaining");
+
+using captive::shared::block_txln_fn;
+
+using namespace archsim::blockjit;
+
+// Point the jump in a slot at a new target. The displacement is 4 byte
+// aligned, so a thread executing the jump sees either the old or the new
+// target.
+static bool PatchSlot(block_txln_fn owner, uint32_t offset, const void *target)
+{
+	uint8_t *slot = (uint8_t*)owner + offset;
+	int64_t displacement = (const uint8_t*)target - (slot + 4);
+
+	if(displacement > INT32_MAX || displacement < INT32_MIN) {
+		return false;
+	}
+
+	__atomic_store_n((int32_t*)slot, (int32_t)displacement, __ATOMIC_RELEASE);
+	return true;
+}
+
+// A translation can only be entered when the features it depends on have the
+// levels it was translated with. Jumping to it from another translation skips
+// that check, so the other translation must depend on the same levels.
+static bool FeaturesImplied(const archsim::ProcessorFeatureSet &owner, const archsim::ProcessorFeatureSet &target)
+{
+	for(const auto &feature : target) {
+		auto match = std::find_if(owner.begin(), owner.end(), [&feature](const std::pair<const uint32_t, uint32_t> &owner_feature) {
+			return owner_feature.first == feature.first;
+		});
+
+		if(match == owner.end() || match->second != feature.second) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void BlockChainTable::Insert(Address phys_addr, const BlockTranslation &txln, const std::vector<ChainSlot> &slots, const BlockProfile &profile)
+{
+	block_txln_fn fn = txln.GetFn();
+
+	auto &chained = translations_[fn];
+	chained.PhysAddr = phys_addr;
+	chained.Features = txln.GetFeatures();
+	chained.MultiPage = txln.GetExtraPageCount() > 0;
+
+	for(const auto &slot : slots) {
+		Link link;
+		link.Slot = slot;
+		link.Target = Address(phys_addr.GetPageBase() | (slot.TargetPC & Address::PageMask));
+		link.Linked = nullptr;
+		chained.Links.push_back(link);
+
+		auto &waiting = waiting_[link.Target];
+		if(std::find(waiting.begin(), waiting.end(), fn) == waiting.end()) {
+			waiting.push_back(fn);
+		}
+	}
+
+	// Link this translation to any successors which have already been
+	// translated...
+	for(auto &link : chained.Links) {
+		auto target = profile.Get(link.Target, chained.Features);
+		if(target.GetFn() != nullptr) {
+			linkSlot(fn, chained, link, target.GetFn());
+		}
+	}
+
+	// ...and any translations which were waiting for this one.
+	auto waiting = waiting_.find(phys_addr);
+	if(waiting != waiting_.end()) {
+		for(auto owner : waiting->second) {
+			auto &owner_chained = translations_.at(owner);
+			for(auto &link : owner_chained.Links) {
+				if(link.Target == phys_addr) {
+					linkSlot(owner, owner_chained, link, fn);
+				}
+			}
+		}
+	}
+}
+
+void BlockChainTable::Retire(block_txln_fn fn)
+{
+	auto chained = translations_.find(fn);
+	if(chained == translations_.end()) {
+		return;
+	}
+
+	// Other translations must no longer jump into this one...
+	auto waiting = waiting_.find(chained->second.PhysAddr);
+	if(waiting != waiting_.end()) {
+		for(auto owner : waiting->second) {
+			for(auto &link : translations_.at(owner).Links) {
+				if(link.Linked == fn) {
+					unlinkSlot(owner, link);
+				}
+			}
+		}
+	}
+
+	// ...and since it might still be running, it must no longer jump into
+	// any others.
+	for(auto &link : chained->second.Links) {
+		unlinkSlot(fn, link);
+
+		auto &targets = waiting_[link.Target];
+		targets.erase(std::remove(targets.begin(), targets.end(), fn), targets.end());
+		if(targets.empty()) {
+			waiting_.erase(link.Target);
+		}
+	}
+
+	translations_.erase(chained);
+}
+
+void BlockChainTable::linkSlot(block_txln_fn owner, const ChainedTranslation &chained, Link &link, block_txln_fn target)
+{
+	auto target_chained = translations_.find(target);
+	if(target_chained == translations_.end()) {
+		return;
+	}
+
+	if(target_chained->second.MultiPage && target != owner) {
+		LC_DEBUG2(LogBlockChaining) << "Not chaining to " << link.Target << ": spans multiple pages";
+		return;
+	}
+
+	if(!FeaturesImplied(chained.Features, target_chained->second.Features)) {
+		LC_DEBUG2(LogBlockChaining) << "Not chaining to " << link.Target << ": features differ";
+		return;
+	}
+
+	if(!PatchSlot(owner, link.Slot.Offset, (const void*)target)) {
+		LC_DEBUG2(LogBlockChaining) << "Not chaining to " << link.Target << ": out of range";
+		return;
+	}
+
+	if(link.Linked == nullptr) {
+		link_count_++;
+	}
+	link.Linked = target;
+}
+
+void BlockChainTable::unlinkSlot(block_txln_fn owner, Link &link)
+{
+	if(link.Linked == nullptr) {
+		return;
+	}
+
+	PatchSlot(owner, link.Slot.Offset, (const uint8_t*)owner + link.Slot.ExitOffset);
+	link.Linked = nullptr;
+	link_count_--;
+}
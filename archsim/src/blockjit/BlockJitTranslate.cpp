@@ -19,6 +19,7 @@
 #include "blockjit/translation-context.h"
 
 #include "translate/jit_funs.h"
+#include "translate/profile/CodeRegionTracker.h"
 #include "translate/profile/Region.h"
 
 #include "util/LogContext.h"
@@ -27,6 +28,7 @@
 #include "blockjit/PerfMap.h"
 #include "blockjit/IRPrinter.h"
 
+#include <algorithm>
 #include <stdio.h>
 
 UseLogContext(LogTranslate);
@@ -93,8 +95,12 @@ bool BaseBlockJITTranslate::translate_block(archsim::core::thread::ThreadInstanc
 	delete _decode_ctx;
 
 	// Fill in the output translation data structure with the translated
-	// function and feature vector
+	// function, feature vector and any other pages it continues onto
 	AttachFeaturesTo(out_txln);
+	out_txln.SetCodeLines(_entry_code_lines);
+	for(const auto &page : _trace_pages) {
+		out_txln.AddExtraPage(page.VirtualOffset, page.Physical, page.CodeLines);
+	}
 
 	timer.tick("compile");
 
@@ -202,6 +208,11 @@ bool BaseBlockJITTranslate::build_block(archsim::core::thread::ThreadInstance *p
 	// to a branch that we can't resolve statically
 	if(!_decode)_decode = processor->GetArch().GetISA(processor->GetModeID()).GetNewDecode();
 	if(!_jumpinfo)_jumpinfo = processor->GetArch().GetISA(processor->GetModeID()).GetNewJumpInfo();
+	_entry_pc = block_address;
+	_trace_pages.clear();
+	_entry_code_lines = 0;
+	_trace_length = 0;
+
 	std::unordered_set<Address> block_heads;
 	return emit_block(processor, block_address, builder, block_heads);
 }
@@ -293,9 +304,100 @@ bool BaseBlockJITTranslate::can_merge_jump(archsim::core::thread::ThreadInstance
 	if(info.IsIndirect) return false;
 	if(info.IsConditional) return false;
 
-	// Return true if this jump lands within the same page as it starts
-	if(info.JumpTarget.GetPageIndex() == pc.GetPageIndex()) return true;
-	else return false;
+	// Whether the target's page can be included is up to the caller
+	return true;
+}
+
+bool BaseBlockJITTranslate::predict_branch(BaseDecode *decode, Address pc, Address &predicted, Address &other)
+{
+	assert(decode->GetEndOfBlock());
+
+	if(!_supportChaining || !_isa_mode_valid || !_features_valid) {
+		return false;
+	}
+
+	JumpInfo info;
+	_jumpinfo->GetJumpInfo(decode, pc, info);
+
+	// Only direct, conditional jumps have two successors which are known
+	// now. Calls and returns are left to the target cache.
+	if(!info.IsJump || info.IsIndirect || info.IsCall || info.IsReturn) return false;
+	if(!info.IsConditional && !decode->GetIsPredicated()) return false;
+
+	// A jump to itself (e.g. a repeated string instruction) is not worth
+	// tracing through
+	if(info.JumpTarget == pc) return false;
+
+	// There is no profile when a block is first translated, so use a static
+	// prediction: backward jumps (usually loops) are taken, and forward
+	// jumps are not.
+	Address fallthrough = pc + decode->Instr_Length;
+	if(info.JumpTarget < pc) {
+		predicted = info.JumpTarget;
+		other = fallthrough;
+	} else {
+		predicted = fallthrough;
+		other = info.JumpTarget;
+	}
+
+	return true;
+}
+
+bool BaseBlockJITTranslate::can_continue_trace(archsim::core::thread::ThreadInstance *processor, Address pc)
+{
+	if(_trace_length >= archsim::options::JitTraceLength) {
+		return false;
+	}
+
+	if(pc.GetPageBase() == _entry_pc.GetPageBase()) {
+		return true;
+	}
+
+	for(const auto &page : _trace_pages) {
+		if(_entry_pc.PageBase() + page.VirtualOffset == pc.PageBase()) {
+			return true;
+		}
+	}
+
+	uint32_t max_pages = std::min<uint32_t>(archsim::options::JitTracePages, 1 + archsim::blockjit::BlockTranslation::kMaxExtraPages);
+	if(_trace_pages.size() + 1 >= max_pages) {
+		return false;
+	}
+
+	// The page must be mapped now, without faulting, since the trace is only
+	// followed if execution actually reaches it.
+	Address phys_page (0);
+	if(processor->GetFetchMI().PerformTranslation(pc.PageBase(), phys_page, false, true, false) != archsim::TranslationResult::OK) {
+		return false;
+	}
+
+	LC_DEBUG3(LogBlockJit) << "Continuing block " << _entry_pc << " onto page " << pc.PageBase() << " (" << phys_page.PageBase() << ")";
+	_trace_pages.push_back({pc.GetPageBase() - _entry_pc.GetPageBase(), phys_page.PageBase(), 0});
+	return true;
+}
+
+void BaseBlockJITTranslate::mark_code(Address pc, uint32_t length)
+{
+	// Record which cache lines each instruction was decoded from, so that
+	// writes to other lines of the same pages don't invalidate the block. An
+	// instruction may run onto the next page.
+	while(length > 0) {
+		uint32_t size = std::min<uint32_t>(length, Address::PageSize - pc.GetPageOffset());
+		uint64_t lines = archsim::translate::profile::CodeRegionTracker::GetLineMask(pc.GetPageOffset(), size);
+
+		if(pc.GetPageBase() == _entry_pc.GetPageBase()) {
+			_entry_code_lines |= lines;
+		} else {
+			for(auto &page : _trace_pages) {
+				if(_entry_pc.PageBase() + page.VirtualOffset == pc.PageBase()) {
+					page.CodeLines |= lines;
+				}
+			}
+		}
+
+		pc += size;
+		length -= size;
+	}
 }
 
 archsim::Address BaseBlockJITTranslate::get_jump_target(archsim::core::thread::ThreadInstance *processor, BaseDecode *decode, Address pc)
@@ -310,7 +412,7 @@ bool BaseBlockJITTranslate::emit_block(archsim::core::thread::ThreadInstance *pr
 {
 
 	Address pc = block_address;
-	uint32_t pc_page = block_address.GetPageBase();
+	uint64_t pc_page = block_address.GetPageBase();
 
 	uint32_t phys_page = 0;
 	if(archsim::options::ProfilePcFreq || _supportProfiling) {
@@ -340,26 +442,61 @@ bool BaseBlockJITTranslate::emit_block(archsim::core::thread::ThreadInstance *pr
 	// getting too large
 	uint32_t max_count = 32;
 
-	// make sure that we stay on the same page, and that the isa mode or feature vector doesn't
-	// change unexpectedly
-	while(pc.GetPageBase() == pc_page && count < max_count && _isa_mode_valid && _features_valid) {
+	// make sure that we only continue onto pages which the translation can
+	// span, and that the isa mode or feature vector doesn't change unexpectedly
+	while(count < max_count && _isa_mode_valid && _features_valid) {
+		if(count > 0) {
+			if(pc.GetPageBase() != pc_page && (!_supportChaining || !can_continue_trace(processor, pc))) {
+				break;
+			}
+			if(_trace_length >= archsim::options::JitTraceLength) {
+				break;
+			}
+			pc_page = pc.GetPageBase();
+		}
+
 		count++;
+		_trace_length++;
 
 		// emit the IR for the instruction pointed to by the virtual PC
 		if(!emit_instruction(processor, pc, _decode, builder)) {
 			success = false;
 			break;
 		}
+		mark_code(pc, _decode->Instr_Length);
 
 		// If this instruction is an end of block, potentially merge the next block
 		if(_decode->GetEndOfBlock()) {
+			Address predicted = 0_ga, other = 0_ga;
+
 			if(can_merge_jump(processor, _decode, pc)) {
 				Address target = get_jump_target(processor, _decode, pc);
-				if(!block_heads.count(target)) {
+				if(!block_heads.count(target) && can_continue_trace(processor, target)) {
 					block_heads.insert(target);
 //					if(archsim::options::Verify && archsim::options::VerifyBlocks) builder.verify(IROperand::pc(pc.Get()));
 					return emit_block(processor, target, builder, block_heads);
 				}
+			} else if(predict_branch(_decode, pc, predicted, other) && !block_heads.count(predicted) && can_continue_trace(processor, predicted)) {
+				// Continue along the predicted path, and leave the
+				// translation if the jump went the other way.
+				const auto &pc_desc = processor->GetArch().GetRegisterFileDescriptor().GetTaggedEntry("PC");
+				uint32_t pc_size = pc_desc.GetEntrySize();
+
+				IRRegId next_pc = builder.alloc_reg(pc_size);
+				IRRegId on_trace = builder.alloc_reg(1);
+				IRBlockId stay_block = builder.alloc_block();
+				IRBlockId leave_block = builder.alloc_block();
+
+				builder.ldreg(IROperand::const32(pc_desc.GetOffset()), IROperand::vreg(next_pc, pc_size));
+				builder.cmpeq(IROperand::vreg(next_pc, pc_size), pc_size == 8 ? IROperand::const64(predicted.Get()) : IROperand::const32(predicted.Get()), IROperand::vreg(on_trace, 1));
+				builder.branch(IROperand::vreg(on_trace, 1), IROperand::block(stay_block), IROperand::block(leave_block));
+
+				builder.SetBlock(leave_block);
+				emit_side_exit(pc, other, builder);
+
+				builder.SetBlock(stay_block);
+				block_heads.insert(predicted);
+				return emit_block(processor, predicted, builder, block_heads);
 			}
 
 			break;
@@ -392,55 +529,52 @@ bool BaseBlockJITTranslate::emit_chain(archsim::core::thread::ThreadInstance *pr
 		_jumpinfo->GetJumpInfo(decode, pc, jump_info);
 		fallthrough_pc = pc + decode->Instr_Length;
 
+		uint8_t kind = IRInstruction::DISPATCH_DIRECT;
+
+		// A predicated call might not be taken, and then nothing returns to
+		// the next instruction.
+		bool is_call = jump_info.IsCall && !decode->GetIsPredicated();
+		if(is_call) {
+			kind |= IRInstruction::DISPATCH_CALL;
+		}
+		if(jump_info.IsReturn) {
+			kind |= IRInstruction::DISPATCH_RETURN;
+		}
+
 		// Can only chain on a direct jump
 		if(!jump_info.IsIndirect) {
-			auto target_page = jump_info.JumpTarget.GetPageBase();
-			auto fallthrough_page = fallthrough_pc.GetPageBase();
-
-			// Can only chain if the target of the jump is on the same page as the rest of the block
-			if(target_page == pc.GetPageBase()) {
-				// If instruction is not predicated, don't use a fallthrough pc
+			target_pc = jump_info.JumpTarget;
+
+			// Can only chain if the target of the jump is on the page that
+			// the translation starts on
+			if(target_pc.GetPageBase() == _entry_pc.GetPageBase()) {
+				// If instruction is not predicated, or falls through onto
+				// another page, don't use a fallthrough pc. A call's
+				// fallthrough is where it returns to instead.
 				// XXX ARM HAX
-				if(!decode->GetIsPredicated()) {
+				if(!is_call && (!decode->GetIsPredicated() || fallthrough_pc.GetPageBase() != _entry_pc.GetPageBase())) {
 					fallthrough_pc = 0_ga;
 				}
 
-				//need to translate target and fallthrough PCs
-
-				Address target_ppc(0), fallthrough_ppc(0);
-				if(target_pc != Address::NullPtr) processor->GetFetchMI().PerformTranslation(target_pc, target_ppc, false, true, false);
-				if(fallthrough_pc != Address::NullPtr) processor->GetFetchMI().PerformTranslation(fallthrough_pc, fallthrough_ppc, false, true, false);
-
-				archsim::blockjit::BlockTranslation target_fn;
-				archsim::blockjit::BlockTranslation fallthrough_fn;
-
-				block_txln_fn target_fn_ptr = nullptr, fallthrough_fn_ptr = nullptr;
-
-				if(target_ppc.Get() != 0) {
-//					processor->GetTranslatedBlock(target_ppc, GetProcessorFeatures(), target_fn);
-				}
-				if(fallthrough_ppc.Get() != 0) {
-//					processor->GetTranslatedBlock(fallthrough_ppc, GetProcessorFeatures(), fallthrough_fn);
-				}
-
-				// actually get functions
-				if(fallthrough_fn.IsValid(GetProcessorFeatures())) {
-					fallthrough_fn_ptr = fallthrough_fn.GetFn();
-				}
-
-				if(target_fn.IsValid(GetProcessorFeatures())) {
-					target_fn_ptr = target_fn.GetFn();
-				}
+				// The jumps are linked to the target and fallthrough
+				// translations when they are registered with the engine.
+				builder.dispatch(IROperand::const32(target_pc.Get()), IROperand::const32(fallthrough_pc.Get()), IROperand::const8(kind), IROperand::const64(pc.Get()), IROperand::const64(_entry_pc.Get()));
+				return true;
+			}
+		}
 
-				if(fallthrough_fn_ptr != nullptr || target_fn_ptr != nullptr) {
-					builder.dispatch(IROperand::const32(target_pc.Get()), IROperand::const32(fallthrough_pc.Get()), IROperand::const64((uint64_t)target_fn_ptr), IROperand::const64((uint64_t)fallthrough_fn_ptr));
-					return true;
-				}
-			} else {
-//				fprintf(stderr, "*** Couldn't chain due to cross page jump\n");
+		// Otherwise, the next PC is only known at run time, so look it up in
+		// the thread's target cache. This also covers jumps to other pages.
+		// Other kinds of end of block (e.g. exceptions) still return to the
+		// execution engine.
+		if(jump_info.IsJump && !archsim::options::JitDisableTargetCache) {
+			if(!is_call) {
+				fallthrough_pc = 0_ga;
 			}
-		} else {
-//			fprintf(stderr, "*** Couldn't chain due to indirect jump\n");
+
+			kind |= IRInstruction::DISPATCH_INDIRECT;
+			builder.dispatch(IROperand::const32(0), IROperand::const32(fallthrough_pc.Get()), IROperand::const8(kind), IROperand::const64(pc.Get()), IROperand::const64(_entry_pc.Get()));
+			return true;
 		}
 	}
 	// If we couldn't find any way to chain, then just return
@@ -448,6 +582,19 @@ bool BaseBlockJITTranslate::emit_chain(archsim::core::thread::ThreadInstance *pr
 	return true;
 }
 
+void BaseBlockJITTranslate::emit_side_exit(archsim::Address site_pc, archsim::Address next_pc, captive::shared::IRBuilder &builder)
+{
+	// Leave a trace for a PC which is known now, chaining directly to it if
+	// possible
+	if(next_pc.GetPageBase() == _entry_pc.GetPageBase()) {
+		builder.dispatch(IROperand::const32(next_pc.Get()), IROperand::const32(0), IROperand::const8(IRInstruction::DISPATCH_DIRECT), IROperand::const64(site_pc.Get()), IROperand::const64(_entry_pc.Get()));
+	} else if(!archsim::options::JitDisableTargetCache) {
+		builder.dispatch(IROperand::const32(0), IROperand::const32(0), IROperand::const8(IRInstruction::DISPATCH_INDIRECT), IROperand::const64(site_pc.Get()), IROperand::const64(_entry_pc.Get()));
+	} else {
+		builder.ret();
+	}
+}
+
 bool BaseBlockJITTranslate::compile_block(archsim::core::thread::ThreadInstance *cpu, archsim::Address block_address, captive::arch::jit::TranslationContext &ctx, archsim::blockjit::BlockTranslation &fn, wulib::MemAllocator &allocator)
 {
 	BlockCompiler compiler (ctx, block_address.Get(), allocator, false, true);
@@ -462,6 +609,8 @@ bool BaseBlockJITTranslate::compile_block(archsim::core::thread::ThreadInstance
 
 	auto lowering = captive::arch::jit::lowering::NativeLowering(ctx, allocator, cpu->GetArch(), cpu->GetStateBlock().GetDescriptor(), result);
 	fn.SetFn(lowering.Function);
+	_last_relocations = lowering.Relocations;
+	_last_chain_slots = lowering.ChainSlots;
 
 	if(dump) {
 		ctx.trim();
@@ -12,6 +12,7 @@
 #include "blockjit/BlockProfile.h"
 #include "util/LogContext.h"
 
+#include <algorithm>
 #include <fstream>
 
 //TODO: this should probably have a parent
@@ -39,121 +40,275 @@ void BlockTranslation::Dump(const std::string &filename)
 }
 
 
-BlockPageProfile::BlockPageProfile(wulib::MemAllocator &allocator) : _allocator(allocator)
+BlockPageProfile::BlockPageProfile() : _dirty_lines(0)
 {
-	_valid = false;
-	_dirty = false;
-	for(auto &i : _table) i = nullptr;
+	for(auto &i : _table) i.store(nullptr, std::memory_order_relaxed);
 }
 
 BlockPageProfile::~BlockPageProfile()
 {
+	for(auto &i : _table) {
+		table_chunk_t *chunk = i.load(std::memory_order_relaxed);
+		if(chunk == nullptr) continue;
 
+		for(auto &txln : *chunk) {
+			delete txln.load(std::memory_order_relaxed);
+		}
+		delete chunk;
+	}
 }
 
-void BlockPageProfile::Insert(Address address, const BlockTranslation &txln)
+BlockPageProfile::table_chunk_t &BlockPageProfile::getChunk(Address address)
 {
-	// We shouldn't be translating any code on a page which is dirty
-	if(_dirty) Invalidate();
+	auto &ptr = getChunkPtr(address);
+	table_chunk_t *chunk = ptr.load(std::memory_order_relaxed);
+
+	// Chunks are never freed while the profile is alive, since a concurrent
+	// reader might still be looking at them.
+	if(chunk == nullptr) {
+		chunk = new table_chunk_t();
+		for(auto &i : *chunk) i.store(nullptr, std::memory_order_relaxed);
+		ptr.store(chunk, std::memory_order_release);
+	}
 
-	if(!_valid) {
+	return *chunk;
+}
 
-		for(auto &i : _table) {
-			delete i;
-			i = nullptr;
-		}
+void BlockPageProfile::Insert(Address address, BlockTranslation *txln, std::vector<BlockTranslation*> &retired)
+{
+	auto *old_txln = getChunk(address)[getChunkIndex(address)].exchange(txln, std::memory_order_acq_rel);
+	if(old_txln != nullptr) {
+		retired.push_back(old_txln);
+	}
+}
+
+void BlockPageProfile::Invalidate(std::vector<BlockTranslation*> &retired, uint64_t lines)
+{
+	_dirty_lines.store(0, std::memory_order_relaxed);
 
-		_valid = true;
+	for(auto &i : _table) {
+		table_chunk_t *chunk = i.load(std::memory_order_relaxed);
+		if(chunk == nullptr) continue;
+
+		for(auto &entry : *chunk) {
+			auto *txln = entry.load(std::memory_order_relaxed);
+			if(txln != nullptr && (txln->GetCodeLines() & lines) != 0) {
+				entry.store(nullptr, std::memory_order_release);
+				retired.push_back(txln);
+			}
+		}
 	}
+}
 
-	// Get the page offset of the address
-	uint32_t address_offset = address.GetPageOffset();
+void BlockPageProfile::Remove(Address address, block_txln_fn fn, std::vector<BlockTranslation*> &retired)
+{
+	table_chunk_t *chunk = getChunkPtr(address).load(std::memory_order_relaxed);
+	if(chunk == nullptr) return;
+
+	auto &entry = (*chunk)[getChunkIndex(address)];
+	BlockTranslation *txln = entry.load(std::memory_order_relaxed);
+	if(txln != nullptr && txln->GetFn() == fn) {
+		entry.store(nullptr, std::memory_order_release);
+		retired.push_back(txln);
+	}
+}
 
-	// XXX ARM HAX
-	uint32_t index = address_offset >> kInstructionAlignment;
+const uint32_t BlockTranslation::kMaxExtraPages;
+const uint64_t BlockTranslation::kAllLines;
 
-//	assert(Get(address).GetFn() == nullptr);
-	if(Get(address).GetFn() != nullptr) {
-		InvalidateTxln(address);
+BlockProfile::BlockProfile(wulib::MemAllocator &allocator) : _allocator(allocator), code_size_(0), has_retired_(false)
+{
+	_page_profiles = new std::atomic<BlockPageProfile*>[kProfileCount];
+	for(size_t i = 0; i < kProfileCount; ++i) {
+		_page_profiles[i].store(nullptr, std::memory_order_relaxed);
 	}
-	_txlns.insert(txln.GetFn());
-	Get(address) = txln;
 }
 
-void BlockPageProfile::InvalidateTxln(Address address)
+BlockProfile::~BlockProfile()
 {
-	auto &txln = Get(address);
+	for(size_t i = 0; i < kProfileCount; ++i) {
+		delete _page_profiles[i].load(std::memory_order_relaxed);
+	}
+	delete [] _page_profiles;
 
-	auto fn = txln.GetFn();
-	if(fn) {
-		_allocator.Free((void*)fn);
-		_txlns.erase(fn);
+	for(auto &i : _retired) {
+		delete i.txln;
 	}
+}
 
-	txln.Invalidate();
+BlockPageProfile &BlockProfile::getProfile(Address address)
+{
+	auto &ptr = _page_profiles[address.GetPageIndex()];
+	BlockPageProfile *profile = ptr.load(std::memory_order_relaxed);
+	if(profile == nullptr) {
+		profile = new BlockPageProfile();
+		ptr.store(profile, std::memory_order_release);
+	}
+	return *profile;
 }
 
-void BlockPageProfile::Invalidate()
+void BlockProfile::retire(std::vector<BlockTranslation*> &txlns, uint64_t epoch)
 {
-	_valid = false;
-	_dirty = false;
-	for(auto i : _txlns) {
-		assert(i != nullptr);
-		_allocator.Free((void*)i);
+	for(auto txln : txlns) {
+		_chains.Retire(txln->GetFn());
+
+		for(uint32_t i = 0; i < txln->GetExtraPageCount(); ++i) {
+			auto spanning = _spanning.find(txln->GetExtraPage(i).Physical);
+			if(spanning == _spanning.end()) continue;
+
+			auto &entries = spanning->second;
+			auto fn = txln->GetFn();
+			entries.erase(std::remove_if(entries.begin(), entries.end(), [fn](const SpanningTranslation &entry) {
+				return entry.Fn == fn;
+			}), entries.end());
+			if(entries.empty()) {
+				_spanning.erase(spanning);
+			}
+		}
+
+		code_size_.fetch_sub(txln->GetSize(), std::memory_order_relaxed);
+		_retired.push_back({epoch, txln});
 	}
 
-	for(auto &i : _table) {
-		if(i) delete i;
-		i = nullptr;
+	if(!_retired.empty()) {
+		has_retired_.store(true, std::memory_order_release);
 	}
-	_txlns.clear();
 }
 
-BlockProfile::BlockProfile(wulib::MemAllocator &allocator) : _allocator(allocator), code_size_(0)
+size_t BlockProfile::Insert(Address address, const BlockTranslation &txln, uint64_t retire_epoch, const std::vector<ChainSlot> &chain_slots)
 {
-	_table_pages_dirty.set();
-	for(auto &i : _page_profiles) {
-		i = nullptr;
+	LC_DEBUG2(LogBlockProfile) << "Inserting " << std::hex << address.Get() << " into the block profile";
+
+	std::lock_guard<std::mutex> lock(_lock);
+
+	// A translation which is replaced might still be in use by another
+	// thread, so it cannot be freed until after the next flush.
+	std::vector<BlockTranslation*> retired;
+	auto &profile = getProfile(address);
+
+	// We shouldn't be translating any code on a page which is dirty
+	if(profile.IsDirty()) {
+		invalidateDirty(address.PageBase(), profile, retired);
 	}
-	Invalidate();
+
+	profile.Insert(address, new BlockTranslation(txln), retired);
+	code_size_.fetch_add(txln.GetSize(), std::memory_order_relaxed);
+
+	for(uint32_t i = 0; i < txln.GetExtraPageCount(); ++i) {
+		const auto &page = txln.GetExtraPage(i);
+		_spanning[page.Physical].push_back({address, txln.GetFn(), page.CodeLines});
+	}
+
+	size_t retired_size = 0;
+	for(auto *i : retired) {
+		retired_size += i->GetSize();
+	}
+
+	retire(retired, retire_epoch);
+	_chains.Insert(address, txln, chain_slots, *this);
+
+	return retired_size;
 }
 
-void BlockProfile::Insert(Address address, const BlockTranslation &txln)
+void BlockProfile::invalidateSpanning(Address page, uint64_t lines, std::vector<BlockTranslation*> &retired)
 {
-	// Get the page index of the address
-	LC_DEBUG2(LogBlockProfile) << "Inserting " << std::hex << address.Get() << " into the block profile";
+	auto spanning = _spanning.find(page.PageBase());
+	if(spanning == _spanning.end()) return;
 
-	code_size_ += txln.GetSize();
+	for(const auto &entry : spanning->second) {
+		if((entry.CodeLines & lines) == 0) continue;
+
+		auto profile = _page_profiles[entry.Entry.GetPageIndex()].load(std::memory_order_relaxed);
+		if(profile != nullptr) {
+			profile->Remove(entry.Entry, entry.Fn, retired);
+		}
+	}
+}
 
-	getProfile(address).Insert(address, txln);
+void BlockProfile::invalidateDirty(Address page, BlockPageProfile &profile, std::vector<BlockTranslation*> &retired)
+{
+	// Only the translations decoded from lines which have been written to
+	// need to go
+	uint64_t lines = profile.GetDirtyLines();
+	profile.Invalidate(retired, lines);
+	invalidateSpanning(page, lines, retired);
 }
 
-void BlockProfile::Invalidate()
+void BlockProfile::Invalidate(uint64_t epoch)
 {
 	LC_DEBUG1(LogBlockProfile) << "Performing a full invalidation";
-	for(auto &i : _page_profiles) {
-		if(i != nullptr) {
-			i->Invalidate();
+
+	std::lock_guard<std::mutex> lock(_lock);
+
+	std::vector<BlockTranslation*> retired;
+	for(size_t i = 0; i < kProfileCount; ++i) {
+		auto profile = _page_profiles[i].load(std::memory_order_relaxed);
+		if(profile != nullptr) {
+			profile->Invalidate(retired);
 		}
 	}
+	_dirty_pages.clear();
+
+	retire(retired, epoch);
+}
 
-	code_size_ = 0;
-	_table_pages_dirty.reset();
+void BlockProfile::InvalidatePage(Address address, uint64_t epoch)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+
+	std::vector<BlockTranslation*> retired;
+	getProfile(address).Invalidate(retired);
+	invalidateSpanning(address, BlockTranslation::kAllLines, retired);
+	retire(retired, epoch);
 }
 
-void BlockProfile::InvalidatePage(Address address)
+void BlockProfile::MarkPageDirty(Address addr, uint64_t lines)
 {
-	getProfile(address).Invalidate();
+	std::lock_guard<std::mutex> lock(_lock);
+
+	auto &profile = getProfile(addr);
+	bool was_dirty = profile.IsDirty();
+	profile.MakeDirty(lines);
+	if(was_dirty) return;
+
+	LC_DEBUG1(LogBlockProfile) << "Marking page " << std::hex << addr.GetPageBase() << " as dirty";
+	_dirty_pages.push_back({addr.PageBase(), &profile});
 }
 
-void BlockProfile::GarbageCollect()
+bool BlockProfile::GarbageCollect(uint64_t epoch)
 {
-	if(_dirty_pages.size()) {
-		LC_DEBUG1(LogBlockProfile) << "Performing a garbage collection";
+	std::lock_guard<std::mutex> lock(_lock);
+
+	if(_dirty_pages.empty()) {
+		return false;
 	}
+
+	LC_DEBUG1(LogBlockProfile) << "Performing a garbage collection";
+
+	std::vector<BlockTranslation*> retired;
 	for(auto &i : _dirty_pages) {
-		i.second->Invalidate();
+		invalidateDirty(i.first, *i.second, retired);
 	}
-
 	_dirty_pages.clear();
+
+	retire(retired, epoch);
+	return true;
+}
+
+void BlockProfile::Reclaim(uint64_t safe_epoch)
+{
+	std::lock_guard<std::mutex> lock(_lock);
+
+	auto keep = _retired.begin();
+	for(auto &i : _retired) {
+		if(i.epoch <= safe_epoch) {
+			_allocator.Free((void*)i.txln->GetFn());
+			delete i.txln;
+		} else {
+			*keep++ = i;
+		}
+	}
+	_retired.erase(keep, _retired.end());
+
+	has_retired_.store(!_retired.empty(), std::memory_order_release);
 }
@@ -0,0 +1,29 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "blockjit/IndirectTargetCache.h"
+
+#include <cstring>
+
+using namespace archsim::blockjit;
+
+const uint32_t IndirectTargetCache::kSiteBits;
+const uint32_t IndirectTargetCache::kSiteCount;
+const uint32_t IndirectTargetCache::kSiteWays;
+const uint32_t IndirectTargetCache::kReturnStackSize;
+const uint32_t IndirectTargetCache::kEntryShift;
+
+void IndirectTargetCache::Reset()
+{
+	// As in the block cache, an all-ones tag never matches a PC
+	for(auto &site : sites_) {
+		for(auto &entry : site) {
+			entry = { ~0ULL, nullptr, kInvalidGeneration, 0 };
+		}
+	}
+	for(auto &entry : return_stack_) {
+		entry = { ~0ULL, nullptr, kInvalidGeneration, 0 };
+	}
+	return_top_ = 0;
+
+	generation_ = kInvalidGeneration + 1;
+}
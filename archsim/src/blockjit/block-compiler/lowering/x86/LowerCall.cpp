@@ -54,7 +54,7 @@ bool LowerCall::Lower(const captive::shared::IRInstruction *&insn)
 	}
 
 	// Load the address of the target function into a temporary, and perform an indirect call.
-	Encoder().mov(target->value, BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)target->value, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	if(rval->is_vreg()) {
@@ -21,7 +21,10 @@ bool LowerCount::Lower(const captive::shared::IRInstruction *&insn)
 	const IROperand *counter = &insn->operands[0];
 	const IROperand *amount = &insn->operands[1];
 
+	// Translations are shared between threads, so the counter may be
+	// updated by several threads at once
 	Encoder().mov(counter->value, BLKJIT_ARG0(8));
+	Encoder().lock();
 	Encoder().add8(amount->value, X86Memory::get(BLKJIT_ARG0(8)));
 
 	insn++;
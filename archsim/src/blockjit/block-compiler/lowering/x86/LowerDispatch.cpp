@@ -13,94 +13,254 @@
 #include "blockjit/translation-context.h"
 #include "blockjit/block-compiler/lowering/x86/X86BlockjitABI.h"
 
+#include "blockjit/BlockCache.h"
+#include "blockjit/IndirectTargetCache.h"
+#include "util/SimOptions.h"
+
+#include <cstddef>
+
 using namespace captive::arch::jit::lowering::x86;
 using namespace captive::shared;
+using archsim::blockjit::IndirectTargetCache;
 
 bool LowerDispatch::Lower(const captive::shared::IRInstruction *&insn)
 {
-	UNIMPLEMENTED;
-//	const auto *cpu = GetCompiler().get_cpu();
-//	uint32_t pc_offset = cpu->GetRegisterByTag("PC")->Offset;
-//
-//	// If we shouldn't dispatch, just do a return instead
-//	if(!GetCompiler().emit_chaining_logic) {
-//		LowerRet r;
-//		r.SetContexts(GetLoweringContext(),GetTranslationContext(), GetCompiler());
-//		r.Lower(insn);
-//		// insn incremented by return lowering
-//		return true;
-//	}
-//
-//	// Dispatch instruction can have three general forms:
-//	// 1. All operands populated - instruction is a predicated jump and both target and fallthrough are compiled
-//	// 2. Fallthrough function not populated - instruction is a predicated jump and only the target is compiled
-//	// 3. Fallthrough PC and function not populated - instruction is a non predicated jump
-//
-//	const IROperand &target_pc = insn->operands[0];
-//	const IROperand &fallthrough_pc = insn->operands[1];
-//	const IROperand &target_fn = insn->operands[2];
-//	const IROperand &fallthrough_fn = insn->operands[3];
-//
-//	assert(target_fn.value != 0 || fallthrough_fn.value != 0);
-//
-//	// We need to do some stuff no matter what kind of dispatch we're doing
-//	// 1. fix up stack
-//	// 2. make sure we don't realloc halfway through emitting dispatch code and wreck the offsets
-//	// 3. do an interrupt check
-//
-//	if(GetLoweringContext().GetStackFrameSize()) {
-//		Encoder().add(GetLoweringContext().GetStackFrameSize(), REG_RSP);
-//	}
-//
-////	Encoder().int3();
-//
-//	// Decrement iteration count
-//	Encoder().cmp4(0, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_pending_actions));
-//
-//	Encoder().ensure_extra_buffer(32);
-//
-//	// If iteration count is nonzero...
-//	uint32_t iteration_count_zero;
-//	Encoder().jne_reloc(iteration_count_zero);
-//
-//	uint32_t pc_not_target = 0;
-//	uint32_t fallthrough_not_target = 0;
-//	if(target_fn.value != 0) {
-//		// compare PC against target PC...
-//		Encoder().cmp4((uint32_t)target_pc.value, X86Memory::get(REG_RBP, pc_offset)); // XXX ARM HACK
-//		Encoder().jne_reloc(pc_not_target);
-//		if(archsim::options::Verbose.GetValue()) {
-//			Encoder().add(1, 8, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_chained_target));
-//		}
-//		Encoder().jmp((void*)target_fn.value, REG_R15);
-//	}
-//	if(fallthrough_fn.value != 0) {
-//		// compare PC against target PC...
-//		Encoder().cmp4((uint32_t)fallthrough_pc.value, X86Memory::get(REG_RBP, pc_offset)); // XXX ARM HACK
-//		Encoder().jne_reloc(fallthrough_not_target);
-//		if(archsim::options::Verbose.GetValue()) {
-//			Encoder().add(1, 8, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_chained_fallthrough));
-//		}
-//		Encoder().jmp((void*)fallthrough_fn.value, REG_R15);
-//	}
-//
-//
-//	// fill in jump targets
-//	*(uint32_t*)(Encoder().get_buffer() + iteration_count_zero) = Encoder().current_offset() - iteration_count_zero - 4;
-//	if(fallthrough_not_target != 0) {
-//		*(uint32_t*)(Encoder().get_buffer() + fallthrough_not_target) = Encoder().current_offset() - fallthrough_not_target - 4;
-//	}
-//	if(pc_not_target != 0) {
-//		*(uint32_t*)(Encoder().get_buffer() + pc_not_target) = Encoder().current_offset() - pc_not_target - 4;
-//	}
-//
-//	if(archsim::options::Verbose.GetValue()) {
-//		Encoder().add(1, 8, X86Memory::get(BLKJIT_CPUSTATE_REG, gensim::CpuStateOffsets::CpuState_chained_failed));
-//	}
-//
-//	Encoder().xorr(REG_RAX, REG_RAX);
-//	Encoder().ret();
-//
-//	insn++;
-//	return true;
+	// Dispatch instruction can have three forms:
+	// 1. Both PCs populated - instruction is a predicated jump, to either the target or the fallthrough
+	// 2. Fallthrough PC not populated - instruction is a non predicated jump
+	// 3. Indirect - the next PC is only known at run time
+	//
+	// Each successor of a direct jump gets a chain slot: a jump which
+	// initially goes to the exit path below, and which is linked to the
+	// successor's translation once both have been registered (see
+	// BlockChainTable). Indirect jumps look the next PC up in the thread's
+	// IndirectTargetCache, and then in its block cache.
+	//
+	// A call also pushes its return address (the fallthrough PC) onto the
+	// cache's return stack, along with a chain slot which jumps to the
+	// translation of the return address. A return which finds the same
+	// address on top of the stack can then jump straight back.
+	//
+	// Target cache entries are only used if they were filled in the cache's
+	// current generation, so that it can be flushed without clearing them.
+
+	const IROperand &target_pc = insn->operands[0];
+	const IROperand &fallthrough_pc = insn->operands[1];
+	uint8_t kind = insn->operands[2].value;
+	archsim::Address site_pc (insn->operands[3].value);
+	archsim::Address entry_pc (insn->operands[4].value);
+
+	const auto &pc_entry = GetLoweringContext().GetArchDescriptor().GetRegisterFileDescriptor().GetTaggedEntry("PC");
+	const auto &sbd = GetLoweringContext().GetStateBlockDescriptor();
+
+	bool count_chains = archsim::options::Verbose && sbd.HasEntry("ChainCounters");
+	uint32_t counters_offset = count_chains ? sbd.GetBlockOffset("ChainCounters") : 0;
+
+	// Without a target cache, indirect jumps always exit.
+	bool has_target_cache = sbd.HasEntry("TargetCache");
+	if(!has_target_cache) {
+		kind &= ~(IRInstruction::DISPATCH_CALL | IRInstruction::DISPATCH_RETURN);
+	}
+
+	// The next translation is entered with the same register file and state
+	// block, but with this translation's frame torn down.
+	Encoder().mov(BLKJIT_REGSTATE_REG, REG_RDI);
+	Encoder().mov(BLKJIT_CPUSTATE_REG, REG_RSI);
+	GetLoweringContext().EmitEpilogue();
+
+	if(count_chains) {
+		Encoder().add(1, 8, X86Memory::get(REG_RSI, counters_offset));
+	}
+
+	// Don't chain if the thread has a message waiting, e.g. an interrupt or
+	// an invalidation of its block cache.
+	Encoder().cmp4(0, X86Memory::get(REG_RSI, sbd.GetBlockOffset("MessageWaiting")));
+
+	std::vector<uint32_t> exit_relocs (1);
+	Encoder().jne_reloc(exit_relocs[0]);
+
+	std::vector<archsim::blockjit::ChainSlot> slots;
+	auto emit_slot = [&](uint64_t pc) {
+		// Align the displacement of the jump, so that it can be patched while
+		// other threads are executing it.
+		while((Encoder().current_offset() + 1) & 3) {
+			Encoder().nop();
+		}
+
+		archsim::blockjit::ChainSlot slot;
+		Encoder().jmp_reloc(slot.Offset);
+		slot.TargetPC = pc;
+		slots.push_back(slot);
+		exit_relocs.push_back(slot.Offset);
+
+		return slot.Offset - 1;
+	};
+
+	if(has_target_cache && (kind & (IRInstruction::DISPATCH_INDIRECT | IRInstruction::DISPATCH_CALL))) {
+		Encoder().mov(X86Memory::get(REG_RSI, sbd.GetBlockOffset("TargetCache")), REG_RDX);
+	}
+
+	uint32_t return_stub_reloc = 0;
+	if(kind & IRInstruction::DISPATCH_CALL) {
+		uint32_t return_stack = IndirectTargetCache::GetReturnStackOffset();
+		uint32_t return_top = IndirectTargetCache::GetReturnTopOffset();
+
+		Encoder().mov(X86Memory::get(REG_RDX, return_top), REG_ECX);
+		Encoder().add(1, REG_ECX);
+		Encoder().andd(IndirectTargetCache::kReturnStackSize - 1, REG_ECX);
+		Encoder().mov(REG_ECX, X86Memory::get(REG_RDX, return_top));
+		Encoder().shl(IndirectTargetCache::kEntryShift, REG_RCX);
+
+		Encoder().mov(fallthrough_pc.value, REG_RAX);
+		Encoder().mov(REG_RAX, X86Memory::get(REG_RDX, return_stack, REG_RCX, 1));
+		Encoder().lea_reloc(REG_RAX, return_stub_reloc);
+		Encoder().mov(REG_RAX, X86Memory::get(REG_RDX, return_stack + offsetof(IndirectTargetCache::Entry, ptr), REG_RCX, 1));
+		Encoder().mov(X86Memory::get(REG_RDX, IndirectTargetCache::GetGenerationOffset()), REG_RAX);
+		Encoder().mov(REG_RAX, X86Memory::get(REG_RDX, return_stack + offsetof(IndirectTargetCache::Entry, generation), REG_RCX, 1));
+	}
+
+	if(kind & IRInstruction::DISPATCH_INDIRECT) {
+		if(has_target_cache) {
+			if(pc_entry.GetEntrySize() == 4) {
+				Encoder().mov(X86Memory::get(REG_RDI, pc_entry.GetOffset()), REG_EAX);
+			} else {
+				Encoder().mov(X86Memory::get(REG_RDI, pc_entry.GetOffset()), REG_RAX);
+			}
+
+			Encoder().mov(X86Memory::get(REG_RDX, IndirectTargetCache::GetGenerationOffset()), REG_R11);
+
+			// Pop the return stack, and go back to the caller if it was
+			// pushed by the matching call.
+			if(kind & IRInstruction::DISPATCH_RETURN) {
+				uint32_t return_stack = IndirectTargetCache::GetReturnStackOffset();
+				uint32_t return_top = IndirectTargetCache::GetReturnTopOffset();
+
+				Encoder().mov(X86Memory::get(REG_RDX, return_top), REG_ECX);
+				Encoder().mov(REG_ECX, REG_R8D);
+				Encoder().sub(1, REG_R8D);
+				Encoder().andd(IndirectTargetCache::kReturnStackSize - 1, REG_R8D);
+				Encoder().mov(REG_R8D, X86Memory::get(REG_RDX, return_top));
+				Encoder().shl(IndirectTargetCache::kEntryShift, REG_RCX);
+
+				uint32_t return_mismatch, return_stale;
+				Encoder().cmp(REG_RAX, X86Memory::get(REG_RDX, return_stack, REG_RCX, 1));
+				Encoder().jne_reloc(return_mismatch);
+				Encoder().cmp(REG_R11, X86Memory::get(REG_RDX, return_stack + offsetof(IndirectTargetCache::Entry, generation), REG_RCX, 1));
+				Encoder().jne_reloc(return_stale);
+				Encoder().jmp(X86Memory::get(REG_RDX, return_stack + offsetof(IndirectTargetCache::Entry, ptr), REG_RCX, 1));
+
+				for(auto reloc : { return_mismatch, return_stale }) {
+					*(uint32_t*)(Encoder().get_buffer() + reloc) = Encoder().current_offset() - reloc - 4;
+				}
+			}
+
+			// Try the targets which this site jumped to most recently...
+			uint32_t site = IndirectTargetCache::GetSiteOffset(IndirectTargetCache::GetSiteIndex(site_pc));
+			for(uint32_t way = 0; way < IndirectTargetCache::kSiteWays; ++way) {
+				uint32_t way_offset = site + way * sizeof(IndirectTargetCache::Entry);
+
+				uint32_t way_mismatch, way_stale;
+				Encoder().cmp(REG_RAX, X86Memory::get(REG_RDX, way_offset));
+				Encoder().jne_reloc(way_mismatch);
+				Encoder().cmp(REG_R11, X86Memory::get(REG_RDX, way_offset + offsetof(IndirectTargetCache::Entry, generation)));
+				Encoder().jne_reloc(way_stale);
+				Encoder().jmp(X86Memory::get(REG_RDX, way_offset + offsetof(IndirectTargetCache::Entry, ptr)));
+
+				for(auto reloc : { way_mismatch, way_stale }) {
+					*(uint32_t*)(Encoder().get_buffer() + reloc) = Encoder().current_offset() - reloc - 4;
+				}
+			}
+
+			// ...then the block cache, as the execution engine would. A hit
+			// becomes this site's most recent target.
+			Encoder().mov(X86Memory::get(REG_RSI, sbd.GetBlockOffset("BlockCache")), REG_RCX);
+			Encoder().mov(REG_RAX, REG_R8);
+			if(archsim::blockjit::BlockCache::kInstructionShift) {
+				Encoder().shr(archsim::blockjit::BlockCache::kInstructionShift, REG_R8);
+			}
+			Encoder().andd(archsim::blockjit::BlockCache::kCacheSize - 1, REG_R8);
+			Encoder().shl(archsim::blockjit::BlockCache::kEntryShift, REG_R8);
+
+			uint32_t cache_miss;
+			Encoder().cmp(REG_RAX, X86Memory::get(REG_RCX, 0, REG_R8, 1));
+			Encoder().jne_reloc(cache_miss);
+			exit_relocs.push_back(cache_miss);
+
+			// The entry must also be from the cache's current generation
+			uint32_t generation_miss;
+			Encoder().mov(X86Memory::get(REG_RCX, archsim::blockjit::BlockCache::kGenerationOffset), REG_R10);
+			Encoder().cmp(REG_R10, X86Memory::get(REG_RCX, offsetof(archsim::blockjit::BlockCacheEntry, generation), REG_R8, 1));
+			Encoder().jne_reloc(generation_miss);
+			exit_relocs.push_back(generation_miss);
+
+			Encoder().mov(X86Memory::get(REG_RCX, offsetof(archsim::blockjit::BlockCacheEntry, ptr), REG_R8, 1), REG_R9);
+
+			// Move the most recent target into the second way, and fill the
+			// first with this one
+			uint32_t second = site + sizeof(IndirectTargetCache::Entry);
+			for(uint32_t field : { offsetof(IndirectTargetCache::Entry, virt_tag), offsetof(IndirectTargetCache::Entry, ptr), offsetof(IndirectTargetCache::Entry, generation) }) {
+				Encoder().mov(X86Memory::get(REG_RDX, site + field), REG_R10);
+				Encoder().mov(REG_R10, X86Memory::get(REG_RDX, second + field));
+			}
+			Encoder().mov(REG_RAX, X86Memory::get(REG_RDX, site + offsetof(IndirectTargetCache::Entry, virt_tag)));
+			Encoder().mov(REG_R9, X86Memory::get(REG_RDX, site + offsetof(IndirectTargetCache::Entry, ptr)));
+			Encoder().mov(REG_R11, X86Memory::get(REG_RDX, site + offsetof(IndirectTargetCache::Entry, generation)));
+			Encoder().jmp(REG_R9);
+		}
+	} else {
+		for(const IROperand *pc : { &target_pc, &fallthrough_pc }) {
+			if(pc == &fallthrough_pc && (pc->value == 0 || (kind & IRInstruction::DISPATCH_CALL))) {
+				continue;
+			}
+
+			if(pc_entry.GetEntrySize() == 4) {
+				Encoder().cmp4((uint32_t)pc->value, X86Memory::get(REG_RDI, pc_entry.GetOffset()));
+			} else {
+				Encoder().mov(pc->value, REG_RAX);
+				Encoder().cmp(REG_RAX, X86Memory::get(REG_RDI, pc_entry.GetOffset()));
+			}
+
+			uint32_t pc_mismatch;
+			Encoder().jne_reloc(pc_mismatch);
+			emit_slot(pc->value);
+
+			*(uint32_t*)(Encoder().get_buffer() + pc_mismatch) = Encoder().current_offset() - pc_mismatch - 4;
+		}
+
+		if(kind & IRInstruction::DISPATCH_CALL) {
+			uint32_t reloc;
+			Encoder().jmp_reloc(reloc);
+			exit_relocs.push_back(reloc);
+		}
+	}
+
+	// The return stub can only be chained if the return address is on the
+	// page that this translation starts on. Otherwise, returning to it exits.
+	uint32_t return_stub = 0;
+	if(kind & IRInstruction::DISPATCH_CALL) {
+		if(archsim::Address(fallthrough_pc.value).GetPageBase() == entry_pc.GetPageBase()) {
+			return_stub = emit_slot(fallthrough_pc.value);
+		}
+	}
+
+	uint32_t exit_offset = Encoder().current_offset();
+	for(auto reloc : exit_relocs) {
+		*(uint32_t*)(Encoder().get_buffer() + reloc) = exit_offset - reloc - 4;
+	}
+	if(kind & IRInstruction::DISPATCH_CALL) {
+		uint32_t stub_target = return_stub ? return_stub : exit_offset;
+		*(uint32_t*)(Encoder().get_buffer() + return_stub_reloc) = stub_target - return_stub_reloc - 4;
+	}
+	for(auto &slot : slots) {
+		slot.ExitOffset = exit_offset;
+		GetLoweringContext().AddChainSlot(slot);
+	}
+
+	if(count_chains) {
+		Encoder().add(1, 8, X86Memory::get(REG_RSI, counters_offset + 8));
+	}
+	Encoder().ret();
+
+	insn++;
+	return true;
 }
@@ -27,7 +27,7 @@ bool LowerTakeException::Lower(const captive::shared::IRInstruction *&insn)
 	GetLoweringContext().encode_operand_function_argument(&insn->operands[0], REG_RSI, GetStackMap());
 	GetLoweringContext().encode_operand_function_argument(&insn->operands[1], REG_RDX, GetStackMap());
 
-	Encoder().mov((uint64_t)(cpuTakeException), BLKJIT_RETURN(8));
+	Encoder().mov_host_ptr((void*)cpuTakeException, BLKJIT_RETURN(8));
 	Encoder().call(BLKJIT_RETURN(8));
 
 	GetLoweringContext().emit_restore_reg_state(GetIsStackFixed());
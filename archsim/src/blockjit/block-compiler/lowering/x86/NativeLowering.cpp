@@ -28,7 +28,7 @@ LoweringResult captive::arch::jit::lowering::NativeLowering(TranslationContext &
 
 	block_txln_fn fn = (block_txln_fn)encoder.get_buffer();
 	fn = (block_txln_fn)allocator.Reallocate(encoder.get_buffer(), encoder.get_buffer_size());
-	return LoweringResult(fn, encoder.get_buffer_size());
+	return LoweringResult(fn, encoder.get_buffer_size(), encoder.get_host_relocations(), lowering.GetChainSlots());
 }
 
 bool captive::arch::jit::lowering::HasNativeLowering()
@@ -197,6 +197,17 @@ void X86Encoder::lea(const X86Memory& addr, const X86Register& dst)
 	encode_opcode_mod_rm(0x8d, dst, addr);
 }
 
+void X86Encoder::lea_reloc(const X86Register& dst, uint32_t& reloc_offset)
+{
+	assert(dst.size == 8);
+
+	encode_rex_prefix(false, false, dst.hireg, true);
+	emit8(0x8d);
+	emit8(0x05 | (dst.raw_index & 7) << 3);
+	reloc_offset = _write_offset;
+	emit32(0);
+}
+
 void X86Encoder::bswap(const X86Register& dst)
 {
 	if(dst.size == 2) {
@@ -237,6 +248,22 @@ void X86Encoder::mov(const X86Register& src, const X86Memory& dst)
 	}
 }
 
+void X86Encoder::mov_host_ptr(const void *src, const X86Register& dst)
+{
+	assert(dst.size == 8);
+
+	uint8_t rex = REX_W;
+	if (dst.hireg) {
+		rex |= REX_B;
+	}
+
+	emit8(rex);
+	emit8(0xb8 + dst.raw_index);
+
+	_host_relocations.push_back({_write_offset, src});
+	emit64((uint64_t)src);
+}
+
 void X86Encoder::mov(uint64_t src, const X86Register& dst)
 {
 	if (dst.size == 1) {
@@ -1441,7 +1468,7 @@ void X86Encoder::call(void *target, const X86Register &reg)
 
 	int64_t offset = ptr - buffer_ptr;
 	if(!_support_relocation || offset > INT32_MAX || offset < INT32_MIN) {
-		mov((uint64_t)target, reg);
+		mov_host_ptr(target, reg);
 		call(reg);
 	} else {
 		emit8(0xe8);
@@ -1473,7 +1500,7 @@ void X86Encoder::jmp(void *target, const X86Register &reg)
 
 	int64_t offset = ptr - buffer_ptr;
 	if(!_support_relocation || offset > INT32_MAX || offset < INT32_MIN) {
-		mov((uint64_t)target, reg);
+		mov_host_ptr(target, reg);
 		jmp(reg);
 	} else {
 		emit8(0xe9);
@@ -1613,6 +1640,11 @@ void X86Encoder::int3()
 	emit8(0xcc);
 }
 
+void X86Encoder::lock()
+{
+	emit8(0xf0);
+}
+
 void X86Encoder::intt(uint8_t irq)
 {
 	emit8(0xcd);
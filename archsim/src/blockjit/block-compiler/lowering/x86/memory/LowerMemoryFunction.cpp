@@ -452,13 +452,13 @@ bool LowerWriteUserMemFunction::Lower(const captive::shared::IRInstruction *&ins
 
 	switch(value->size) {
 		case 1:
-			Encoder().mov((uint64_t)cpuWrite8User, BLKJIT_RETURN(8));
+			Encoder().mov_host_ptr((void*)cpuWrite8User, BLKJIT_RETURN(8));
 			break;
 		case 2:
 			assert(false);
 			break;
 		case 4:
-			Encoder().mov((uint64_t)cpuWrite32User, BLKJIT_RETURN(8));
+			Encoder().mov_host_ptr((void*)cpuWrite32User, BLKJIT_RETURN(8));
 			break;
 		default:
 			assert(false);
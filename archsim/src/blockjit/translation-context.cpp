@@ -69,7 +69,7 @@ struct captive::shared::insn_descriptor captive::shared::insn_descriptors[] = {
 	{ .mnemonic = "jmp",		.format = "NXXXXX", .has_side_effects = true },
 	{ .mnemonic = "branch",		.format = "INNXXX", .has_side_effects = true },
 	{ .mnemonic = "ret",		.format = "XXXXXX", .has_side_effects = true },
-	{ .mnemonic = "dispatch",	.format = "NNNNXX", .has_side_effects = true },
+	{ .mnemonic = "dispatch",	.format = "NNNNNX", .has_side_effects = true },
 
 	{ .mnemonic = "scm",		.format = "IXXXXX", .has_side_effects = true },
 	{ .mnemonic = "set_feature",.format = "NNXXXX", .has_side_effects = true },
@@ -0,0 +1,186 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "concurrent/ReservationTable.h"
+
+#include <cassert>
+
+using namespace archsim::concurrent;
+
+ReservationTable::ReservationTable() : max_thread_id_(-1), exclusive_(false), exclusive_owner_(-1), exclusive_sections_(0)
+{
+	for(auto &granule : granules_) {
+		granule.Version = 0;
+	}
+
+	for(auto &slot : slots_) {
+		slot.ReservedAddress = Address(0);
+		slot.ReservedVersion = 0;
+		slot.ReservedSections = 0;
+		slot.Reserved = false;
+		slot.Held = nullptr;
+		slot.Storing = false;
+		slot.Succeeded = 0;
+		slot.Failed = 0;
+	}
+}
+
+ReservationTable::ThreadSlot &ReservationTable::getSlot(int thread_id)
+{
+	assert(thread_id >= 0 && (unsigned)thread_id < kMaxThreads);
+
+	int max = max_thread_id_.load(std::memory_order_relaxed);
+	while(thread_id > max && !max_thread_id_.compare_exchange_weak(max, thread_id)) ;
+
+	return slots_[thread_id];
+}
+
+void ReservationTable::Reserve(int thread_id, Address addr)
+{
+	ThreadSlot &slot = getSlot(thread_id);
+
+	slot.ReservedAddress = addr;
+	slot.ReservedSections = exclusive_sections_.load(std::memory_order_acquire);
+	slot.ReservedVersion = getGranule(addr).Version.load(std::memory_order_acquire);
+	slot.Reserved = true;
+}
+
+void ReservationTable::Clear(int thread_id)
+{
+	getSlot(thread_id).Reserved = false;
+}
+
+bool ReservationTable::BeginConditionalStore(int thread_id, Address addr)
+{
+	ThreadSlot &slot = getSlot(thread_id);
+
+	bool reserved = slot.Reserved && slot.ReservedAddress == addr;
+	slot.Reserved = false;
+
+	// An odd version means that the granule was being written when the
+	// reservation was taken, so the reservation is already broken.
+	uint64_t version = slot.ReservedVersion;
+	if(!reserved || (version & 1)) {
+		slot.Failed.store(slot.Failed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	// Announce the store, and back off if another thread is in (or entering)
+	// the exclusive section. If this thread is the one in the exclusive
+	// section then there's nothing to wait for.
+	if(exclusive_owner_.load(std::memory_order_relaxed) != thread_id) {
+		while(true) {
+			slot.Storing.store(true, std::memory_order_seq_cst);
+			if(!exclusive_.load(std::memory_order_seq_cst)) {
+				break;
+			}
+
+			slot.Storing.store(false, std::memory_order_release);
+			while(exclusive_.load(std::memory_order_acquire)) {
+				asm volatile("pause");
+			}
+		}
+
+		// An exclusive section may have written to the address since the
+		// reservation was taken
+		if(exclusive_sections_.load(std::memory_order_seq_cst) != slot.ReservedSections) {
+			slot.Storing.store(false, std::memory_order_release);
+			slot.Failed.store(slot.Failed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+
+	Granule &granule = getGranule(addr);
+	if(!granule.Version.compare_exchange_strong(version, version + 1, std::memory_order_acq_rel)) {
+		slot.Storing.store(false, std::memory_order_release);
+		slot.Failed.store(slot.Failed.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+		return false;
+	}
+
+	slot.Held = &granule;
+	slot.Succeeded.store(slot.Succeeded.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	return true;
+}
+
+void ReservationTable::EndConditionalStore(int thread_id)
+{
+	ThreadSlot &slot = getSlot(thread_id);
+
+	if(slot.Held != nullptr) {
+		slot.Held->Version.fetch_add(1, std::memory_order_release);
+		slot.Held = nullptr;
+		slot.Storing.store(false, std::memory_order_release);
+	}
+}
+
+void ReservationTable::Invalidate(Address addr)
+{
+	// Adding two keeps the granule's parity, so this is safe even while
+	// another thread is part way through a conditional store.
+	getGranule(addr).Version.fetch_add(2, std::memory_order_acq_rel);
+}
+
+void ReservationTable::NotifyWrite(int thread_id, Address addr)
+{
+	Granule &granule = getGranule(addr);
+	if(getSlot(thread_id).Held != &granule) {
+		Invalidate(addr);
+	}
+}
+
+void ReservationTable::LockExclusive(int thread_id)
+{
+	if(exclusive_owner_.load(std::memory_order_relaxed) == thread_id) {
+		return;
+	}
+
+	exclusive_lock_.lock();
+	exclusive_owner_.store(thread_id, std::memory_order_relaxed);
+	exclusive_.store(true, std::memory_order_seq_cst);
+
+	// Wait for any conditional stores which started before the exclusive
+	// section did.
+	int max = max_thread_id_.load(std::memory_order_acquire);
+	for(int i = 0; i <= max; ++i) {
+		if(i == thread_id) {
+			continue;
+		}
+
+		while(slots_[i].Storing.load(std::memory_order_seq_cst)) {
+			asm volatile("pause");
+		}
+	}
+}
+
+void ReservationTable::UnlockExclusive(int thread_id)
+{
+	EndConditionalStore(thread_id);
+
+	if(exclusive_owner_.load(std::memory_order_relaxed) != thread_id) {
+		return;
+	}
+
+	// Break every reservation, before any conditional store can go ahead
+	exclusive_sections_.fetch_add(1, std::memory_order_seq_cst);
+
+	exclusive_owner_.store(-1, std::memory_order_relaxed);
+	exclusive_.store(false, std::memory_order_release);
+	exclusive_lock_.unlock();
+}
+
+uint64_t ReservationTable::GetStoresSucceeded() const
+{
+	uint64_t total = 0;
+	for(int i = 0; i <= max_thread_id_; ++i) {
+		total += slots_[i].Succeeded;
+	}
+	return total;
+}
+
+uint64_t ReservationTable::GetStoresFailed() const
+{
+	uint64_t total = 0;
+	for(int i = 0; i <= max_thread_id_; ++i) {
+		total += slots_[i].Failed;
+	}
+	return total;
+}
@@ -124,11 +124,17 @@ static void* thread_entry_point(void* arg)
 
 void Thread::start()
 {
-	pthread_create(&get_thread_handle_data()->thread_, // pthread id
-	               NULL, // pthread attributes
-	               thread_entry_point, // thread entry point (function pointer)
-	               this); // parameters to entry point function
 	std::lock_guard<std::mutex> l(get_thread_handle_data()->thread_mutex_);
+	if(pthread_create(&get_thread_handle_data()->thread_, // pthread id
+	                  NULL, // pthread attributes
+	                  thread_entry_point, // thread entry point (function pointer)
+	                  this)) { // parameters to entry point function
+		return;
+	}
+
+	// The thread can be joined as soon as it exists, even if it has not
+	// started running yet
+	get_thread_handle_data()->is_valid_ = true;
 	pthread_setname_np(get_thread_handle_data()->thread_, name.c_str());
 }
 
@@ -18,7 +18,7 @@ TranslationResult MMUTranslationProvider::Translate(Address virt_addr, Address&
 	info.Write = is_write;
 	info.Ring = thread_->GetExecutionRing();
 
-	auto result = mmu_->Translate(thread_, virt_addr, phys_addr, info);
+	auto result = mmu_->TranslateCached(thread_, virt_addr, phys_addr, info);
 	switch(result) {
 		case archsim::abi::devices::MMU::TXLN_OK:
 			return TranslationResult::OK;
@@ -201,7 +201,7 @@ MemoryResult LegacyFetchMemoryInterface::Write128(Address address, uint128_t dat
 
 CachedLegacyMemoryInterface::CachedLegacyMemoryInterface(int index, archsim::abi::memory::MemoryModel& mem_model, archsim::core::thread::ThreadInstance* thread) : mem_model_(mem_model), thread_(thread)
 {
-	cache_offset_ = thread->GetStateBlock().AddBlock("memory_cache_" + std::to_string(index), sizeof (struct Cache));
+	cache_entry_ = thread->GetStateBlock().AddEntry<Cache>("memory_cache_" + std::to_string(index), true);
 	Invalidate();
 }
 
@@ -215,7 +215,7 @@ void CachedLegacyMemoryInterface::Invalidate()
 
 CachedLegacyMemoryInterface::Cache* CachedLegacyMemoryInterface::GetCache()
 {
-	return (Cache*)(((char*)thread_->GetStateBlock().GetData()) + cache_offset_);
+	return cache_entry_.Get(thread_->GetStateBlock());
 }
 
 
@@ -74,3 +74,44 @@ void BaseMemoryMonitor::Notify(archsim::core::thread::ThreadInstance* thread, Ad
 
 	Unlock(thread);
 }
+
+void ReservationMemoryMonitor::AcquireMonitor(archsim::core::thread::ThreadInstance* thread, Address addr)
+{
+	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " took monitor on " << addr;
+	reservations_.Reserve(thread->GetThreadID(), addr);
+}
+
+bool ReservationMemoryMonitor::LockMonitor(archsim::core::thread::ThreadInstance* thread, Address addr)
+{
+	if(reservations_.BeginConditionalStore(thread->GetThreadID(), addr)) {
+		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " successfully locked on " << addr;
+		return true;
+	} else {
+		LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " failed to lock on " << addr;
+		return false;
+	}
+}
+
+void ReservationMemoryMonitor::UnlockMonitor(archsim::core::thread::ThreadInstance* thread, Address addr)
+{
+	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " unlocking monitor";
+	reservations_.EndConditionalStore(thread->GetThreadID());
+}
+
+void ReservationMemoryMonitor::Notify(archsim::core::thread::ThreadInstance* thread, Address addr)
+{
+	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << " notified " << addr;
+	reservations_.NotifyWrite(thread->GetThreadID(), addr);
+}
+
+void ReservationMemoryMonitor::Lock(archsim::core::thread::ThreadInstance* thread)
+{
+	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": locking monitor";
+	reservations_.LockExclusive(thread->GetThreadID());
+}
+
+void ReservationMemoryMonitor::Unlock(archsim::core::thread::ThreadInstance* thread)
+{
+	LC_DEBUG1(LogMonitor) << "Thread " << thread->GetThreadID() << ": unlocking monitor";
+	reservations_.UnlockExclusive(thread->GetThreadID());
+}
@@ -4,21 +4,33 @@
 #include "core/execution/BasicJITExecutionEngine.h"
 #include "core/MemoryInterface.h"
 #include "util/LogContext.h"
+#include "system.h"
 
+#include <algorithm>
+#include <cassert>
 #include <chrono>
 
 using namespace archsim::core::execution;
 
 DeclareLogContext(LogBasicJIT, "BasicJIT");
 
-void flush_txlns_callback(PubSubType::PubSubType type, void *context, const void *data)
+static void flush_txlns_callback(PubSubType::PubSubType type, void *context, const void *data)
 {
-	BasicJITExecutionEngine *engine = (BasicJITExecutionEngine*)context;
+	BasicJITExecutionEngineThreadContext *ctx = (BasicJITExecutionEngineThreadContext*)context;
+	BasicJITExecutionEngine *engine = ctx->GetJITEngine();
 
 	switch(type) {
 		case PubSubType::ITlbFullFlush:
+			// A flush raised by one thread (e.g. a write to its own page
+			// table base) says nothing about the other threads' mappings.
+			// Global flushes have no thread.
+			if(data != nullptr && data != ctx->GetThread()) {
+				break;
+			}
+			ctx->InvalidateBlockCache();
+			break;
 		case PubSubType::ITlbEntryFlush:
-			engine->FlushTxlnCache();
+			ctx->InvalidateBlockCache();
 			break;
 		case PubSubType::FlushTranslations:
 		case PubSubType::L1ICacheFlush:
@@ -26,65 +38,238 @@ void flush_txlns_callback(PubSubType::PubSubType type, void *context, const void
 			break;
 
 		case PubSubType::FeatureChange:
-			engine->FlushTxlnsFeature();
+			ctx->InvalidateBlockCacheFeatures();
 			break;
 
 		case PubSubType::FlushAllTranslations:
 			engine->FlushAllTxlns();
 			break;
 
-		case PubSubType::RegionInvalidatePhysical:
-			engine->InvalidateRegion(archsim::Address((uint64_t)data));
+		case PubSubType::CodeLinesInvalidatePhysical: {
+			auto invalidation = (const archsim::translate::profile::CodeLineInvalidation*)data;
+			engine->InvalidateRegion(archsim::Address(invalidation->PageBase), invalidation->Lines);
 			break;
+		}
 		default:
 			break;
 	}
 }
 
-BasicJITExecutionEngine::BasicJITExecutionEngine(uint64_t max_code_size) : phys_block_profile_(mem_allocator_), subscribed_(false), flush_txlns_(0), flush_all_txlns_(0), max_code_size_(max_code_size)
+BasicJITExecutionEngineThreadContext::BasicJITExecutionEngineThreadContext(BasicJITExecutionEngine *engine, thread::ThreadInstance *thread) :
+	BasicJITExecutionEngineThreadContext(engine, thread, this)
 {
 
 }
 
+BasicJITExecutionEngineThreadContext::BasicJITExecutionEngineThreadContext(BasicJITExecutionEngine *engine, thread::ThreadInstance *thread, ExecutionEngineThreadContext *owner) :
+	ExecutionEngineThreadContext(engine, thread),
+	jit_engine_(engine),
+	owner_(owner),
+	invalidate_pending_(false),
+	invalidate_features_pending_(false),
+	quiescent_epoch_(0),
+	subscriber_(thread->GetEmulationModel().GetSystem().GetPubSub())
+{
+	auto &state_block = thread->GetStateBlock();
+	if(!state_block.GetDescriptor().HasEntry("BlockCache")) {
+		// The caches are looked at on every dispatch
+		state_block.AddBlock("BlockCache", sizeof(void*), true, true);
+		state_block.AddBlock("TargetCache", sizeof(void*), true, true);
+		state_block.AddBlock("BlockCacheInstance", sizeof(void*), true);
+		// Dispatches attempted, and dispatches which did not chain
+		state_block.AddBlock("ChainCounters", sizeof(uint64_t) * 2, true);
+	}
+	*state_block.GetEntryHandle<archsim::blockjit::BlockCacheEntry*>("BlockCache").Get(state_block) = block_cache_.GetPtr();
+	*state_block.GetEntryHandle<archsim::blockjit::IndirectTargetCache*>("TargetCache").Get(state_block) = &target_cache_;
+	*state_block.GetEntryHandle<archsim::blockjit::BlockCache*>("BlockCacheInstance").Get(state_block) = &block_cache_;
+	chain_counters_ = state_block.GetEntryHandle<uint64_t>("ChainCounters");
+
+	subscriber_.Subscribe(PubSubType::FlushTranslations, flush_txlns_callback, this);
+	subscriber_.Subscribe(PubSubType::FlushAllTranslations, flush_txlns_callback, this);
+	subscriber_.Subscribe(PubSubType::ITlbFullFlush, flush_txlns_callback, this);
+	subscriber_.Subscribe(PubSubType::ITlbEntryFlush, flush_txlns_callback, this);
+	subscriber_.Subscribe(PubSubType::L1ICacheFlush, flush_txlns_callback, this);
+	subscriber_.Subscribe(PubSubType::FeatureChange, flush_txlns_callback, this);
+	subscriber_.Subscribe(PubSubType::CodeLinesInvalidatePhysical, flush_txlns_callback, this);
+
+	jit_engine_->registerContext(this);
+}
 
-void BasicJITExecutionEngine::FlushTxlns()
+BasicJITExecutionEngineThreadContext::~BasicJITExecutionEngineThreadContext()
 {
-	virt_block_cache_.Invalidate();
-	flush_txlns_ = 1;
+	jit_engine_->unregisterContext(this);
 }
 
-void BasicJITExecutionEngine::FlushAllTxlns()
+bool BasicJITExecutionEngineThreadContext::isOwningThread()
+{
+	return owner_->GetWorker().get_id() == std::this_thread::get_id();
+}
+
+void BasicJITExecutionEngineThreadContext::InvalidateBlockCache()
+{
+	// The owning thread can invalidate its cache straight away. Any other
+	// thread has to ask the owner to do it, since the owner may be reading
+	// the cache at the same time.
+	if(isOwningThread()) {
+		block_cache_.Invalidate();
+		target_cache_.Invalidate();
+
+		// The owner may be part way through a translation, which would
+		// otherwise chain straight into the next one without looking at the
+		// cache. Translated code doesn't chain while a message is waiting.
+		GetThread()->SendMessage(thread::ThreadMessage::Nop);
+	} else {
+		invalidate_pending_.store(true, std::memory_order_release);
+		if(GetOwnerState() == ExecutionState::Running) {
+			GetThread()->SendMessage(thread::ThreadMessage::Nop);
+		}
+	}
+}
+
+void BasicJITExecutionEngineThreadContext::InvalidateBlockCacheFeatures()
+{
+	if(isOwningThread()) {
+		block_cache_.InvalidateFeatures(GetThread()->GetFeatures().GetAvailableMask());
+		target_cache_.Invalidate();
+		GetThread()->SendMessage(thread::ThreadMessage::Nop);
+	} else {
+		invalidate_features_pending_.store(true, std::memory_order_release);
+		if(GetOwnerState() == ExecutionState::Running) {
+			GetThread()->SendMessage(thread::ThreadMessage::Nop);
+		}
+	}
+}
+
+void BasicJITExecutionEngineThreadContext::EnterQuiescentState(uint64_t epoch)
+{
+	if(invalidate_pending_.exchange(false, std::memory_order_acq_rel)) {
+		invalidate_features_pending_.store(false, std::memory_order_relaxed);
+		block_cache_.Invalidate();
+		target_cache_.Invalidate();
+	} else if(invalidate_features_pending_.exchange(false, std::memory_order_acq_rel)) {
+		block_cache_.InvalidateFeatures(GetThread()->GetFeatures().GetAvailableMask());
+		target_cache_.Invalidate();
+	}
+
+	quiescent_epoch_.store(epoch, std::memory_order_release);
+}
+
+void BasicJITExecutionEngineThreadContext::UpdateChainMetrics()
+{
+	uint64_t *counters = chain_counters_.Get(GetThread()->GetStateBlock());
+
+	auto &metrics = GetThread()->GetMetrics();
+	metrics.JITSuccessfulChains.inc(counters[0] - counters[1]);
+	metrics.JITFailedChains.inc(counters[1]);
+
+	counters[0] = 0;
+	counters[1] = 0;
+}
+
+BasicJITExecutionEngine::BasicJITExecutionEngine(uint64_t max_code_size) : phys_block_profile_(mem_allocator_), max_code_size_(max_code_size), flush_epoch_(0), replaced_code_size_(0)
+{
+
+}
+
+ExecutionEngineThreadContext *BasicJITExecutionEngine::GetNewContext(thread::ThreadInstance *thread)
+{
+	return new BasicJITExecutionEngineThreadContext(this, thread);
+}
+
+void BasicJITExecutionEngine::registerContext(BasicJITExecutionEngineThreadContext *ctx)
+{
+	std::lock_guard<std::mutex> lock(contexts_lock_);
+	contexts_.push_back(ctx);
+
+	// Every thread's state block is laid out in the same way, so the block
+	// cache can be found without looking it up by name on each dispatch.
+	auto block_cache_entry = ctx->GetThread()->GetStateBlock().GetEntryHandle<archsim::blockjit::BlockCache*>("BlockCacheInstance");
+	if(!block_cache_entry_.IsValid()) {
+		block_cache_entry_ = block_cache_entry;
+	}
+	assert(block_cache_entry_.GetOffset() == block_cache_entry.GetOffset());
+}
+
+void BasicJITExecutionEngine::unregisterContext(BasicJITExecutionEngineThreadContext *ctx)
 {
-	virt_block_cache_.Invalidate();
-	flush_all_txlns_ = 1;
-	flush_txlns_ = 1;
+	std::lock_guard<std::mutex> lock(contexts_lock_);
+	contexts_.erase(std::remove(contexts_.begin(), contexts_.end(), ctx), contexts_.end());
 }
 
-void BasicJITExecutionEngine::FlushTxlnCache()
+void BasicJITExecutionEngine::startFlushEpoch(bool flush_all)
 {
-	virt_block_cache_.Invalidate();
+	std::lock_guard<std::mutex> lock(contexts_lock_);
+
+	// Translations retired now belong to the next epoch. They can only be
+	// freed once every thread has invalidated its block cache, so make sure
+	// every thread has been asked to do so before the new epoch is visible.
+	uint64_t epoch = flush_epoch_.load(std::memory_order_relaxed) + 1;
+
+	if(archsim::options::AggressiveCodeInvalidation || flush_all) {
+		phys_block_profile_.Invalidate(epoch);
+	} else {
+		phys_block_profile_.GarbageCollect(epoch);
+	}
+
+	// Every block cache is invalidated either way, so the epoch always
+	// moves on, even if nothing was retired here.
+	advanceEpoch(epoch);
 }
 
-void BasicJITExecutionEngine::FlushTxlnsFeature()
+void BasicJITExecutionEngine::advanceEpoch(uint64_t epoch)
 {
-	for(auto i : GetThreads()) {
-		virt_block_cache_.InvalidateFeatures(i->GetFeatures().GetAvailableMask());
+	for(auto ctx : contexts_) {
+		ctx->InvalidateBlockCache();
 	}
+
+	replaced_code_size_ = 0;
+	flush_epoch_.store(epoch, std::memory_order_release);
+}
+
+void BasicJITExecutionEngine::FlushTxlns()
+{
+	startFlushEpoch(false);
+}
+
+void BasicJITExecutionEngine::FlushAllTxlns()
+{
+	startFlushEpoch(true);
+}
+
+void BasicJITExecutionEngine::InvalidateRegion(Address addr, uint64_t lines)
+{
+	phys_block_profile_.MarkPageDirty(addr, lines);
 }
 
-void BasicJITExecutionEngine::InvalidateRegion(Address addr)
+void BasicJITExecutionEngine::reclaimTxlns()
 {
-	phys_block_profile_.MarkPageDirty(addr);
+	// Find the oldest epoch which any running thread might still be
+	// holding translations from.
+	uint64_t safe_epoch = flush_epoch_.load(std::memory_order_acquire);
+	{
+		std::lock_guard<std::mutex> lock(contexts_lock_);
+		for(auto ctx : contexts_) {
+			auto state = ctx->GetOwnerState();
+			if(state == ExecutionState::Running || state == ExecutionState::Halting || state == ExecutionState::Suspending) {
+				safe_epoch = std::min(safe_epoch, ctx->GetQuiescentEpoch());
+			}
+		}
+	}
+
+	// Freeing code touches the memory allocator, so don't race with a
+	// translation. If another thread is translating, try again later.
+	std::unique_lock<std::mutex> lock(translate_lock_, std::try_to_lock);
+	if(lock.owns_lock()) {
+		phys_block_profile_.Reclaim(safe_epoch);
+	}
 }
 
-void BasicJITExecutionEngine::checkFlushTxlns()
+void BasicJITExecutionEngine::checkFlushTxlns(BasicJITExecutionEngineThreadContext *ctx)
 {
-	if(flush_txlns_) {
-		if(archsim::options::AggressiveCodeInvalidation || flush_all_txlns_) phys_block_profile_.Invalidate();
-		else phys_block_profile_.GarbageCollect();
-		virt_block_cache_.Invalidate();
-		flush_txlns_ = false;
-		flush_all_txlns_ = false;
+	ctx->EnterQuiescentState(flush_epoch_.load(std::memory_order_acquire));
+
+	if(phys_block_profile_.HasRetired()) {
+		reclaimTxlns();
 	}
 }
 
@@ -94,14 +279,13 @@ void BasicJITExecutionEngine::checkCodeSize()
 		return;
 	}
 	if(phys_block_profile_.GetTotalCodeSize() > max_code_size_) {
-		phys_block_profile_.Invalidate();
-		virt_block_cache_.Invalidate();
+		FlushAllTxlns();
 	}
 
 }
 
 
-template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(ExecutionEngineThreadContext *ctx, PC_t *pc_ptr)
+template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(BasicJITExecutionEngineThreadContext *ctx, PC_t *pc_ptr)
 {
 	auto thread = ctx->GetThread();
 
@@ -118,7 +302,7 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 			thread->GetTraceSource()->Trace_End_Insn();
 		}
 
-		checkFlushTxlns();
+		checkFlushTxlns(ctx);
 
 		if(thread->HasMessage()) {
 			auto result = thread->HandleMessage();
@@ -127,6 +311,9 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 				case ExecutionResult::Exception:
 					break;
 				default:
+					if(verbose) {
+						ctx->UpdateChainMetrics();
+					}
 					return result;
 			}
 		}
@@ -145,9 +332,16 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 				thread->GetMetrics().JITTime.Stop();
 			}
 		} else {
-			if(!translateBlock(thread, Address(*pc_ptr), false, false)) {
+			bool translated;
+			{
+				std::lock_guard<std::mutex> lock(translate_lock_);
+				translated = translateBlock(thread, Address(*pc_ptr), true, false);
+			}
+
+			if(!translated) {
 				// failed to decode a block: abort
 				if(verbose) {
+					ctx->UpdateChainMetrics();
 					thread->GetMetrics().SelfRuntime.Stop();
 				}
 				return ExecutionResult::Abort;
@@ -160,48 +354,41 @@ template<typename PC_t> ExecutionResult BasicJITExecutionEngine::ExecuteLoop(Exe
 	}
 
 	if(verbose) {
+		ctx->UpdateChainMetrics();
 		thread->GetMetrics().SelfRuntime.Stop();
 	}
 
 	return ExecutionResult::Halt;
 }
 
-template<typename PC_t> void BasicJITExecutionEngine::ExecuteInnerLoop(ExecutionEngineThreadContext* ctx, PC_t* pc_ptr)
+template<typename PC_t> void BasicJITExecutionEngine::ExecuteInnerLoop(BasicJITExecutionEngineThreadContext* ctx, PC_t* pc_ptr)
 {
 	auto thread = ctx->GetThread();
 	auto regfile = thread->GetRegisterFile();
+	auto &block_cache = ctx->GetBlockCache();
 
 	while(!thread->HasMessage()) {
 		uint64_t pc = *(PC_t*)(pc_ptr);
 
-		uint64_t entry_idx = pc & BLOCKCACHE_MASK;
-		entry_idx >>= BLOCKCACHE_INSTRUCTION_SHIFT;
+		block_txln_fn txln_fn = block_cache.Lookup(Address(pc));
 
-		const auto & entry  = virt_block_cache_.GetEntry(Address(pc));
-
-		if(entry.virt_tag == pc) {
-			entry.ptr(regfile, thread->GetStateBlock().GetData());
+		if(txln_fn) {
+			txln_fn(regfile, thread->GetStateBlock().GetData());
 		} else {
 			return;
 		}
 	}
 }
 
-ExecutionResult BasicJITExecutionEngine::Execute(ExecutionEngineThreadContext* ctx)
+ExecutionResult BasicJITExecutionEngine::Execute(ExecutionEngineThreadContext* engine_ctx)
 {
+	auto ctx = static_cast<BasicJITExecutionEngineThreadContext*>(engine_ctx);
 	auto thread = ctx->GetThread();
 
-	util::PubSubscriber pubsub (thread->GetPubsub());
-	pubsub.Subscribe(PubSubType::FlushTranslations, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::FlushAllTranslations, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::ITlbFullFlush, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::ITlbEntryFlush, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::L1ICacheFlush, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::FeatureChange, flush_txlns_callback, this);
-	pubsub.Subscribe(PubSubType::RegionInvalidatePhysical, flush_txlns_callback, this);
-
-	ctx->GetThread()->GetStateBlock().AddBlock("BlockCache", sizeof(void*));
-	ctx->GetThread()->GetStateBlock().SetEntry<archsim::blockjit::BlockCacheEntry*>("BlockCache", virt_block_cache_.GetPtr());
+	// This thread may have missed invalidations while it was not running
+	ctx->GetBlockCache().Invalidate();
+	ctx->GetTargetCache().Invalidate();
+	ctx->EnterQuiescentState(flush_epoch_.load(std::memory_order_acquire));
 
 	std::unique_ptr<util::CounterTimerContext> timer_ctx;
 
@@ -222,11 +409,34 @@ ExecutionResult BasicJITExecutionEngine::Execute(ExecutionEngineThreadContext* c
 	}
 }
 
+ExecutionResult BasicJITExecutionEngine::StepBlock(BasicJITExecutionEngineThreadContext* ctx)
+{
+	auto thread = ctx->GetThread();
+
+	checkFlushTxlns(ctx);
+
+	block_txln_fn fn;
+	if(!lookupBlock(thread, thread->GetPC(), fn)) {
+		std::lock_guard<std::mutex> lock(translate_lock_);
+		if(!translateBlock(thread, thread->GetPC(), false, false)) {
+			return ExecutionResult::Abort;
+		}
+
+		// Translating may have raised a fetch fault and moved the PC, so
+		// leave the new block to the next step.
+		return ExecutionResult::Continue;
+	}
+
+	fn(thread->GetRegisterFile(), thread->GetStateBlock().GetData());
+	return ExecutionResult::Continue;
+}
+
 bool BasicJITExecutionEngine::lookupBlock(thread::ThreadInstance* thread, Address addr, captive::shared::block_txln_fn& txln_fn)
 {
 	LC_DEBUG2(LogBasicJIT) << "Looking up " << addr;
 	// Look up the block in the cache, just in case we already have it translated
-	if((txln_fn = virt_block_cache_.Lookup(addr))) {
+	auto &block_cache = getBlockCache(thread);
+	if((txln_fn = block_cache.Lookup(addr))) {
 		LC_DEBUG2(LogBasicJIT) << " - found in cache";
 		return true;
 	}
@@ -249,7 +459,21 @@ bool BasicJITExecutionEngine::lookupBlock(thread::ThreadInstance* thread, Addres
 
 	if(txln.IsValid(thread->GetFeatures())) {
 		LC_DEBUG2(LogBasicJIT) << " - Features valid";
-		virt_block_cache_.Insert(addr, txln.GetFn(), txln.GetFeatures());
+
+		// A translation which continues onto other pages can only be used
+		// while those pages are still mapped as they were when it was
+		// translated. The block cache is flushed whenever the mappings
+		// change, so they only need to be checked here.
+		for(uint32_t i = 0; i < txln.GetExtraPageCount(); ++i) {
+			const auto &page = txln.GetExtraPage(i);
+			Address page_phys (0);
+			if(thread->GetFetchMI().PerformTranslation(addr.PageBase() + page.VirtualOffset, page_phys, false, true, false) != archsim::TranslationResult::OK || page_phys.PageBase() != page.Physical) {
+				LC_DEBUG2(LogBasicJIT) << " - Mapping of page " << page.Physical << " changed";
+				return false;
+			}
+		}
+
+		block_cache.Insert(addr, txln.GetFn(), txln.GetFeatures());
 		txln_fn = txln.GetFn();
 		return true;
 	} else {
@@ -258,9 +482,20 @@ bool BasicJITExecutionEngine::lookupBlock(thread::ThreadInstance* thread, Addres
 	}
 }
 
-void BasicJITExecutionEngine::registerTranslation(Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation& txln)
+void BasicJITExecutionEngine::registerTranslation(thread::ThreadInstance *thread, Address phys_addr, Address virt_addr, archsim::blockjit::BlockTranslation& txln, const std::vector<archsim::blockjit::ChainSlot> &chain_slots)
 {
 	LC_DEBUG2(LogBasicJIT) << "Registering translation at " << virt_addr << "(" << phys_addr << ")";
-	phys_block_profile_.Insert(phys_addr, txln);
-	virt_block_cache_.Insert(virt_addr, txln.GetFn(), txln.GetFeatures());
+
+	std::lock_guard<std::mutex> lock(contexts_lock_);
+
+	// Any translation replaced by this one might still be in a thread's
+	// block cache, so is retired into the next epoch. Starting that epoch
+	// means flushing every thread's caches, so it is left to the next flush
+	// unless enough replaced code builds up in the meantime.
+	uint64_t epoch = flush_epoch_.load(std::memory_order_relaxed) + 1;
+	replaced_code_size_ += phys_block_profile_.Insert(phys_addr, txln, epoch, chain_slots);
+	if(replaced_code_size_ > kMaxReplacedCodeSize) {
+		advanceEpoch(epoch);
+	}
+	getBlockCache(thread).Insert(virt_addr, txln.GetFn(), txln.GetFeatures());
 }
@@ -5,7 +5,10 @@
 #include "core/execution/ExecutionEngineFactory.h"
 #include "core/thread/ThreadInstance.h"
 #include "core/MemoryInterface.h"
+#include "abi/memory/MemoryModel.h"
+#include "translate/TranslationStore.h"
 #include "util/LogContext.h"
+#include "util/SimOptions.h"
 #include "system.h"
 
 #include <setjmp.h>
@@ -14,6 +17,9 @@ UseLogContext(LogBlockJitCpu);
 
 using namespace archsim::core::execution;
 using namespace archsim::core::thread;
+using archsim::translate::TranslationStore;
+using archsim::translate::TranslationStoreKey;
+using archsim::translate::StoredTranslation;
 
 
 BlockJITExecutionEngine::BlockJITExecutionEngine(gensim::blockjit::BaseBlockJITTranslate *translator) : BasicJITExecutionEngine(64*1024*1024), translator_(translator)
@@ -21,12 +27,69 @@ BlockJITExecutionEngine::BlockJITExecutionEngine(gensim::blockjit::BaseBlockJITT
 
 }
 
+TranslationStoreKey BlockJITExecutionEngine::getStoreKey(ThreadInstance *thread, Address physaddr, Address block_pc, bool support_chaining, bool support_profiling)
+{
+	uint8_t page[Address::PageSize];
+	thread->GetEmulationModel().GetMemoryModel().Peek(physaddr.PageBase(), page, sizeof(page));
+
+	TranslationStoreKey key;
+	key.PageHash = TranslationStore::Hash(page, sizeof(page));
+	key.Address = block_pc.Get();
+	key.FeatureHash = TranslationStore::HashFeatures(thread->GetFeatures());
+
+	// Every option which changes the code generated for a block must be part
+	// of the key, so that a translation is only reused by a run which would
+	// have produced the same code.
+	uint64_t shape[] = {
+		support_chaining && !archsim::options::JitDisableBranchOpt,
+		support_profiling,
+		archsim::options::JitDisableTargetCache,
+		thread->GetTraceSource() != nullptr,
+		archsim::options::JitTraceLength,
+		archsim::options::JitTracePages,
+		TranslationStore::HashStateBlock(thread->GetStateBlock().GetDescriptor())
+	};
+	key.ShapeHash = TranslationStore::Hash(shape, sizeof(shape));
+	key.ISAMode = thread->GetModeID();
+	key.Kind = archsim::translate::StoredTranslationKind::BlockJIT;
+
+	return key;
+}
 
-ExecutionEngineThreadContext* BlockJITExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
+bool BlockJITExecutionEngine::canStoreTranslations()
 {
-	return new ExecutionEngineThreadContext(this, thread);
+	// These options embed pointers to the thread and its metrics into the
+	// generated code. They are only valid in this process, and can't be
+	// relocated, so such translations must neither be stored nor loaded.
+	return !archsim::options::Verbose && !archsim::options::Profile && !archsim::options::ProfilePcFreq && !archsim::options::ProfileIrFreq && !archsim::options::InstructionTick;
 }
 
+bool BlockJITExecutionEngine::loadStoredBlock(ThreadInstance *thread, const TranslationStoreKey &key, archsim::blockjit::BlockTranslation &txln)
+{
+	StoredTranslation stored;
+	if(!TranslationStore::Singleton.Lookup(key, stored)) {
+		return false;
+	}
+
+	uint8_t *code = (uint8_t*)GetMemAllocator().Allocate(stored.GetSize());
+	memcpy(code, stored.GetCode(), stored.GetSize());
+
+	if(!stored.Relocate(code)) {
+		GetMemAllocator().Free(code);
+		return false;
+	}
+
+	txln.SetFn((captive::shared::block_txln_fn)code);
+	txln.SetSize(stored.GetSize());
+	for(const auto &feature : stored.GetRequiredFeatures()) {
+		txln.AddRequiredFeature(feature.first, feature.second);
+	}
+
+	LC_DEBUG4(LogBlockJitCpu) << "Loaded stored translation for block " << std::hex << key.Address;
+	return true;
+}
+
+
 bool BlockJITExecutionEngine::translateBlock(ThreadInstance *thread, archsim::Address block_pc, bool support_chaining, bool support_profiling)
 {
 	checkCodeSize();
@@ -40,13 +103,27 @@ bool BlockJITExecutionEngine::translateBlock(ThreadInstance *thread, archsim::Ad
 	Address physaddr (0);
 	archsim::TranslationResult fault = thread->GetFetchMI().PerformTranslation(block_pc, physaddr, false, true, true);
 
-	archsim::blockjit::BlockTranslation txln;
 	// we couldn't find the block in the physical profile, so create a new translation
-	thread->GetEmulationModel().GetSystem().GetCodeRegions().MarkRegionAsCode(PhysicalAddress(physaddr.PageBase().Get()));
+	archsim::blockjit::BlockTranslation txln;
+	auto &code_regions = thread->GetEmulationModel().GetSystem().GetCodeRegions();
+
+	TranslationStoreKey store_key;
+	bool use_store = TranslationStore::Singleton.IsOpen() && canStoreTranslations();
+	if(use_store) {
+		store_key = getStoreKey(thread, physaddr, block_pc, support_chaining, support_profiling);
+
+		// Stored translations don't record which lines they were decoded
+		// from, so the whole page is treated as code.
+		if(archsim::options::JitLoadTranslations && loadStoredBlock(thread, store_key, txln)) {
+			code_regions.MarkRegionAsCode(PhysicalAddress(physaddr.PageBase().Get()));
+			registerTranslation(thread, physaddr, block_pc, txln);
+			return true;
+		}
+	}
 
 	LC_DEBUG4(LogBlockJitCpu) << "Translating block " << std::hex << block_pc.Get();
 	auto *translate = translator_;
-	if(!support_chaining) translate->setSupportChaining(false);
+	translate->setSupportChaining(support_chaining && !archsim::options::JitDisableBranchOpt);
 
 	if(support_profiling) {
 		translate->setSupportProfiling(true);
@@ -55,9 +132,24 @@ bool BlockJITExecutionEngine::translateBlock(ThreadInstance *thread, archsim::Ad
 	bool success = translate->translate_block(thread, block_pc, txln, GetMemAllocator());
 
 	if(success) {
+		// Only writes to the lines which the block was decoded from need to
+		// invalidate it. The other pages of a translation must be watched for
+		// modification too, but there is nothing to check that they are
+		// mapped in the same way when a stored translation is loaded, so
+		// don't store it.
+		code_regions.MarkLinesAsCode(PhysicalAddress(physaddr.PageBase().Get()), txln.GetCodeLines());
+		for(uint32_t i = 0; i < txln.GetExtraPageCount(); ++i) {
+			const auto &page = txln.GetExtraPage(i);
+			code_regions.MarkLinesAsCode(PhysicalAddress(page.Physical.Get()), page.CodeLines);
+		}
+
+		if(use_store && archsim::options::JitSaveTranslations && txln.GetExtraPageCount() == 0) {
+			TranslationStore::Singleton.Insert(store_key, (void*)txln.GetFn(), txln.GetSize(), translate->GetLastRelocations(), txln.GetFeatures());
+		}
+
 		// we successfully created a translation, so add it to the physical profile
 		// and to the cache, since we'll probably need it again soon
-		registerTranslation(physaddr, block_pc, txln);
+		registerTranslation(thread, physaddr, block_pc, txln, translate->GetLastChainSlots());
 	} else {
 		// if we failed to produce a translation, then try and stop the simulation
 		LC_ERROR(LogBlockJitCpu) << "Failed to compile block! Aborting.";
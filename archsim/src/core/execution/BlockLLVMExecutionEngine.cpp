@@ -35,22 +35,6 @@ using namespace archsim::core::execution;
 
 UseLogContext(LogBlockJitCpu);
 
-static llvm::TargetMachine *GetNativeMachine()
-{
-	llvm::TargetMachine *machine = nullptr;
-
-	if(machine == nullptr) {
-		llvm::InitializeNativeTarget();
-		llvm::InitializeNativeTargetAsmPrinter();
-		llvm::InitializeNativeTargetAsmParser();
-		machine = llvm::EngineBuilder().selectTarget();
-		machine->setOptLevel(llvm::CodeGenOpt::Aggressive);
-		machine->setFastISel(true);
-		machine->setO0WantsFastISel(false);
-	}
-	return machine;
-}
-
 BlockLLVMExecutionEngine::BlockLLVMExecutionEngine(gensim::BaseLLVMTranslate *translator) :
 	BasicJITExecutionEngine(0),
 	translator_(translator),
@@ -60,11 +44,6 @@ BlockLLVMExecutionEngine::BlockLLVMExecutionEngine(gensim::BaseLLVMTranslate *tr
 }
 
 
-ExecutionEngineThreadContext* BlockLLVMExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
-{
-	return new ExecutionEngineThreadContext(this, thread);
-}
-
 static unsigned __int128 uremi128(unsigned __int128 a, unsigned __int128 b)
 {
 	return a % b;
@@ -136,8 +115,8 @@ bool BlockLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread, ar
 		fpm.run(*function);
 	}
 
-	archsim::translate::translate_llvm::LLVMOptimiser opt;
-	opt.Optimise(module.get(), GetNativeMachine()->createDataLayout());
+	archsim::translate::translate_llvm::LLVMOptimiser opt (&compiler_.GetTargetMachine());
+	opt.Optimise(module.get(), compiler_.GetTargetMachine().createDataLayout());
 
 	if(archsim::options::Debug) {
 		std::ofstream str(fn_name + "-opt.ll");
@@ -167,7 +146,7 @@ bool BlockLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread, ar
 //			txln.Dump("llvm-bin-" + std::to_string(physaddr.Get()));
 //		}
 //
-//		registerTranslation(physaddr, block_pc, txln);
+//		registerTranslation(thread, physaddr, block_pc, txln);
 //
 //		return true;
 //	} else {
@@ -49,22 +49,6 @@ bool BlockJITLLVMMemoryManager::finalizeMemory(std::string* ErrMsg)
 	return true;
 }
 
-static llvm::TargetMachine *GetNativeMachine()
-{
-	llvm::TargetMachine *machine = nullptr;
-
-	if(machine == nullptr) {
-		llvm::InitializeNativeTarget();
-		llvm::InitializeNativeTargetAsmPrinter();
-		llvm::InitializeNativeTargetAsmParser();
-		machine = llvm::EngineBuilder().selectTarget();
-		machine->setOptLevel(llvm::CodeGenOpt::Aggressive);
-		machine->setFastISel(false);
-		machine->setO0WantsFastISel(false);
-	}
-	return machine;
-}
-
 BlockToLLVMExecutionEngine::BlockToLLVMExecutionEngine(gensim::blockjit::BaseBlockJITTranslate *translator) :
 	BlockJITExecutionEngine(translator),
 	adaptor_(*llvm_ctx_.getContext()),
@@ -165,7 +149,7 @@ bool BlockToLLVMExecutionEngine::translateBlock(thread::ThreadInstance* thread,
 //			txln.Dump("llvm-bin-" + std::to_string(physaddr.Get()));
 //		}
 //
-//		registerTranslation(physaddr, block_pc, txln);
+//		registerTranslation(thread, physaddr, block_pc, txln);
 //
 //		return true;
 //	} else {
@@ -1,6 +1,9 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "core/execution/ExecutionContextManager.h"
+#include "util/SimOptions.h"
+
+#include <iostream>
 
 using namespace archsim;
 using namespace archsim::core::execution;
@@ -19,6 +22,26 @@ void ExecutionContextManager::AddEngine(ExecutionEngine* engine)
 
 void ExecutionContextManager::Start()
 {
+	if(archsim::options::StateBlockDump) {
+		for(auto engine : contexts_) {
+			for(auto thread : engine->GetThreads()) {
+				std::cout << "Thread " << thread->GetThreadID() << " ";
+				thread->GetStateBlock().GetDescriptor().Dump(std::cout);
+			}
+		}
+	}
+
+	// Every thread has to be known to the scheduler before any of them
+	// starts, so that the first quantum includes them all.
+	if(quantum_scheduler_) {
+		for(auto engine : contexts_) {
+			for(auto thread : engine->GetThreads()) {
+				quantum_scheduler_->AddThread(thread);
+				thread->SetQuantumScheduler(quantum_scheduler_.get());
+			}
+		}
+	}
+
 	for(auto i : contexts_) {
 		i->Start();
 	}
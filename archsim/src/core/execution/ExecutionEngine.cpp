@@ -1,6 +1,7 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "core/execution/ExecutionEngine.h"
+#include "core/execution/QuantumScheduler.h"
 #include "core/thread/ThreadInstance.h"
 
 #include <cassert>
@@ -13,7 +14,16 @@ DeclareLogContext(LogExecutionEngine, "ExecutionEngine");
 
 void ExecutionEngineThreadContext::Execute()
 {
+	auto scheduler = thread_->GetQuantumScheduler();
+	if(scheduler != nullptr) {
+		scheduler->Enter(thread_);
+	}
+
 	engine_->Execute(this);
+
+	if(scheduler != nullptr) {
+		scheduler->Leave(thread_);
+	}
 }
 
 void ExecutionEngineThreadContext::Start()
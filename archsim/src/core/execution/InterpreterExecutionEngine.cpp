@@ -7,7 +7,10 @@
 
 using namespace archsim::core::execution;
 
-InterpreterExecutionEngineThreadContext::InterpreterExecutionEngineThreadContext(ExecutionEngine* engine, thread::ThreadInstance* thread) : ExecutionEngineThreadContext(engine, thread)
+InterpreterExecutionEngineThreadContext::InterpreterExecutionEngineThreadContext(ExecutionEngine* engine, thread::ThreadInstance* thread) :
+	ExecutionEngineThreadContext(engine, thread),
+	predecoded_blocks_(thread->GetEmulationModel().GetSystem().GetPubSub()),
+	use_predecoded_blocks_(false)
 {
 	auto &isa = thread->GetArch().GetISA(0);
 	decode_ctx_ = thread->GetEmulationModel().GetNewDecodeContext(*thread);
@@ -15,6 +18,10 @@ InterpreterExecutionEngineThreadContext::InterpreterExecutionEngineThreadContext
 		decode_ctx_ = new gensim::CachedDecodeContext(thread->GetEmulationModel().GetSystem().GetPubSub(), decode_ctx_, [&isa]() {
 			return isa.GetNewDecode();
 		});
+
+		// Pre-decoded blocks rely on code invalidation events in the same
+		// way as the decode cache.
+		use_predecoded_blocks_ = !archsim::options::InterpDisablePredecode;
 	}
 }
 
@@ -54,7 +61,7 @@ ExecutionResult InterpreterExecutionEngine::Execute(ExecutionEngineThreadContext
 				}
 			}
 
-			auto result = interpreter_->StepBlock(ieetc);
+			auto result = interpreter_->ExecuteBlock(ieetc);
 			switch(result) {
 				case ExecutionResult::Continue:
 				case ExecutionResult::Exception:
@@ -18,8 +18,9 @@ LLVMRegionJITExecutionEngineContext::LLVMRegionJITExecutionEngineContext(archsim
 		throw std::logic_error("");
 	}
 
-	thread->GetStateBlock().AddBlock("page_cache", 8);
-	thread->GetStateBlock().SetEntry("page_cache", &PageCache.Cache[0]);
+	auto &state_block = thread->GetStateBlock();
+	auto page_cache = state_block.AddEntry<RegionJITCacheEntry*>("page_cache", true, true);
+	*page_cache.Get(state_block) = &PageCache.Cache[0];
 }
 
 LLVMRegionJITExecutionEngineContext::~LLVMRegionJITExecutionEngineContext()
@@ -163,7 +164,7 @@ ExecutionResult LLVMRegionJITExecutionEngine::EpochInterpret(LLVMRegionJITExecut
 		}
 
 		region->TraceBlock(thread, virt_pc);
-		auto result = interpreter_->StepBlock(ctx);
+		auto result = executeColdBlock(ctx, *region);
 
 		switch(result) {
 			case ExecutionResult::Continue:
@@ -176,6 +177,10 @@ ExecutionResult LLVMRegionJITExecutionEngine::EpochInterpret(LLVMRegionJITExecut
 	return ExecutionResult::Continue;
 }
 
+ExecutionResult LLVMRegionJITExecutionEngine::executeColdBlock(LLVMRegionJITExecutionEngineContext* ctx, archsim::translate::profile::Region& region)
+{
+	return interpreter_->ExecuteBlock(ctx);
+}
 
 ExecutionEngine* LLVMRegionJITExecutionEngine::Factory(const archsim::module::ModuleInfo* module, const std::string& cpu_prefix)
 {
@@ -0,0 +1,173 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "core/execution/QuantumScheduler.h"
+#include "core/thread/ThreadInstance.h"
+#include "abi/devices/generic/timing/TickSource.h"
+#include "util/LogContext.h"
+
+#include <algorithm>
+
+UseLogContext(LogExecutionEngine);
+
+using namespace archsim::core::execution;
+using archsim::core::thread::ThreadInstance;
+
+// The guest thread which is running on this host thread, if any
+static thread_local ThreadInstance *current_thread = nullptr;
+
+static bool ThreadIDOrder(const ThreadInstance *a, const ThreadInstance *b)
+{
+	return a->GetThreadID() < b->GetThreadID();
+}
+
+QuantumScheduler::QuantumScheduler(archsim::abi::devices::timing::InstructionTickSource& tick_source, uint32_t quantum, bool parallel) : tick_source_(tick_source), quantum_(std::max<uint32_t>(quantum, 1)), parallel_(parallel), generation_(0), arrived_(0), turn_(0), retired_(0), ending_quantum_(false)
+{
+
+}
+
+QuantumScheduler::~QuantumScheduler()
+{
+
+}
+
+void QuantumScheduler::AddThread(ThreadInstance* thread)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	if(isParticipant(thread) || std::find(pending_.begin(), pending_.end(), thread) != pending_.end()) {
+		return;
+	}
+	pending_.push_back(thread);
+}
+
+void QuantumScheduler::Enter(ThreadInstance* thread)
+{
+	current_thread = thread;
+
+	std::unique_lock<std::mutex> lock(lock_);
+	while(!mayRun(thread)) {
+		// Nobody is running a quantum to let waiting threads in at the end
+		// of, so start a new one with them.
+		if(participants_.empty()) {
+			admitPending();
+			continue;
+		}
+
+		quantum_end_.wait(lock);
+	}
+}
+
+void QuantumScheduler::Leave(ThreadInstance* thread)
+{
+	std::unique_lock<std::mutex> lock(lock_);
+	current_thread = nullptr;
+
+	auto pending = std::find(pending_.begin(), pending_.end(), thread);
+	if(pending != pending_.end()) {
+		pending_.erase(pending);
+	}
+
+	auto participant = std::find(participants_.begin(), participants_.end(), thread);
+	if(participant == participants_.end()) {
+		return;
+	}
+
+	// The leaving thread is running, so it has not yet reached the barrier
+	// and (when taking turns) it is the thread whose turn it is. Removing it
+	// hands the turn on to the next thread.
+	size_t index = participant - participants_.begin();
+	participants_.erase(participant);
+	if(index < turn_) {
+		turn_--;
+	}
+
+	if(!participants_.empty() && arrived_ == participants_.size()) {
+		endQuantum();
+	}
+	quantum_end_.notify_all();
+}
+
+void QuantumScheduler::EndQuantum(ThreadInstance* thread, uint64_t retired)
+{
+	std::unique_lock<std::mutex> lock(lock_);
+
+	retired_ += retired;
+	arrived_++;
+	turn_++;
+
+	uint64_t generation = generation_;
+	if(arrived_ == participants_.size()) {
+		endQuantum();
+	}
+	quantum_end_.notify_all();
+
+	while(generation_ == generation || !mayRun(thread)) {
+		quantum_end_.wait(lock);
+	}
+}
+
+bool QuantumScheduler::Defer(ThreadInstance* target, const DeferredAction& action)
+{
+	ThreadInstance *sender = current_thread;
+	if(sender == nullptr || sender == target || ending_quantum_) {
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(deferred_lock_);
+	deferred_[sender->GetThreadID()].push_back(action);
+	return true;
+}
+
+bool QuantumScheduler::isParticipant(ThreadInstance* thread) const
+{
+	return std::find(participants_.begin(), participants_.end(), thread) != participants_.end();
+}
+
+bool QuantumScheduler::mayRun(ThreadInstance* thread) const
+{
+	if(parallel_) {
+		return isParticipant(thread);
+	}
+	return turn_ < participants_.size() && participants_[turn_] == thread;
+}
+
+void QuantumScheduler::admitPending()
+{
+	participants_.insert(participants_.end(), pending_.begin(), pending_.end());
+	pending_.clear();
+	std::sort(participants_.begin(), participants_.end(), ThreadIDOrder);
+}
+
+// Called with lock_ held by the last thread to reach the barrier, while
+// every other thread is stopped.
+void QuantumScheduler::endQuantum()
+{
+	ending_quantum_ = true;
+
+	// Time moves on by every instruction retired during the quantum, firing
+	// any timer events which fell due in deadline order.
+	tick_source_.RetireInstructions(retired_);
+	retired_ = 0;
+
+	std::map<int, std::vector<DeferredAction>> deferred;
+	{
+		std::lock_guard<std::mutex> lock(deferred_lock_);
+		deferred.swap(deferred_);
+	}
+
+	for(auto &sender : deferred) {
+		for(auto &action : sender.second) {
+			action();
+		}
+	}
+
+	admitPending();
+
+	LC_DEBUG2(LogExecutionEngine) << "Quantum " << generation_ << " ended with " << participants_.size() << " threads";
+
+	arrived_ = 0;
+	turn_ = 0;
+	generation_++;
+
+	ending_quantum_ = false;
+}
@@ -0,0 +1,59 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "core/execution/TieredExecutionEngine.h"
+#include "core/execution/ExecutionEngineFactory.h"
+#include "blockjit/block-compiler/lowering/NativeLowering.h"
+#include "translate/profile/Region.h"
+#include "util/LogContext.h"
+#include "util/SimOptions.h"
+
+using namespace archsim::core::execution;
+
+DeclareLogContext(LogTiered, "Tiered");
+
+TieredExecutionEngineContext::TieredExecutionEngineContext(TieredExecutionEngine* engine, archsim::core::thread::ThreadInstance* thread) : LLVMRegionJITExecutionEngineContext(engine, thread), BlockJIT(&engine->blockjit_, thread, this)
+{
+
+}
+
+TieredExecutionEngine::TieredExecutionEngine(interpret::Interpreter* interp, gensim::BaseLLVMTranslate* translate, gensim::blockjit::BaseBlockJITTranslate* blockjit_translate) : LLVMRegionJITExecutionEngine(interp, translate), blockjit_(blockjit_translate)
+{
+
+}
+
+ExecutionEngineThreadContext* TieredExecutionEngine::GetNewContext(thread::ThreadInstance* thread)
+{
+	return new TieredExecutionEngineContext(this, thread);
+}
+
+ExecutionResult TieredExecutionEngine::executeColdBlock(LLVMRegionJITExecutionEngineContext* ctx, archsim::translate::profile::Region& region)
+{
+	// Don't spend time compiling code which might only run once.
+	if(!region.IsHot(archsim::options::JitTierUpThreshold)) {
+		return interpreter_->ExecuteBlock(ctx);
+	}
+
+	return blockjit_.StepBlock(&((TieredExecutionEngineContext*)ctx)->BlockJIT);
+}
+
+ExecutionEngine* TieredExecutionEngine::Factory(const archsim::module::ModuleInfo* module, const std::string& cpu_prefix)
+{
+	// need an interpreter, an LLVM translator and a blockjit translator
+	auto interpreter_entry = module->GetEntry<module::ModuleInterpreterEntry>("Interpreter");
+	auto llvm_entry = module->GetEntry<module::ModuleLLVMTranslatorEntry>("LLVMTranslator");
+
+	std::string blockjit_entry_name = cpu_prefix + "BlockJITTranslator";
+	if(interpreter_entry == nullptr || llvm_entry == nullptr || !module->HasEntry(blockjit_entry_name)) {
+		return nullptr;
+	}
+
+	if(!captive::arch::jit::lowering::HasNativeLowering()) {
+		LC_DEBUG1(LogTiered) << "No native lowering found";
+		return nullptr;
+	}
+
+	auto blockjit_entry = module->GetEntry<module::ModuleBlockJITTranslatorEntry>(blockjit_entry_name);
+	return new TieredExecutionEngine(interpreter_entry->Get(), llvm_entry->Get(), blockjit_entry->Get());
+}
+
+static ExecutionEngineFactoryRegistration registration("Tiered", 95, TieredExecutionEngine::Factory);
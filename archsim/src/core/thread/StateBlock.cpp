@@ -1,43 +1,133 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "core/thread/StateBlock.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
 #include <stdexcept>
 
 using namespace archsim;
 
-StateBlockDescriptor::StateBlockDescriptor() : total_size_(0)
+const uint32_t StateBlockDescriptor::kCacheLineSize;
+const uint32_t StateBlockDescriptor::kHotSize;
+
+// Entries are aligned to their size, up to a cache line
+static uint32_t GetAlignment(size_t size)
 {
+	uint32_t alignment = 1;
+	while(alignment < size && alignment < StateBlockDescriptor::kCacheLineSize) {
+		alignment <<= 1;
+	}
+	return alignment;
+}
 
+static uint32_t AlignUp(uint32_t offset, uint32_t alignment)
+{
+	return (offset + alignment - 1) & ~(alignment - 1);
 }
 
+StateBlockDescriptor::StateBlockDescriptor() : hot_size_(0), total_size_(kHotSize)
+{
+
+}
 
-uint32_t StateBlockDescriptor::AddBlock(const std::string& name, size_t size_in_bytes)
+uint32_t StateBlockDescriptor::AddBlock(const std::string& name, size_t size_in_bytes, bool host_only, bool hot)
 {
-	if(block_offsets_.count(name)) {
+	if(entry_index_.count(name)) {
 		throw std::logic_error("Duplicate state block entry name!");
 	}
-	block_offsets_[name] = total_size_;
-	block_sizes_in_bytes_[name] = size_in_bytes;
-	total_size_ += size_in_bytes;
-	return total_size_;
+
+	uint32_t alignment = GetAlignment(size_in_bytes);
+	uint32_t offset;
+
+	uint32_t hot_offset = AlignUp(hot_size_, alignment);
+	if(hot && hot_offset + size_in_bytes <= kHotSize) {
+		offset = hot_offset;
+		hot_size_ = offset + size_in_bytes;
+	} else {
+		offset = AlignUp(total_size_, alignment);
+		total_size_ = offset + size_in_bytes;
+	}
+
+	entry_index_[name] = entries_.size();
+	entries_.push_back({name, offset, (uint32_t)size_in_bytes, host_only, hot});
+
+	return offset;
+}
+
+const StateBlockDescriptor::Entry& StateBlockDescriptor::getEntry(const std::string& name) const
+{
+	return entries_.at(entry_index_.at(name));
 }
 
 size_t StateBlockDescriptor::GetBlockOffset(const std::string& name) const
 {
-	return block_offsets_.at(name);
+	return getEntry(name).Offset;
 }
 
 size_t StateBlockDescriptor::GetBlockSizeInBytes(const std::string& name) const
 {
-	return block_sizes_in_bytes_.at(name);
+	return getEntry(name).Size;
 }
 
+void StateBlockDescriptor::Dump(std::ostream& str) const
+{
+	std::vector<const Entry *> entries;
+	for(const auto &entry : entries_) {
+		entries.push_back(&entry);
+	}
+	std::sort(entries.begin(), entries.end(), [](const Entry *a, const Entry *b) {
+		return a->Offset < b->Offset;
+	});
 
-uint32_t StateBlock::AddBlock(const std::string& name, size_t size_in_bytes)
+	str << "State block layout (" << total_size_ << " bytes, " << hot_size_ << " of " << kHotSize << " hot bytes used)" << std::endl;
+	str << "Offset\tSize\tLine\tFlags\tName" << std::endl;
+	for(auto entry : entries) {
+		uint32_t first_line = entry->Offset / kCacheLineSize;
+		uint32_t last_line = (entry->Offset + std::max<uint32_t>(entry->Size, 1) - 1) / kCacheLineSize;
+
+		str << entry->Offset << "\t" << entry->Size << "\t" << first_line;
+		if(last_line != first_line) {
+			str << "-" << last_line;
+		}
+		str << "\t" << (entry->Hot ? "H" : "-") << (entry->HostOnly ? "h" : "-") << "\t" << entry->Name << std::endl;
+	}
+}
+
+StateBlock::StateBlock() : data_(nullptr), capacity_(0)
 {
-	uint32_t offset = data_.size();
-	descriptor_.AddBlock(name, size_in_bytes);
-	data_.resize(data_.size() + size_in_bytes);
-	return offset;
+
+}
+
+StateBlock::~StateBlock()
+{
+	free(data_);
 }
 
+uint32_t StateBlock::AddBlock(const std::string& name, size_t size_in_bytes, bool host_only, bool hot)
+{
+	uint32_t offset = descriptor_.AddBlock(name, size_in_bytes, host_only, hot);
+
+	uint32_t size = descriptor_.GetSize();
+	if(size > capacity_) {
+		uint32_t capacity = std::max(size, capacity_ * 2);
+
+		void *data;
+		if(posix_memalign(&data, StateBlockDescriptor::kCacheLineSize, capacity) != 0) {
+			throw std::bad_alloc();
+		}
+
+		memset(data, 0, capacity);
+		if(data_ != nullptr) {
+			memcpy(data, data_, capacity_);
+			free(data_);
+		}
+
+		data_ = (unsigned char *)data;
+		capacity_ = capacity;
+	}
+
+	return offset;
+}
@@ -2,13 +2,23 @@
 
 #include "abi/EmulationModel.h"
 #include "abi/devices/IRQController.h"
+#include "abi/devices/generic/timing/TickSource.h"
+#include "core/execution/QuantumScheduler.h"
 #include "core/thread/ThreadInstance.h"
 #include "core/MemoryInterface.h"
 #include "util/LogContext.h"
+#include "util/SimOptions.h"
 #include "system.h"
 
 #include <setjmp.h>
 #include <fenv.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <thread>
 
 // These are deprecated and should be removed soon
 DeclareLogContext(LogCPU, "CPU");
@@ -18,6 +28,18 @@ DeclareLogContext(LogBlockJitCpu, "BlockJIT");
 using namespace archsim;
 using namespace archsim::core::thread;
 
+static uint64_t GetHostTimeNS()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Latencies are counted in power of two buckets: bucket N holds latencies
+// of less than 2^N nanoseconds
+static uint32_t GetLatencyBucket(uint64_t latency_ns)
+{
+	return latency_ns == 0 ? 0 : 64 - __builtin_clzll(latency_ns);
+}
+
 void FPState::Apply()
 {
 	int target_rounding_mode = 0;
@@ -42,7 +64,7 @@ void FPState::Apply()
 }
 
 
-ThreadInstance::ThreadInstance(util::PubSubContext &pubsub, const ArchDescriptor& arch, archsim::abi::EmulationModel &emu_model, int thread_id) : pubsub_(pubsub), descriptor_(arch), state_block_(), features_(pubsub), emu_model_(emu_model), register_file_(arch.GetRegisterFileDescriptor()), peripherals_(*this), thread_id_(thread_id)
+ThreadInstance::ThreadInstance(util::PubSubContext &pubsub, const ArchDescriptor& arch, archsim::abi::EmulationModel &emu_model, int thread_id) : pubsub_(pubsub), descriptor_(arch), state_block_(), features_(pubsub), emu_model_(emu_model), register_file_(arch.GetRegisterFileDescriptor()), peripherals_(*this), thread_id_(thread_id), pending_irqs_(0), interrupt_posts_(0), interrupt_post_time_(0), nop_queued_(false), wake_sequence_(0), waiting_(false), instruction_batch_(1), instructions_until_retire_(1), deadline_generation_(nullptr), batch_generation_(0), quantum_scheduler_(nullptr)
 {
 	// Need to fill in structures based on arch descriptor info
 
@@ -66,20 +88,20 @@ ThreadInstance::ThreadInstance(util::PubSubContext &pubsub, const ArchDescriptor
 	// Set up default state block entries
 
 	// Set up thread pointer back to this
-	state_block_.AddBlock("thread_ptr", sizeof(this));
-	state_block_.SetEntry<ThreadInstance*>("thread_ptr", this);
+	auto thread_ptr = state_block_.AddEntry<ThreadInstance*>("thread_ptr", true, true);
+	*thread_ptr.Get(state_block_) = this;
 
 	// Set up ISA Mode ID
-	mode_offset_ = state_block_.AddBlock("ModeID", sizeof(uint32_t));
-	state_block_.SetEntry<uint32_t>("ModeID", 0);
+	mode_entry_ = state_block_.AddEntry<uint32_t>("ModeID", false, true);
+	*mode_entry_.Get(state_block_) = 0;
 
 	// Set up Ring ID
-	ring_offset_ = state_block_.AddBlock("RingID", sizeof(uint32_t));
-	state_block_.SetEntry<uint32_t>("RingID", 0);
+	ring_entry_ = state_block_.AddEntry<uint32_t>("RingID", false, true);
+	*ring_entry_.Get(state_block_) = 0;
 
 	// Set up Message Waiting
-	message_waiting_offset_ = state_block_.AddBlock("MessageWaiting", sizeof(uint32_t));
-	state_block_.SetEntry<uint32_t>("MessageWaiting", 0);
+	message_waiting_entry_ = state_block_.AddEntry<uint32_t>("MessageWaiting", true, true);
+	*message_waiting_entry_.Get(state_block_) = 0;
 
 	// Get a pointer to the PC
 	pc_ptr_ = GetRegisterFileInterface().GetTaggedSlotPointer<void*>("PC");
@@ -95,7 +117,7 @@ void ThreadInstance::ReturnToSafepoint()
 
 void ThreadInstance::SetExecutionRing(uint32_t new_ring)
 {
-	GetStateBlock().SetEntry<uint32_t>("RingID", new_ring);
+	*ring_entry_.Get(state_block_) = new_ring;
 	GetEmulationModel().GetSystem().GetPubSub().Publish(PubSubType::PrivilegeLevelChange, this);
 	LC_DEBUG1(LogCPU) << "Now executing in ring " << new_ring;
 }
@@ -217,6 +239,171 @@ void ThreadInstance::HandleIRQ()
 	}
 }
 
+void ThreadInstance::WaitForInterrupt()
+{
+	// With an instruction based clock, time stands still while the thread
+	// is parked, so the timer interrupt it is waiting for would never come.
+	if(archsim::options::InstructionTick) {
+		return;
+	}
+
+	static_assert(sizeof(wake_sequence_) == sizeof(uint32_t), "futex word must be 32 bits");
+
+	// Publish that we are waiting before sampling the sequence, so that
+	// anything sent after the check below either changes the sequence
+	// before we sleep, or sees that it has to wake us.
+	waiting_ = true;
+	uint32_t sequence = wake_sequence_;
+
+	if(!HasMessage() && pending_irqs_ == 0) {
+		// Sleep until the next timer event is due, since that is when an
+		// interrupt is most likely to arrive. Anything else which raises an
+		// interrupt wakes us itself, so the timeout only bounds the wait
+		// when the tick source cannot say when its next event is.
+		auto tick_source = GetEmulationModel().GetSystem().GetTickSource();
+		uint64_t timeout_us = archsim::abi::devices::timing::EventScheduler::kNoDeadline;
+		if(tick_source != nullptr) {
+			timeout_us = tick_source->GetMicrosecondsUntilNextEvent();
+		}
+		if(timeout_us == archsim::abi::devices::timing::EventScheduler::kNoDeadline) {
+			timeout_us = archsim::options::WaitForInterruptTimeout;
+		} else if(timeout_us == 0) {
+			// The event is already due, and will be fired shortly
+			timeout_us = 1;
+		}
+
+		struct timespec timeout;
+		timeout.tv_sec = timeout_us / 1000000;
+		timeout.tv_nsec = (timeout_us % 1000000) * 1000;
+
+		archsim::util::CounterTimerContext idle_timer(GetMetrics().IdleTime);
+		GetMetrics().IdleWaits++;
+
+		// Returns early if the sequence has already moved on, and may
+		// return spuriously, which WFI is allowed to do anyway.
+		syscall(SYS_futex, (uint32_t*)&wake_sequence_, FUTEX_WAIT_PRIVATE, sequence, &timeout, nullptr, 0);
+	}
+
+	waiting_ = false;
+}
+
+void ThreadInstance::Wake()
+{
+	wake_sequence_++;
+	if(waiting_) {
+		syscall(SYS_futex, (uint32_t*)&wake_sequence_, FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+	}
+}
+
+void ThreadInstance::RetireInstructions()
+{
+	// Under a quantum scheduler the scheduler retires instructions to the
+	// clock once every thread has finished its quantum
+	if(quantum_scheduler_ != nullptr) {
+		quantum_scheduler_->EndQuantum(this, instruction_batch_);
+		instructions_until_retire_ = instruction_batch_;
+		return;
+	}
+
+	// Only called with an instruction based clock, which always uses an
+	// InstructionTickSource
+	auto tick_source = static_cast<archsim::abi::devices::timing::InstructionTickSource*>(GetEmulationModel().GetSystem().GetTickSource());
+
+	// The batch may have been cut short by a newly scheduled event
+	uint64_t retired = instruction_batch_ - instructions_until_retire_;
+	if(retired != 0) {
+		tick_source->RetireInstructions(retired);
+	}
+
+	// Sample the generation before sizing the next batch, so that an event
+	// scheduled in between is noticed on the next instruction
+	deadline_generation_ = &tick_source->GetDeadlineGeneration();
+	batch_generation_ = deadline_generation_->load(std::memory_order_acquire);
+
+	instruction_batch_ = tick_source->GetInstructionsUntilNextEvent();
+	instructions_until_retire_ = instruction_batch_;
+}
+
+void ThreadInstance::SetQuantumScheduler(archsim::core::execution::QuantumScheduler* scheduler)
+{
+	quantum_scheduler_ = scheduler;
+	if(scheduler != nullptr) {
+		// Quanta have a fixed length, and the scheduler deals with events
+		deadline_generation_ = nullptr;
+		instruction_batch_ = scheduler->GetQuantum();
+		instructions_until_retire_ = instruction_batch_;
+	}
+}
+
+bool ThreadInstance::DeferAction(const std::function<void()>& action)
+{
+	return quantum_scheduler_ != nullptr && quantum_scheduler_->Defer(this, action);
+}
+
+void ThreadInstance::QueueMessage(ThreadMessage message)
+{
+	if(message == ThreadMessage::Interrupt) {
+		// The Interrupt message which is already queued will take this
+		// interrupt too, as it looks at every IRQ line when it is handled.
+		if(interrupt_posts_++ != 0) {
+			return;
+		}
+		interrupt_post_time_ = GetHostTimeNS();
+	} else if(message == ThreadMessage::Nop) {
+		// A Nop only makes the thread come out of translated code and look
+		// at its state again, which the queued one will do. The thread
+		// sends these to itself, and nothing else would drain the queue.
+		if(nop_queued_.exchange(true)) {
+			return;
+		}
+	}
+
+	// The queue only fills up if the thread has stopped handling messages
+	// altogether, since Interrupt and Nop messages never pile up
+	while(!message_queue_.TryPush(message)) {
+		std::this_thread::yield();
+	}
+
+	// The message must be in the queue before the flag is set, so that the
+	// thread cannot clear the flag after missing the message (see
+	// GetNextMessage)
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	__atomic_store_n(message_waiting_entry_.Get(state_block_), 1, __ATOMIC_RELAXED);
+
+	Wake();
+}
+
+ThreadMessage ThreadInstance::GetNextMessage()
+{
+	uint32_t *message_waiting = message_waiting_entry_.Get(state_block_);
+
+	// Clear the flag before looking at the queue, so that a message which
+	// we miss sets it again
+	__atomic_store_n(message_waiting, 0, __ATOMIC_RELAXED);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	ThreadMessage message;
+	if(!message_queue_.TryPop(message)) {
+		return ThreadMessage::Nop;
+	}
+
+	if(!message_queue_.IsEmpty()) {
+		__atomic_store_n(message_waiting, 1, __ATOMIC_RELAXED);
+	}
+
+	if(message == ThreadMessage::Interrupt) {
+		// Interrupts sent from here on need a new message
+		uint32_t posts = interrupt_posts_.exchange(0);
+
+		GetMetrics().InterruptsCoalesced.inc(posts - 1);
+		GetMetrics().IRQLatency.inc(GetLatencyBucket(GetHostTimeNS() - interrupt_post_time_));
+	} else if(message == ThreadMessage::Nop) {
+		nop_queued_ = false;
+	}
+
+	return message;
+}
+
 void ThreadInstance::PendIRQ()
 {
 	bool should_pend_interrupts = false;
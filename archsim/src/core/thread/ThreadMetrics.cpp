@@ -15,37 +15,9 @@ void ThreadMetricPrinter::PrintStats(const ArchDescriptor &arch, const ThreadMet
 
 	str << "Thread Metrics" << std::endl;
 
-	// TODO: Improve profiling to be per-isa
 	if(archsim::options::Profile) {
 		str << "Instruction Profile" << std::endl;
-
-		auto disasm = arch.GetISA(0).GetDisasm();
-		if(disasm != nullptr) {
-			hp.PrintHistogram(metrics.OpcodeHistogram, str, [disasm](uint32_t i) {
-				return disasm->GetInstrName(i);
-			});
-		} else {
-			str << "(No instruction disassembly available)" << std::endl;
-			hp.PrintHistogram(metrics.OpcodeHistogram, str, [disasm](uint32_t i) {
-				return std::to_string(i);
-			});
-		}
-	}
-	if(archsim::options::ProfileIrFreq) {
-		std::ofstream ir_str ("ir_freq.out");
-		hp.PrintHistogram(metrics.InstructionIRHistogram, ir_str, [](uint32_t i) {
-			std::stringstream str;
-			str << std::hex << i;
-			return str.str();
-		});
-	}
-	if(archsim::options::ProfilePcFreq) {
-		std::ofstream pc_str("pc_freq.out");
-		hp.PrintHistogram(metrics.PCHistogram, pc_str, [](uint32_t i) {
-			std::stringstream str;
-			str << std::hex << i;
-			return str.str();
-		});
+		PrintInstructionProfile(arch, metrics.OpcodeHistogram, str);
 	}
 
 	str << "Instructions: " << metrics.InstructionCount.get_value() << std::endl;
@@ -57,9 +29,15 @@ void ThreadMetricPrinter::PrintStats(const ArchDescriptor &arch, const ThreadMet
 	str << "Writes: " << metrics.Writes.get_value() << std::endl;
 	str << "Write hits: " << metrics.WriteHits.get_value() << std::endl;
 
+	str << "ITLB hits: " << metrics.ITLBHits.get_value() << std::endl;
+	str << "ITLB misses: " << metrics.ITLBMisses.get_value() << std::endl;
+	str << "DTLB hits: " << metrics.DTLBHits.get_value() << std::endl;
+	str << "DTLB misses: " << metrics.DTLBMisses.get_value() << std::endl;
+
 	str << "Self Runtime: " << metrics.SelfRuntime.GetElapsedS() << " seconds" << std::endl;
 	str << "JIT Runtime: " << metrics.JITTime.GetElapsedS() << " seconds" << std::endl;
 	str << "Interpreter Runtime: " << metrics.InterpretTime.GetElapsedS() << " seconds" << std::endl;
+	str << "Idle Runtime: " << metrics.IdleTime.GetElapsedS() << " seconds (" << metrics.IdleWaits.get_value() << " waits for interrupt)" << std::endl;
 	str << "Infrastructure Runtime: " << metrics.SelfRuntime.GetElapsedS() - (metrics.InterpretTime.GetElapsedS() + metrics.JITTime.GetElapsedS()) << " seconds" << std::endl;
 	str << "Execution Rate: " << (metrics.InstructionCount.get_value() / 1000000.0) / metrics.SelfRuntime.GetElapsedS() << " MIPS" << std::endl;
 
@@ -78,11 +56,73 @@ void ThreadMetricPrinter::PrintStats(const ArchDescriptor &arch, const ThreadMet
 	hp.PrintHistogram(metrics.JITExitReasons, str, [](uint32_t i) {
 		return std::to_string(i);
 	});
+
+	str << "Coalesced interrupts: " << metrics.InterruptsCoalesced.get_value() << std::endl;
+	str << "IRQ latency: " << std::endl;
+	hp.PrintHistogram(metrics.IRQLatency, str, [](uint32_t i) {
+		return "< " + std::to_string(1ULL << i) + " ns";
+	});
+}
+
+void ThreadMetricPrinter::PrintProfiles(const ArchDescriptor &arch, const std::vector<const ThreadMetrics *> &metrics, std::ostream &str)
+{
+	HistogramPrinter hp;
+
+	// Each thread counts into its own histograms, which are only combined
+	// here. Translated code is shared between threads, though, and has the
+	// counters of the thread which translated it built in, so other threads
+	// can count into them too. That is why they are updated atomically (see
+	// LowerCount and Histogram.h).
+	archsim::util::Histogram opcodes, irs, pcs;
+	for(auto thread_metrics : metrics) {
+		opcodes.merge(thread_metrics->OpcodeHistogram);
+		irs.merge(thread_metrics->InstructionIRHistogram);
+		pcs.merge(thread_metrics->PCHistogram);
+	}
+
+	if(archsim::options::Profile && metrics.size() > 1) {
+		str << "Combined Instruction Profile" << std::endl;
+		PrintInstructionProfile(arch, opcodes, str);
+	}
+	if(archsim::options::ProfileIrFreq) {
+		std::ofstream ir_str ("ir_freq.out");
+		hp.PrintHistogram(irs, ir_str, [](uint32_t i) {
+			std::stringstream str;
+			str << std::hex << i;
+			return str.str();
+		});
+	}
+	if(archsim::options::ProfilePcFreq) {
+		std::ofstream pc_str("pc_freq.out");
+		hp.PrintHistogram(pcs, pc_str, [](uint32_t i) {
+			std::stringstream str;
+			str << std::hex << i;
+			return str.str();
+		});
+	}
+}
+
+// TODO: Improve profiling to be per-isa
+void ThreadMetricPrinter::PrintInstructionProfile(const ArchDescriptor &arch, const archsim::util::Histogram &opcodes, std::ostream &str)
+{
+	HistogramPrinter hp;
+
+	auto disasm = arch.GetISA(0).GetDisasm();
+	if(disasm != nullptr) {
+		hp.PrintHistogram(opcodes, str, [disasm](uint32_t i) {
+			return disasm->GetInstrName(i);
+		});
+	} else {
+		str << "(No instruction disassembly available)" << std::endl;
+		hp.PrintHistogram(opcodes, str, [disasm](uint32_t i) {
+			return std::to_string(i);
+		});
+	}
 }
 
 void HistogramPrinter::PrintHistogram(const archsim::util::Histogram& hist, std::ostream& str, std::function<std::string(archsim::util::HistogramEntry::histogram_key_t) > key_formatter)
 {
 	for(auto i : hist.get_value_map()) {
-		str << key_formatter(i.first) << "\t" << *i.second << std::endl;
+		str << key_formatter(i.first) << "\t" << i.second << std::endl;
 	}
 }
@@ -1,9 +1,173 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 
 #include "interpret/Interpreter.h"
+#include "core/thread/ThreadInstance.h"
+#include "core/MemoryInterface.h"
+#include "gensim/gensim_decode.h"
+#include "translate/profile/CodeRegionTracker.h"
+#include "util/SimOptions.h"
+#include "system.h"
 
 using namespace archsim::interpret;
+using archsim::core::execution::ExecutionResult;
+using archsim::core::execution::InterpreterExecutionEngineThreadContext;
+using archsim::translate::profile::CodeRegionTracker;
 
 DeclareLogContext(LogInterpreter,"Interpreter")
 
 Interpreter::~Interpreter() {}
+
+instruction_handler_t Interpreter::GetInstructionHandler(const gensim::BaseDecode& decode, uint32_t isa_mode, bool trace)
+{
+	return nullptr;
+}
+
+ExecutionResult Interpreter::ExecuteBlock(InterpreterExecutionEngineThreadContext* thread_ctx)
+{
+	if(!thread_ctx->UsePredecodedBlocks()) {
+		return StepBlock(thread_ctx);
+	}
+
+	auto &cache = thread_ctx->GetPredecodedBlocks();
+
+	auto thread = thread_ctx->GetThread();
+
+	// Nothing can be executing from the cache at this point, so it's safe to
+	// free invalidated blocks.
+	cache.Reclaim();
+
+	Address virt_pc = thread->GetPC();
+	Address phys_pc (0);
+	if(thread->GetFetchMI().PerformTranslation(virt_pc, phys_pc, false, true, false) != archsim::TranslationResult::OK) {
+		// Let the ordinary interpreter raise the fetch fault
+		return StepBlock(thread_ctx);
+	}
+
+	PredecodedBlock *block = cache.Lookup(phys_pc, thread->GetModeID());
+	if(block == nullptr) {
+		block = predecodeBlock(thread_ctx, virt_pc, phys_pc);
+		if(block == nullptr) {
+			return StepBlock(thread_ctx);
+		}
+		cache.Insert(block);
+	}
+
+	return executePredecodedBlock(thread, *block);
+}
+
+PredecodedBlock *Interpreter::predecodeBlock(InterpreterExecutionEngineThreadContext* thread_ctx, Address virt_pc, Address phys_pc)
+{
+	auto thread = thread_ctx->GetThread();
+	uint32_t isa_mode = thread->GetModeID();
+	bool trace = archsim::options::Trace;
+
+	PredecodedBlock *block = new PredecodedBlock(phys_pc, isa_mode);
+
+	// Decode up to the end of the block, stopping early at the end of the page
+	// (so that a block only depends on one physical page) or at anything we
+	// can't handle, which will then start the next block.
+	Address pc = virt_pc;
+	uint32_t length = 0;
+	while(true) {
+		gensim::BaseDecode *decode;
+		if(thread_ctx->GetDC()->DecodeSync(thread->GetFetchMI(), pc, isa_mode, decode)) {
+			decode->Release();
+			break;
+		}
+
+		instruction_handler_t handler = nullptr;
+		if(decode->Instr_Code != (uint16_t)-1 && pc.GetPageOffset() + decode->Instr_Length <= Address::PageSize) {
+			handler = GetInstructionHandler(*decode, isa_mode, trace);
+		}
+
+		if(handler == nullptr) {
+			decode->Release();
+			break;
+		}
+
+		length += decode->Instr_Length;
+		block->AddInstruction(handler, decode);
+
+		if(decode->GetEndOfBlock()) {
+			break;
+		}
+
+		pc += decode->Instr_Length;
+		if(pc.PageBase() != virt_pc.PageBase()) {
+			break;
+		}
+	}
+
+	if(block->size() == 0) {
+		delete block;
+		return nullptr;
+	}
+
+	// The cache drops a page's blocks when code on it is written to, so the
+	// block's lines must be marked as code even if nothing else translates
+	// them.
+	thread->GetEmulationModel().GetSystem().GetCodeRegions().MarkLinesAsCode(PhysicalAddress(phys_pc.GetPageBase()), CodeRegionTracker::GetLineMask(phys_pc.GetPageOffset(), length));
+
+	return block;
+}
+
+ExecutionResult Interpreter::executePredecodedBlock(archsim::core::thread::ThreadInstance* thread, const PredecodedBlock& block)
+{
+	// Pick a copy of the dispatch loop with the per-instruction options
+	// resolved, so that the common case is just the message check and the
+	// handler call.
+	if(archsim::options::InstructionTick) {
+		if(archsim::options::Verbose) {
+			return executePredecodedBlock<true, true>(thread, block);
+		}
+		return executePredecodedBlock<true, false>(thread, block);
+	}
+	if(archsim::options::Verbose) {
+		return executePredecodedBlock<false, true>(thread, block);
+	}
+	return executePredecodedBlock<false, false>(thread, block);
+}
+
+template<bool instruction_tick, bool verbose> ExecutionResult Interpreter::executePredecodedBlock(archsim::core::thread::ThreadInstance* thread, const PredecodedBlock& block)
+{
+	auto &metrics = thread->GetMetrics();
+
+	for(const PredecodedInstruction *insn = block.begin(); insn != block.end(); ++insn) {
+		if(thread->HasMessage()) {
+			return thread->HandleMessage();
+		}
+
+		if(instruction_tick) {
+			thread->InstructionTick();
+		}
+
+		if(verbose) {
+			if(archsim::options::ProfilePcFreq) {
+				metrics.PCHistogram.inc(thread->GetPC().Get());
+			}
+			if(archsim::options::Profile) {
+				metrics.OpcodeHistogram.inc(insn->Decode->Instr_Code);
+			}
+			if(archsim::options::ProfileIrFreq) {
+				metrics.InstructionIRHistogram.inc(insn->Decode->ir);
+			}
+			metrics.InstructionCount++;
+		}
+
+		auto result = insn->Handler(thread, *insn->Decode);
+
+		if(insn->Decode->GetEndOfBlock()) {
+			return ExecutionResult::Continue;
+		}
+		if(result != ExecutionResult::Continue) {
+			return result;
+		}
+
+		// The instruction may have modified the code of this block
+		if(!block.IsValid()) {
+			break;
+		}
+	}
+
+	return ExecutionResult::Continue;
+}
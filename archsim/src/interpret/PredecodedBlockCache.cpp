@@ -0,0 +1,140 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "interpret/PredecodedBlockCache.h"
+#include "gensim/gensim_decode.h"
+
+using namespace archsim::interpret;
+
+PredecodedBlock::~PredecodedBlock()
+{
+	for(auto &insn : instructions_) {
+		insn.Decode->Release();
+	}
+}
+
+PredecodedBlockCache::PredecodedBlockCache(util::PubSubContext& pubsub) : has_retired_(false), subscriber_(pubsub)
+{
+	lookup_cache_.fill({0, nullptr});
+
+	subscriber_.Subscribe(PubSubType::RegionInvalidatePhysical, InvalidateCallback, this);
+	subscriber_.Subscribe(PubSubType::FlushTranslations, InvalidateCallback, this);
+	subscriber_.Subscribe(PubSubType::FlushAllTranslations, InvalidateCallback, this);
+}
+
+PredecodedBlockCache::~PredecodedBlockCache()
+{
+	InvalidateAll();
+	Reclaim();
+}
+
+void PredecodedBlockCache::InvalidateCallback(PubSubType::PubSubType type, void* context, const void* data)
+{
+	PredecodedBlockCache *cache = (PredecodedBlockCache*)context;
+
+	switch(type) {
+		case PubSubType::RegionInvalidatePhysical:
+			cache->InvalidatePage(Address((uint64_t)data));
+			break;
+		case PubSubType::FlushTranslations:
+		case PubSubType::FlushAllTranslations:
+			cache->InvalidateAll();
+			break;
+		default:
+			break;
+	}
+}
+
+PredecodedBlock *PredecodedBlockCache::Lookup(Address phys_addr, uint32_t isa_mode)
+{
+	uint64_t key = getKey(phys_addr, isa_mode);
+
+	auto &entry = lookup_cache_[getLookupIndex(key)];
+	if(entry.Key == key && entry.Block != nullptr && entry.Block->IsValid()) {
+		return entry.Block;
+	}
+
+	std::lock_guard<std::mutex> lock(lock_);
+
+	auto page = pages_.find(phys_addr.PageBase().Get());
+	if(page == pages_.end()) {
+		return nullptr;
+	}
+
+	auto block = page->second.find(key);
+	if(block == page->second.end()) {
+		return nullptr;
+	}
+
+	entry = {key, block->second};
+	return block->second;
+}
+
+void PredecodedBlockCache::Insert(PredecodedBlock* block)
+{
+	uint64_t key = getKey(block->GetPhysicalAddress(), block->GetISAMode());
+	lookup_cache_[getLookupIndex(key)] = {key, block};
+
+	std::lock_guard<std::mutex> lock(lock_);
+
+	auto &slot = pages_[block->GetPhysicalAddress().PageBase().Get()][key];
+	if(slot != nullptr) {
+		slot->Invalidate();
+		retired_.push_back(slot);
+		has_retired_ = true;
+	}
+	slot = block;
+}
+
+void PredecodedBlockCache::InvalidatePage(Address phys_page)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	auto page = pages_.find(phys_page.PageBase().Get());
+	if(page == pages_.end()) {
+		return;
+	}
+
+	for(auto &block : page->second) {
+		block.second->Invalidate();
+		retired_.push_back(block.second);
+	}
+	pages_.erase(page);
+	has_retired_ = true;
+}
+
+void PredecodedBlockCache::InvalidateAll()
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	for(auto &page : pages_) {
+		for(auto &block : page.second) {
+			block.second->Invalidate();
+			retired_.push_back(block.second);
+		}
+	}
+	pages_.clear();
+	has_retired_ = true;
+}
+
+void PredecodedBlockCache::Reclaim()
+{
+	if(!has_retired_.load(std::memory_order_relaxed)) {
+		return;
+	}
+
+	std::vector<PredecodedBlock *> retired;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		retired.swap(retired_);
+		has_retired_ = false;
+	}
+
+	for(auto block : retired) {
+		auto &entry = lookup_cache_[getLookupIndex(getKey(block->GetPhysicalAddress(), block->GetISAMode()))];
+		if(entry.Block == block) {
+			entry.Block = nullptr;
+		}
+
+		delete block;
+	}
+}
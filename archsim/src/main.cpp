@@ -56,10 +56,23 @@ static int run_simple_simulation(archsim::Session& session)
 #endif
 	System *simsys = new System(session);
 
+	// A deterministic simulation is timed by the instructions it executes,
+	// and block requests are completed on the guest thread which made them
+	// rather than by host I/O threads at wall-clock times
+	if(archsim::options::Deterministic) {
+		archsim::options::InstructionTick.SetValue(true);
+		archsim::options::BlockIOThreads.SetValue(0);
+	}
+
 	if(archsim::options::InstructionTick) {
-		simsys->SetTickSource(new archsim::abi::devices::timing::SubscriberTickSource(simsys->GetPubSub(), PubSubType::InstructionExecute, 1));
+		auto tick_source = new archsim::abi::devices::timing::InstructionTickSource();
+		simsys->SetTickSource(tick_source);
+
+		if(archsim::options::Deterministic) {
+			simsys->GetECM().SetQuantumScheduler(new archsim::core::execution::QuantumScheduler(*tick_source, archsim::options::DeterministicQuantum, archsim::options::DeterministicParallel));
+		}
 	} else {
-		simsys->SetTickSource(new archsim::abi::devices::timing::MicrosecondTickSource(1000));
+		simsys->SetTickSource(new archsim::abi::devices::timing::HostTimeTickSource(1000));
 	}
 
 	archsim::abi::devices::generic::block::BlockDevice *block_dev = nullptr;
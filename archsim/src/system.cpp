@@ -6,13 +6,21 @@
 #include "system.h"
 
 #include "abi/EmulationModel.h"
+#include "abi/Snapshot.h"
+#include "abi/SystemEmulationModel.h"
 #include "abi/memory/MemoryCounterEventHandler.h"
+#include "abi/memory/MemoryImage.h"
+#include "abi/memory/MemoryModel.h"
 #include "abi/devices/generic/timing/TickSource.h"
 
 #include "core/thread/ThreadInstance.h"
 #include "core/thread/ThreadMetrics.h"
 
 #include "translate/TranslationManager.h"
+#include "translate/TranslationStore.h"
+#if ARCHSIM_ENABLE_LLVM
+#include "translate/llvm/LLVMHostTarget.h"
+#endif
 
 #include "util/ComponentManager.h"
 #include "util/LogContext.h"
@@ -21,12 +29,30 @@
 
 #include "uarch/uArch.h"
 
+#include "cmake-scm.h"
+
 #include <iostream>
 #include <libtrace/TraceSink.h>
+#include <libtrace/compressed/CompressedTraceSink.h>
+#include <sys/utsname.h>
 
 DeclareLogContext(LogSystem, "System");
 DeclareLogContext(LogInfrastructure, "Infrastructure");
 
+// Describes the host which translations are generated for
+static std::string HostTargetDescription()
+{
+#if ARCHSIM_ENABLE_LLVM
+	return archsim::translate::translate_llvm::LLVMHostTarget::Get().GetDescription();
+#else
+	struct utsname host;
+	if(uname(&host)) {
+		return "unknown";
+	}
+	return host.machine;
+#endif
+}
+
 System::System(archsim::Session& session) :
 	session(session),
 	exit_code(EXIT_SUCCESS),
@@ -64,6 +90,13 @@ bool System::Initialise()
 
 			sink = new libtrace::BinaryFileTraceSink(archsim::options::TraceFile.GetValue());
 
+		} else if(archsim::options::TraceMode == "compressed") {
+			if(!archsim::options::TraceFile.IsSpecified()) {
+				UNIMPLEMENTED;
+			}
+
+			sink = new libtrace::CompressedFileTraceSink(archsim::options::TraceFile.GetValue());
+
 		} else {
 			UNIMPLEMENTED;
 		}
@@ -98,6 +131,15 @@ bool System::Initialise()
 		return false;
 	}
 
+	if(archsim::options::JitLoadTranslations || archsim::options::JitSaveTranslations) {
+		// Stored translations are only valid for the simulator build,
+		// emulation model, memory models and host target which produced
+		// them. The memory models decide how translated code reaches guest
+		// memory, and which state block entries it uses.
+		std::string config_tag = std::string(QUOTEME(SCM_REV)) + "/" + archsim::options::EmulationModel.GetValue() + "/" + archsim::options::MemoryModel.GetValue() + "/" + archsim::options::SystemMemoryModel.GetValue() + "/" + HostTargetDescription();
+		archsim::translate::TranslationStore::Singleton.Open(archsim::options::JitTranslationStore.GetValue(), config_tag);
+	}
+
 	return true;
 }
 
@@ -112,6 +154,10 @@ void System::Destroy()
 		GetECM().GetTraceSink()->Flush();
 	}
 
+	if(archsim::options::JitSaveTranslations) {
+		archsim::translate::TranslationStore::Singleton.Save();
+	}
+
 	emulation_model->Destroy();
 	delete emulation_model;
 
@@ -128,12 +174,23 @@ void System::PrintStatistics(std::ostream& stream)
 
 	stream << "Thread Statistics" << std::endl;
 	archsim::core::thread::ThreadMetricPrinter printer;
+	std::vector<const archsim::core::thread::ThreadMetrics *> thread_metrics;
+	const archsim::ArchDescriptor *arch = nullptr;
 	for(auto context : GetECM()) {
 		for(auto thread : context->GetThreads()) {
 			printer.PrintStats(thread->GetArch(), thread->GetMetrics(), stream);
+			thread_metrics.push_back(&thread->GetMetrics());
+			arch = &thread->GetArch();
 		}
 	}
 
+	if(arch != nullptr) {
+		printer.PrintProfiles(*arch, thread_metrics, stream);
+	}
+
+	stream << "Code Region Statistics" << std::endl;
+	code_region_tracker_.PrintStatistics(stream);
+
 	stream << "Simulation Statistics" << std::endl;
 
 	// Print Emulation Model statistics
@@ -144,12 +201,62 @@ void System::PrintStatistics(std::ostream& stream)
 	stream << std::endl;
 }
 
+static std::string GetSnapshotConfigTag()
+{
+	// Snapshots are only valid for the simulator build and emulation model
+	// which produced them.
+	return std::string(QUOTEME(SCM_REV)) + "/" + archsim::options::EmulationModel.GetValue();
+}
+
 bool System::RunSimulation()
 {
 	if (!emulation_model->PrepareBoot(*this)) return false;
+
+	if(archsim::options::SnapshotRestore.IsSpecified() || archsim::options::SnapshotSave.IsSpecified()) {
+		if(dynamic_cast<archsim::abi::SystemEmulationModel*>(emulation_model) == nullptr) {
+			LC_ERROR(LogSystem) << "Snapshots are only supported for system emulation";
+			return false;
+		}
+	}
+
+	if(archsim::options::SnapshotRestore.IsSpecified()) {
+		auto &model = *dynamic_cast<archsim::abi::SystemEmulationModel*>(emulation_model);
+
+		snapshot_.reset(new archsim::abi::Snapshot());
+		if(!snapshot_->Restore(model, archsim::options::SnapshotRestore.GetValue(), GetSnapshotConfigTag(), !archsim::options::SnapshotEagerRestore)) {
+			LC_ERROR(LogSystem) << "Unable to restore snapshot '" << archsim::options::SnapshotRestore.GetValue() << "'";
+			return false;
+		}
+	}
+
 	GetECM().Start();
 	GetECM().Join();
 
+	if(archsim::options::SnapshotSave.IsSpecified()) {
+		auto &model = *dynamic_cast<archsim::abi::SystemEmulationModel*>(emulation_model);
+
+		if(!archsim::abi::Snapshot::Save(model, archsim::options::SnapshotSave.GetValue(), GetSnapshotConfigTag())) {
+			LC_ERROR(LogSystem) << "Unable to save snapshot '" << archsim::options::SnapshotSave.GetValue() << "'";
+			return false;
+		}
+	}
+
+	if(archsim::options::MemoryImageSave.IsSpecified()) {
+		auto memory = dynamic_cast<archsim::abi::memory::RegionBasedMemoryModel*>(&emulation_model->GetMemoryModel());
+
+		// Rewriting the image which guest memory is mapped from would pull
+		// the pages out from under it
+		if(memory == nullptr || archsim::options::MemoryImageSave.GetValue() == archsim::options::MemoryImage.GetValue()) {
+			LC_ERROR(LogSystem) << "Unable to save memory image '" << archsim::options::MemoryImageSave.GetValue() << "' from this memory model";
+			return false;
+		}
+
+		if(!archsim::abi::memory::MemoryImage::Save(*memory, archsim::options::MemoryImageSave.GetValue())) {
+			LC_ERROR(LogSystem) << "Unable to save memory image '" << archsim::options::MemoryImageSave.GetValue() << "'";
+			return false;
+		}
+	}
+
 	return true;
 }
 
@@ -11,13 +11,14 @@
 #include "translate/TranslationEngine.h"
 #include "translate/TranslationWorkUnit.h"
 #include "translate/profile/Region.h"
+#include "translate/llvm/LLVMHostTarget.h"
 #include "translate/llvm/LLVMOptimiser.h"
 #include "util/ComponentManager.h"
 #include "util/LogContext.h"
 #include "util/SimOptions.h"
 
 UseLogContext(LogTranslate);
-DeclareChildLogContext(LogWorkQueue, LogTranslate, "WorkQueue");
+UseLogContext(LogWorkQueue);
 
 using namespace archsim::translate;
 
@@ -27,16 +28,13 @@ AsynchronousTranslationManager::AsynchronousTranslationManager(util::PubSubConte
 
 AsynchronousTranslationManager::~AsynchronousTranslationManager() { }
 
-bool WorkUnitQueueComparator::operator()(const TranslationWorkUnit* lhs, const TranslationWorkUnit* rhs) const
-{
-	return lhs->GetWeight() < rhs->GetWeight();
-}
-
 bool AsynchronousTranslationManager::Initialise(gensim::BaseLLVMTranslate *translate)
 {
 	if (!TranslationManager::Initialise())
 		return false;
 
+	work_unit_queue_ = std::unique_ptr<WorkUnitQueue>(new WorkUnitQueue(archsim::options::JitThreads));
+
 	for (unsigned int i = 0; i < archsim::options::JitThreads; i++) {
 		auto worker = new AsynchronousTranslationWorker(*this, i, translate);
 		workers.push_back(worker);
@@ -50,15 +48,7 @@ void AsynchronousTranslationManager::Destroy()
 {
 	// No point notfiying threads here of the change to the queue, as they are
 	// about to be terminated.
-	work_unit_queue_lock.lock();
-
-	while(!work_unit_queue_.empty()) {
-		auto i = work_unit_queue_.back();
-		work_unit_queue_.pop_back();
-		delete i;
-	}
-
-	work_unit_queue_lock.unlock();
+	work_unit_queue_->Clear();
 
 	while (!workers.empty()) {
 		auto worker = workers.front();
@@ -75,7 +65,7 @@ bool AsynchronousTranslationManager::UpdateThreshold()
 {
 	auto initial_threshold = curr_hotspot_threshold;
 
-	if (work_unit_queue_.size() > workers.size() * 2) {
+	if (work_unit_queue_->Size() > workers.size() * 2) {
 		curr_hotspot_threshold *= 10;
 
 		// Cap the threshold to stop it from overflowing
@@ -110,14 +100,8 @@ bool AsynchronousTranslationManager::TranslateRegion(archsim::core::thread::Thre
 		return false;
 	}
 
-	// Acquire the work unit queue lock.
-	work_unit_queue_lock.lock();
-
-	work_unit_queue_.push_back(twu);
-	LC_DEBUG1(LogWorkQueue) << "[ENQUEUE] Enqueueing " << *twu << ", queue length " << work_unit_queue_.size() << " threshold " << curr_hotspot_threshold;
-
-	work_unit_queue_cond.notify_one();
-	work_unit_queue_lock.unlock();
+	LC_DEBUG1(LogWorkQueue) << "[ENQUEUE] Enqueueing " << *twu << ", queue length " << work_unit_queue_->Size() << " threshold " << curr_hotspot_threshold;
+	work_unit_queue_->Push(twu);
 
 	return true;
 }
@@ -126,9 +110,9 @@ void AsynchronousTranslationManager::PrintStatistics(std::ostream& stream)
 {
 	TranslationManager::PrintStatistics(stream);
 
-	work_unit_queue_lock.lock();
-	stream << "Work Queue Size: " << work_unit_queue_.size() << std::endl;
-	work_unit_queue_lock.unlock();
+	work_unit_queue_->PrintStatistics(stream);
+
+	translate_llvm::LLVMHostTarget::Get().PrintStatistics(stream);
 
 	stream << "-----------------------------------------------------" << std::endl;
 	stream << "#  Generation    Optimisation  Compilation" << std::endl;
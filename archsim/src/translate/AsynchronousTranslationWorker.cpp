@@ -48,76 +48,23 @@ AsynchronousTranslationWorker::AsynchronousTranslationWorker(AsynchronousTransla
  */
 void AsynchronousTranslationWorker::run()
 {
-
-	// Instantiate the unique lock for the work unit queue.
-	std::unique_lock<std::mutex> queue_lock(mgr.work_unit_queue_lock, std::defer_lock);
-
 	// Loop until told to terminate.
 	while (!terminate) {
-		// Acquire the work unit queue lock.
-		queue_lock.lock();
-
-		// Loop until work becomes available, or we're asked to terminate.
-		while (mgr.work_unit_queue_.empty() && !terminate) {
-			// first do a bit of busy work
+		// Do a bit of busy work while there is nothing to translate
+		if(mgr.work_unit_queue_->Size() == 0) {
 			compiler_.GC();
-
-			// Wait on the work unit queue signal.
-			mgr.work_unit_queue_cond.wait(queue_lock);
 		}
 
-		// If we woke up because we were asked to terminate, then release the
-		// work unit queue lock and exit the loop.
-		if (terminate) {
-			queue_lock.unlock();
-			break;
-		}
-
-		// Dequeue the translation work unit.
-		TranslationWorkUnit *unit;
-
-		// Skip over work units that are invalid.
-		do {
-			// Detect the case when we've cleared the work unit queue of valid translations.
-			if (mgr.work_unit_queue_.empty()) {
-				unit = NULL;
-				break;
-			}
-
+		// Dequeue the hottest valid translation work unit, waiting for one to
+		// become available if necessary.
+		TranslationWorkUnit *unit = mgr.work_unit_queue_->Pop(id);
 
-			auto best_it = mgr.work_unit_queue_.begin();
-			uint64_t max_heat = (*best_it)->GetWeight();
-			auto it = mgr.work_unit_queue_.begin();
-			while(it != mgr.work_unit_queue_.end()) {
-				auto this_heat = (*it)->GetWeight();
-				if(this_heat > max_heat) {
-					max_heat = this_heat;
-					best_it = it;
-				}
-				it++;
-			}
-			unit = *best_it;
-			mgr.work_unit_queue_.erase(best_it);
-
-			if (!unit->GetRegion().IsValid()) {
-				LC_DEBUG1(LogWorkQueue) << "[DEQUEUE] Skipping " << *unit;
-				delete unit;
-
-				//Setting unit to null here will cause us to break out of this do, while loop,
-				//and then hit the continue a little later on in the main while loop. This
-				//entire loop is somewhat too complicated and should be broken up.
-				unit = NULL;
-				break;
-			}
-		} while (!terminate && !unit->GetRegion().IsValid());
-
-		// Release the queue lock.
-		queue_lock.unlock();
-
-		if (terminate || !unit)
+		if (terminate || !unit) {
+			delete unit;
 			continue;
+		}
 
-		LC_DEBUG1(LogWorkQueue) << "[DEQUEUE] Dequeueing " << *unit << ", queue length " << mgr.work_unit_queue_.size() << ", @ " << (uint32_t)id;
+		LC_DEBUG1(LogWorkQueue) << "[DEQUEUE] Dequeueing " << *unit << ", queue length " << mgr.work_unit_queue_->Size() << ", @ " << (uint32_t)id;
 
 		// Perform the translation, and destroy the translation work unit.
 		Translate(*unit);
@@ -134,10 +81,8 @@ void AsynchronousTranslationWorker::stop()
 	// Set the termination flag.
 	terminate = true;
 
-	// Signal the thread to wake-up, if it's waiting on the work unit queue lock.
-	mgr.work_unit_queue_lock.lock();
-	mgr.work_unit_queue_cond.notify_all();
-	mgr.work_unit_queue_lock.unlock();
+	// Wake the thread up, if it's waiting on the work unit queue.
+	mgr.work_unit_queue_->Terminate();
 
 	// Wait for the thread to terminate.
 	join();
@@ -171,11 +116,26 @@ void AsynchronousTranslationWorker::Translate(TranslationWorkUnit& unit)
 
 		LC_DEBUG2(LogTranslate) << "[" << (uint32_t)id << "] Translating: " << unit;
 
-		translate_llvm::LLVMWorkUnitTranslator txltr(translate_, *llvm_ctx_.getContext());
-		auto txlt_result = txltr.TranslateWorkUnit(unit);
+		// If this region has been compiled by a previous run, skip IR
+		// generation and let the compiler load the stored object instead.
+		auto &object_cache = compiler_.GetObjectCache();
+		auto store_key = LLVMObjectCache::GetStoreKey(unit);
+
+		llvm::Module *module;
+		llvm::Function *function = nullptr;
+		if(object_cache.HasObject(store_key)) {
+			module = object_cache.CreateStubModule(store_key, unit, *llvm_ctx_.getContext());
+		} else {
+			translate_llvm::LLVMWorkUnitTranslator txltr(translate_, *llvm_ctx_.getContext());
+			auto txlt_result = txltr.TranslateWorkUnit(unit);
+
+			module = txlt_result.first;
+			function = txlt_result.second;
+			object_cache.AttachKey(module, store_key);
+		}
 
 		// compile
-		auto txln = CompileModule(unit, txlt_result.first, txlt_result.second);
+		auto txln = CompileModule(unit, module, function);
 
 		if (!txln) {
 			LC_ERROR(LogTranslate) << "[" << (uint32_t)id << "] Translation Failed: " << unit;
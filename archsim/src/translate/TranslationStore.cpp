@@ -0,0 +1,477 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "translate/TranslationStore.h"
+#include "util/LogContext.h"
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+DeclareLogContext(LogTranslationStore, "TranslationStore");
+
+using namespace archsim::translate;
+
+TranslationStore TranslationStore::Singleton;
+
+static const char kMagic[8] = { 'A', 'S', 'I', 'M', 'T', 'X', 'S', 0 };
+
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t tag_size;
+	uint32_t object_count;
+	uint32_t reserved;
+	uint64_t entry_count;
+};
+
+struct TranslationStore::EntryHeader {
+	TranslationStoreKey key;
+	uint32_t code_size;
+	uint32_t relocation_count;
+	uint32_t feature_count;
+	uint32_t total_size;
+};
+
+struct StoredFeature {
+	uint32_t id;
+	uint32_t level;
+};
+
+struct StoredRelocation {
+	uint32_t offset;
+	uint32_t object;
+	uint64_t object_offset;
+};
+
+static size_t align8(size_t size)
+{
+	return (size + 7) & ~7;
+}
+
+namespace
+{
+	// Helpers for mapping host pointers to and from (shared object, offset)
+	// pairs, so that code can be relinked if the simulator or its modules are
+	// loaded at a different address.
+	struct HostObjectQuery {
+		uintptr_t address;
+		const char *name_in;
+		std::string name_out;
+		uintptr_t base;
+		bool found;
+	};
+
+	int find_object_containing(struct dl_phdr_info *info, size_t size, void *data)
+	{
+		HostObjectQuery *query = (HostObjectQuery*)data;
+
+		for(int i = 0; i < info->dlpi_phnum; ++i) {
+			const auto &phdr = info->dlpi_phdr[i];
+			if(phdr.p_type != PT_LOAD) continue;
+
+			uintptr_t start = info->dlpi_addr + phdr.p_vaddr;
+			if(query->address >= start && query->address < start + phdr.p_memsz) {
+				query->name_out = info->dlpi_name;
+				query->base = info->dlpi_addr;
+				query->found = true;
+				return 1;
+			}
+		}
+
+		return 0;
+	}
+
+	int find_object_named(struct dl_phdr_info *info, size_t size, void *data)
+	{
+		HostObjectQuery *query = (HostObjectQuery*)data;
+
+		if(!strcmp(info->dlpi_name, query->name_in)) {
+			query->base = info->dlpi_addr;
+			query->found = true;
+			return 1;
+		}
+
+		return 0;
+	}
+}
+
+std::string TranslationStoreKey::ToString() const
+{
+	std::ostringstream str;
+	str << "txln_" << std::hex << PageHash << "_" << Address << "_" << FeatureHash << "_" << ShapeHash << "_" << ISAMode << "_" << (uint32_t)Kind;
+	return str.str();
+}
+
+size_t TranslationStoreKeyHash::operator()(const TranslationStoreKey &key) const
+{
+	return key.PageHash ^ (key.Address * 0x9e3779b97f4a7c15ULL) ^ key.FeatureHash ^ key.ShapeHash ^ ((uint64_t)key.ISAMode << 48) ^ (uint64_t)key.Kind;
+}
+
+bool StoredTranslation::Relocate(uint8_t *code) const
+{
+	for(const auto &reloc : relocations_) {
+		HostObjectQuery query;
+		query.name_in = reloc.Object.c_str();
+		query.found = false;
+		dl_iterate_phdr(find_object_named, &query);
+
+		if(!query.found) {
+			LC_DEBUG1(LogTranslationStore) << "Could not find host object '" << reloc.Object << "' to relocate against";
+			return false;
+		}
+
+		uint64_t target = query.base + reloc.ObjectOffset;
+		memcpy(code + reloc.Offset, &target, sizeof(target));
+	}
+
+	return true;
+}
+
+TranslationStore::TranslationStore() : open_(false), mapping_(nullptr), mapping_size_(0), hits_(0), misses_(0)
+{
+
+}
+
+TranslationStore::~TranslationStore()
+{
+	close();
+}
+
+void TranslationStore::close()
+{
+	if(mapping_ != nullptr) {
+		munmap((void*)mapping_, mapping_size_);
+		mapping_ = nullptr;
+		mapping_size_ = 0;
+	}
+
+	index_.clear();
+	pending_.clear();
+	objects_.clear();
+	open_ = false;
+}
+
+uint64_t TranslationStore::Hash(const void *data, size_t size, uint64_t seed)
+{
+	// FNV-1a over 64 bit words where possible
+	const uint8_t *bytes = (const uint8_t*)data;
+	uint64_t hash = seed;
+
+	size_t i = 0;
+	for(; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash ^= word;
+		hash *= 0x100000001b3ULL;
+	}
+	for(; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+uint64_t TranslationStore::HashFeatures(const archsim::ProcessorFeatureSet &features)
+{
+	uint64_t hash = Hash(nullptr, 0);
+	for(const auto &i : features) {
+		StoredFeature feature = { i.first, i.second };
+		hash = Hash(&feature, sizeof(feature), hash);
+	}
+	return hash;
+}
+
+uint64_t TranslationStore::HashStateBlock(const archsim::StateBlockDescriptor &descriptor)
+{
+	uint64_t hash = Hash(nullptr, 0);
+	for(const auto &entry : descriptor.GetEntries()) {
+		uint32_t layout[] = { entry.Offset, entry.Size };
+		hash = Hash(entry.Name.data(), entry.Name.size(), hash);
+		hash = Hash(layout, sizeof(layout), hash);
+	}
+	return hash;
+}
+
+bool TranslationStore::Open(const std::string &filename, const std::string &config_tag)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	close();
+
+	filename_ = filename;
+	config_tag_ = config_tag;
+	open_ = true;
+
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		LC_DEBUG1(LogTranslationStore) << "No translation store found at " << filename << ", starting with an empty store";
+		return true;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) || st.st_size < (off_t)sizeof(FileHeader)) {
+		::close(fd);
+		LC_WARNING(LogTranslationStore) << "Translation store " << filename << " is invalid, ignoring it";
+		return true;
+	}
+
+	void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+
+	if(mapping == MAP_FAILED) {
+		LC_WARNING(LogTranslationStore) << "Could not map translation store " << filename;
+		return true;
+	}
+
+	mapping_ = (const uint8_t*)mapping;
+	mapping_size_ = st.st_size;
+
+	if(!loadIndex(mapping_, mapping_size_)) {
+		LC_WARNING(LogTranslationStore) << "Translation store " << filename << " is corrupt or was produced by a different configuration, ignoring it";
+		munmap(mapping, mapping_size_);
+		mapping_ = nullptr;
+		mapping_size_ = 0;
+		index_.clear();
+		objects_.clear();
+	}
+
+	LC_DEBUG1(LogTranslationStore) << "Loaded " << index_.size() << " translations from " << filename;
+	return true;
+}
+
+bool TranslationStore::loadIndex(const uint8_t *data, size_t size)
+{
+	const FileHeader *header = (const FileHeader*)data;
+	if(memcmp(header->magic, kMagic, sizeof(kMagic)) || header->version != kVersion) {
+		return false;
+	}
+
+	size_t offset = sizeof(FileHeader);
+	if(offset + header->tag_size > size) return false;
+	if(std::string((const char*)data + offset, header->tag_size) != config_tag_) {
+		return false;
+	}
+	offset = align8(offset + header->tag_size);
+
+	for(uint32_t i = 0; i < header->object_count; ++i) {
+		uint32_t length;
+		if(offset + sizeof(length) > size) return false;
+		memcpy(&length, data + offset, sizeof(length));
+		offset += sizeof(length);
+
+		if(offset + length > size) return false;
+		objects_.push_back(std::string((const char*)data + offset, length));
+		offset += length;
+	}
+	offset = align8(offset);
+
+	for(uint64_t i = 0; i < header->entry_count; ++i) {
+		if(offset + sizeof(EntryHeader) > size) return false;
+
+		const EntryHeader *entry = (const EntryHeader*)(data + offset);
+		if(entry->total_size > size - offset || !isValidEntry(data + offset)) return false;
+
+		index_[entry->key] = data + offset;
+		offset += entry->total_size;
+	}
+
+	return true;
+}
+
+// Check that everything readEntry and Relocate will read from the entry lies
+// within it. The entry header itself is known to be in range.
+bool TranslationStore::isValidEntry(const uint8_t *data) const
+{
+	const EntryHeader *entry = (const EntryHeader*)data;
+
+	uint64_t required_size = sizeof(EntryHeader);
+	required_size += (uint64_t)entry->feature_count * sizeof(StoredFeature);
+	required_size += (uint64_t)entry->relocation_count * sizeof(StoredRelocation);
+	required_size += entry->code_size;
+	if(required_size > entry->total_size || entry->total_size != align8(entry->total_size)) {
+		return false;
+	}
+
+	const StoredRelocation *relocations = (const StoredRelocation*)(data + sizeof(EntryHeader) + entry->feature_count * sizeof(StoredFeature));
+	for(uint32_t i = 0; i < entry->relocation_count; ++i) {
+		if(relocations[i].object >= objects_.size()) return false;
+		if((uint64_t)relocations[i].offset + sizeof(uint64_t) > entry->code_size) return false;
+	}
+
+	return true;
+}
+
+void TranslationStore::readEntry(const uint8_t *data, StoredTranslation &txln)
+{
+	const EntryHeader *entry = (const EntryHeader*)data;
+	const StoredFeature *features = (const StoredFeature*)(entry + 1);
+	const StoredRelocation *relocations = (const StoredRelocation*)(features + entry->feature_count);
+
+	txln.features_ = archsim::ProcessorFeatureSet();
+	for(uint32_t i = 0; i < entry->feature_count; ++i) {
+		txln.features_.AddFeature(features[i].id);
+		txln.features_.SetFeatureLevel(features[i].id, features[i].level);
+	}
+
+	txln.relocations_.clear();
+	for(uint32_t i = 0; i < entry->relocation_count; ++i) {
+		txln.relocations_.push_back({relocations[i].offset, objects_.at(relocations[i].object), relocations[i].object_offset});
+	}
+
+	txln.code_ = (const uint8_t*)(relocations + entry->relocation_count);
+	txln.size_ = entry->code_size;
+}
+
+bool TranslationStore::Contains(const TranslationStoreKey &key)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+	return index_.count(key);
+}
+
+bool TranslationStore::Lookup(const TranslationStoreKey &key, StoredTranslation &txln)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	auto entry = index_.find(key);
+	if(entry == index_.end()) {
+		misses_++;
+		return false;
+	}
+
+	hits_++;
+	readEntry(entry->second, txln);
+	return true;
+}
+
+uint32_t TranslationStore::getObjectIndex(const std::string &name)
+{
+	for(uint32_t i = 0; i < objects_.size(); ++i) {
+		if(objects_[i] == name) return i;
+	}
+
+	objects_.push_back(name);
+	return objects_.size() - 1;
+}
+
+bool TranslationStore::Insert(const TranslationStoreKey &key, const void *code, size_t size, const std::vector<HostRelocation> &relocations, const archsim::ProcessorFeatureSet &required_features)
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	if(!open_ || index_.count(key)) {
+		return false;
+	}
+
+	std::vector<StoredRelocation> stored_relocations;
+	for(const auto &reloc : relocations) {
+		HostObjectQuery query;
+		query.address = (uintptr_t)reloc.Target;
+		query.found = false;
+		dl_iterate_phdr(find_object_containing, &query);
+
+		if(!query.found) {
+			// The code refers to something which isn't part of a loaded
+			// object (e.g. heap data), so it can't be reused.
+			LC_DEBUG1(LogTranslationStore) << "Not storing " << key.ToString() << ": it refers to unrelocatable host address " << reloc.Target;
+			return false;
+		}
+
+		stored_relocations.push_back({reloc.Offset, getObjectIndex(query.name_out), (uint64_t)reloc.Target - query.base});
+	}
+
+	std::vector<StoredFeature> stored_features;
+	for(const auto &i : required_features) {
+		stored_features.push_back({i.first, i.second});
+	}
+
+	size_t total_size = sizeof(EntryHeader) + stored_features.size() * sizeof(StoredFeature) + stored_relocations.size() * sizeof(StoredRelocation) + size;
+	total_size = align8(total_size);
+
+	std::unique_ptr<std::vector<uint8_t>> buffer (new std::vector<uint8_t>(total_size, 0));
+	uint8_t *ptr = buffer->data();
+
+	EntryHeader header;
+	memset(&header, 0, sizeof(header));
+	header.key = key;
+	header.code_size = size;
+	header.relocation_count = stored_relocations.size();
+	header.feature_count = stored_features.size();
+	header.total_size = total_size;
+
+	memcpy(ptr, &header, sizeof(header));
+	ptr += sizeof(header);
+	if(!stored_features.empty()) memcpy(ptr, stored_features.data(), stored_features.size() * sizeof(StoredFeature));
+	ptr += stored_features.size() * sizeof(StoredFeature);
+	if(!stored_relocations.empty()) memcpy(ptr, stored_relocations.data(), stored_relocations.size() * sizeof(StoredRelocation));
+	ptr += stored_relocations.size() * sizeof(StoredRelocation);
+	memcpy(ptr, code, size);
+
+	index_[key] = buffer->data();
+	pending_.push_back(std::move(buffer));
+
+	return true;
+}
+
+bool TranslationStore::Save()
+{
+	std::lock_guard<std::mutex> lock(lock_);
+
+	if(!open_) {
+		return false;
+	}
+	if(pending_.empty()) {
+		return true;
+	}
+
+	std::string temp_filename = filename_ + ".tmp";
+	FILE *file = fopen(temp_filename.c_str(), "wb");
+	if(file == nullptr) {
+		LC_ERROR(LogTranslationStore) << "Could not open " << temp_filename << " for writing";
+		return false;
+	}
+
+	const uint8_t padding[8] = {0};
+
+	FileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, kMagic, sizeof(kMagic));
+	header.version = kVersion;
+	header.tag_size = config_tag_.size();
+	header.object_count = objects_.size();
+	header.entry_count = index_.size();
+
+	size_t offset = 0;
+	offset += fwrite(&header, 1, sizeof(header), file);
+	offset += fwrite(config_tag_.data(), 1, config_tag_.size(), file);
+	offset += fwrite(padding, 1, align8(offset) - offset, file);
+
+	for(const auto &object : objects_) {
+		uint32_t length = object.size();
+		offset += fwrite(&length, 1, sizeof(length), file);
+		offset += fwrite(object.data(), 1, length, file);
+	}
+	offset += fwrite(padding, 1, align8(offset) - offset, file);
+
+	for(const auto &entry : index_) {
+		const EntryHeader *entry_header = (const EntryHeader*)entry.second;
+		offset += fwrite(entry.second, 1, entry_header->total_size, file);
+	}
+
+	bool success = !ferror(file);
+	fclose(file);
+
+	if(!success || rename(temp_filename.c_str(), filename_.c_str())) {
+		LC_ERROR(LogTranslationStore) << "Failed to write translation store " << filename_;
+		unlink(temp_filename.c_str());
+		return false;
+	}
+
+	LC_INFO(LogTranslationStore) << "Saved " << index_.size() << " translations to " << filename_ << " (" << hits_ << " hits, " << misses_ << " misses this run)";
+	return true;
+}
@@ -18,7 +18,7 @@ UseLogContext(LogTranslate);
 using namespace archsim::translate;
 using namespace archsim::translate::interrupts;
 
-TranslationWorkUnit::TranslationWorkUnit(archsim::core::thread::ThreadInstance *thread, profile::Region& region, uint32_t generation, uint32_t weight) : thread(thread), region(region), generation(generation), weight(weight), emit_trace_calls(thread->GetTraceSource() != nullptr)
+TranslationWorkUnit::TranslationWorkUnit(archsim::core::thread::ThreadInstance *thread, profile::Region& region, uint32_t generation, uint32_t weight) : thread(thread), region(region), generation(generation), weight(weight), emit_trace_calls(thread != nullptr && thread->GetTraceSource() != nullptr)
 {
 	region.Acquire();
 	dispatch_heat_ = region.GetTotalInterpCount();
@@ -33,7 +33,14 @@ TranslationWorkUnit::~TranslationWorkUnit()
 
 uint32_t TranslationWorkUnit::GetWeight() const
 {
-	return GetRegion().GetTotalInterpCount() - dispatch_heat_;
+	// The region's heat is reset when it is invalidated
+	uint64_t heat = GetRegion().GetTotalInterpCount();
+	if(heat < dispatch_heat_) {
+		return 0;
+	}
+
+	heat -= dispatch_heat_;
+	return heat > UINT32_MAX ? UINT32_MAX : heat;
 }
 
 
@@ -0,0 +1,260 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "translate/WorkUnitQueue.h"
+#include "translate/TranslationWorkUnit.h"
+#include "translate/profile/Region.h"
+#include "util/LogContext.h"
+
+#include <iomanip>
+
+UseLogContext(LogTranslate);
+DeclareChildLogContext(LogWorkQueue, LogTranslate, "WorkQueue");
+
+using namespace archsim::translate;
+
+constexpr std::chrono::milliseconds WorkUnitQueue::kRefreshInterval;
+
+void WorkUnitQueue::Shard::Swap(size_t a, size_t b)
+{
+	std::swap(Heap[a], Heap[b]);
+	Index[&Heap[a].Unit->GetRegion()] = a;
+	Index[&Heap[b].Unit->GetRegion()] = b;
+}
+
+void WorkUnitQueue::Shard::SiftUp(size_t i)
+{
+	while(i > 0) {
+		size_t parent = (i - 1) / 2;
+		if(Heap[parent].Weight >= Heap[i].Weight) break;
+
+		Swap(i, parent);
+		i = parent;
+	}
+}
+
+void WorkUnitQueue::Shard::SiftDown(size_t i)
+{
+	while(true) {
+		size_t left = (2 * i) + 1, right = left + 1, largest = i;
+
+		if(left < Heap.size() && Heap[left].Weight > Heap[largest].Weight) largest = left;
+		if(right < Heap.size() && Heap[right].Weight > Heap[largest].Weight) largest = right;
+		if(largest == i) break;
+
+		Swap(i, largest);
+		i = largest;
+	}
+}
+
+void WorkUnitQueue::Shard::Refresh()
+{
+	for(auto &entry : Heap) {
+		entry.Weight = GetWeight(*entry.Unit);
+	}
+
+	for(size_t i = Heap.size() / 2; i > 0; --i) {
+		SiftDown(i - 1);
+	}
+}
+
+WorkUnitQueue::Entry WorkUnitQueue::Shard::RemoveTop()
+{
+	Entry top = Heap.front();
+	Index.erase(&top.Unit->GetRegion());
+
+	if(Heap.size() > 1) {
+		Heap.front() = Heap.back();
+		Index[&Heap.front().Unit->GetRegion()] = 0;
+	}
+	Heap.pop_back();
+
+	if(!Heap.empty()) {
+		SiftDown(0);
+	}
+
+	return top;
+}
+
+WorkUnitQueue::WorkUnitQueue(unsigned int shard_count) : size_(0), terminate_(false), dequeued_(0), stolen_(0), dropped_(0), reweighted_(0), total_latency_us_(0), max_latency_us_(0)
+{
+	if(shard_count == 0) shard_count = 1;
+
+	for(unsigned int i = 0; i < shard_count; ++i) {
+		shards_.push_back(std::unique_ptr<Shard>(new Shard()));
+	}
+}
+
+WorkUnitQueue::~WorkUnitQueue()
+{
+	Clear();
+}
+
+uint32_t WorkUnitQueue::GetWeight(const TranslationWorkUnit& unit)
+{
+	// The weight the region was profiled with, plus however many times its
+	// blocks have been interpreted since then
+	uint64_t weight = (uint64_t)unit.GetProfileWeight() + unit.GetWeight();
+	return weight > UINT32_MAX ? UINT32_MAX : weight;
+}
+
+WorkUnitQueue::Shard &WorkUnitQueue::getShard(const profile::Region &region)
+{
+	return *shards_[(region.GetPhysicalBaseAddress().Get() >> 12) % shards_.size()];
+}
+
+void WorkUnitQueue::Push(TranslationWorkUnit *unit)
+{
+	Shard &shard = getShard(unit->GetRegion());
+
+	{
+		std::lock_guard<std::mutex> lock(shard.Lock);
+
+		auto existing = shard.Index.find(&unit->GetRegion());
+		if(existing != shard.Index.end()) {
+			// The region is already waiting: the new unit reflects a more
+			// recent profile, so it replaces the old one (keeping its place
+			// in the queue).
+			Entry &entry = shard.Heap[existing->second];
+			delete entry.Unit;
+
+			entry.Unit = unit;
+			entry.Weight = GetWeight(*unit);
+			shard.SiftUp(existing->second);
+			shard.SiftDown(shard.Index.at(&unit->GetRegion()));
+
+			reweighted_++;
+			return;
+		}
+
+		shard.Heap.push_back({unit, GetWeight(*unit), clock_t::now()});
+		shard.Index[&unit->GetRegion()] = shard.Heap.size() - 1;
+		shard.SiftUp(shard.Heap.size() - 1);
+		size_++;
+	}
+
+	std::lock_guard<std::mutex> lock(wait_lock_);
+	wait_cond_.notify_one();
+}
+
+bool WorkUnitQueue::popFrom(Shard& shard, bool wait_for_lock, Entry &entry)
+{
+	std::unique_lock<std::mutex> lock(shard.Lock, std::defer_lock);
+	if(wait_for_lock) {
+		lock.lock();
+	} else if(!lock.try_lock()) {
+		return false;
+	}
+
+	// Regions keep heating up while they wait, so the order is only right
+	// once the weights have been brought up to date. Between refreshes the
+	// order lags a little behind, which is fine since weights only grow.
+	auto now = clock_t::now();
+	if(now - shard.LastRefresh >= kRefreshInterval) {
+		shard.Refresh();
+		shard.LastRefresh = now;
+	}
+
+	while(!shard.Heap.empty()) {
+		entry = shard.RemoveTop();
+		size_--;
+
+		if(entry.Unit->GetRegion().IsValid()) {
+			return true;
+		}
+
+		LC_DEBUG1(LogWorkQueue) << "[DEQUEUE] Skipping " << *entry.Unit;
+		delete entry.Unit;
+		dropped_++;
+	}
+
+	return false;
+}
+
+void WorkUnitQueue::recordLatency(const Entry& entry)
+{
+	uint64_t latency = std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now() - entry.EnqueueTime).count();
+
+	dequeued_++;
+	total_latency_us_ += latency;
+
+	uint64_t max = max_latency_us_;
+	while(latency > max && !max_latency_us_.compare_exchange_weak(max, latency)) ;
+}
+
+TranslationWorkUnit *WorkUnitQueue::TryPop(unsigned int shard_index)
+{
+	shard_index %= shards_.size();
+
+	Entry entry;
+	if(popFrom(*shards_[shard_index], true, entry)) {
+		recordLatency(entry);
+		return entry.Unit;
+	}
+
+	// Our own shard is empty, so try to steal from the others. Don't wait on
+	// a busy shard: its owner is probably popping from it.
+	for(unsigned int pass = 0; pass < 2; ++pass) {
+		for(unsigned int i = 1; i < shards_.size(); ++i) {
+			Shard &victim = *shards_[(shard_index + i) % shards_.size()];
+			if(popFrom(victim, pass == 1, entry)) {
+				stolen_++;
+				recordLatency(entry);
+				return entry.Unit;
+			}
+		}
+	}
+
+	return nullptr;
+}
+
+TranslationWorkUnit *WorkUnitQueue::Pop(unsigned int shard)
+{
+	while(!terminate_) {
+		TranslationWorkUnit *unit = TryPop(shard);
+		if(unit != nullptr) {
+			return unit;
+		}
+
+		std::unique_lock<std::mutex> lock(wait_lock_);
+		while(size_ == 0 && !terminate_) {
+			wait_cond_.wait(lock);
+		}
+	}
+
+	return nullptr;
+}
+
+void WorkUnitQueue::Terminate()
+{
+	terminate_ = true;
+
+	std::lock_guard<std::mutex> lock(wait_lock_);
+	wait_cond_.notify_all();
+}
+
+void WorkUnitQueue::Clear()
+{
+	for(auto &shard : shards_) {
+		std::lock_guard<std::mutex> lock(shard->Lock);
+
+		for(auto &entry : shard->Heap) {
+			delete entry.Unit;
+		}
+		size_ -= shard->Heap.size();
+
+		shard->Heap.clear();
+		shard->Index.clear();
+	}
+}
+
+void WorkUnitQueue::PrintStatistics(std::ostream& stream) const
+{
+	uint64_t dequeued = dequeued_;
+
+	stream << "Work Queue Size:        " << size_ << std::endl;
+	stream << "  Dequeued Units:       " << dequeued << " (" << stolen_ << " stolen)" << std::endl;
+	stream << "  Dropped Units:        " << dropped_ << std::endl;
+	stream << "  Reweighted Units:     " << reweighted_ << std::endl;
+	stream << "  Mean Queue Latency:   " << std::fixed << std::setprecision(2) << (dequeued ? (double)total_latency_us_ / dequeued / 1000.0 : 0.0) << " ms" << std::endl;
+	stream << "  Max Queue Latency:    " << std::fixed << std::setprecision(2) << (max_latency_us_ / 1000.0) << " ms" << std::endl;
+}
@@ -2,6 +2,7 @@
 
 #include "core/thread/ThreadInstance.h"
 #include "translate/adapt/BlockJITToLLVM.h"
+#include "translate/llvm/LLVMHostTarget.h"
 #include "translate/llvm/LLVMOptimiser.h"
 #include "translate/adapt/BlockJITAdaptorLoweringContext.h"
 #include "blockjit/block-compiler/lowering/LoweringContext.h"
@@ -30,7 +31,7 @@ using namespace archsim::translate::adapt;
 using namespace captive::arch::jit;
 using namespace captive::shared;
 
-BlockJITToLLVMAdaptor::BlockJITToLLVMAdaptor(llvm::LLVMContext& ctx) : ctx_(ctx)
+BlockJITToLLVMAdaptor::BlockJITToLLVMAdaptor(llvm::LLVMContext& ctx) : ctx_(ctx), target_machine_(translate_llvm::LLVMHostTarget::Get().CreateTargetMachine()), optimiser_(target_machine_.get())
 {
 
 }
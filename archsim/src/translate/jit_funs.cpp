@@ -222,6 +222,11 @@ extern "C" {
 		cpu->PendIRQ();
 	}
 
+	void cpuWaitForInterrupt(archsim::core::thread::ThreadInstance *cpu)
+	{
+		cpu->WaitForInterrupt();
+	}
+
 	uint32_t cpuTranslate(gensim::Processor *cpu, uint32_t virt_addr, uint32_t *phys_addr)
 	{
 		UNIMPLEMENTED;
@@ -403,7 +408,7 @@ extern "C" {
 
 	void cpuInstructionTick(archsim::core::thread::ThreadInstance *cpu)
 	{
-		cpu->GetEmulationModel().GetSystem().GetPubSub().Publish(PubSubType::InstructionExecute, NULL);
+		cpu->InstructionTick();
 	}
 
 	/*
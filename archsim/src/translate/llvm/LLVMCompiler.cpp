@@ -2,6 +2,7 @@
 
 #include "gensim/gensim_processor_api.h"
 #include "translate/llvm/LLVMCompiler.h"
+#include "translate/llvm/LLVMHostTarget.h"
 #include "translate/profile/Region.h"
 #include "translate/jit_funs.h"
 
@@ -29,38 +30,15 @@ static void WritePerfMap(archsim::Address phys_addr, void *ptr, size_t size)
 	perf_mutex_.unlock();
 }
 
-static llvm::TargetMachine *GetNativeMachine()
-{
-	static std::mutex lock;
-	lock.lock();
-
-	llvm::TargetMachine *machine = nullptr;
-
-	if(machine == nullptr) {
-		llvm::InitializeNativeTarget();
-		llvm::InitializeNativeTargetAsmPrinter();
-		llvm::InitializeNativeTargetAsmParser();
-		llvm::EngineBuilder builder;
-		builder.setMAttrs<>(std::vector<std::string> {"+popcnt"});
-		builder.setMCPU("haswell");
-		machine = builder.selectTarget();
-		machine->setOptLevel(llvm::CodeGenOpt::Aggressive);
-		machine->setFastISel(false);
-	}
-
-	lock.unlock();
-	return machine;
-}
-
 LLVMCompiler::LLVMCompiler(llvm::orc::ThreadSafeContext &ctx) :
-	target_machine_(GetNativeMachine()),
+	target_machine_(LLVMHostTarget::Get().CreateTargetMachine()),
 	linker_(session_, [this]()
 {
 	return std::unique_ptr<llvm::RuntimeDyld::MemoryManager>(new archsim::translate::translate_llvm::LLVMMemoryManager(code_pool, code_pool));
 }),
 ctx_(ctx)
 {
-	compiler_ = std::unique_ptr<CompileLayer>(new CompileLayer(session_, linker_, llvm::orc::SimpleCompiler(*target_machine_)));
+	compiler_ = std::unique_ptr<CompileLayer>(new CompileLayer(session_, linker_, llvm::orc::SimpleCompiler(*target_machine_, &object_cache_)));
 
 	initJitSymbols();
 }
@@ -154,6 +132,7 @@ void LLVMCompiler::initJitSymbols()
 	jit_symbols_["__divti3"] = (void*)divi128;
 
 	jit_symbols_["cpuInstructionTick"] = (void*)cpuInstructionTick;
+	jit_symbols_["cpuWaitForInterrupt"] = (void*)cpuWaitForInterrupt;
 
 	// todo: change these to actual bitcode
 	jit_symbols_["txln_shunt___builtin_f32_is_snan"] = (void*)shunt_builtin_f32_is_snan;
@@ -0,0 +1,265 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "translate/llvm/LLVMHostTarget.h"
+#include "util/LogContext.h"
+#include "util/SimOptions.h"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/IR/Function.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/Module.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <algorithm>
+#include <memory>
+#include <set>
+#include <sstream>
+
+UseLogContext(LogTranslate);
+DeclareChildLogContext(LogHostTarget, LogTranslate, "HostTarget");
+
+using namespace archsim::translate::translate_llvm;
+
+// The features which are worth knowing about: those which change the kind of
+// code that translations can use, rather than how fast it runs.
+static const char *x86_features[] = { "sse4.1", "sse4.2", "popcnt", "avx", "avx2", "fma", "bmi", "bmi2", "lzcnt", "avx512f", "avx512bw", "avx512dq", "avx512vl" };
+static const char *aarch64_features[] = { "neon", "crc", "lse", "sve" };
+
+static std::vector<std::string> GetInterestingFeatures()
+{
+	llvm::Triple triple (llvm::sys::getProcessTriple());
+
+	if(triple.getArch() == llvm::Triple::x86_64 || triple.getArch() == llvm::Triple::x86) {
+		return std::vector<std::string>(std::begin(x86_features), std::end(x86_features));
+	} else if(triple.getArch() == llvm::Triple::aarch64) {
+		return std::vector<std::string>(std::begin(aarch64_features), std::end(aarch64_features));
+	}
+
+	return std::vector<std::string>();
+}
+
+LLVMHostTarget &LLVMHostTarget::Get()
+{
+	static LLVMHostTarget target;
+	return target;
+}
+
+LLVMHostTarget::LLVMHostTarget() : translations_(0)
+{
+	llvm::InitializeNativeTarget();
+	llvm::InitializeNativeTargetAsmPrinter();
+	llvm::InitializeNativeTargetAsmParser();
+
+	if(archsim::options::JitHostCPU.IsSpecified()) {
+		// The CPU implies its own features, so the features of whichever host
+		// we happen to be running on are not relevant.
+		cpu_ = archsim::options::JitHostCPU.GetValue();
+	} else {
+		cpu_ = llvm::sys::getHostCPUName().str();
+
+		llvm::StringMap<bool> host_features;
+		if(llvm::sys::getHostCPUFeatures(host_features)) {
+			for(const auto &feature : host_features) {
+				features_.push_back((feature.getValue() ? "+" : "-") + feature.getKey().str());
+			}
+
+			// Keep the feature string (and so the description) stable.
+			std::sort(features_.begin(), features_.end(), [](const std::string &a, const std::string &b) {
+				return a.substr(1) < b.substr(1);
+			});
+		} else {
+			LC_WARNING(LogHostTarget) << "Could not detect the features of host CPU " << cpu_;
+		}
+	}
+
+	if(archsim::options::JitHostFeatures.IsSpecified()) {
+		ApplyFeatureOverrides(archsim::options::JitHostFeatures.GetValue());
+	}
+
+	// Ask the target which of the features that we care about are actually
+	// available, since a CPU name implies features which are not listed.
+	std::unique_ptr<llvm::TargetMachine> machine (CreateTargetMachine());
+	if(machine == nullptr) {
+		LC_ERROR(LogHostTarget) << "Could not create a target machine for host CPU " << cpu_;
+	} else {
+		for(const auto &feature : GetInterestingFeatures()) {
+			if(machine->getMCSubtargetInfo()->checkFeatures("+" + feature)) {
+				enabled_.push_back(feature);
+			}
+		}
+	}
+
+	std::stringstream enabled;
+	for(const auto &feature : enabled_) {
+		enabled << " " << feature;
+	}
+	LC_INFO(LogHostTarget) << "Generating code for host CPU " << cpu_ << ", with" << enabled.str();
+}
+
+void LLVMHostTarget::ApplyFeatureOverrides(const std::string& overrides)
+{
+	std::istringstream stream (overrides);
+	std::string item;
+
+	while(std::getline(stream, item, ',')) {
+		if(item.empty()) {
+			continue;
+		}
+		if(item[0] != '+' && item[0] != '-') {
+			item = "+" + item;
+		}
+
+		std::string name = item.substr(1);
+		features_.erase(std::remove_if(features_.begin(), features_.end(), [&name](const std::string &feature) {
+			return feature.substr(1) == name;
+		}), features_.end());
+		features_.push_back(item);
+	}
+}
+
+std::string LLVMHostTarget::GetFeatureString() const
+{
+	std::string str;
+	for(const auto &feature : features_) {
+		if(!str.empty()) {
+			str += ",";
+		}
+		str += feature;
+	}
+	return str;
+}
+
+bool LLVMHostTarget::HasFeature(const std::string& name) const
+{
+	return std::find(enabled_.begin(), enabled_.end(), name) != enabled_.end();
+}
+
+unsigned LLVMHostTarget::GetMaxVectorWidth() const
+{
+	if(HasFeature("avx512f")) {
+		return 512;
+	} else if(HasFeature("avx")) {
+		return 256;
+	}
+	return 128;
+}
+
+std::string LLVMHostTarget::GetDescription() const
+{
+	return cpu_ + ":" + GetFeatureString();
+}
+
+llvm::TargetMachine* LLVMHostTarget::CreateTargetMachine(bool fast_isel) const
+{
+	llvm::EngineBuilder builder;
+	builder.setMCPU(cpu_);
+	builder.setMAttrs(features_);
+
+	llvm::TargetMachine *machine = builder.selectTarget();
+	if(machine == nullptr) {
+		return nullptr;
+	}
+
+	machine->setOptLevel(llvm::CodeGenOpt::Aggressive);
+	machine->setFastISel(fast_isel);
+	machine->setO0WantsFastISel(false);
+	return machine;
+}
+
+void LLVMHostTarget::Specialise(llvm::Module& module) const
+{
+	std::string features = GetFeatureString();
+
+	for(auto &function : module) {
+		if(function.isDeclaration()) {
+			continue;
+		}
+
+		function.addFnAttr("target-cpu", cpu_);
+		function.addFnAttr("target-features", features);
+	}
+}
+
+std::vector<std::string> LLVMHostTarget::RecordFeatureUsage(const llvm::Module& module)
+{
+	// This is an estimate, from the kinds of operation in the IR: the code
+	// generator may still decide not to use a feature which is available.
+	std::set<std::string> used;
+
+	auto use = [this, &used](const char *feature) {
+		if(HasFeature(feature)) {
+			used.insert(feature);
+		}
+	};
+
+	for(const auto &function : module) {
+		for(const auto &insn : llvm::instructions(function)) {
+			llvm::Type *type = insn.getType();
+			if(auto store = llvm::dyn_cast<llvm::StoreInst>(&insn)) {
+				type = store->getValueOperand()->getType();
+			}
+
+			if(type->isVectorTy()) {
+				uint64_t bits = type->getPrimitiveSizeInBits();
+				if(bits > 256) {
+					use("avx512f");
+					if(type->getScalarType()->isIntegerTy() && type->getScalarSizeInBits() < 32) {
+						use("avx512bw");
+					}
+				} else if(bits > 128) {
+					use(type->getScalarType()->isIntegerTy() ? "avx2" : "avx");
+				}
+				use("neon");
+			}
+
+			if(auto intrinsic = llvm::dyn_cast<llvm::IntrinsicInst>(&insn)) {
+				switch(intrinsic->getIntrinsicID()) {
+					case llvm::Intrinsic::ctpop:
+						use("popcnt");
+						break;
+					case llvm::Intrinsic::cttz:
+						use("bmi");
+						break;
+					case llvm::Intrinsic::ctlz:
+						use("lzcnt");
+						break;
+					case llvm::Intrinsic::fma:
+					case llvm::Intrinsic::fmuladd:
+						use("fma");
+						break;
+					default:
+						break;
+				}
+			}
+		}
+	}
+
+	std::vector<std::string> features (used.begin(), used.end());
+
+	std::lock_guard<std::mutex> lock(usage_lock_);
+	translations_++;
+	for(const auto &feature : features) {
+		usage_[feature]++;
+	}
+
+	return features;
+}
+
+void LLVMHostTarget::PrintStatistics(std::ostream& stream)
+{
+	std::lock_guard<std::mutex> lock(usage_lock_);
+
+	stream << "Host Target: " << cpu_ << std::endl;
+	stream << "  Translations: " << translations_ << std::endl;
+	for(const auto &feature : enabled_) {
+		stream << "  Using " << feature << ": " << usage_[feature] << std::endl;
+	}
+	stream << std::endl;
+}
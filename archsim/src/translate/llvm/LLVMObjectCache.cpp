@@ -0,0 +1,206 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "translate/llvm/LLVMObjectCache.h"
+#include "translate/TranslationWorkUnit.h"
+#include "translate/profile/Region.h"
+#include "abi/EmulationModel.h"
+#include "abi/memory/MemoryModel.h"
+#include "core/thread/ThreadInstance.h"
+#include "util/LogContext.h"
+#include "util/SimOptions.h"
+
+#include <llvm/IR/Constants.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/Instructions.h>
+#include <llvm/Support/MemoryBuffer.h>
+
+UseLogContext(LogTranslate);
+
+using namespace archsim::translate;
+using namespace archsim::translate::translate_llvm;
+
+TranslationStoreKey LLVMObjectCache::GetStoreKey(TranslationWorkUnit &unit)
+{
+	Address phys_base = unit.GetRegion().GetPhysicalBaseAddress();
+
+	uint8_t page[Address::PageSize];
+	unit.GetThread()->GetEmulationModel().GetMemoryModel().Peek(phys_base, page, sizeof(page));
+
+	// The generated code depends on the shape of the region (which blocks
+	// were profiled, and how they are entered) as well as the guest code.
+	uint64_t shape = TranslationStore::Hash(nullptr, 0);
+	for(const auto &block : unit.GetBlocks()) {
+		uint64_t block_shape[] = {
+			block.first.Get(),
+			block.second->GetISAMode(),
+			block.second->IsEntryBlock(),
+			block.second->IsInterruptCheck(),
+			block.second->GetInstructions().size()
+		};
+		shape = TranslationStore::Hash(block_shape, sizeof(block_shape), shape);
+	}
+	uint64_t tracing = unit.ShouldEmitTracing();
+	shape = TranslationStore::Hash(&tracing, sizeof(tracing), shape);
+	uint64_t state_block = TranslationStore::HashStateBlock(unit.GetThread()->GetStateBlock().GetDescriptor());
+	shape = TranslationStore::Hash(&state_block, sizeof(state_block), shape);
+
+	TranslationStoreKey key;
+	key.PageHash = TranslationStore::Hash(page, sizeof(page));
+	key.Address = phys_base.Get();
+	key.FeatureHash = TranslationStore::HashFeatures(unit.GetThread()->GetFeatures());
+	key.ShapeHash = shape;
+	key.ISAMode = 0;
+	key.Kind = StoredTranslationKind::LLVMObject;
+
+	return key;
+}
+
+bool LLVMObjectCache::HasObject(const TranslationStoreKey& key)
+{
+	if(!archsim::options::JitLoadTranslations || !TranslationStore::Singleton.IsOpen()) {
+		return false;
+	}
+
+	return TranslationStore::Singleton.Contains(key);
+}
+
+llvm::Module *LLVMObjectCache::CreateStubModule(const TranslationStoreKey& key, TranslationWorkUnit &unit, llvm::LLVMContext& ctx)
+{
+	llvm::Module *module = new llvm::Module(key.ToString(), ctx);
+
+	auto i8ptrty = llvm::Type::getInt8PtrTy(ctx);
+	llvm::FunctionType *fn_type = llvm::FunctionType::get(llvm::Type::getInt32Ty(ctx), {i8ptrty, i8ptrty}, false);
+
+	std::string fn_name = "fn_" + std::to_string(unit.GetRegion().GetPhysicalBaseAddress().Get());
+	llvm::Function *fn = llvm::Function::Create(fn_type, llvm::GlobalValue::ExternalLinkage, fn_name, module);
+
+	llvm::IRBuilder<> builder (llvm::BasicBlock::Create(ctx, "", fn));
+	builder.CreateRet(llvm::ConstantInt::get(llvm::Type::getInt32Ty(ctx), 0));
+
+	AttachKey(module, key);
+	return module;
+}
+
+// Returns true if the value is, or is built from, a constant integer cast to
+// a pointer. Such constants are host addresses (e.g. of metrics counters, or
+// of helper functions called directly) which are only valid in this process.
+static bool IsHostConstant(const llvm::Value *value)
+{
+	auto expr = llvm::dyn_cast<llvm::ConstantExpr>(value);
+	if(expr == nullptr) {
+		return false;
+	}
+
+	if(expr->getOpcode() == llvm::Instruction::IntToPtr) {
+		auto address = llvm::dyn_cast<llvm::ConstantInt>(expr->getOperand(0));
+		if(address != nullptr && !address->isZero()) {
+			return true;
+		}
+	}
+
+	for(const auto &operand : expr->operands()) {
+		if(IsHostConstant(operand)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ContainsHostConstants(const llvm::Module *module)
+{
+	for(const auto &fn : *module) {
+		for(const auto &block : fn) {
+			for(const auto &insn : block) {
+				if(auto cast = llvm::dyn_cast<llvm::IntToPtrInst>(&insn)) {
+					auto address = llvm::dyn_cast<llvm::ConstantInt>(cast->getOperand(0));
+					if(address != nullptr && !address->isZero()) {
+						return true;
+					}
+				}
+
+				for(const auto &operand : insn.operands()) {
+					if(IsHostConstant(operand)) {
+						return true;
+					}
+				}
+			}
+		}
+	}
+	return false;
+}
+
+void LLVMObjectCache::AttachKey(llvm::Module* module, const TranslationStoreKey& key)
+{
+	module->setModuleIdentifier(key.ToString());
+
+	// This must be checked before the module is optimised, since the fixed
+	// base of contiguous guest memory is folded into the code as a constant
+	// too, but is the same in every process.
+	if(ContainsHostConstants(module)) {
+		LC_DEBUG2(LogTranslate) << "Not storing " << key.ToString() << ", as it contains host addresses";
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(lock_);
+	keys_[key.ToString()] = key;
+}
+
+void LLVMObjectCache::notifyObjectCompiled(const llvm::Module* module, llvm::MemoryBufferRef object)
+{
+	if(!archsim::options::JitSaveTranslations || !TranslationStore::Singleton.IsOpen()) {
+		return;
+	}
+
+	TranslationStoreKey key;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+
+		auto entry = keys_.find(module->getModuleIdentifier());
+		if(entry == keys_.end()) {
+			return;
+		}
+
+		key = entry->second;
+		keys_.erase(entry);
+	}
+
+	// Only modules without absolute host addresses are given a key, and the
+	// functions they call are declared by name and resolved from the JIT
+	// symbols when the object is linked, so no host relocations need to be
+	// recorded. Objects compiled from stub modules are never stored, as the
+	// store already holds their key.
+	TranslationStore::Singleton.Insert(key, object.getBufferStart(), object.getBufferSize(), {}, archsim::ProcessorFeatureSet());
+}
+
+std::unique_ptr<llvm::MemoryBuffer> LLVMObjectCache::getObject(const llvm::Module* module)
+{
+	if(!archsim::options::JitLoadTranslations || !TranslationStore::Singleton.IsOpen()) {
+		return nullptr;
+	}
+
+	std::string id = module->getModuleIdentifier();
+
+	TranslationStoreKey key;
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+
+		auto entry = keys_.find(id);
+		if(entry == keys_.end()) {
+			return nullptr;
+		}
+		key = entry->second;
+	}
+
+	StoredTranslation stored;
+	if(!TranslationStore::Singleton.Lookup(key, stored)) {
+		return nullptr;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(lock_);
+		keys_.erase(id);
+	}
+
+	LC_DEBUG2(LogTranslate) << "Loaded stored object for " << id;
+	return llvm::MemoryBuffer::getMemBufferCopy(llvm::StringRef((const char*)stored.GetCode(), stored.GetSize()), id);
+}
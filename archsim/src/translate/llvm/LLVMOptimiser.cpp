@@ -2,6 +2,7 @@
 
 #include "translate/llvm/LLVMOptimiser.h"
 #include "translate/llvm/LLVMAliasAnalysis.h"
+#include "translate/llvm/LLVMHostTarget.h"
 #include "translate/llvm/passes/LexicographicallyOrderBlocksPass.h"
 
 #include "util/SimOptions.h"
@@ -21,6 +22,7 @@
 #include <llvm/Analysis/TypeBasedAliasAnalysis.h>
 #include <llvm/Analysis/BasicAliasAnalysis.h>
 #include <llvm/Analysis/AliasAnalysisEvaluator.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
 
 #include <llvm/IR/DataLayout.h>
 #include <llvm/IR/MDBuilder.h>
@@ -28,6 +30,7 @@
 #include <llvm/IR/Module.h>
 
 #include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/Target/TargetMachine.h>
 
 #include <llvm/Transforms/IPO.h>
 #include <llvm/Transforms/Utils.h>
@@ -314,7 +317,7 @@ ArchSimAA::ArchSimAA() : llvm::AAResultBase<ArchSimAA>()
 //}
 
 
-LLVMOptimiser::LLVMOptimiser() : isInitialised(false), my_aa_(nullptr)
+LLVMOptimiser::LLVMOptimiser(::llvm::TargetMachine *target) : isInitialised(false), my_aa_(nullptr), target_(target)
 {
 
 }
@@ -332,6 +335,10 @@ bool LLVMOptimiser::Initialise(const ::llvm::DataLayout &datalayout)
 		my_aa_ = new ArchSimAA();
 	}
 
+	if(target_ != nullptr) {
+		pm.add(llvm::createTargetTransformInfoWrapperPass(target_->getTargetIRAnalysis()));
+	}
+
 	if(archsim::options::JitOptLevel.GetValue() == 4) {
 		pm.add(new LLVMRegisterOptimisationPass());
 	}
@@ -402,6 +409,15 @@ bool LLVMOptimiser::Initialise(const ::llvm::DataLayout &datalayout)
 		llvm::PassManagerBuilder pmp;
 		pmp.OptLevel = archsim::options::JitOptLevel.GetValue();
 
+		if(target_ != nullptr) {
+			target_->adjustPassManager(pmp);
+
+			// Guest vector operations and unrolled guest loops can make use of
+			// the host's vector units.
+			pmp.LoopVectorize = pmp.OptLevel >= 2;
+			pmp.SLPVectorize = pmp.OptLevel >= 2;
+		}
+
 		if(my_aa_ == nullptr) {
 			my_aa_ = new ArchSimAA();
 		}
@@ -482,7 +498,16 @@ bool LLVMOptimiser::Optimise(::llvm::Module* module, const ::llvm::DataLayout &d
 	if(archsim::options::Debug && ::llvm::verifyModule(*module, &::llvm::outs())) assert(false);
 
 	if(!isInitialised)Initialise(data_layout);
+
+	auto &host = LLVMHostTarget::Get();
+	host.Specialise(*module);
 	pm.run(*module);
 
+	std::string features;
+	for(const auto &feature : host.RecordFeatureUsage(*module)) {
+		features += " " + feature;
+	}
+	LC_DEBUG1(LogTranslate) << "Translation " << module->getName().str() << " uses host features:" << features;
+
 	return true;
 }
@@ -324,6 +324,7 @@ LLVMTranslationContext::LLVMTranslationContext(llvm::LLVMContext &ctx, llvm::Fun
 	Functions.cpuEnterUser = (llvm::Function*)Module->getOrInsertFunction("cpuEnterUserMode", Types.vtype, Types.i8Ptr);
 	Functions.cpuEnterKernel = (llvm::Function*)Module->getOrInsertFunction("cpuEnterKernelMode", Types.vtype, Types.i8Ptr);
 	Functions.cpuPendIRQ = (llvm::Function*)Module->getOrInsertFunction("cpuPendInterrupt", Types.vtype, Types.i8Ptr);
+	Functions.cpuWaitForInterrupt = (llvm::Function*)Module->getOrInsertFunction("cpuWaitForInterrupt", Types.vtype, Types.i8Ptr);
 	Functions.cpuPushInterrupt = (llvm::Function*)Module->getOrInsertFunction("cpuPushInterrupt", Types.vtype, Types.i8Ptr, Types.i32);
 
 	Functions.InstructionTick = (llvm::Function*)Module->getOrInsertFunction("cpuInstructionTick", Types.vtype, Types.i8Ptr);
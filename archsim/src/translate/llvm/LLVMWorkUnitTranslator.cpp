@@ -3,6 +3,7 @@
 #include "gensim/gensim_translate.h"
 
 #include "translate/llvm/LLVMWorkUnitTranslator.h"
+#include "translate/llvm/LLVMHostTarget.h"
 #include "translate/llvm/LLVMOptimiser.h"
 #include "translate/llvm/LLVMTranslationContext.h"
 
@@ -25,27 +26,7 @@
 using namespace archsim::translate;
 using namespace archsim::translate::translate_llvm;
 
-static llvm::TargetMachine *GetNativeMachine()
-{
-	static std::mutex lock;
-	lock.lock();
-
-	llvm::TargetMachine *machine = nullptr;
-
-	if(machine == nullptr) {
-		llvm::InitializeNativeTarget();
-		llvm::InitializeNativeTargetAsmPrinter();
-		llvm::InitializeNativeTargetAsmParser();
-		machine = llvm::EngineBuilder().selectTarget();
-		machine->setOptLevel(llvm::CodeGenOpt::Aggressive);
-		machine->setFastISel(false);
-	}
-
-	lock.unlock();
-	return machine;
-}
-
-LLVMWorkUnitTranslator::LLVMWorkUnitTranslator(gensim::BaseLLVMTranslate *txlt, llvm::LLVMContext &ctx) : target_machine_(GetNativeMachine()), translate_(txlt), llvm_ctx_(ctx)
+LLVMWorkUnitTranslator::LLVMWorkUnitTranslator(gensim::BaseLLVMTranslate *txlt, llvm::LLVMContext &ctx) : target_machine_(LLVMHostTarget::Get().CreateTargetMachine()), translate_(txlt), llvm_ctx_(ctx)
 {
 
 }
@@ -198,7 +179,7 @@ static void EmitControlFlow(llvm::IRBuilder<> &builder, translate_llvm::LLVMTran
 std::pair<llvm::Module *, llvm::Function *> LLVMWorkUnitTranslator::TranslateWorkUnit(TranslationWorkUnit &unit)
 {
 	// Create a new LLVM translation context.
-	LLVMOptimiser opt;
+	LLVMOptimiser opt (target_machine_.get());
 
 	// Create a new llvm module to contain the translation
 	llvm::Module *module = new llvm::Module("region_" + std::to_string(unit.GetRegion().GetPhysicalBaseAddress().Get()), llvm_ctx_);
@@ -0,0 +1,131 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include "translate/profile/CodeRegionTracker.h"
+
+#include <algorithm>
+
+using namespace archsim::translate::profile;
+
+const uint32_t CodeRegionTracker::kLineBits;
+const uint32_t CodeRegionTracker::kLineSize;
+const uint64_t CodeRegionTracker::kAllLines;
+
+CodeRegionTracker::CodeRegionTracker(archsim::util::PubSubContext &pubsub) : pubsub(pubsub), code_writes_(0), avoided_invalidations_(0)
+{
+	for(auto &chunk : code_lines) {
+		chunk.store(nullptr, std::memory_order_relaxed);
+	}
+
+	Invalidate();
+}
+
+CodeRegionTracker::~CodeRegionTracker()
+{
+	for(auto &chunk : code_lines) {
+		delete [] chunk.load(std::memory_order_relaxed);
+	}
+}
+
+std::atomic<uint64_t> *CodeRegionTracker::getLinesPtr(PhysicalAddress page_base) const
+{
+	uint64_t page = page_base.GetPageIndex();
+	std::atomic<uint64_t> *chunk = code_lines[page / kPagesPerChunk].load(std::memory_order_acquire);
+	if(chunk == nullptr) {
+		return nullptr;
+	}
+
+	return &chunk[page % kPagesPerChunk];
+}
+
+std::atomic<uint64_t> &CodeRegionTracker::getLines(PhysicalAddress page_base)
+{
+	uint64_t page = page_base.GetPageIndex();
+	auto &chunk_ptr = code_lines[page / kPagesPerChunk];
+
+	// Chunks are never freed, so once one is published it can be used
+	// without taking a lock
+	std::atomic<uint64_t> *chunk = chunk_ptr.load(std::memory_order_acquire);
+	if(chunk == nullptr) {
+		std::atomic<uint64_t> *new_chunk = new std::atomic<uint64_t>[kPagesPerChunk];
+		for(uint32_t i = 0; i < kPagesPerChunk; ++i) {
+			new_chunk[i].store(0, std::memory_order_relaxed);
+		}
+
+		if(chunk_ptr.compare_exchange_strong(chunk, new_chunk, std::memory_order_acq_rel)) {
+			chunk = new_chunk;
+		} else {
+			delete [] new_chunk;
+		}
+	}
+
+	return chunk[page % kPagesPerChunk];
+}
+
+void CodeRegionTracker::MarkLinesAsCode(PhysicalAddress page_base, uint64_t lines)
+{
+	getLines(page_base).fetch_or(lines, std::memory_order_relaxed);
+	code_regions.set(page_base.GetPageIndex());
+	pubsub.Publish(PubSubType::RegionDispatchedForTranslationPhysical, (void*)(uint64_t)page_base.GetPageBase());
+}
+
+void CodeRegionTracker::invalidateWrite(PhysicalAddress addr, uint64_t size)
+{
+	// A write may cross onto the next page
+	uint64_t offset = addr.GetPageOffset();
+	uint64_t first_size = std::min<uint64_t>(size, RegionArch::PageSize - offset);
+	InvalidateLines(addr.PageBase(), GetLineMask(offset, first_size));
+
+	if(first_size < size) {
+		uint64_t second_size = std::min<uint64_t>(size - first_size, RegionArch::PageSize);
+		InvalidateLines(PhysicalAddress(addr.GetPageBase() + RegionArch::PageSize), GetLineMask(0, second_size));
+	}
+}
+
+void CodeRegionTracker::InvalidateLines(PhysicalAddress page_base, uint64_t lines)
+{
+	if(!IsRegionCode(page_base)) {
+		return;
+	}
+
+	code_writes_.fetch_add(1, std::memory_order_relaxed);
+
+	std::atomic<uint64_t> *page_lines = getLinesPtr(page_base);
+	uint64_t code = page_lines != nullptr ? page_lines->fetch_and(~lines, std::memory_order_relaxed) : 0;
+	uint64_t hit = code & lines;
+
+	if(hit == 0) {
+		avoided_invalidations_.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	LC_DEBUG1(LogProfile) << "Invalidating code region at " << std::hex << page_base.GetPageBase() << " (lines " << hit << ")";
+
+	if((code & ~lines) == 0) {
+		code_regions.reset(page_base.GetPageIndex());
+	}
+
+	pubsub.Publish(PubSubType::RegionInvalidatePhysical, (void*)(uint64_t)page_base.GetPageBase());
+
+	CodeLineInvalidation invalidation { page_base.GetPageBase(), hit };
+	pubsub.Publish(PubSubType::CodeLinesInvalidatePhysical, &invalidation);
+}
+
+void CodeRegionTracker::Invalidate()
+{
+	code_regions.reset();
+
+	for(auto &chunk_ptr : code_lines) {
+		std::atomic<uint64_t> *chunk = chunk_ptr.load(std::memory_order_acquire);
+		if(chunk == nullptr) continue;
+
+		for(uint32_t i = 0; i < kPagesPerChunk; ++i) {
+			chunk[i].store(0, std::memory_order_relaxed);
+		}
+	}
+}
+
+void CodeRegionTracker::PrintStatistics(std::ostream &stream) const
+{
+	stream << "Writes to code pages: " << GetCodeWrites() << std::endl;
+	stream << "Code invalidations avoided: " << GetAvoidedInvalidations() << std::endl;
+}
@@ -39,6 +39,7 @@
 
 #include "concurrent/ScopedLock.h"
 
+#include <cassert>
 #include <stdio.h>
 #include <sstream>
 
@@ -74,187 +75,173 @@ namespace archsim
 // -------------------------------------------------------------------------
 // Histogram
 //
+		const uint64_t Histogram::kEmptyKey;
+		const uint32_t Histogram::kMaxSegments;
 
-// Re-fill HistogramEntry allocation pool
-//
-		uint32_t Histogram::refill_historgram_allocation_pool()
+		static inline uint32_t hash_index(HistogramEntry::histogram_key_t idx, uint32_t size)
 		{
-			// Register pointer to HistogramEntry chunk
-			//
-			HistogramEntry* entries = new HistogramEntry[alloc_size_];
-			hist_entries_alloc_chunks_.push(entries);
+			return (uint32_t)(((uint64_t)idx * 0x9E3779B97F4A7C15ULL) >> 32) & (size - 1);
+		}
 
-			// Fill up hist_alloc_pool_
+		static inline void add_to_value(HistogramEntry::histogram_value_t* value, HistogramEntry::histogram_value_t val)
+		{
+			// Translated code shared between threads updates values with an
+			// atomic add too, so increments from here must not overwrite them
 			//
-			for (uint32_t i = 0; i < alloc_size_; ++i) {
-				hist_entries_alloc_pool_.push(&entries[i]);
+			__atomic_fetch_add(value, val, __ATOMIC_RELAXED);
+		}
+
+// Returns pointer to the value at index, without taking any locks
+//
+		HistogramEntry::histogram_value_t* Histogram::lookup(HistogramEntry::histogram_key_t idx) const
+		{
+			for (uint32_t s = 0; s < kMaxSegments; ++s) {
+				Segment* segment = segments_[s].load(std::memory_order_acquire);
+				if (segment == nullptr) {
+					break;
+				}
+
+				// Segments are never full, so there is always an empty slot to
+				// stop at
+				//
+				for (uint32_t i = hash_index(idx, segment->size);; i = (i + 1) & (segment->size - 1)) {
+					Slot &slot = segment->slots[i];
+					uint64_t key = slot.key.load(std::memory_order_acquire);
+
+					if (key == idx) {
+						return &slot.value;
+					} else if (key == kEmptyKey) {
+						break;
+					}
+				}
 			}
 
-			return hist_entries_alloc_pool_.size();
+			return nullptr;
 		}
 
-// Returns pointer to new HistogramEntry while maintaining all lookup
-// structures
+// Returns pointer to the value of a new HistogramEntry, adding a segment to
+// the table if the last one is three quarters full
 //
-		HistogramEntry* Histogram::new_histogram_entry(uint32_t idx)
+		HistogramEntry::histogram_value_t* Histogram::new_histogram_entry(HistogramEntry::histogram_key_t idx)
 		{
 			archsim::concurrent::ScopedLock lock(hist_entries_mutex_);
 
-			// Re-fill allocation pool if it is empty
+			// Another thread may have added the entry while we were waiting
 			//
-			if (hist_entries_alloc_pool_.empty()) {
-				refill_historgram_allocation_pool();
+			HistogramEntry::histogram_value_t* value = lookup(idx);
+			if (value != nullptr) {
+				return value;
 			}
 
-			// Pop entry from allocation pool stack
-			//
-			HistogramEntry* entry = hist_entries_alloc_pool_.top();
-			hist_entries_alloc_pool_.pop();
+			uint32_t s = 0;
+			while (s + 1 < kMaxSegments && segments_[s + 1].load(std::memory_order_relaxed) != nullptr) {
+				++s;
+			}
 
-			// Set desired index
-			//
-			entry->set_index(idx);
+			Segment* segment = segments_[s].load(std::memory_order_relaxed);
+			if (segment == nullptr || (segment->used + 1) * 4 > segment->size * 3) {
+				if (segment != nullptr) {
+					++s;
+				}
+				assert(s < kMaxSegments);
+
+				segment = new Segment();
+				segment->size = alloc_size_ << s;
+				segment->used = 0;
+				segment->slots = new Slot[segment->size];
+				for (uint32_t i = 0; i < segment->size; ++i) {
+					segment->slots[i].key.store(kEmptyKey, std::memory_order_relaxed);
+					segment->slots[i].value = 0;
+				}
+
+				segments_[s].store(segment, std::memory_order_release);
+			}
 
-			// Add entry to histogram entries
-			//
-			hist_entries_.insert(entry);
+			uint32_t i = hash_index(idx, segment->size);
+			while (segment->slots[i].key.load(std::memory_order_relaxed) != kEmptyKey) {
+				i = (i + 1) & (segment->size - 1);
+			}
 
-			// Install mapping into fast lookup map
+			// Publish the key last, so that lock-free readers never see the
+			// entry before its value has been initialised
 			//
-			hist_map_index_value_[idx] = entry->get_value_ptr();
+			segment->slots[i].key.store(idx, std::memory_order_release);
+			segment->used++;
 
-			return entry;
+			return &segment->slots[i].value;
 		}
 
 // Set value at index
 //
 		void Histogram::set_value_at_index(HistogramEntry::histogram_key_t idx, HistogramEntry::histogram_value_t val)
 		{
-			hist_map_key_ptr_t::const_iterator I;
-			if ((I = hist_map_index_value_.find(idx)) != hist_map_index_value_.end()) {
-				// FAST PATH ------------------------------------------------------------
-				//
-
-				// Hit in fast lookup map
-				//
-				(*I->second) = val;
-			} else {
-				// SLOW PATH ------------------------------------------------------------
-				//
-
-				// HistogramEntry is not in fast look-up map so we have to create and install
-				// a new one via the following method call.
-				//
-				HistogramEntry* entry = new_histogram_entry(idx);
-				entry->set_value(val);
-			}
+			__atomic_store_n(get_value_ptr_at_index(idx), val, __ATOMIC_RELAXED);
 		}
 
 // Get value at index
 //
 		HistogramEntry::histogram_value_t Histogram::get_value_at_index(HistogramEntry::histogram_key_t idx)
 		{
-			hist_map_key_ptr_t::const_iterator I;
-			if ((I = hist_map_index_value_.find(idx)) != hist_map_index_value_.end()) {
-				// FAST PATH ------------------------------------------------------------
-				//
-
-				// Hit in fast lookup map
-				//
-				return (*I->second);
-			} else {
-				// SLOW PATH ------------------------------------------------------------
-				//
-
-				// HistogramEntry is not in fast look-up map so we have to create and install
-				// a new one via the following method call.
-				//
-				HistogramEntry* entry = new_histogram_entry(idx);
-				return entry->get_value();
-			}
+			return __atomic_load_n(get_value_ptr_at_index(idx), __ATOMIC_RELAXED);
 		}
 
 		HistogramEntry::histogram_value_t* Histogram::get_value_ptr_at_index(HistogramEntry::histogram_key_t idx)
 		{
 			// FAST PATH ------------------------------------------------------------
 			//
-
-			// First we query fast lookup map
-			//
-			hist_map_key_ptr_t::const_iterator I;
-			if ((I = hist_map_index_value_.find(idx)) != hist_map_index_value_.end()) {
-				// Hit in fast lookup map
-				//
-				return I->second;
+			HistogramEntry::histogram_value_t* value = lookup(idx);
+			if (value != nullptr) {
+				return value;
 			}
 
 			// SLOW PATH ------------------------------------------------------------
 			//
 
-			// HistogramEntry is not in fast look-up map so we have to create and install
+			// HistogramEntry is not in the table so we have to create and install
 			// a new one via the following method call.
 			//
-			HistogramEntry* entry = new_histogram_entry(idx);
-			return entry->get_value_ptr();
+			return new_histogram_entry(idx);
 		}
 
 		bool Histogram::index_exists(HistogramEntry::histogram_key_t idx) const
 		{
-			return hist_map_index_value_.find(idx) != hist_map_index_value_.end();
+			return lookup(idx) != nullptr;
 		}
 
 // Increment
 //
 		void Histogram::inc(HistogramEntry::histogram_key_t idx)
 		{
-			hist_map_key_ptr_t::const_iterator I;
-			if ((I = hist_map_index_value_.find(idx)) != hist_map_index_value_.end()) {
-				// FAST PATH ------------------------------------------------------------
-				//
-
-				// Hit in fast lookup map
-				//
-				++(*I->second);
-			} else {
-				// SLOW PATH ------------------------------------------------------------
-				//
-
-				// HistogramEntry is not in fast look-up map so we have to create and install
-				// a new one via the following method call.
-				//
-				HistogramEntry* entry = new_histogram_entry(idx);
-				entry->inc();
-			}
+			add_to_value(get_value_ptr_at_index(idx), 1);
 		}
 
 		void Histogram::inc(HistogramEntry::histogram_key_t idx, HistogramEntry::histogram_value_t val)
 		{
-			hist_map_key_ptr_t::const_iterator I;
-			if ((I = hist_map_index_value_.find(idx)) != hist_map_index_value_.end()) {
-				// FAST PATH ------------------------------------------------------------
-				//
-
-				// Hit in fast lookup map
-				//
-				(*I->second) += val;
-			} else {
-				// SLOW PATH ------------------------------------------------------------
-				//
+			add_to_value(get_value_ptr_at_index(idx), val);
+		}
 
-				// HistogramEntry is not in fast look-up map so we have to create and install
-				// a new one via the following method call.
-				//
-				HistogramEntry* entry = new_histogram_entry(idx);
-				entry->inc(val);
-			}
+// Merge another histogram into this one
+//
+		void Histogram::merge(const Histogram& other)
+		{
+			other.for_each_entry([this](HistogramEntry::histogram_key_t idx, HistogramEntry::histogram_value_t val) {
+				inc(idx, val);
+			});
 		}
 
 // Reset everything to 0
 //
 		void Histogram::clear()
 		{
-			for (std::set<HistogramEntry*>::const_iterator I = hist_entries_.begin(), E = hist_entries_.end(); I != E; ++I) {
-				(*I)->clear();
+			for (uint32_t s = 0; s < kMaxSegments; ++s) {
+				Segment* segment = segments_[s].load(std::memory_order_acquire);
+				if (segment == nullptr) {
+					break;
+				}
+
+				for (uint32_t i = 0; i < segment->size; ++i) {
+					__atomic_store_n(&segment->slots[i].value, 0, __ATOMIC_RELAXED);
+				}
 			}
 		}
 
@@ -263,57 +250,83 @@ namespace archsim
 		uint64_t Histogram::get_total(void) const
 		{
 			uint64_t total = 0;
-			for (std::set<HistogramEntry*>::iterator I = hist_entries_.begin(), E = hist_entries_.end(); I != E; ++I) {
-				total += (*I)->get_value();
-			}
+			for_each_entry([&total](HistogramEntry::histogram_key_t idx, HistogramEntry::histogram_value_t val) {
+				total += val;
+			});
 			return total;
 		}
 
-		std::string Histogram::to_string()
+		Histogram::hist_map_key_value_t Histogram::get_value_map() const
 		{
-			std::set<HistogramEntry*, HistogramEntryComparator> hist_entries_sorted(hist_entries_.begin(), hist_entries_.end());
+			hist_map_key_value_t values;
+			for_each_entry([&values](HistogramEntry::histogram_key_t idx, HistogramEntry::histogram_value_t val) {
+				values[idx] = val;
+			});
+			return values;
+		}
 
+		std::string Histogram::to_string()
+		{
 			std::ostringstream buf;
 
-			for (std::set<HistogramEntry*>::iterator I = hist_entries_sorted.begin(), E = hist_entries_sorted.end(); I != E; ++I) {
-				if((*I)->get_value())
-					buf << "\n\t" << (*I)->to_string();
+			HistogramEntry entry;
+			for (auto I : get_value_map()) {
+				if (I.second) {
+					entry.set_index(I.first);
+					entry.set_value(I.second);
+					buf << "\n\t" << entry.to_string();
+				}
 			}
 			return buf.str();
 		}
 
 		std::string Histogram::to_string(const char* format)
 		{
-			std::set<HistogramEntry*, HistogramEntryComparator> hist_entries_sorted(hist_entries_.begin(), hist_entries_.end());
-
 			std::ostringstream buf;
 
-			for (std::set<HistogramEntry*>::iterator I = hist_entries_sorted.begin(), E = hist_entries_sorted.end(); I != E; ++I) {
-				buf << (*I)->to_string(format);
+			HistogramEntry entry;
+			for (auto I : get_value_map()) {
+				entry.set_index(I.first);
+				entry.set_value(I.second);
+				buf << entry.to_string(format);
 			}
 			return buf.str();
 		}
 
 // Protected no args Histogram constructor
 //
-		Histogram::Histogram() : id_(kInitialHistogramId), alloc_size_(kHistogramEntryDefaultAllocSize)
+		Histogram::Histogram() : Histogram(kHistogramEntryDefaultAllocSize)
 		{
 		}
 
-// Public Histogram constructor using automatic unique ID injection
+// Public Histogram constructor. The table is only allocated when the first
+// entry is added.
 //
-		Histogram::Histogram(uint32_t alloc_size) : id_(kInitialHistogramId), alloc_size_(alloc_size)
+		Histogram::Histogram(uint32_t alloc_size) : id_(kInitialHistogramId), alloc_size_(1)
 		{
+			// Segment sizes must be powers of two
+			//
+			while (alloc_size_ < alloc_size) {
+				alloc_size_ <<= 1;
+			}
+
+			for (uint32_t s = 0; s < kMaxSegments; ++s) {
+				segments_[s].store(nullptr, std::memory_order_relaxed);
+			}
 		}
 
 		Histogram::~Histogram()
 		{
-			// Remove all dynamically allocated histogram chunks
+			// Remove all dynamically allocated segments
 			//
-			while (!hist_entries_alloc_chunks_.empty()) {
-				HistogramEntry* entries = hist_entries_alloc_chunks_.top();
-				delete[] entries;
-				hist_entries_alloc_chunks_.pop();
+			for (uint32_t s = 0; s < kMaxSegments; ++s) {
+				Segment* segment = segments_[s].load(std::memory_order_relaxed);
+				if (segment == nullptr) {
+					break;
+				}
+
+				delete[] segment->slots;
+				delete segment;
 			}
 		}
 
@@ -322,25 +335,32 @@ namespace archsim
 //
 		HistogramIter::HistogramIter(const Histogram& h) : hist(h)
 		{
-			entries.insert(hist.hist_entries_.begin(), hist.hist_entries_.end());
-			iter = entries.begin();
+			fill_entries();
 		}
 
 		HistogramIter::HistogramIter(Histogram* const h) : hist(*h)
 		{
-			entries.insert(hist.hist_entries_.begin(), hist.hist_entries_.end());
-			iter = entries.begin();
+			fill_entries();
 		}
 
 		HistogramIter::HistogramIter(const HistogramIter& hi) : hist(hi.hist)
 		{
-			entries.insert(hist.hist_entries_.begin(), hist.hist_entries_.end());
-			iter = entries.begin();
+			fill_entries();
 		}
 
 		HistogramIter::HistogramIter(HistogramIter* const hi) : hist(hi->hist)
 		{
-			entries.insert(hist.hist_entries_.begin(), hist.hist_entries_.end());
+			fill_entries();
+		}
+
+		void HistogramIter::fill_entries()
+		{
+			for (auto I : hist.get_value_map()) {
+				HistogramEntry entry;
+				entry.set_index(I.first);
+				entry.set_value(I.second);
+				entries.push_back(entry);
+			}
 			iter = entries.begin();
 		}
 
@@ -351,7 +371,7 @@ namespace archsim
 
 		const HistogramEntry* HistogramIter::operator*()
 		{
-			return *iter;
+			return &*iter;
 		}
 
 		bool HistogramIter::is_end()
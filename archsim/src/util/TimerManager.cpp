@@ -81,7 +81,8 @@ namespace archsim
 
 			void TimerManager::run()
 			{
-				terminate = false;
+				// terminate is cleared by the constructor, not here, since the
+				// manager may be destroyed before this thread gets to run
 
 				// Acquire the mutex
 				timers_mutex.acquire();
@@ -0,0 +1,130 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockCache.h"
+#include "blockjit/IndirectTargetCache.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+using archsim::Address;
+using archsim::ProcessorFeatureSet;
+using archsim::blockjit::BlockCache;
+using archsim::blockjit::BlockCacheEntry;
+using archsim::blockjit::IndirectTargetCache;
+using captive::shared::block_txln_fn;
+
+static block_txln_fn MakeFn(uintptr_t value)
+{
+	return (block_txln_fn)value;
+}
+
+TEST(BlockCache, InvalidateStartsNewGeneration)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+	ProcessorFeatureSet features;
+
+	cache->Insert(Address(0x1000), MakeFn(0x10), features);
+	ASSERT_EQ(MakeFn(0x10), cache->Lookup(Address(0x1000)));
+
+	uint64_t generation = cache->GetGeneration();
+	cache->Invalidate();
+	ASSERT_NE(generation, cache->GetGeneration());
+	ASSERT_FALSE(cache->Contains(Address(0x1000)));
+
+	// Translated code finds the generation just before the entries
+	ASSERT_EQ(cache->GetGeneration(), *(uint64_t*)((uint8_t*)cache->GetPtr() + BlockCache::kGenerationOffset));
+
+	cache->Insert(Address(0x1000), MakeFn(0x20), features);
+	ASSERT_EQ(MakeFn(0x20), cache->Lookup(Address(0x1000)));
+}
+
+TEST(BlockCache, InvalidateFeaturesOnlyMismatching)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+
+	ProcessorFeatureSet none;
+	ProcessorFeatureSet needs_fp;
+	needs_fp.SetFeatureLevel(0, 1);
+
+	// Spread the entries over the start, middle and end of the cache
+	const std::vector<uint64_t> addrs { 0x0, 0x1, 0x2, 0x3, 0x205, BlockCache::kCacheSize - 1 };
+	for(uint64_t addr : addrs) {
+		cache->Insert(Address(addr), MakeFn(0x100 + addr), (addr & 1) ? needs_fp : none);
+	}
+
+	ProcessorFeatureSet fp_enabled;
+	fp_enabled.SetFeatureLevel(0, 1);
+	cache->InvalidateFeatures(fp_enabled.GetAvailableMask());
+	for(uint64_t addr : addrs) {
+		ASSERT_TRUE(cache->Contains(Address(addr)));
+	}
+
+	ProcessorFeatureSet fp_disabled;
+	fp_disabled.SetFeatureLevel(0, 0);
+	cache->InvalidateFeatures(fp_disabled.GetAvailableMask());
+	for(uint64_t addr : addrs) {
+		ASSERT_EQ(!(addr & 1), cache->Contains(Address(addr)));
+	}
+}
+
+TEST(BlockCache, InvalidateLeavesEntriesInPlace)
+{
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+	ProcessorFeatureSet features;
+
+	cache->Insert(Address(0x1000), MakeFn(0x10), features);
+	cache->Invalidate();
+
+	// Flushing only starts a new generation, so it costs the same however
+	// big the cache is: the old entry is still there, but never matches
+	const BlockCacheEntry &entry = cache->GetEntry(Address(0x1000));
+	ASSERT_EQ(0x1000U, entry.virt_tag);
+	ASSERT_EQ(MakeFn(0x10), entry.ptr);
+	ASSERT_NE(cache->GetGeneration(), entry.generation);
+	ASSERT_EQ(nullptr, cache->Lookup(Address(0x1000)));
+}
+
+// Not a test as such: compares the cost of flushing the caches by starting
+// a new generation against rewriting every entry, as they used to. It is
+// disabled, since it only prints timings; run it with
+// --gtest_also_run_disabled_tests --gtest_filter=BlockCache.DISABLED_FlushCost
+TEST(BlockCache, DISABLED_FlushCost)
+{
+	const int kIterations = 100000;
+	std::unique_ptr<BlockCache> cache (new BlockCache());
+	std::unique_ptr<IndirectTargetCache> target_cache (new IndirectTargetCache());
+	ProcessorFeatureSet features;
+
+	auto time = [&](std::function<void()> fn) {
+		auto start = std::chrono::high_resolution_clock::now();
+		for(int i = 0; i < kIterations; ++i) {
+			fn();
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count() / (double)kIterations;
+	};
+
+	double generation = time([&]() {
+		cache->Insert(Address(0x1000), MakeFn(0x10), features);
+		cache->Invalidate();
+		target_cache->Invalidate();
+	});
+
+	double rewrite = time([&]() {
+		cache->Insert(Address(0x1000), MakeFn(0x10), features);
+		memset((void*)cache->GetPtr(), 0xff, sizeof(BlockCacheEntry) * BlockCache::kCacheSize);
+		memset((uint8_t*)target_cache.get() + IndirectTargetCache::GetSiteOffset(0), 0xff, sizeof(IndirectTargetCache::Entry) * IndirectTargetCache::kSiteCount * IndirectTargetCache::kSiteWays);
+	});
+
+	double features_scan = time([&]() {
+		cache->InvalidateFeatures(0);
+	});
+
+	std::cout << "Full flush: " << generation << "ns, rewriting entries: " << rewrite << "ns, feature flush: " << features_scan << "ns" << std::endl;
+	ASSERT_FALSE(cache->Contains(Address(0x1000)));
+}
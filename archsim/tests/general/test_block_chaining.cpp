@@ -0,0 +1,70 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockChaining.h"
+#include "blockjit/BlockProfile.h"
+#include "util/MemAllocator.h"
+
+#include "TestTranslations.h"
+
+#include <string.h>
+
+using archsim::Address;
+using archsim::blockjit::BlockProfile;
+using archsim::blockjit::BlockTranslation;
+using archsim::blockjit::ChainSlot;
+using captive::shared::block_txln_fn;
+
+// A replacement for B, in the same form as the shared stand-ins
+alignas(16) static uint8_t code_c[16];
+
+TEST(BlockChaining, LinkAndUnlink)
+{
+	wulib::SimpleZoneMemAllocator allocator;
+	BlockProfile profile(allocator);
+
+	memset(code_a, 0, sizeof(code_a));
+	memset(code_b, 0, sizeof(code_b));
+	memset(code_c, 0, sizeof(code_c));
+
+	// A jumps to B, which has not been translated yet
+	std::vector<ChainSlot> slots { { 4, 8, 0x40001100 } };
+	profile.Insert(Address(0x1000), MakeTranslation(code_a), 1, slots);
+	ASSERT_EQ(code_a + 8, GetJumpTarget(code_a));
+
+	// Translating B links A to it
+	profile.Insert(Address(0x1100), MakeTranslation(code_b), 1);
+	ASSERT_EQ(code_b, GetJumpTarget(code_a));
+
+	// Replacing B links A to the replacement
+	profile.Insert(Address(0x1100), MakeTranslation(code_c), 1);
+	ASSERT_EQ(code_c, GetJumpTarget(code_a));
+
+	// Invalidating the page unlinks A, which might still be running
+	profile.InvalidatePage(Address(0x1000), 2);
+	ASSERT_EQ(code_a + 8, GetJumpTarget(code_a));
+}
+
+TEST(BlockChaining, FeaturesMustMatch)
+{
+	wulib::SimpleZoneMemAllocator allocator;
+	BlockProfile profile(allocator);
+
+	memset(code_a, 0, sizeof(code_a));
+
+	// B depends on a feature which A does not, so A can't skip B's check
+	BlockTranslation b = MakeTranslation(code_b);
+	b.AddRequiredFeature(1, 1);
+	profile.Insert(Address(0x2100), b, 1);
+
+	std::vector<ChainSlot> slots { { 4, 8, 0x2100 } };
+	profile.Insert(Address(0x2000), MakeTranslation(code_a), 1, slots);
+	ASSERT_EQ(code_a + 8, GetJumpTarget(code_a));
+
+	// Unless A depends on the same feature level
+	BlockTranslation a = MakeTranslation(code_a);
+	a.AddRequiredFeature(1, 1);
+	profile.Insert(Address(0x2000), a, 1, slots);
+	ASSERT_EQ(code_b, GetJumpTarget(code_a));
+}
@@ -0,0 +1,58 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/devices/generic/block/FileBackedBlockDevice.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using archsim::abi::devices::generic::block::FileBackedBlockDevice;
+
+TEST(FileBackedBlockDevice, VectoredTransfers)
+{
+	char filename[] = "/tmp/archsim-bdev-XXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+
+	// The last block is only partly backed by the file
+	std::vector<uint8_t> contents(512 * 7 + 100, 0xcc);
+	ASSERT_EQ((ssize_t)contents.size(), write(fd, contents.data(), contents.size()));
+	close(fd);
+
+	FileBackedBlockDevice bdev;
+	ASSERT_TRUE(bdev.Open(filename));
+	ASSERT_EQ(8, bdev.GetBlockCount());
+
+	uint8_t a[512], b[1024], c[512];
+	memset(a, 1, sizeof(a));
+	memset(b, 2, sizeof(b));
+
+	struct iovec write_iov[] = { { a, sizeof(a) }, { b, sizeof(b) } };
+	ASSERT_TRUE(bdev.WriteBlocksV(2, write_iov, 2));
+
+	struct iovec read_iov[] = { { b, sizeof(b) }, { a, sizeof(a) } };
+	ASSERT_TRUE(bdev.ReadBlocksV(1, read_iov, 2));
+	ASSERT_EQ(0xcc, b[0]);
+	ASSERT_EQ(1, b[512]);
+	ASSERT_EQ(2, a[0]);
+
+	// Reads through the block cache see the vectored writes
+	ASSERT_TRUE(bdev.ReadBlocks(3, 1, c));
+	ASSERT_EQ(2, c[0]);
+
+	// Whatever lies past the end of the file reads as zero
+	struct iovec tail_iov[] = { { c, sizeof(c) } };
+	ASSERT_TRUE(bdev.ReadBlocksV(7, tail_iov, 1));
+	ASSERT_EQ(0xcc, c[99]);
+	ASSERT_EQ(0, c[100]);
+
+	// Transfers past the end of the device, or of partial blocks, fail
+	ASSERT_FALSE(bdev.ReadBlocksV(8, tail_iov, 1));
+	struct iovec partial_iov[] = { { c, 100 } };
+	ASSERT_FALSE(bdev.ReadBlocksV(0, partial_iov, 1));
+
+	bdev.Close();
+	unlink(filename);
+}
@@ -0,0 +1,112 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/BlockProfile.h"
+#include "util/MemAllocator.h"
+
+#include "TestTranslations.h"
+
+#include <string.h>
+
+using archsim::Address;
+using archsim::ProcessorFeatureSet;
+using archsim::blockjit::BlockProfile;
+using archsim::blockjit::BlockTranslation;
+using archsim::blockjit::ChainSlot;
+using captive::shared::block_txln_fn;
+
+TEST(BlockProfile, SpanningRetiredWithExtraPage)
+{
+	wulib::SimpleZoneMemAllocator allocator;
+	BlockProfile profile(allocator);
+	ProcessorFeatureSet features;
+
+	// A starts on page 0x3000 and continues onto page 0x5000
+	BlockTranslation a = MakeTranslation(code_a);
+	a.AddExtraPage(0x1000, Address(0x5000));
+	profile.Insert(Address(0x3f00), a, 1);
+	ASSERT_EQ((block_txln_fn)code_a, profile.Get(Address(0x3f00), features).GetFn());
+
+	// Modifying an unrelated page leaves it alone
+	profile.InvalidatePage(Address(0x4000), 2);
+	ASSERT_EQ((block_txln_fn)code_a, profile.Get(Address(0x3f00), features).GetFn());
+
+	// Modifying the page it continues onto retires it
+	profile.MarkPageDirty(Address(0x5010));
+	ASSERT_TRUE(profile.GarbageCollect(3));
+	ASSERT_EQ(nullptr, profile.Get(Address(0x3f00), features).GetFn());
+	ASSERT_TRUE(profile.HasRetired());
+}
+
+TEST(BlockProfile, SpanningOnlyChainedToItself)
+{
+	wulib::SimpleZoneMemAllocator allocator;
+	BlockProfile profile(allocator);
+
+	memset(code_a, 0, sizeof(code_a));
+	memset(code_b, 0, sizeof(code_b));
+
+	// B loops back to its own start, and continues onto another page
+	BlockTranslation b = MakeTranslation(code_b);
+	b.AddExtraPage(0x1000, Address(0x9000));
+	std::vector<ChainSlot> b_slots { { 4, 8, 0x6100 } };
+	profile.Insert(Address(0x6100), b, 1, b_slots);
+	ASSERT_EQ(code_b, GetJumpTarget(code_b));
+
+	// A is not linked to B, since A doesn't check B's other page
+	std::vector<ChainSlot> a_slots { { 4, 8, 0x6100 } };
+	profile.Insert(Address(0x6000), MakeTranslation(code_a), 1, a_slots);
+	ASSERT_EQ(code_a + 8, GetJumpTarget(code_a));
+}
+
+TEST(BlockProfile, DirtyLinesOnlyRetireOverlapping)
+{
+	wulib::SimpleZoneMemAllocator allocator;
+	BlockProfile profile(allocator);
+	ProcessorFeatureSet features;
+
+	// A was decoded from the first line of the page, and B from the second
+	BlockTranslation a = MakeTranslation(code_a);
+	a.SetCodeLines(0x1);
+	profile.Insert(Address(0x7000), a, 1);
+
+	BlockTranslation b = MakeTranslation(code_b);
+	b.SetCodeLines(0x2);
+	profile.Insert(Address(0x7040), b, 1);
+
+	// Writing to the second line only retires B
+	profile.MarkPageDirty(Address(0x7040), 0x2);
+	ASSERT_TRUE(profile.GarbageCollect(2));
+	ASSERT_EQ((block_txln_fn)code_a, profile.Get(Address(0x7000), features).GetFn());
+	ASSERT_EQ(nullptr, profile.Get(Address(0x7040), features).GetFn());
+}
+
+TEST(BlockProfile, ReplacedTranslationReclaimedAfterItsEpoch)
+{
+	wulib::SimpleZoneMemAllocator allocator;
+	BlockProfile profile(allocator);
+	ProcessorFeatureSet features;
+
+	// Reclaiming frees the code, so it has to come from the allocator
+	uint8_t *first = (uint8_t*)allocator.Allocate(16);
+	uint8_t *second = (uint8_t*)allocator.Allocate(16);
+	memset(first, 0, 16);
+	memset(second, 0, 16);
+
+	ASSERT_EQ(0U, profile.Insert(Address(0x8000), MakeTranslation(first), 1));
+	ASSERT_FALSE(profile.HasRetired());
+
+	// Replacing a translation tells the caller how much code is waiting
+	// for the epoch the old one was retired into
+	ASSERT_EQ(16U, profile.Insert(Address(0x8000), MakeTranslation(second), 2));
+	ASSERT_EQ((block_txln_fn)second, profile.Get(Address(0x8000), features).GetFn());
+	ASSERT_TRUE(profile.HasRetired());
+	ASSERT_EQ(16U, profile.GetTotalCodeSize());
+
+	profile.Reclaim(1);
+	ASSERT_TRUE(profile.HasRetired());
+
+	profile.Reclaim(2);
+	ASSERT_FALSE(profile.HasRetired());
+}
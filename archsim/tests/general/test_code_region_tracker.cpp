@@ -0,0 +1,50 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "translate/profile/CodeRegionTracker.h"
+#include "util/PubSubSync.h"
+
+using archsim::PhysicalAddress;
+using archsim::translate::profile::CodeLineInvalidation;
+using archsim::translate::profile::CodeRegionTracker;
+
+static std::vector<CodeLineInvalidation> invalidations;
+
+static void RecordInvalidation(PubSubType::PubSubType type, void *context, const void *data)
+{
+	invalidations.push_back(*(const CodeLineInvalidation*)data);
+}
+
+TEST(CodeRegionTracker, LineMask)
+{
+	ASSERT_EQ(0x1ull, CodeRegionTracker::GetLineMask(0, 1));
+	ASSERT_EQ(0x3ull, CodeRegionTracker::GetLineMask(0x3e, 4));
+	ASSERT_EQ(0x8000000000000000ull, CodeRegionTracker::GetLineMask(0xffc, 4));
+	ASSERT_EQ(~0ull, CodeRegionTracker::GetLineMask(0, 4096));
+}
+
+TEST(CodeRegionTracker, WritesToDataDontInvalidate)
+{
+	archsim::util::PubSubContext pubsub;
+	archsim::util::PubSubscriber subscriber (pubsub);
+	subscriber.Subscribe(PubSubType::CodeLinesInvalidatePhysical, RecordInvalidation, nullptr);
+	invalidations.clear();
+
+	// Code in the second line of the page
+	CodeRegionTracker tracker (pubsub);
+	tracker.MarkLinesAsCode(PhysicalAddress(0x8000), CodeRegionTracker::GetLineMask(0x40, 0x40));
+	ASSERT_TRUE(tracker.IsRegionCode(PhysicalAddress(0x8000)));
+
+	// Writing to data elsewhere on the page leaves it alone
+	tracker.InvalidateWrite(PhysicalAddress(0x8100), 4);
+	ASSERT_TRUE(invalidations.empty());
+	ASSERT_EQ(1, tracker.GetAvoidedInvalidations());
+
+	// Writing to the code invalidates it, and only it
+	tracker.InvalidateWrite(PhysicalAddress(0x803e), 4);
+	ASSERT_EQ(1, invalidations.size());
+	ASSERT_EQ(0x8000, invalidations[0].PageBase);
+	ASSERT_EQ(0x2ull, invalidations[0].Lines);
+	ASSERT_FALSE(tracker.IsRegionCode(PhysicalAddress(0x8000)));
+}
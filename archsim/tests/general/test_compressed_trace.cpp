@@ -0,0 +1,130 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "libtrace/compressed/CompressedRecordFile.h"
+#include "libtrace/compressed/CompressedTraceSink.h"
+
+#include <algorithm>
+#include <memory>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using libtrace::CompressedFileTraceSink;
+using libtrace::CompressedRecordFile;
+using libtrace::InstructionHeaderRecord;
+using libtrace::Record;
+using libtrace::RecordBufferInterface;
+using libtrace::TraceRecord;
+
+// A mixture of very regular records, which compress well, and noisy ones
+static TraceRecord MakeRecord(uint32_t i)
+{
+	if((i / 1000) & 1) {
+		return TraceRecord(libtrace::MemReadData, i * 2654435761U, i * 40503U, 0);
+	}
+	return InstructionHeaderRecord(0, 0x8000 + (i & ~3U), 0);
+}
+
+static void CheckRecords(const std::string &filename, uint32_t count)
+{
+	FILE *f = fopen(filename.c_str(), "r");
+	ASSERT_NE(nullptr, f);
+
+	std::unique_ptr<RecordBufferInterface> file (libtrace::OpenRecordFile(f));
+	ASSERT_NE(nullptr, file.get());
+	ASSERT_EQ(count, file->Size());
+
+	for(uint32_t i = 0; i < count; ++i) {
+		Record record;
+		ASSERT_TRUE(file->Get(i, record));
+		ASSERT_EQ(MakeRecord(i).GetHeader(), record.GetHeader());
+		ASSERT_EQ(MakeRecord(i).GetData(), record.GetData());
+	}
+
+	// Going backwards has to move between blocks
+	for(uint32_t i = count; i > 0; i -= std::min(i, 997U)) {
+		Record record;
+		ASSERT_TRUE(file->Get(i - 1, record));
+		ASSERT_EQ(MakeRecord(i - 1).GetData(), record.GetData());
+	}
+
+	Record record;
+	ASSERT_FALSE(file->Get(count, record));
+
+	fclose(f);
+}
+
+TEST(CompressedTrace, BlockRoundTrip)
+{
+	std::vector<Record> records;
+	for(uint32_t i = 0; i < 3000; ++i) {
+		records.push_back(MakeRecord(i));
+	}
+
+	std::vector<char> compressed (CompressedRecordFile::GetMaxBlockSize(records.size()));
+	uint32_t size = CompressedRecordFile::CompressBlock(records.data(), records.size(), compressed.data());
+	ASSERT_LT(size, records.size() * sizeof(Record));
+
+	std::vector<Record> decompressed (records.size());
+	ASSERT_TRUE(CompressedRecordFile::DecompressBlock(compressed.data(), size, decompressed.data(), decompressed.size()));
+	for(uint32_t i = 0; i < records.size(); ++i) {
+		ASSERT_EQ(records[i].GetHeader(), decompressed[i].GetHeader());
+		ASSERT_EQ(records[i].GetData(), decompressed[i].GetData());
+	}
+
+	// Damaged data is rejected rather than producing the wrong records
+	ASSERT_FALSE(CompressedRecordFile::DecompressBlock(compressed.data(), size / 2, decompressed.data(), decompressed.size()));
+}
+
+TEST(CompressedTrace, SinkRoundTrip)
+{
+	char dirname[] = "/tmp/archsim-ctrace-XXXXXX";
+	ASSERT_NE(nullptr, mkdtemp(dirname));
+	std::string pattern = std::string(dirname) + "/trace";
+	std::string filename = pattern + "0";
+
+	// More than two blocks' worth, so that both buffers are reused
+	const uint32_t count = CompressedRecordFile::kMaxBlockRecords * 2 + 1234;
+	const uint32_t first_flush = 5000;
+
+	{
+		CompressedFileTraceSink sink(pattern);
+		int id = sink.Open();
+		ASSERT_EQ(0, id);
+
+		// Records can be copied in...
+		std::vector<TraceRecord> copied;
+		for(uint32_t i = 0; i < first_flush; ++i) {
+			copied.push_back(MakeRecord(i));
+		}
+		sink.SinkPackets(id, copied.data(), copied.data() + copied.size());
+
+		// ...and the file is readable after each flush
+		sink.Flush();
+		CheckRecords(filename, first_flush);
+
+		// ...or written straight into the sink's buffers
+		size_t capacity;
+		TraceRecord *buffer = sink.AcquireBuffer(id, capacity);
+		ASSERT_NE(nullptr, buffer);
+
+		size_t filled = 0;
+		for(uint32_t i = first_flush; i < count; ++i) {
+			buffer[filled++] = MakeRecord(i);
+			if(filled == capacity) {
+				buffer = sink.SubmitBuffer(id, filled);
+				filled = 0;
+			}
+		}
+		sink.SubmitBuffer(id, filled);
+	}
+
+	CheckRecords(filename, count);
+
+	unlink(filename.c_str());
+	rmdir(dirname);
+}
@@ -0,0 +1,186 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/devices/generic/timing/EventScheduler.h"
+#include "abi/devices/generic/timing/TickSource.h"
+
+#include <vector>
+
+using archsim::abi::devices::timing::EventScheduler;
+using archsim::abi::devices::timing::HostTimeTickSource;
+using archsim::abi::devices::timing::InstructionTickSource;
+using archsim::abi::devices::timing::ScheduledEvent;
+
+class RecordingEvent : public ScheduledEvent
+{
+public:
+	RecordingEvent(int id, std::vector<int> &fired) : id_(id), fired_(fired) {}
+
+	void Fire(uint64_t now) override
+	{
+		fired_.push_back(id_);
+	}
+
+private:
+	int id_;
+	std::vector<int> &fired_;
+};
+
+class PeriodicEvent : public ScheduledEvent
+{
+public:
+	PeriodicEvent(EventScheduler &scheduler, uint64_t period) : scheduler_(scheduler), period_(period), count_(0) {}
+
+	void Fire(uint64_t now) override
+	{
+		count_++;
+		scheduler_.Schedule(*this, now + period_);
+	}
+
+	uint32_t GetCount() const
+	{
+		return count_;
+	}
+
+private:
+	EventScheduler &scheduler_;
+	uint64_t period_;
+	uint32_t count_;
+};
+
+TEST(EventScheduler, FiresInDeadlineOrder)
+{
+	EventScheduler scheduler;
+	std::vector<int> fired;
+	std::vector<RecordingEvent*> events;
+
+	uint64_t deadlines[] = { 50, 10, 40, 20, 30, 60 };
+	for(int i = 0; i < 6; ++i) {
+		events.push_back(new RecordingEvent(i, fired));
+		scheduler.Schedule(*events.back(), deadlines[i]);
+	}
+
+	ASSERT_EQ(10U, scheduler.GetNextDeadline());
+
+	// Moving and cancelling events keeps the heap in order
+	scheduler.Schedule(*events[5], 5);
+	scheduler.Cancel(*events[2]);
+	ASSERT_FALSE(events[2]->IsScheduled());
+	ASSERT_EQ(5U, scheduler.GetNextDeadline());
+
+	ASSERT_EQ(4U, scheduler.Advance(30));
+	ASSERT_EQ((std::vector<int> { 5, 1, 3, 4 }), fired);
+	ASSERT_EQ(50U, scheduler.GetNextDeadline());
+
+	ASSERT_EQ(1U, scheduler.Advance(100));
+	ASSERT_EQ(EventScheduler::kNoDeadline, scheduler.GetNextDeadline());
+	ASSERT_EQ(0U, scheduler.GetPendingCount());
+
+	for(auto event : events) {
+		delete event;
+	}
+}
+
+TEST(EventScheduler, SimultaneousEventsFireInScheduleOrder)
+{
+	EventScheduler scheduler;
+	std::vector<int> fired;
+	std::vector<RecordingEvent*> events;
+
+	for(int i = 0; i < 8; ++i) {
+		events.push_back(new RecordingEvent(i, fired));
+		scheduler.Schedule(*events.back(), 10);
+	}
+
+	// Rescheduling an event moves it behind the others
+	scheduler.Schedule(*events[2], 10);
+
+	scheduler.Advance(10);
+	ASSERT_EQ((std::vector<int> { 0, 1, 3, 4, 5, 6, 7, 2 }), fired);
+
+	for(auto event : events) {
+		delete event;
+	}
+}
+
+TEST(EventScheduler, EventsCanRescheduleThemselves)
+{
+	EventScheduler scheduler;
+	PeriodicEvent event (scheduler, 10);
+
+	scheduler.Schedule(event, 10);
+
+	// Once per period, however far time jumps
+	scheduler.Advance(5);
+	ASSERT_EQ(0U, event.GetCount());
+	scheduler.Advance(10);
+	ASSERT_EQ(1U, event.GetCount());
+	scheduler.Advance(1000);
+	ASSERT_EQ(2U, event.GetCount());
+	ASSERT_EQ(1010U, scheduler.GetNextDeadline());
+
+	scheduler.Cancel(event);
+}
+
+TEST(EventScheduler, HostTimeSourceReportsTimeUntilNextEvent)
+{
+	std::vector<int> fired;
+	RecordingEvent event (0, fired);
+
+	// Ticks of 1ms, and the source is never started, so the event can't fire
+	HostTimeTickSource tick_source (1000);
+	ASSERT_EQ(EventScheduler::kNoDeadline, tick_source.GetMicrosecondsUntilNextEvent());
+
+	tick_source.ScheduleEvent(event, tick_source.GetCounter() + 50);
+	uint64_t us = tick_source.GetMicrosecondsUntilNextEvent();
+	ASSERT_LE(us, 50000U);
+	ASSERT_GT(us, 45000U);
+
+	tick_source.CancelEvent(event);
+	ASSERT_EQ(EventScheduler::kNoDeadline, tick_source.GetMicrosecondsUntilNextEvent());
+}
+
+TEST(EventScheduler, InstructionSourceDoesNotFollowHostTime)
+{
+	std::vector<int> fired;
+	RecordingEvent event (0, fired);
+
+	InstructionTickSource tick_source;
+	tick_source.ScheduleEvent(event, 10);
+	ASSERT_EQ(EventScheduler::kNoDeadline, tick_source.GetMicrosecondsUntilNextEvent());
+
+	tick_source.CancelEvent(event);
+}
+
+TEST(EventScheduler, InstructionSourceReportsEarlierDeadlines)
+{
+	std::vector<int> fired;
+	RecordingEvent late (0, fired), early (1, fired), later (2, fired);
+
+	InstructionTickSource tick_source;
+	tick_source.Start();
+	uint64_t generation = tick_source.GetDeadlineGeneration();
+
+	tick_source.ScheduleEvent(late, 5000);
+	ASSERT_NE(generation, tick_source.GetDeadlineGeneration().load());
+	ASSERT_EQ(5000U, tick_source.GetInstructionsUntilNextEvent());
+
+	// A thread part way through a 5000 instruction batch has to see that
+	// the next event is now much sooner
+	generation = tick_source.GetDeadlineGeneration();
+	tick_source.ScheduleEvent(early, 10);
+	ASSERT_NE(generation, tick_source.GetDeadlineGeneration().load());
+	ASSERT_EQ(10U, tick_source.GetInstructionsUntilNextEvent());
+
+	// An event behind the next one doesn't shorten anything
+	generation = tick_source.GetDeadlineGeneration();
+	tick_source.ScheduleEvent(later, 20);
+	ASSERT_EQ(generation, tick_source.GetDeadlineGeneration().load());
+
+	tick_source.RetireInstructions(10);
+	ASSERT_EQ((std::vector<int> { 1 }), fired);
+
+	tick_source.CancelEvent(late);
+	tick_source.CancelEvent(later);
+}
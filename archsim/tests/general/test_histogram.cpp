@@ -0,0 +1,60 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "util/Histogram.h"
+
+#include <atomic>
+#include <thread>
+
+using archsim::util::Histogram;
+using archsim::util::HistogramEntry;
+
+TEST(Histogram, PointersStableAcrossGrowth)
+{
+	Histogram histogram (4);
+
+	HistogramEntry::histogram_value_t *first = histogram.get_value_ptr_at_index(7);
+	*first = 3;
+
+	// Enough entries to add several segments to the table
+	for(uint32_t i = 100; i < 10000; ++i) {
+		histogram.inc(i, i);
+	}
+
+	ASSERT_EQ(first, histogram.get_value_ptr_at_index(7));
+	ASSERT_EQ(3, histogram.get_value_at_index(7));
+	ASSERT_EQ(5000, histogram.get_value_at_index(5000));
+	ASSERT_FALSE(histogram.index_exists(50));
+	ASSERT_EQ(9901U, histogram.get_value_map().size());
+}
+
+TEST(Histogram, MergeWhileUpdating)
+{
+	Histogram a, b;
+	std::atomic<bool> done (false);
+
+	// Merging only reads the source, so it can run while the owning thread
+	// carries on counting
+	std::thread reader ([&]() {
+		while(!done) {
+			Histogram merged;
+			merged.merge(a);
+		}
+	});
+
+	for(uint32_t i = 0; i < 100000; ++i) {
+		a.inc(i % 1000);
+	}
+	done = true;
+	reader.join();
+
+	b.inc(0, 5);
+	b.inc(5000, 1);
+	b.merge(a);
+
+	ASSERT_EQ(105, b.get_value_at_index(0));
+	ASSERT_EQ(100, b.get_value_at_index(999));
+	ASSERT_EQ(1, b.get_value_at_index(5000));
+	ASSERT_EQ(100006U, b.get_total());
+}
@@ -0,0 +1,62 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "blockjit/IndirectTargetCache.h"
+
+#include <string.h>
+
+using archsim::Address;
+using archsim::blockjit::IndirectTargetCache;
+
+TEST(IndirectTargetCache, StartsEmpty)
+{
+	IndirectTargetCache cache;
+
+	// No 32 or 64 bit PC may match an entry which was never filled
+	uint32_t site = IndirectTargetCache::GetSiteIndex(Address(0x1234));
+	ASSERT_EQ(UINT64_MAX, cache.GetSiteEntry(site, 0).virt_tag);
+	ASSERT_EQ(UINT64_MAX, cache.GetSiteEntry(site, 1).virt_tag);
+	ASSERT_EQ(UINT64_MAX, cache.GetReturnEntry(0).virt_tag);
+	ASSERT_NE(cache.GetGeneration(), cache.GetSiteEntry(site, 0).generation);
+	ASSERT_EQ(0, cache.GetReturnTop());
+}
+
+TEST(IndirectTargetCache, InvalidateStartsNewGeneration)
+{
+	IndirectTargetCache cache;
+
+	// Fill the cache the way translated code does, through the offsets
+	uint8_t *raw = (uint8_t*)&cache;
+	uint64_t generation = *(uint64_t*)(raw + IndirectTargetCache::GetGenerationOffset());
+	ASSERT_EQ(cache.GetGeneration(), generation);
+
+	uint32_t site = IndirectTargetCache::GetSiteIndex(Address(0x1234));
+	auto *entries = (IndirectTargetCache::Entry*)(raw + IndirectTargetCache::GetSiteOffset(site));
+	for(uint32_t way = 0; way < IndirectTargetCache::kSiteWays; ++way) {
+		entries[way] = { 0x1234, nullptr, generation, 0 };
+	}
+	*(IndirectTargetCache::Entry*)(raw + IndirectTargetCache::GetReturnStackOffset()) = { 0x1238, nullptr, generation, 0 };
+	*(uint32_t*)(raw + IndirectTargetCache::GetReturnTopOffset()) = 3;
+
+	ASSERT_EQ(generation, cache.GetSiteEntry(site, 1).generation);
+	ASSERT_EQ(0x1238, cache.GetReturnEntry(0).virt_tag);
+	ASSERT_EQ(3, cache.GetReturnTop());
+
+	// Flushing leaves the entries where they are, but none of them are
+	// from the new generation, so translated code won't use them
+	cache.Invalidate();
+	ASSERT_EQ(0x1234, cache.GetSiteEntry(site, 0).virt_tag);
+	ASSERT_NE(cache.GetGeneration(), cache.GetSiteEntry(site, 0).generation);
+	ASSERT_NE(cache.GetGeneration(), cache.GetSiteEntry(site, 1).generation);
+	ASSERT_NE(cache.GetGeneration(), cache.GetReturnEntry(0).generation);
+	ASSERT_EQ(0, cache.GetReturnTop());
+}
+
+TEST(IndirectTargetCache, SiteIndexInRange)
+{
+	for(uint64_t pc = 0; pc < 0x100000; pc += 0x44) {
+		ASSERT_LT(IndirectTargetCache::GetSiteIndex(Address(pc)), IndirectTargetCache::kSiteCount);
+	}
+	ASSERT_LT(IndirectTargetCache::GetSiteIndex(Address(0xffffffff80001000ULL)), IndirectTargetCache::kSiteCount);
+}
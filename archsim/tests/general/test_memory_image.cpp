@@ -0,0 +1,65 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/memory/MemoryImage.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+using archsim::abi::memory::MemoryImage;
+
+static const size_t kPageSize = MemoryImage::kPageSize;
+
+TEST(MemoryImage, CopyOnWriteAndReset)
+{
+	// An image covering one and a half pages, starting at guest address 0
+	char filename[] = "/tmp/archsim-memory-image-XXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+
+	uint8_t contents[kPageSize + kPageSize / 2];
+	memset(contents, 0x11, kPageSize);
+	memset(contents + kPageSize, 0x22, kPageSize / 2);
+	ASSERT_EQ((ssize_t)sizeof(contents), write(fd, contents, sizeof(contents)));
+	close(fd);
+
+	MemoryImage image;
+	ASSERT_TRUE(image.Open(filename));
+	unlink(filename);
+	ASSERT_EQ(2 * kPageSize, image.GetSize());
+
+	// Map three pages: the last one is past the end of the image
+	const size_t size = 3 * kPageSize;
+	uint8_t *memory = (uint8_t *)mmap(nullptr, size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(MAP_FAILED, memory);
+	ASSERT_TRUE(image.Map(memory, 0, size, PROT_READ | PROT_WRITE));
+
+	ASSERT_EQ(0x11, memory[0]);
+	ASSERT_EQ(0x22, memory[kPageSize]);
+	ASSERT_EQ(0, memory[kPageSize + kPageSize / 2]);
+	ASSERT_EQ(0, memory[2 * kPageSize]);
+
+	// Only the pages whose contents change are written to
+	uint8_t data[16];
+	memset(data, 0x11, 8);
+	memset(data + 8, 0x22, 8);
+	ASSERT_EQ(0u, MemoryImage::Write(memory + kPageSize - 8, data, sizeof(data)));
+
+	memset(data + 8, 0x55, 8);
+	ASSERT_EQ(1u, MemoryImage::Write(memory + kPageSize - 8, data, sizeof(data)));
+	ASSERT_EQ(0x55, memory[kPageSize]);
+
+	memory[0] = 0x33;
+	memory[2 * kPageSize] = 0x44;
+
+	// Resetting brings back the image, and zeroes the rest
+	ASSERT_TRUE(MemoryImage::Reset(memory, size));
+	ASSERT_EQ(0x11, memory[0]);
+	ASSERT_EQ(0x22, memory[kPageSize]);
+	ASSERT_EQ(0, memory[2 * kPageSize]);
+
+	munmap(memory, size);
+}
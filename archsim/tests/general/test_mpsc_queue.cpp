@@ -0,0 +1,80 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "concurrent/MPSCQueue.h"
+
+#include <thread>
+#include <vector>
+
+using archsim::concurrent::MPSCQueue;
+
+TEST(MPSCQueue, FillsUpAndEmpties)
+{
+	MPSCQueue<int, 4> queue;
+	int value;
+
+	ASSERT_TRUE(queue.IsEmpty());
+	ASSERT_FALSE(queue.TryPop(value));
+
+	for(int i = 0; i < 4; ++i) {
+		ASSERT_TRUE(queue.TryPush(i));
+	}
+	ASSERT_FALSE(queue.TryPush(4));
+
+	for(int i = 0; i < 4; ++i) {
+		ASSERT_TRUE(queue.TryPop(value));
+		ASSERT_EQ(i, value);
+	}
+	ASSERT_TRUE(queue.IsEmpty());
+
+	// Slots are reused once they have wrapped around
+	ASSERT_TRUE(queue.TryPush(5));
+	ASSERT_TRUE(queue.TryPop(value));
+	ASSERT_EQ(5, value);
+}
+
+TEST(MPSCQueue, KeepsEachProducersOrder)
+{
+	const int kProducers = 4;
+	const int kMessages = 10000;
+
+	MPSCQueue<int, 64> queue;
+	std::vector<std::thread> producers;
+
+	for(int p = 0; p < kProducers; ++p) {
+		producers.emplace_back([&queue, p, kMessages]() {
+			for(int i = 0; i < kMessages; ++i) {
+				while(!queue.TryPush(p * kMessages + i)) {
+					std::this_thread::yield();
+				}
+			}
+		});
+	}
+
+	// Failures are only counted here, so that the producers are always
+	// joined before the test can end
+	std::vector<int> next(kProducers, 0);
+	int received = 0;
+	int out_of_order = 0;
+	while(received < kProducers * kMessages) {
+		int value;
+		if(!queue.TryPop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		int producer = value / kMessages;
+		if(next[producer] != value % kMessages) {
+			out_of_order++;
+		}
+		next[producer] = value % kMessages + 1;
+		received++;
+	}
+
+	for(auto &producer : producers) {
+		producer.join();
+	}
+	ASSERT_EQ(0, out_of_order);
+	ASSERT_TRUE(queue.IsEmpty());
+}
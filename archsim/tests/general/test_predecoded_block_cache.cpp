@@ -0,0 +1,60 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "interpret/PredecodedBlockCache.h"
+
+#include <thread>
+
+using archsim::Address;
+using archsim::interpret::PredecodedBlock;
+using archsim::interpret::PredecodedBlockCache;
+
+TEST(PredecodedBlockCache, LookupFindsBlockByModeAndAddress)
+{
+	archsim::util::PubSubContext pubsub;
+	PredecodedBlockCache cache (pubsub);
+
+	PredecodedBlock *arm = new PredecodedBlock(Address(0x1000), 0);
+	PredecodedBlock *thumb = new PredecodedBlock(Address(0x1000), 1);
+	cache.Insert(arm);
+	cache.Insert(thumb);
+
+	// Looking up both blocks again goes through the owner's table, and the
+	// two modes share a slot in it
+	for(int i = 0; i < 2; ++i) {
+		ASSERT_EQ(arm, cache.Lookup(Address(0x1000), 0));
+		ASSERT_EQ(thumb, cache.Lookup(Address(0x1000), 1));
+	}
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1004), 0));
+}
+
+TEST(PredecodedBlockCache, InvalidationFromAnotherThreadHidesBlock)
+{
+	archsim::util::PubSubContext pubsub;
+	PredecodedBlockCache cache (pubsub);
+
+	PredecodedBlock *block = new PredecodedBlock(Address(0x1040), 0);
+	PredecodedBlock *other_page = new PredecodedBlock(Address(0x2040), 0);
+	cache.Insert(block);
+	cache.Insert(other_page);
+	ASSERT_EQ(block, cache.Lookup(Address(0x1040), 0));
+
+	std::thread invalidator([&cache]() {
+		cache.InvalidatePage(Address(0x1000));
+	});
+	invalidator.join();
+
+	// The block is not freed until the owner reclaims it, but it must not be
+	// found again, even though it is still in the owner's table
+	ASSERT_FALSE(block->IsValid());
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1040), 0));
+	ASSERT_EQ(other_page, cache.Lookup(Address(0x2040), 0));
+
+	cache.Reclaim();
+	ASSERT_EQ(nullptr, cache.Lookup(Address(0x1040), 0));
+
+	PredecodedBlock *replacement = new PredecodedBlock(Address(0x1040), 0);
+	cache.Insert(replacement);
+	ASSERT_EQ(replacement, cache.Lookup(Address(0x1040), 0));
+}
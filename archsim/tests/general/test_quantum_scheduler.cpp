@@ -0,0 +1,173 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "TestThreads.h"
+
+#include "abi/devices/generic/timing/TickSource.h"
+#include "core/execution/QuantumScheduler.h"
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using archsim::abi::devices::timing::InstructionTickSource;
+using archsim::core::execution::QuantumScheduler;
+using archsim::core::thread::ThreadInstance;
+using archsim::core::thread::ThreadMessage;
+
+#define QUANTUM 100
+#define QUANTA 4U
+
+// Run each thread on its own host thread for the given number of quanta,
+// calling body at the start of each one.
+template<typename Body> static void RunQuanta(QuantumScheduler &scheduler, const std::vector<ThreadInstance *> &threads, unsigned quanta, Body body)
+{
+	for(auto thread : threads) {
+		scheduler.AddThread(thread);
+	}
+
+	std::vector<std::thread> host_threads;
+	for(auto thread : threads) {
+		host_threads.push_back(std::thread([&scheduler, thread, quanta, body]() {
+			scheduler.Enter(thread);
+			for(unsigned quantum = 0; quantum < quanta; ++quantum) {
+				body(thread, quantum);
+				scheduler.EndQuantum(thread, QUANTUM);
+			}
+			scheduler.Leave(thread);
+		}));
+	}
+
+	for(auto &host_thread : host_threads) {
+		host_thread.join();
+	}
+}
+
+TEST(QuantumScheduler, TakesTurnsInThreadIDOrder)
+{
+	TestThreads test_threads;
+	InstructionTickSource tick_source;
+	QuantumScheduler scheduler (tick_source, QUANTUM, false);
+
+	// Threads are added out of order, and take turns by ID regardless
+	std::vector<ThreadInstance *> threads { test_threads.Create(2), test_threads.Create(0), test_threads.Create(1) };
+
+	std::mutex lock;
+	std::string order;
+	RunQuanta(scheduler, threads, QUANTA, [&lock, &order](ThreadInstance *thread, unsigned quantum) {
+		std::lock_guard<std::mutex> guard(lock);
+		order += (char)('0' + thread->GetThreadID());
+	});
+
+	ASSERT_EQ("012012012012", order);
+	ASSERT_EQ((uint64_t)QUANTA, scheduler.GetQuantumCount());
+
+	// Every instruction retired in a quantum moves the clock on
+	ASSERT_EQ((uint64_t)QUANTA * QUANTUM * threads.size(), tick_source.GetCounter());
+}
+
+TEST(QuantumScheduler, ParallelThreadsWaitAtBarrier)
+{
+	TestThreads test_threads;
+	InstructionTickSource tick_source;
+	QuantumScheduler scheduler (tick_source, QUANTUM, true);
+
+	std::vector<ThreadInstance *> threads;
+	for(int i = 0; i < 4; ++i) {
+		threads.push_back(test_threads.Create(i));
+	}
+
+	// No thread may start a quantum until every thread has finished the
+	// one before it
+	std::atomic<unsigned> started[QUANTA];
+	for(auto &count : started) {
+		count = 0;
+	}
+	std::atomic<unsigned> early (0);
+
+	size_t thread_count = threads.size();
+	RunQuanta(scheduler, threads, QUANTA, [&started, &early, thread_count](ThreadInstance *thread, unsigned quantum) {
+		if(quantum > 0 && started[quantum - 1] != thread_count) {
+			early++;
+		}
+		started[quantum]++;
+	});
+
+	ASSERT_EQ(0U, early.load());
+	ASSERT_EQ((uint64_t)QUANTA, scheduler.GetQuantumCount());
+}
+
+TEST(QuantumScheduler, DeferredActionsRunInSenderOrder)
+{
+	TestThreads test_threads;
+	InstructionTickSource tick_source;
+	QuantumScheduler scheduler (tick_source, QUANTUM, true);
+
+	ThreadInstance *target = test_threads.Create(0);
+	std::vector<ThreadInstance *> senders;
+	for(int i = 1; i <= 4; ++i) {
+		senders.push_back(test_threads.Create(i));
+	}
+
+	// Actions are only touched by the thread ending the quantum, while every
+	// other thread is stopped
+	std::string order;
+	std::atomic<unsigned> early (0);
+
+	RunQuanta(scheduler, senders, QUANTA, [&scheduler, &order, &early, target, &senders](ThreadInstance *thread, unsigned quantum) {
+		bool deferred = scheduler.Defer(target, [&order, thread]() {
+			order += (char)('0' + thread->GetThreadID());
+		});
+		if(!deferred) {
+			early++;
+		}
+
+		// Nothing deferred in this quantum has happened yet
+		if(order.size() != quantum * senders.size()) {
+			early++;
+		}
+	});
+
+	ASSERT_EQ(0U, early.load());
+	ASSERT_EQ("1234123412341234", order);
+}
+
+TEST(QuantumScheduler, MessagesAreDeliveredBetweenQuanta)
+{
+	TestThreads test_threads;
+	InstructionTickSource tick_source;
+	QuantumScheduler scheduler (tick_source, QUANTUM, false);
+
+	// The receiver takes its turn first in each quantum
+	ThreadInstance *receiver = test_threads.Create(0);
+	ThreadInstance *sender = test_threads.Create(1);
+	sender->SetQuantumScheduler(&scheduler);
+	receiver->SetQuantumScheduler(&scheduler);
+
+	std::atomic<unsigned> received (0);
+	std::atomic<unsigned> early (0);
+
+	RunQuanta(scheduler, {receiver, sender}, QUANTA, [receiver, &received, &early](ThreadInstance *thread, unsigned quantum) {
+		if(thread == receiver) {
+			if(receiver->GetNextMessage() == ThreadMessage::Halt) {
+				received++;
+			}
+			return;
+		}
+
+		// The message is held back until the end of the quantum
+		receiver->SendMessage(ThreadMessage::Halt);
+		if(receiver->HasMessage()) {
+			early++;
+		}
+	});
+
+	// Each message is received in the quantum after it was sent, so the last
+	// one is still waiting
+	ASSERT_EQ(0U, early.load());
+	ASSERT_EQ(QUANTA - 1, received.load());
+	ASSERT_EQ(ThreadMessage::Halt, receiver->GetNextMessage());
+}
@@ -0,0 +1,115 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "concurrent/ReservationTable.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using archsim::Address;
+using archsim::concurrent::ReservationTable;
+
+#define STRESS_ITERATIONS 100000
+
+TEST(ReservationTable, ConditionalStoreNeedsReservation)
+{
+	ReservationTable table;
+
+	ASSERT_FALSE(table.BeginConditionalStore(0, Address(0x1000)));
+
+	table.Reserve(0, Address(0x1000));
+	ASSERT_FALSE(table.BeginConditionalStore(0, Address(0x1004)));
+
+	// The failed store consumed the reservation
+	ASSERT_FALSE(table.BeginConditionalStore(0, Address(0x1000)));
+
+	table.Reserve(0, Address(0x1000));
+	ASSERT_TRUE(table.BeginConditionalStore(0, Address(0x1000)));
+	table.EndConditionalStore(0);
+}
+
+TEST(ReservationTable, StoreBreaksOtherReservations)
+{
+	ReservationTable table;
+
+	table.Reserve(0, Address(0x1000));
+	table.Reserve(1, Address(0x1008));
+
+	ASSERT_TRUE(table.BeginConditionalStore(1, Address(0x1008)));
+	table.EndConditionalStore(1);
+
+	// Same granule, so thread 0 loses its reservation
+	ASSERT_FALSE(table.BeginConditionalStore(0, Address(0x1000)));
+}
+
+TEST(ReservationTable, InvalidateBreaksReservations)
+{
+	ReservationTable table;
+
+	table.Reserve(0, Address(0x2000));
+	table.Invalidate(Address(0x2010));
+	ASSERT_FALSE(table.BeginConditionalStore(0, Address(0x2000)));
+}
+
+TEST(ReservationTable, ExclusiveSectionBreaksReservations)
+{
+	ReservationTable table;
+
+	table.Reserve(0, Address(0x3000));
+	table.LockExclusive(1);
+	table.UnlockExclusive(1);
+	ASSERT_FALSE(table.BeginConditionalStore(0, Address(0x3000)));
+
+	// Reservations taken after the section ended are unaffected
+	table.Reserve(0, Address(0x3000));
+	ASSERT_TRUE(table.BeginConditionalStore(0, Address(0x3000)));
+	table.EndConditionalStore(0);
+}
+
+// N threads each atomically increment a shared counter using exclusive
+// load/store pairs, mixed with increments in the exclusive section. No
+// increments may be lost.
+TEST(ReservationTable, ContendedAtomicsStress)
+{
+	ReservationTable table;
+
+	unsigned thread_count = std::max(2u, std::thread::hardware_concurrency());
+	std::atomic<uint64_t> counter (0);
+	Address counter_addr (0x4000);
+
+	std::vector<std::thread> threads;
+	for(unsigned id = 0; id < thread_count; ++id) {
+		threads.push_back(std::thread([&table, &counter, counter_addr, id]() {
+			for(int i = 0; i < STRESS_ITERATIONS; ++i) {
+				if(i % 16 == 0) {
+					// An atomic read-modify-write, as the guest's exclusive
+					// sections do it. Leaving the section breaks the other
+					// threads' reservations.
+					table.LockExclusive(id);
+					counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+					table.UnlockExclusive(id);
+					continue;
+				}
+
+				while(true) {
+					table.Reserve(id, counter_addr);
+					uint64_t value = counter.load(std::memory_order_relaxed);
+
+					if(table.BeginConditionalStore(id, counter_addr)) {
+						counter.store(value + 1, std::memory_order_relaxed);
+						table.EndConditionalStore(id);
+						break;
+					}
+				}
+			}
+		}));
+	}
+
+	for(auto &thread : threads) {
+		thread.join();
+	}
+
+	ASSERT_EQ((uint64_t)thread_count * STRESS_ITERATIONS, counter.load());
+}
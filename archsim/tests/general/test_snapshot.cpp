@@ -0,0 +1,125 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/Snapshot.h"
+#include "abi/devices/DeviceState.h"
+
+#include <signal.h>
+#include <string.h>
+#include <sys/mman.h>
+
+using archsim::abi::LazyMemoryRestorer;
+using archsim::abi::Snapshot;
+using archsim::abi::devices::DeviceState;
+
+TEST(Snapshot, DeviceStateRoundTrip)
+{
+	DeviceState state, nested;
+	nested.Write<uint32_t>(0xdeadbeef);
+
+	state.Write<uint8_t>(1);
+	state.Write<uint64_t>(0x123456789abcdef0);
+	state.WriteString("uart@10013000");
+	state.WriteState(nested);
+
+	DeviceState restored(state.GetData(), state.GetSize()), restored_nested;
+	uint8_t a;
+	uint64_t b;
+	uint32_t c;
+	std::string name;
+
+	ASSERT_TRUE(restored.Read(a));
+	ASSERT_TRUE(restored.Read(b));
+	ASSERT_TRUE(restored.ReadString(name));
+	ASSERT_TRUE(restored.ReadState(restored_nested));
+	ASSERT_TRUE(restored.AtEnd());
+	ASSERT_TRUE(restored_nested.Read(c));
+
+	ASSERT_EQ(1, a);
+	ASSERT_EQ(0x123456789abcdef0, b);
+	ASSERT_EQ("uart@10013000", name);
+	ASSERT_EQ(0xdeadbeef, c);
+
+	// Reading past the end fails rather than returning junk
+	ASSERT_FALSE(restored.Read(a));
+}
+
+TEST(Snapshot, PageCompression)
+{
+	uint8_t page[Snapshot::kPageSize], out[Snapshot::kPageSize], restored[Snapshot::kPageSize];
+
+	memset(page, 0, sizeof(page));
+	ASSERT_TRUE(Snapshot::IsZeroPage(page));
+
+	for(unsigned i = 0; i < sizeof(page); ++i) {
+		page[i] = i % 7;
+	}
+	ASSERT_FALSE(Snapshot::IsZeroPage(page));
+
+	uint32_t size = Snapshot::CompressPage(page, out);
+	ASSERT_LT(size, Snapshot::kPageSize);
+	ASSERT_TRUE(Snapshot::DecompressPage(out, size, restored));
+	ASSERT_EQ(0, memcmp(page, restored, sizeof(page)));
+
+	// Incompressible pages are stored as they are
+	uint32_t seed = 1;
+	for(unsigned i = 0; i < sizeof(page); ++i) {
+		seed = seed * 1103515245 + 12345;
+		page[i] = seed >> 16;
+	}
+
+	size = Snapshot::CompressPage(page, out);
+	ASSERT_EQ(Snapshot::kPageSize, size);
+	ASSERT_TRUE(Snapshot::DecompressPage(out, size, restored));
+	ASSERT_EQ(0, memcmp(page, restored, sizeof(page)));
+}
+
+static LazyMemoryRestorer *test_restorer;
+
+static void HandleTestFault(int signo, siginfo_t *info, void *ctx)
+{
+	if(!test_restorer->HandleFault((uintptr_t)info->si_addr)) {
+		abort();
+	}
+}
+
+TEST(Snapshot, LazyRestore)
+{
+	const size_t region_size = LazyMemoryRestorer::kChunkPages * Snapshot::kPageSize * 2;
+	uint8_t *region = (uint8_t *)mmap(nullptr, region_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ASSERT_NE(MAP_FAILED, region);
+
+	// Leave some junk in the region, which the restore should throw away
+	memset(region, 0xff, region_size);
+
+	uint8_t page[Snapshot::kPageSize], compressed[Snapshot::kPageSize];
+	memset(page, 0x5a, sizeof(page));
+	uint32_t size = Snapshot::CompressPage(page, compressed);
+
+	std::vector<LazyMemoryRestorer::Page> pages;
+	pages.push_back({ 1, compressed, size });
+	pages.push_back({ LazyMemoryRestorer::kChunkPages + 3, compressed, size });
+
+	LazyMemoryRestorer restorer(region, region_size, PROT_READ | PROT_WRITE, pages);
+	ASSERT_TRUE(restorer.Install());
+
+	struct sigaction sa, old_sa;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_sigaction = HandleTestFault;
+	sa.sa_flags = SA_SIGINFO;
+	test_restorer = &restorer;
+	sigaction(SIGSEGV, &sa, &old_sa);
+
+	ASSERT_EQ(0, region[0]);
+	ASSERT_EQ(0x5a, region[Snapshot::kPageSize]);
+	ASSERT_EQ(1, restorer.GetChunksRestored());
+
+	region[(LazyMemoryRestorer::kChunkPages + 3) * Snapshot::kPageSize] ^= 0xff;
+	ASSERT_EQ(0xa5, region[(LazyMemoryRestorer::kChunkPages + 3) * Snapshot::kPageSize]);
+	ASSERT_EQ(0, region[(LazyMemoryRestorer::kChunkPages + 4) * Snapshot::kPageSize]);
+	ASSERT_EQ(2, restorer.GetChunksRestored());
+
+	sigaction(SIGSEGV, &old_sa, nullptr);
+	munmap(region, region_size);
+}
@@ -0,0 +1,116 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "abi/devices/MMU.h"
+#include "abi/devices/SoftwareTLB.h"
+
+using archsim::Address;
+using archsim::abi::devices::AccessInfo;
+using archsim::abi::devices::SoftwareTLB;
+using archsim::abi::devices::TLBContext;
+
+static const AccessInfo KernelRead(1, false, false);
+static const AccessInfo KernelWrite(1, true, false);
+static const AccessInfo UserRead(0, false, false);
+
+TEST(SoftwareTLB, OnlyPermittedAccessesHit)
+{
+	SoftwareTLB tlb;
+	TLBContext ctx {1, 0};
+	Address phys;
+
+	ASSERT_FALSE(tlb.Lookup(Address(0x1234), ctx, KernelRead, phys));
+
+	tlb.Insert(Address(0x1234), Address(0x80001234), 0xfff, ctx, false, KernelRead);
+	ASSERT_TRUE(tlb.Lookup(Address(0x1ffc), ctx, KernelRead, phys));
+	ASSERT_EQ(Address(0x80001ffc), phys);
+
+	// Writes and user accesses haven't been checked yet
+	ASSERT_FALSE(tlb.Lookup(Address(0x1234), ctx, KernelWrite, phys));
+	ASSERT_FALSE(tlb.Lookup(Address(0x1234), ctx, UserRead, phys));
+
+	tlb.Insert(Address(0x1234), Address(0x80001234), 0xfff, ctx, false, KernelWrite);
+	ASSERT_TRUE(tlb.Lookup(Address(0x1234), ctx, KernelWrite, phys));
+	ASSERT_TRUE(tlb.Lookup(Address(0x1234), ctx, KernelRead, phys));
+}
+
+TEST(SoftwareTLB, ContextTagging)
+{
+	SoftwareTLB tlb;
+	TLBContext a {1, 0}, b {2, 0}, a_other_state {1, 1};
+	Address phys;
+
+	tlb.Insert(Address(0x1000), Address(0x5000), 0xfff, a, false, KernelRead);
+	tlb.Insert(Address(0x2000), Address(0x6000), 0xfff, a, true, KernelRead);
+
+	ASSERT_FALSE(tlb.Lookup(Address(0x1000), b, KernelRead, phys));
+	ASSERT_FALSE(tlb.Lookup(Address(0x1000), a_other_state, KernelRead, phys));
+
+	// Global translations are shared between address spaces, but not
+	// between states
+	ASSERT_TRUE(tlb.Lookup(Address(0x2000), b, KernelRead, phys));
+	ASSERT_FALSE(tlb.Lookup(Address(0x2000), a_other_state, KernelRead, phys));
+}
+
+TEST(SoftwareTLB, SelectiveFlush)
+{
+	SoftwareTLB tlb;
+	TLBContext a {1, 0}, b {2, 0};
+	Address phys;
+
+	tlb.Insert(Address(0x1000), Address(0x5000), 0xfff, a, false, KernelRead);
+	tlb.Insert(Address(0x1000), Address(0x7000), 0xfff, b, false, KernelRead);
+	tlb.Insert(Address(0x2000), Address(0x6000), 0xfff, a, false, KernelRead);
+	tlb.Insert(Address(0x3000), Address(0x8000), 0xfff, a, true, KernelRead);
+
+	tlb.FlushPage(Address(0x1000), 1);
+	ASSERT_FALSE(tlb.Lookup(Address(0x1000), a, KernelRead, phys));
+	ASSERT_TRUE(tlb.Lookup(Address(0x1000), b, KernelRead, phys));
+	ASSERT_EQ(Address(0x7000), phys);
+
+	tlb.FlushASID(1);
+	ASSERT_FALSE(tlb.Lookup(Address(0x2000), a, KernelRead, phys));
+	ASSERT_TRUE(tlb.Lookup(Address(0x3000), a, KernelRead, phys));
+
+	tlb.FlushPage(Address(0x3000));
+	ASSERT_FALSE(tlb.Lookup(Address(0x3000), a, KernelRead, phys));
+
+	tlb.Flush();
+	ASSERT_FALSE(tlb.Lookup(Address(0x1000), b, KernelRead, phys));
+}
+
+TEST(SoftwareTLB, Superpages)
+{
+	SoftwareTLB tlb;
+	TLBContext ctx {1, 0};
+	Address phys;
+
+	tlb.Insert(Address(0x40201234), Address(0x80201234), 0x1fffff, ctx, false, KernelRead);
+	ASSERT_TRUE(tlb.Lookup(Address(0x40201000), ctx, KernelRead, phys));
+	ASSERT_EQ(Address(0x80201000), phys);
+
+	// Flushing any address in the superpage removes it, even though the
+	// entry was filed under a different page
+	tlb.FlushPage(Address(0x40300000));
+	ASSERT_FALSE(tlb.Lookup(Address(0x40201000), ctx, KernelRead, phys));
+}
+
+TEST(SoftwareTLB, Replacement)
+{
+	SoftwareTLB tlb;
+	TLBContext ctx {1, 0};
+	Address phys;
+
+	// Fill one set past its capacity: the most recent insertions survive
+	Address::underlying_t stride = SoftwareTLB::kSets * Address::PageSize;
+	for(unsigned i = 0; i <= SoftwareTLB::kWays; ++i) {
+		tlb.Insert(Address(i * stride), Address(0x100000 + i * Address::PageSize), 0xfff, ctx, false, KernelRead);
+	}
+
+	ASSERT_FALSE(tlb.Lookup(Address(0), ctx, KernelRead, phys));
+	for(unsigned i = 1; i <= SoftwareTLB::kWays; ++i) {
+		ASSERT_TRUE(tlb.Lookup(Address(i * stride), ctx, KernelRead, phys));
+		ASSERT_EQ(Address(0x100000 + i * Address::PageSize), phys);
+	}
+}
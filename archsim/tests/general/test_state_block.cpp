@@ -0,0 +1,52 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "core/thread/StateBlock.h"
+
+#include <sstream>
+
+using archsim::StateBlock;
+using archsim::StateBlockDescriptor;
+
+TEST(StateBlock, HotEntriesArePackedFirst)
+{
+	StateBlock state_block;
+
+	auto cold = state_block.AddEntry<uint64_t>("cold");
+	auto flag = state_block.AddEntry<uint32_t>("flag", true, true);
+	auto pointer = state_block.AddEntry<void*>("pointer", true, true);
+
+	ASSERT_EQ(0U, flag.GetOffset());
+	ASSERT_EQ(8U, pointer.GetOffset());
+	ASSERT_EQ(StateBlockDescriptor::kHotSize, cold.GetOffset());
+
+	// Hot entries which do not fit go after the others
+	auto big = state_block.AddBlock("big", StateBlockDescriptor::kHotSize, true, true);
+	ASSERT_EQ(StateBlockDescriptor::kHotSize + StateBlockDescriptor::kCacheLineSize, big);
+
+	ASSERT_EQ(0U, (uintptr_t)state_block.GetData() % StateBlockDescriptor::kCacheLineSize);
+}
+
+TEST(StateBlock, HandlesMatchNamedLookups)
+{
+	StateBlock state_block;
+
+	auto first = state_block.AddEntry<uint32_t>("first");
+	*first.Get(state_block) = 1;
+
+	// Growing the block keeps the contents of existing entries
+	for(int i = 0; i < 64; ++i) {
+		state_block.AddBlock("entry_" + std::to_string(i), 24);
+	}
+	auto last = state_block.GetEntryHandle<uint64_t>("entry_63");
+	*last.Get(state_block) = 2;
+
+	ASSERT_EQ(1U, state_block.GetEntry<uint32_t>("first"));
+	ASSERT_EQ(2U, state_block.GetEntry<uint64_t>("entry_63"));
+	ASSERT_EQ(0U, last.GetOffset() % 8);
+
+	std::ostringstream dump;
+	state_block.GetDescriptor().Dump(dump);
+	ASSERT_NE(std::string::npos, dump.str().find("entry_63"));
+}
@@ -0,0 +1,78 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "TestThreads.h"
+
+using archsim::core::thread::ThreadInstance;
+using archsim::core::thread::ThreadMessage;
+
+TEST(ThreadMessages, InterruptsAreCoalesced)
+{
+	TestThreads test_threads;
+	ThreadInstance *thread = test_threads.Create(0);
+
+	ASSERT_FALSE(thread->HasMessage());
+
+	// Interrupts sent while one is waiting are folded into it
+	for(int i = 0; i < 3; ++i) {
+		thread->SendMessage(ThreadMessage::Interrupt);
+	}
+	ASSERT_TRUE(thread->HasMessage());
+	ASSERT_EQ(ThreadMessage::Interrupt, thread->GetNextMessage());
+	ASSERT_FALSE(thread->HasMessage());
+	ASSERT_EQ(ThreadMessage::Nop, thread->GetNextMessage());
+	ASSERT_EQ(2U, thread->GetMetrics().InterruptsCoalesced.get_value());
+
+	// Once it has been taken, the next interrupt needs a new message
+	thread->SendMessage(ThreadMessage::Interrupt);
+	ASSERT_TRUE(thread->HasMessage());
+	ASSERT_EQ(ThreadMessage::Interrupt, thread->GetNextMessage());
+	ASSERT_EQ(ThreadMessage::Nop, thread->GetNextMessage());
+	ASSERT_EQ(2U, thread->GetMetrics().InterruptsCoalesced.get_value());
+}
+
+TEST(ThreadMessages, NopsAreCoalesced)
+{
+	TestThreads test_threads;
+	ThreadInstance *thread = test_threads.Create(0);
+
+	// A thread sends itself a Nop every time it flushes its block cache, and
+	// there may be more of those in one translation than fit in the queue
+	for(int i = 0; i < 1000; ++i) {
+		thread->SendMessage(ThreadMessage::Nop);
+	}
+	thread->SendMessage(ThreadMessage::Halt);
+
+	ASSERT_TRUE(thread->HasMessage());
+	ASSERT_EQ(ThreadMessage::Nop, thread->GetNextMessage());
+	ASSERT_TRUE(thread->HasMessage());
+	ASSERT_EQ(ThreadMessage::Halt, thread->GetNextMessage());
+	ASSERT_FALSE(thread->HasMessage());
+
+	// Once it has been taken, the next Nop needs a new message
+	thread->SendMessage(ThreadMessage::Nop);
+	ASSERT_TRUE(thread->HasMessage());
+	ASSERT_EQ(ThreadMessage::Nop, thread->GetNextMessage());
+	ASSERT_FALSE(thread->HasMessage());
+}
+
+TEST(ThreadMessages, OtherMessagesAreNotCoalesced)
+{
+	TestThreads test_threads;
+	ThreadInstance *thread = test_threads.Create(0);
+
+	// A folded interrupt does not change the order of the other messages
+	thread->SendMessage(ThreadMessage::Interrupt);
+	thread->SendMessage(ThreadMessage::Nop);
+	thread->SendMessage(ThreadMessage::Interrupt);
+	thread->SendMessage(ThreadMessage::Halt);
+	thread->SendMessage(ThreadMessage::Halt);
+
+	ThreadMessage expected[] = { ThreadMessage::Interrupt, ThreadMessage::Nop, ThreadMessage::Halt, ThreadMessage::Halt };
+	for(auto message : expected) {
+		ASSERT_TRUE(thread->HasMessage());
+		ASSERT_EQ(message, thread->GetNextMessage());
+	}
+	ASSERT_FALSE(thread->HasMessage());
+}
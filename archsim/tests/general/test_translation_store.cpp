@@ -0,0 +1,106 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "translate/TranslationStore.h"
+
+#include <fstream>
+#include <iterator>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+using archsim::ProcessorFeatureSet;
+using archsim::translate::StoredTranslation;
+using archsim::translate::StoredTranslationKind;
+using archsim::translate::TranslationStore;
+using archsim::translate::TranslationStoreKey;
+
+static TranslationStoreKey MakeKey()
+{
+	TranslationStoreKey key;
+	memset(&key, 0, sizeof(key));
+	key.PageHash = 0x1234;
+	key.Address = 0x8000;
+	key.Kind = StoredTranslationKind::BlockJIT;
+	return key;
+}
+
+static std::vector<uint8_t> ReadFile(const char *filename)
+{
+	std::ifstream file(filename, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static void WriteFile(const char *filename, const std::vector<uint8_t> &contents)
+{
+	std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+	file.write((const char*)contents.data(), contents.size());
+}
+
+TEST(TranslationStore, RejectsEntryLargerThanFile)
+{
+	char filename[] = "/tmp/archsim-txln-store-XXXXXX";
+	int fd = mkstemp(filename);
+	ASSERT_GE(fd, 0);
+	close(fd);
+
+	TranslationStoreKey key = MakeKey();
+	uint8_t code[16];
+	memset(code, 0x90, sizeof(code));
+
+	{
+		TranslationStore store;
+		ASSERT_TRUE(store.Open(filename, "test"));
+		ASSERT_TRUE(store.Insert(key, code, sizeof(code), {}, ProcessorFeatureSet()));
+		ASSERT_TRUE(store.Save());
+	}
+
+	{
+		TranslationStore store;
+		ASSERT_TRUE(store.Open(filename, "test"));
+
+		StoredTranslation txln;
+		ASSERT_TRUE(store.Lookup(key, txln));
+		ASSERT_EQ(sizeof(code), txln.GetSize());
+		ASSERT_EQ(0, memcmp(code, txln.GetCode(), sizeof(code)));
+	}
+
+	// The code size follows the key in the entry header. Claiming more code
+	// than the entry holds must not let lookups read past the mapping.
+	std::vector<uint8_t> contents = ReadFile(filename);
+	uint8_t *entry = (uint8_t*)memmem(contents.data(), contents.size(), &key, sizeof(key));
+	ASSERT_NE(nullptr, entry);
+	uint32_t code_size = 0x100000;
+	memcpy(entry + sizeof(key), &code_size, sizeof(code_size));
+	WriteFile(filename, contents);
+
+	{
+		TranslationStore store;
+		ASSERT_TRUE(store.Open(filename, "test"));
+		ASSERT_FALSE(store.Contains(key));
+	}
+
+	unlink(filename);
+}
+
+TEST(TranslationStore, StateBlockHashFollowsLayout)
+{
+	archsim::StateBlockDescriptor a, b, c;
+
+	a.AddBlock("MessageWaiting", 4, true, true);
+	a.AddBlock("BlockCache", 8, true, true);
+
+	b.AddBlock("MessageWaiting", 4, true, true);
+	b.AddBlock("BlockCache", 8, true, true);
+	ASSERT_EQ(TranslationStore::HashStateBlock(a), TranslationStore::HashStateBlock(b));
+
+	// Hot entries are packed in the order they are added, so registering
+	// the same entries in another order moves them
+	c.AddBlock("BlockCache", 8, true, true);
+	c.AddBlock("MessageWaiting", 4, true, true);
+	ASSERT_NE(TranslationStore::HashStateBlock(a), TranslationStore::HashStateBlock(c));
+
+	b.AddBlock("MemoryModelCache", 8, true, true);
+	ASSERT_NE(TranslationStore::HashStateBlock(a), TranslationStore::HashStateBlock(b));
+}
@@ -0,0 +1,161 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+#include <gtest/gtest.h>
+
+#include "translate/TranslationManager.h"
+#include "translate/TranslationWorkUnit.h"
+#include "translate/WorkUnitQueue.h"
+#include "translate/profile/Region.h"
+#include "util/PubSubSync.h"
+
+#include <vector>
+
+using archsim::Address;
+using archsim::translate::TranslationManager;
+using archsim::translate::TranslationWorkUnit;
+using archsim::translate::WorkUnitQueue;
+using archsim::translate::profile::Region;
+
+class WorkUnitQueueTest : public ::testing::Test
+{
+protected:
+	WorkUnitQueueTest() : manager(pubsub) {}
+
+	~WorkUnitQueueTest()
+	{
+		for(auto region : regions) region->Release();
+	}
+
+	Region &MakeRegion(uint32_t page)
+	{
+		Region *region = new Region(manager, Address(page << 12));
+		regions.push_back(region);
+		return *region;
+	}
+
+	TranslationWorkUnit *MakeUnit(Region &region, uint32_t weight)
+	{
+		return new TranslationWorkUnit(nullptr, region, 0, weight);
+	}
+
+	archsim::util::PubSubContext pubsub;
+	TranslationManager manager;
+	std::vector<Region *> regions;
+};
+
+TEST_F(WorkUnitQueueTest, PopsHottestFirst)
+{
+	WorkUnitQueue queue(1);
+
+	uint32_t weights[] = { 5, 50, 1, 20, 100, 10 };
+	for(uint32_t i = 0; i < 6; ++i) {
+		queue.Push(MakeUnit(MakeRegion(i), weights[i]));
+	}
+	ASSERT_EQ(6U, queue.Size());
+
+	uint32_t expected[] = { 100, 50, 20, 10, 5, 1 };
+	for(auto weight : expected) {
+		TranslationWorkUnit *unit = queue.TryPop(0);
+		ASSERT_NE(nullptr, unit);
+		EXPECT_EQ(weight, unit->GetProfileWeight());
+		delete unit;
+	}
+
+	EXPECT_EQ(nullptr, queue.TryPop(0));
+}
+
+TEST_F(WorkUnitQueueTest, StealsFromOtherShards)
+{
+	WorkUnitQueue queue(4);
+
+	for(uint32_t i = 0; i < 16; ++i) {
+		queue.Push(MakeUnit(MakeRegion(i), i));
+	}
+
+	// Whichever shards the regions landed in, one worker drains them all
+	for(uint32_t i = 0; i < 16; ++i) {
+		TranslationWorkUnit *unit = queue.TryPop(0);
+		ASSERT_NE(nullptr, unit);
+		delete unit;
+	}
+
+	EXPECT_EQ(0U, queue.Size());
+	EXPECT_EQ(nullptr, queue.TryPop(0));
+}
+
+TEST_F(WorkUnitQueueTest, RequeueReplacesWaitingUnit)
+{
+	WorkUnitQueue queue(1);
+
+	Region &cold = MakeRegion(1);
+	Region &warm = MakeRegion(2);
+	Region &hot = MakeRegion(3);
+
+	queue.Push(MakeUnit(cold, 1));
+	queue.Push(MakeUnit(warm, 10));
+	queue.Push(MakeUnit(hot, 100));
+
+	// Profiling the waiting regions again moves them to their new places
+	queue.Push(MakeUnit(cold, 1000));
+	queue.Push(MakeUnit(hot, 0));
+	ASSERT_EQ(3U, queue.Size());
+
+	Region *expected[] = { &cold, &warm, &hot };
+	uint32_t weights[] = { 1000, 10, 0 };
+	for(int i = 0; i < 3; ++i) {
+		TranslationWorkUnit *unit = queue.TryPop(0);
+		ASSERT_NE(nullptr, unit);
+		EXPECT_EQ(expected[i], &unit->GetRegion());
+		EXPECT_EQ(weights[i], unit->GetProfileWeight());
+		delete unit;
+	}
+}
+
+TEST_F(WorkUnitQueueTest, DropsInvalidatedRegions)
+{
+	WorkUnitQueue queue(1);
+
+	Region &stale = MakeRegion(1);
+	Region &live = MakeRegion(2);
+	queue.Push(MakeUnit(stale, 100));
+	queue.Push(MakeUnit(live, 1));
+
+	stale.Invalidate();
+
+	TranslationWorkUnit *unit = queue.TryPop(0);
+	ASSERT_NE(nullptr, unit);
+	EXPECT_EQ(&live, &unit->GetRegion());
+	delete unit;
+
+	EXPECT_EQ(nullptr, queue.TryPop(0));
+}
+
+TEST_F(WorkUnitQueueTest, RegionsHeatingUpWhileWaitingMoveForward)
+{
+	WorkUnitQueue queue(1);
+
+	Region &cold = MakeRegion(1);
+	Region &warm = MakeRegion(2);
+	Region &hot = MakeRegion(3);
+
+	TranslationWorkUnit *cold_unit = MakeUnit(cold, 1);
+	queue.Push(cold_unit);
+	queue.Push(MakeUnit(warm, 10));
+	queue.Push(MakeUnit(hot, 100));
+
+	// The cold region keeps being interpreted after it was queued. A region
+	// which is in translation only counts its heat, so no thread is needed.
+	cold.SetStatus(Region::InTranslation);
+	for(int i = 0; i < 500; ++i) {
+		cold.TraceBlock(nullptr, Address(0x1000));
+	}
+	EXPECT_EQ(501U, WorkUnitQueue::GetWeight(*cold_unit));
+
+	Region *expected[] = { &cold, &hot, &warm };
+	for(auto region : expected) {
+		TranslationWorkUnit *unit = queue.TryPop(0);
+		ASSERT_NE(nullptr, unit);
+		EXPECT_EQ(region, &unit->GetRegion());
+		delete unit;
+	}
+}
@@ -0,0 +1,78 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   TestThreads.h
+ *
+ * A minimal architecture and emulation model, for tests which need real
+ * ThreadInstances (e.g. to send them messages or schedule them) but which
+ * never execute guest code.
+ */
+
+#ifndef TESTTHREADS_H
+#define TESTTHREADS_H
+
+#include "abi/EmulationModel.h"
+#include "core/arch/ArchDescriptor.h"
+#include "core/thread/ThreadInstance.h"
+#include "util/PubSubSync.h"
+
+#include <memory>
+#include <vector>
+
+class TestEmulationModel : public archsim::abi::EmulationModel
+{
+public:
+	void HaltCores() override {}
+
+	gensim::DecodeContext *GetNewDecodeContext(archsim::core::thread::ThreadInstance &cpu) override
+	{
+		return nullptr;
+	}
+
+	bool PrepareBoot(System &system) override
+	{
+		return true;
+	}
+
+	archsim::abi::ExceptionAction HandleException(archsim::core::thread::ThreadInstance *thread, uint64_t category, uint64_t data) override
+	{
+		return archsim::abi::AbortSimulation;
+	}
+
+	void PrintStatistics(std::ostream &stream) override {}
+};
+
+class TestThreads
+{
+public:
+	TestThreads() : Arch(GetTestThreadArch()) {}
+
+	// Threads are owned by this object, and live as long as it does.
+	archsim::core::thread::ThreadInstance *Create(int thread_id)
+	{
+		threads_.emplace_back(new archsim::core::thread::ThreadInstance(PubSub, Arch, Model, thread_id));
+		return threads_.back().get();
+	}
+
+	archsim::util::PubSubContext PubSub;
+	archsim::ArchDescriptor Arch;
+	TestEmulationModel Model;
+
+private:
+	static archsim::ArchDescriptor GetTestThreadArch()
+	{
+		archsim::ISABehavioursDescriptor behaviours({});
+		archsim::ISADescriptor isa("isa", 0, [](archsim::Address addr, archsim::MemoryInterface *, gensim::BaseDecode&) {
+			return 0u;
+		}, nullptr, []()->gensim::BaseDecode* { return nullptr; }, []()->gensim::BaseJumpInfoProvider* { return nullptr; }, []()->gensim::DecodeTranslateContext* { return nullptr; }, behaviours);
+		archsim::FeaturesDescriptor f({});
+		archsim::MemoryInterfacesDescriptor mem({archsim::MemoryInterfaceDescriptor("Mem", 4, 4, false, 0)}, "Mem");
+		archsim::RegisterFileDescriptor rf(128, {archsim::RegisterFileEntryDescriptor("PC", 0, 0, 1, 8, 1, 8, 8, "PC")});
+
+		return archsim::ArchDescriptor("test_arch", rf, mem, f, {isa});
+	}
+
+	std::vector<std::unique_ptr<archsim::core::thread::ThreadInstance>> threads_;
+};
+
+#endif /* TESTTHREADS_H */
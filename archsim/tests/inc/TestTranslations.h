@@ -0,0 +1,35 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   TestTranslations.h
+ *
+ * Stand-ins for translated code, for tests of the block profile and of
+ * block chaining. Each has a jump displacement at offset 4, and an exit
+ * path at offset 8.
+ */
+
+#ifndef TESTTRANSLATIONS_H
+#define TESTTRANSLATIONS_H
+
+#include "blockjit/BlockProfile.h"
+
+#include <string.h>
+
+alignas(16) static uint8_t code_a[16], code_b[16];
+
+static const uint8_t *GetJumpTarget(const uint8_t *code)
+{
+	int32_t displacement;
+	memcpy(&displacement, code + 4, sizeof(displacement));
+	return code + 8 + displacement;
+}
+
+static archsim::blockjit::BlockTranslation MakeTranslation(uint8_t *code)
+{
+	archsim::blockjit::BlockTranslation txln;
+	txln.SetFn((captive::shared::block_txln_fn)code);
+	txln.SetSize(16);
+	return txln;
+}
+
+#endif /* TESTTRANSLATIONS_H */
@@ -34,6 +34,8 @@ namespace gensim
 			bool GenerateStepInstruction(util::cppformatstream &str) const;
 			bool GenerateStepInstructionISA(util::cppformatstream &str, isa::ISADescription &isa) const;
 			bool RegisterStepInstruction(isa::InstructionDescription &insn) const;
+			bool GenerateInstructionHandlers(util::cppformatstream &str) const;
+			bool GenerateInstructionHandlersISA(util::cppformatstream &str, isa::ISADescription &isa) const;
 
 			bool GenerateBehavioursDescriptors(util::cppformatstream &str) const;
 		};
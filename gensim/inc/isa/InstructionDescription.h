@@ -75,6 +75,10 @@ namespace gensim
 			std::list<std::vector<DecodeConstraint> > EOB_Contraints;
 
 			std::list<std::vector<DecodeConstraint> > Uses_PC_Constraints;
+
+			// When this instruction is a call to, or return from, a function
+			std::list<std::vector<DecodeConstraint> > Call_Constraints;
+			std::list<std::vector<DecodeConstraint> > Return_Constraints;
 			std::vector<uint32_t> Specialisations;
 
 			std::list<AsmDescription*> Disasms;
@@ -386,6 +386,7 @@ void SSAInterpreterStatementVisitor::VisitIntrinsicStatement(SSAIntrinsicStateme
 		case IntrinsicID::SetCpuMode:
 		case IntrinsicID::TakeException:
 		case IntrinsicID::PendInterrupt:
+		case IntrinsicID::WaitForInterrupt:
 		case IntrinsicID::Trap:
 		case IntrinsicID::WriteDevice32:
 		case IntrinsicID::PopInterrupt:
@@ -1037,6 +1037,9 @@ namespace gensim
 //							output << "UNIMPLEMENTED; // pendirq\n";
 							output << "builder.call(IROperand::const32(0), IROperand::func((void*)cpuPendInterrupt));";
 							break;
+						case IntrinsicID::WaitForInterrupt:
+							output << "builder.call(IROperand::const32(0), IROperand::func((void*)cpuWaitForInterrupt));";
+							break;
 						case IntrinsicID::PopInterrupt:
 							// XXX TODO FIXME
 							output << "builder.trap();";
@@ -44,6 +44,7 @@ bool InterpEEGenerator::GenerateHeader(util::cppformatstream &str) const
 	    "class Interpreter : public archsim::interpret::Interpreter {"
 	    "public:"
 	    "   virtual archsim::core::execution::ExecutionResult StepBlock(archsim::core::execution::InterpreterExecutionEngineThreadContext *thread);"
+	    "   virtual archsim::interpret::instruction_handler_t GetInstructionHandler(const gensim::BaseDecode &decode, uint32_t isa_mode, bool trace);"
 	    "	using decode_t = gensim::" << Manager.GetArch().Name << "::Decode;"
 	    "private:"
 	    "	gensim::DecodeContext *decode_context_;"
@@ -89,6 +90,7 @@ bool InterpEEGenerator::GenerateSource(util::cppformatstream &str) const
 
 	GenerateHelperFunctions(str);
 	GenerateStepInstruction(str);
+	GenerateInstructionHandlers(str);
 
 	GenerateBehavioursDescriptors(str);
 
@@ -171,7 +173,7 @@ bool InterpEEGenerator::GenerateBlockExecutor(util::cppformatstream& str) const
 	    "  uint32_t dcode_exception = DecodeInstruction(static_cast<archsim::core::execution::InterpreterExecutionEngineThreadContext*>(thread_ctx), inst_);"
 	    "  if(thread->HasMessage()) { return thread->HandleMessage(); }"
 	    "  if(dcode_exception) { thread->TakeMemoryException(thread->GetFetchMI(), thread->GetPC()); return archsim::core::execution::ExecutionResult::Exception; }"
-	    "  if(archsim::options::InstructionTick) { thread->GetPubsub().Publish(PubSubType::InstructionExecute, nullptr); } "
+	    "  if(archsim::options::InstructionTick) { thread->InstructionTick(); } "
 	    "  auto result = StepInstruction(thread, *inst_);"
 	    "  if(inst_->GetEndOfBlock()) { inst_->Release(); return archsim::core::execution::ExecutionResult::Continue; }"
 	    "  inst_->Release();"
@@ -294,6 +296,65 @@ bool InterpEEGenerator::GenerateStepInstructionISA(util::cppformatstream& str, i
 	return true;
 }
 
+bool InterpEEGenerator::GenerateInstructionHandlers(util::cppformatstream& str) const
+{
+	for(auto i : Manager.GetArch().ISAs) {
+		GenerateInstructionHandlersISA(str, *i);
+	}
+
+	// Look up the handler for a pre-decoded instruction, so that the
+	// interpreter can dispatch directly to it without switching on the mode
+	// and instruction code each time the instruction is executed.
+	str << "archsim::interpret::instruction_handler_t Interpreter::GetInstructionHandler(const gensim::BaseDecode &decode, uint32_t isa_mode, bool trace) {";
+	str << "using namespace gensim::" << Manager.GetArch().Name << ";";
+	str << "switch(isa_mode) {";
+
+	for(auto isa : Manager.GetArch().ISAs) {
+		str << "case " << isa->isa_mode_id << ":";
+		str << "switch(decode.Instr_Code) {";
+		for(auto i : isa->Instructions) {
+			str << "case INST_" << isa->ISAName << "_" << i.second->Name << ": return trace ? &Handler_" << isa->ISAName << "_" << i.first << "<true> : &Handler_" << isa->ISAName << "_" << i.first << "<false>;";
+		}
+		str << "default: return nullptr;";
+		str << "}";
+	}
+
+	str << "default: return nullptr;";
+	str << "}";
+	str << "}";
+
+	return true;
+}
+
+bool InterpEEGenerator::GenerateInstructionHandlersISA(util::cppformatstream& str, isa::ISADescription& isa) const
+{
+	bool has_predicate = isa.GetSSAContext().HasAction("instruction_is_predicated") && isa.GetSSAContext().HasAction("instruction_predicate");
+
+	for(auto i : isa.Instructions) {
+		str << "template<bool trace> static archsim::core::execution::ExecutionResult Handler_" << isa.ISAName << "_" << i.first << "(archsim::core::thread::ThreadInstance *thread, gensim::BaseDecode &base_decode) {";
+		str << "Interpreter::decode_t &decode = static_cast<Interpreter::decode_t&>(base_decode);";
+		str << "gensim::" << Manager.GetArch().Name << "::ArchInterface interface(thread);";
+		str << "archsim::core::execution::ExecutionResult interp_result = archsim::core::execution::ExecutionResult::Continue;";
+		str << "bool should_execute = true;";
+
+		str << "if(trace) { thread->GetTraceSource()->Trace_Insn(thread->GetPC().Get(), decode.ir, false, thread->GetModeID(), thread->GetExecutionRing(), 1); }";
+		if(has_predicate) {
+			str << "should_execute =  !" << isa.ISAName << "_is_predicated(thread, decode) || " << isa.ISAName << "_check_predicate(thread, decode);";
+		}
+		str << "if(should_execute) { interp_result = StepInstruction_" << isa.ISAName << "_" << i.first << "<trace>(thread, decode); }";
+
+		str << "if(!decode.GetEndOfBlock() || !should_execute) {";
+		str << "  interface.write_pc(interface.read_pc() + decode.Instr_Length);";
+		str << "}";
+
+		str << "if(trace) { thread->GetTraceSource()->Trace_End_Insn(); }";
+		str << "return interp_result;";
+		str << "}";
+	}
+
+	return true;
+}
+
 bool InterpEEGenerator::GenerateBehavioursDescriptors(util::cppformatstream& str) const
 {
 	std::string isa_descriptors;
@@ -446,6 +446,9 @@ namespace gensim
 					case IntrinsicID::PendInterrupt:
 						output << "thread->PendIRQ();";
 						break;
+					case IntrinsicID::WaitForInterrupt:
+						output << "thread->WaitForInterrupt();";
+						break;
 
 					case IntrinsicID::Abs32:
 					case IntrinsicID::Abs64:
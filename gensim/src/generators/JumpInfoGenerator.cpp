@@ -27,6 +27,8 @@ public:
 private:
 	bool GenerateHeader(util::cppformatstream &stream) const;
 	bool GenerateSource(util::cppformatstream &stream) const;
+
+	void GenerateConstrainedFlag(util::cppformatstream &stream, const std::list<std::vector<isa::InstructionDescription::DecodeConstraint> > &constraints, const std::string &flag) const;
 };
 
 bool JumpInfoGenerator::Generate() const
@@ -55,7 +57,7 @@ bool JumpInfoGenerator::GenerateSource(util::cppformatstream &stream) const
 	stream << "using namespace gensim; using namespace gensim::" << Manager.GetArch().Name << ";";
 	stream << "void JumpInfoProvider::GetJumpInfo(const gensim::BaseDecode *instr, archsim::Address pc, JumpInfo &info) {";
 
-	stream << "info.IsJump = info.IsIndirect = info.IsConditional = false;";
+	stream << "info.IsJump = info.IsIndirect = info.IsConditional = info.IsCall = info.IsReturn = false;";
 	stream << "const Decode *inst = static_cast<const Decode*>(instr);";
 
 	stream << "if(!instr->GetEndOfBlock()) { return; }";
@@ -82,6 +84,8 @@ bool JumpInfoGenerator::GenerateSource(util::cppformatstream &stream) const
 						stream << "info.JumpTarget = pc + inst->" << i->second->FixedJumpField << " + " << i->second->FixedJumpOffset << ";";
 					}
 				}
+				GenerateConstrainedFlag(stream, i->second->Call_Constraints, "IsCall");
+				GenerateConstrainedFlag(stream, i->second->Return_Constraints, "IsReturn");
 				stream << "break;\n";
 			}
 		}
@@ -92,6 +96,32 @@ bool JumpInfoGenerator::GenerateSource(util::cppformatstream &stream) const
 	return true;
 }
 
+// Set a flag in the jump info if any of the sets of constraints on the decoded
+// instruction's fields is satisfied (an empty set is always satisfied).
+void JumpInfoGenerator::GenerateConstrainedFlag(util::cppformatstream &stream, const std::list<std::vector<isa::InstructionDescription::DecodeConstraint> > &constraints, const std::string &flag) const
+{
+	for (const auto &constraint_set : constraints) {
+		if (constraint_set.size() == 0) {
+			stream << "info." << flag << " = true;";
+			return;
+		}
+
+		stream << "if(";
+		bool first = true;
+		for (const auto &constraint : constraint_set) {
+			if (!first) stream << " && ";
+			first = false;
+			if (constraint.Type == isa::InstructionDescription::Constraint_Equals)
+				stream << "(inst->" << constraint.Field << " == " << constraint.Value << ")";
+			else if (constraint.Type == isa::InstructionDescription::Constraint_BitwiseAnd)
+				stream << "((inst->" << constraint.Field << " & " << constraint.Value << ") == " << constraint.Value << ")";
+			else
+				stream << "(inst->" << constraint.Field << " != " << constraint.Value << ")";
+		}
+		stream << ") info." << flag << " = true;";
+	}
+}
+
 bool JumpInfoGenerator::GenerateHeader(util::cppformatstream &stream) const
 {
 	stream << "#include <cstdint>\n";
@@ -330,6 +330,22 @@ bool ISADescriptionParser::load_isa_from_node(pANTLR3_BASE_TREE node, std::strin
 				}
 				break;
 			}
+			case SET_CALL:
+			case SET_RETURN: {
+				pANTLR3_BASE_TREE instrNode = (pANTLR3_BASE_TREE)child->getChild(child, 0);
+				std::string instrName = (char *)instrNode->getText(instrNode)->chars;
+
+				if (isa->Instructions.find(instrName) == isa->Instructions.end()) {
+					diag.Error("Attempting to add call/return constraint to unknown instruction " + instrName, DiagNode(filename, instrNode));
+					success = false;
+				} else {
+					InstructionDescription *instr = isa->instructions_.at(instrName);
+					auto &constraints = child->getType(child) == SET_CALL ? instr->Call_Constraints : instr->Return_Constraints;
+					if(!InstructionDescriptionParser::load_constraints_from_node(child, constraints))
+						success = false;
+				}
+				break;
+			}
 			case SET_USES_PC: {
 				pANTLR3_BASE_TREE instrNode = (pANTLR3_BASE_TREE)child->getChild(child, 0);
 				std::string instrName = (char *)instrNode->getText(instrNode)->chars;
@@ -1,6 +1,8 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
 #include <mutex>
 #include <thread>
 #include <vector>
@@ -93,18 +95,35 @@ namespace libgvnc
 		bool ServePointerEvent();
 		bool ServeClientCutText();
 
-		void UpdateFB(const struct fb_update_request &request);
+		// Framebuffer updates are encoded and sent on their own thread, so
+		// that input events are still delivered while a large update is
+		// being encoded. Requests which arrive while one is pending are
+		// merged into it.
+		void QueueUpdate(const struct fb_update_request &request);
+		void EncoderThread();
+		void StopEncoder();
+		void SendUpdate(const std::vector<Rectangle> &rectangles);
 
 		void SetPixelFormat(struct FB_PixelFormat &new_format)
 		{
+			std::lock_guard<std::mutex> lg(update_lock_);
 			pixel_format_ = new_format;
 		}
 
 		struct FB_PixelFormat pixel_format_;
-		std::thread thread_;
+		EncodingType encoding_;
 		std::mutex lock_;
+
+		std::thread encoder_thread_;
+		std::mutex update_lock_;
+		std::condition_variable update_cv_;
+		bool update_pending_;
+		struct fb_update_request pending_request_;
+
 		net::Socket *client_socket_;
-		bool open_;
+		// Shared by the reader and encoder threads, either of which may
+		// close the connection
+		std::atomic<bool> open_;
 		State state_;
 		int subversion_;
 		Server *server_;
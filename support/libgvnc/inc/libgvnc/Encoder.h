@@ -3,6 +3,8 @@
 
 #include "Framebuffer.h"
 
+#include <zlib.h>
+
 namespace libgvnc
 {
 
@@ -26,6 +28,10 @@ namespace libgvnc
 			return encoded_format_;
 		}
 
+	protected:
+		// Append a pixel in the encoded format
+		void AppendPixel(std::vector<char> &data, uint32_t pixel) const;
+
 	private:
 		struct FB_PixelFormat encoded_format_;
 		RectangleShape shape_;
@@ -43,4 +49,85 @@ namespace libgvnc
 
 		virtual std::vector<char> Encode(const std::vector<uint32_t> &data);
 	};
+
+	/**
+	 * Splits a rectangle into 16x16 tiles, each of which is sent as a
+	 * background colour plus solid subrectangles, or as raw pixels if that
+	 * would be smaller.
+	 */
+	class HextileEncoder : public Encoder
+	{
+	public:
+		HextileEncoder(const struct FB_PixelFormat &format, const RectangleShape &shape);
+
+		virtual std::vector<char> Encode(const std::vector<uint32_t> &data);
+
+	private:
+		static const uint32_t kTileSize = 16;
+
+		void EncodeTile(std::vector<char> &data, const std::vector<uint32_t> &pixels, uint32_t tile_x, uint32_t tile_y, uint32_t width, uint32_t height);
+
+		bool background_valid_;
+		uint32_t background_;
+	};
+
+	/**
+	 * A deflate stream which is kept for the lifetime of a connection. ZRLE
+	 * requires every rectangle to be compressed with the same stream, so
+	 * that the client's inflate stream stays in step.
+	 */
+	class ZlibStream
+	{
+	public:
+		ZlibStream();
+		~ZlibStream();
+
+		ZlibStream(const ZlibStream &) = delete;
+		ZlibStream &operator=(const ZlibStream &) = delete;
+
+		std::vector<char> Compress(const std::vector<char> &input);
+
+	private:
+		z_stream stream_;
+	};
+
+	/**
+	 * Per connection state which encoders carry from one rectangle to the
+	 * next.
+	 */
+	class EncoderState
+	{
+	public:
+		ZlibStream &GetZRLEStream()
+		{
+			return zrle_stream_;
+		}
+
+	private:
+		ZlibStream zrle_stream_;
+	};
+
+	/**
+	 * Splits a rectangle into 64x64 tiles, each of which is sent as a solid
+	 * colour, a packed palette, run lengths or raw pixels, and compresses
+	 * the result with the connection's zlib stream.
+	 */
+	class ZRLEEncoder : public Encoder
+	{
+	public:
+		ZRLEEncoder(const struct FB_PixelFormat &format, const RectangleShape &shape, ZlibStream &stream);
+
+		virtual std::vector<char> Encode(const std::vector<uint32_t> &data);
+
+	private:
+		static const uint32_t kTileSize = 64;
+
+		void EncodeTile(std::vector<char> &data, const std::vector<uint32_t> &pixels, uint32_t tile_width);
+		void AppendCPixel(std::vector<char> &data, uint32_t pixel) const;
+
+		ZlibStream &stream_;
+		bool compact_pixels_;
+		// Which three bytes of a compact pixel are sent
+		uint32_t cpixel_shift_;
+	};
 }
@@ -33,7 +33,9 @@ namespace libgvnc
 	};
 
 	enum class EncodingType : int32_t {
-		Raw = 0
+		Raw = 0,
+		Hextile = 5,
+		ZRLE = 16
 	};
 
 	class RectangleShape
@@ -51,6 +53,8 @@ namespace libgvnc
 		std::vector<char> Data;
 	};
 
+	class EncoderState;
+
 	class Framebuffer
 	{
 	public:
@@ -85,11 +89,14 @@ namespace libgvnc
 			return data_;
 		}
 
-		std::vector<Rectangle> ServeRequest(const struct fb_update_request &request, const struct FB_PixelFormat &target_format);
-		void FillRectangle(Rectangle &rect, const struct FB_PixelFormat &target_format, EncodingType encoding);
+		std::vector<Rectangle> ServeRequest(const std::vector<RectangleShape> &shapes, const struct FB_PixelFormat &target_format, EncodingType encoding, EncoderState &state);
+		void FillRectangle(Rectangle &rect, const struct FB_PixelFormat &target_format, EncodingType encoding, EncoderState &state);
 
 		uint32_t GetPixel(uint32_t x, uint32_t y) const;
 
+		// Hash the current contents of part of the framebuffer
+		uint64_t HashRectangle(const RectangleShape &shape) const;
+
 	private:
 		uint16_t height_, width_;
 		std::string title_;
@@ -97,4 +104,29 @@ namespace libgvnc
 
 		void *data_;
 	};
+
+	/**
+	 * Works out which parts of a framebuffer have changed since they were
+	 * last sent to a client, by comparing a hash of each tile with the hash
+	 * it had when it was sent. Each client has its own tracker.
+	 */
+	class DamageTracker
+	{
+	public:
+		static const uint16_t kTileSize = 64;
+
+		DamageTracker(const Framebuffer &fb);
+
+		// Return the parts of a requested region which must be sent. If the
+		// request is incremental, unchanged tiles are left out. Adjacent
+		// tiles in a row are merged into one rectangle.
+		std::vector<RectangleShape> Update(const RectangleShape &region, bool incremental);
+
+	private:
+		const Framebuffer &fb_;
+		uint16_t tiles_x_, tiles_y_;
+
+		std::vector<uint64_t> hashes_;
+		std::vector<bool> valid_;
+	};
 }
@@ -2,13 +2,19 @@
 #include "libgvnc/ClientConnection.h"
 #include "libgvnc/Framebuffer.h"
 #include "libgvnc/Server.h"
+#include "libgvnc/Encoder.h"
+#include <algorithm>
+#include <chrono>
 #include <stdexcept>
 #include <arpa/inet.h>
 
 using namespace libgvnc;
 using namespace libgvnc::net;
 
-ClientConnection::ClientConnection(Server *server, Socket *client_socket) : client_socket_(client_socket), state_(State::Invalid), server_(server)
+// How often a deferred incremental update checks the framebuffer again
+static const std::chrono::milliseconds kUpdatePollInterval(20);
+
+ClientConnection::ClientConnection(Server *server, Socket *client_socket) : client_socket_(client_socket), state_(State::Invalid), server_(server), encoding_(EncodingType::Raw), update_pending_(false)
 {
 }
 
@@ -16,13 +22,21 @@ void ClientConnection::Open()
 {
 	open_ = true;
 	state_ = State::FreshlyConnected;
-	thread_ = std::thread([this]() {
+	// The connection owns itself once it is open, and is deleted by its
+	// own thread, so nothing else ever needs to join it.
+	std::thread([this]() {
 		try {
 			Run();
 		} catch(std::exception &e) {
-			delete this;
 		}
-	});
+
+		StopEncoder();
+		if(state_ != State::Closed) {
+			Close();
+		}
+
+		delete this;
+	}).detach();
 }
 
 void ClientConnection::Close()
@@ -39,6 +53,10 @@ void ClientConnection::Run()
 		return;
 	}
 
+	encoder_thread_ = std::thread([this]() {
+		EncoderThread();
+	});
+
 	while(open_) {
 		std::lock_guard<std::mutex> lg(lock_);
 
@@ -63,6 +81,9 @@ void ClientConnection::ReceiveRaw(void* data, size_t size)
 	char *cdata = (char*)data;
 	while(total_bytes < size) {
 		int bytes = client_socket_->Read(cdata + total_bytes, size - total_bytes);
+		if(bytes == 0) {
+			throw std::logic_error("Connection closed");
+		}
 		if(bytes < 0) {
 			throw std::logic_error("Something went wrong: " + std::string(strerror(errno)));
 		}
@@ -234,6 +255,20 @@ bool ClientConnection::ServeSetEncodings()
 	encodings.resize(number_encodings);
 	ReceiveRaw(encodings.data(), sizeof(int32_t) * number_encodings);
 
+	// Encodings are listed in order of preference, so use the first one
+	// which is supported
+	EncodingType encoding = EncodingType::Raw;
+	for(auto encoding_id : encodings) {
+		EncodingType type = (EncodingType)(int32_t)ntohl(encoding_id);
+		if(type == EncodingType::ZRLE || type == EncodingType::Hextile || type == EncodingType::Raw) {
+			encoding = type;
+			break;
+		}
+	}
+
+	std::lock_guard<std::mutex> lg(update_lock_);
+	encoding_ = encoding;
+
 	return true;
 }
 
@@ -252,12 +287,109 @@ bool ClientConnection::ServeFramebufferUpdateRequest()
 	Receive(request.height);
 	request.height = ntohs(request.height);
 
-	UpdateFB(request);
+	QueueUpdate(request);
 
 	return true;
 }
 
-void ClientConnection::UpdateFB(const struct fb_update_request& request)
+void ClientConnection::QueueUpdate(const struct fb_update_request& request)
+{
+	std::lock_guard<std::mutex> lg(update_lock_);
+
+	if(!update_pending_) {
+		pending_request_ = request;
+		update_pending_ = true;
+	} else {
+		// Cover both regions, and only leave out unchanged parts if
+		// neither request needs them
+		uint32_t x0 = std::min(pending_request_.x_pos, request.x_pos);
+		uint32_t y0 = std::min(pending_request_.y_pos, request.y_pos);
+		uint32_t x1 = std::max(pending_request_.x_pos + pending_request_.width, request.x_pos + request.width);
+		uint32_t y1 = std::max(pending_request_.y_pos + pending_request_.height, request.y_pos + request.height);
+
+		pending_request_.incremental = pending_request_.incremental && request.incremental;
+		pending_request_.x_pos = x0;
+		pending_request_.y_pos = y0;
+		pending_request_.width = x1 - x0;
+		pending_request_.height = y1 - y0;
+	}
+
+	update_cv_.notify_one();
+}
+
+void ClientConnection::EncoderThread()
+{
+	DamageTracker damage(*GetServer()->GetFB());
+	EncoderState encoder_state;
+
+	std::unique_lock<std::mutex> lg(update_lock_);
+
+	try {
+		while(open_) {
+			if(!update_pending_) {
+				update_cv_.wait(lg);
+				continue;
+			}
+
+			struct fb_update_request request = pending_request_;
+			struct FB_PixelFormat format = pixel_format_;
+			EncodingType encoding = encoding_;
+			update_pending_ = false;
+
+			lg.unlock();
+
+			RectangleShape region;
+			region.X = request.x_pos;
+			region.Y = request.y_pos;
+			region.Width = request.width;
+			region.Height = request.height;
+
+			auto shapes = damage.Update(region, request.incremental);
+
+			if(shapes.empty() && request.incremental) {
+				// Nothing has changed: keep the request until something does,
+				// rather than answering it and having the client ask again
+				// straight away
+				lg.lock();
+				if(!update_pending_) {
+					update_cv_.wait_for(lg, kUpdatePollInterval);
+				}
+				lg.unlock();
+
+				QueueUpdate(request);
+
+				lg.lock();
+				continue;
+			}
+
+			SendUpdate(GetServer()->GetFB()->ServeRequest(shapes, format, encoding, encoder_state));
+
+			lg.lock();
+		}
+	} catch(std::exception &e) {
+		// The connection has failed, so stop encoding. The reader thread
+		// will see the failure too, and clean up.
+		if(!lg.owns_lock()) {
+			lg.lock();
+		}
+		open_ = false;
+	}
+}
+
+void ClientConnection::StopEncoder()
+{
+	{
+		std::lock_guard<std::mutex> lg(update_lock_);
+		open_ = false;
+		update_cv_.notify_all();
+	}
+
+	if(encoder_thread_.joinable()) {
+		encoder_thread_.join();
+	}
+}
+
+void ClientConnection::SendUpdate(const std::vector<Rectangle> &rectangles)
 {
 	// Message type
 	Buffer((uint8_t)0);
@@ -265,10 +397,9 @@ void ClientConnection::UpdateFB(const struct fb_update_request& request)
 	// Padding
 	Buffer((uint8_t)0);
 
-	auto result = GetServer()->GetFB()->ServeRequest(request, pixel_format_);
-	Buffer((uint16_t)htons(result.size()));
+	Buffer((uint16_t)htons(rectangles.size()));
 	// result is a vector of rectangles
-	for(auto &rectangle : result) {
+	for(auto &rectangle : rectangles) {
 		Buffer(htons(rectangle.Shape.X));
 		Buffer(htons(rectangle.Shape.Y));
 		Buffer(htons(rectangle.Shape.Width));
@@ -1,15 +1,45 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libgvnc/Encoder.h"
 
+#include <algorithm>
+#include <cstring>
 #include <stdexcept>
+#include <unordered_map>
 
 using namespace libgvnc;
 
+const uint32_t HextileEncoder::kTileSize;
+const uint32_t ZRLEEncoder::kTileSize;
+
 Encoder::Encoder(const FB_PixelFormat& format, const RectangleShape& shape) : encoded_format_(format), shape_(shape)
 {
 
 }
 
+void Encoder::AppendPixel(std::vector<char> &data, uint32_t pixel_data) const
+{
+	switch (GetFormat().bits_per_pixel) {
+		case 8:
+			data.push_back(pixel_data);
+			break;
+		case 16:
+			data.push_back(pixel_data >> 8);
+			data.push_back(pixel_data);
+			break;
+		case 24:
+			data.push_back(pixel_data >> 16);
+			data.push_back(pixel_data >> 8);
+			data.push_back(pixel_data);
+			break;
+		case 32:
+			data.insert(data.end(), (const char*)&pixel_data, (const char*)&pixel_data + 4);
+			break;
+
+		default:
+			throw std::logic_error("Unknown pixel depth");
+	}
+}
+
 RawEncoder::RawEncoder(const FB_PixelFormat& format, const RectangleShape& shape) : Encoder(format, shape)
 {
 
@@ -17,31 +47,399 @@ RawEncoder::RawEncoder(const FB_PixelFormat& format, const RectangleShape& shape
 
 std::vector<char> RawEncoder::Encode(const std::vector<uint32_t> &pixels)
 {
-	std::vector<char> data(GetShape().Width * GetShape().Height * GetFormat().bits_per_pixel / 8);
-	uint32_t data_ptr = 0;
+	std::vector<char> data;
+	data.reserve(GetShape().Width * GetShape().Height * GetFormat().bits_per_pixel / 8);
 	for (auto pixel_data : pixels) {
-		switch (GetFormat().bits_per_pixel) {
-			case 8:
-				data[data_ptr++] = pixel_data;
-				break;
-			case 16:
-				data[data_ptr++] = pixel_data >> 8;
-				data[data_ptr++] = pixel_data;
-				break;
-			case 24:
-				data[data_ptr++] = pixel_data >> 16;
-				data[data_ptr++] = pixel_data >> 8;
-				data[data_ptr++] = pixel_data;
-				break;
-			case 32:
-				*(uint32_t*) (data.data() + data_ptr) = pixel_data;
-				data_ptr += 4;
-				break;
-
-			default:
-				throw std::logic_error("Unknown pixel depth");
+		AppendPixel(data, pixel_data);
+	}
+
+	return data;
+}
+
+HextileEncoder::HextileEncoder(const FB_PixelFormat& format, const RectangleShape& shape) : Encoder(format, shape), background_valid_(false), background_(0)
+{
+
+}
+
+std::vector<char> HextileEncoder::Encode(const std::vector<uint32_t> &pixels)
+{
+	std::vector<char> data;
+
+	for (uint32_t y = 0; y < GetShape().Height; y += kTileSize) {
+		for (uint32_t x = 0; x < GetShape().Width; x += kTileSize) {
+			uint32_t width = std::min<uint32_t>(kTileSize, GetShape().Width - x);
+			uint32_t height = std::min<uint32_t>(kTileSize, GetShape().Height - y);
+			EncodeTile(data, pixels, x, y, width, height);
+		}
+	}
+
+	return data;
+}
+
+enum HextileSubencoding {
+	Hextile_Raw = 1,
+	Hextile_BackgroundSpecified = 2,
+	Hextile_ForegroundSpecified = 4,
+	Hextile_AnySubrects = 8,
+	Hextile_SubrectsColoured = 16
+};
+
+struct HextileSubrect {
+	uint32_t Colour;
+	uint8_t X, Y, Width, Height;
+};
+
+void HextileEncoder::EncodeTile(std::vector<char> &data, const std::vector<uint32_t> &pixels, uint32_t tile_x, uint32_t tile_y, uint32_t width, uint32_t height)
+{
+	uint32_t tile[kTileSize * kTileSize];
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			tile[y * width + x] = pixels[(tile_y + y) * GetShape().Width + tile_x + x];
+		}
+	}
+
+	// The most common colour becomes the background
+	std::unordered_map<uint32_t, uint32_t> counts;
+	uint32_t background = tile[0];
+	for (uint32_t i = 0; i < width * height; ++i) {
+		if (++counts[tile[i]] > counts[background]) {
+			background = tile[i];
+		}
+	}
+
+	// Cover the remaining pixels with solid subrectangles, growing each one
+	// right and then down
+	std::vector<HextileSubrect> subrects;
+	bool covered[kTileSize * kTileSize] = { false };
+	bool coloured = false;
+
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			uint32_t colour = tile[y * width + x];
+			if (colour == background || covered[y * width + x]) {
+				continue;
+			}
+
+			uint32_t w = 1;
+			while (x + w < width && tile[y * width + x + w] == colour && !covered[y * width + x + w]) {
+				w++;
+			}
+
+			uint32_t h = 1;
+			while (y + h < height) {
+				bool row_matches = true;
+				for (uint32_t i = x; i < x + w; ++i) {
+					if (tile[(y + h) * width + i] != colour || covered[(y + h) * width + i]) {
+						row_matches = false;
+						break;
+					}
+				}
+				if (!row_matches) {
+					break;
+				}
+				h++;
+			}
+
+			for (uint32_t j = y; j < y + h; ++j) {
+				for (uint32_t i = x; i < x + w; ++i) {
+					covered[j * width + i] = true;
+				}
+			}
+
+			if (!subrects.empty() && subrects.front().Colour != colour) {
+				coloured = true;
+			}
+			subrects.push_back({ colour, (uint8_t)x, (uint8_t)y, (uint8_t)w, (uint8_t)h });
+		}
+	}
+
+	uint32_t pixel_size = GetFormat().bits_per_pixel / 8;
+	bool send_background = !background_valid_ || background != background_;
+
+	uint32_t encoded_size = 1 + (send_background ? pixel_size : 0);
+	if (!subrects.empty()) {
+		encoded_size += 1 + (coloured ? 0 : pixel_size) + subrects.size() * (2 + (coloured ? pixel_size : 0));
+	}
+
+	if (subrects.size() > 255 || encoded_size >= 1 + width * height * pixel_size) {
+		data.push_back(Hextile_Raw);
+		for (uint32_t i = 0; i < width * height; ++i) {
+			AppendPixel(data, tile[i]);
+		}
+
+		// The client forgets the background after a raw tile
+		background_valid_ = false;
+		return;
+	}
+
+	uint8_t subencoding = 0;
+	if (send_background) {
+		subencoding |= Hextile_BackgroundSpecified;
+	}
+	if (!subrects.empty()) {
+		subencoding |= Hextile_AnySubrects;
+		subencoding |= coloured ? Hextile_SubrectsColoured : Hextile_ForegroundSpecified;
+	}
+
+	data.push_back(subencoding);
+	if (send_background) {
+		AppendPixel(data, background);
+	}
+
+	if (!subrects.empty()) {
+		if (!coloured) {
+			AppendPixel(data, subrects.front().Colour);
+		}
+
+		data.push_back(subrects.size());
+		for (const auto &subrect : subrects) {
+			if (coloured) {
+				AppendPixel(data, subrect.Colour);
+			}
+			data.push_back((subrect.X << 4) | subrect.Y);
+			data.push_back(((subrect.Width - 1) << 4) | (subrect.Height - 1));
+		}
+	}
+
+	background_valid_ = true;
+	background_ = background;
+}
+
+ZlibStream::ZlibStream()
+{
+	memset(&stream_, 0, sizeof(stream_));
+
+	// Favour latency: the tiles have already been run length encoded
+	if (deflateInit(&stream_, Z_BEST_SPEED) != Z_OK) {
+		throw std::runtime_error("Could not initialise zlib stream");
+	}
+}
+
+ZlibStream::~ZlibStream()
+{
+	deflateEnd(&stream_);
+}
+
+std::vector<char> ZlibStream::Compress(const std::vector<char> &input)
+{
+	std::vector<char> output;
+
+	stream_.next_in = (Bytef*)input.data();
+	stream_.avail_in = input.size();
+
+	// Flush after every rectangle so that the client can decode it without
+	// waiting for the next one
+	do {
+		size_t offset = output.size();
+		output.resize(offset + deflateBound(&stream_, stream_.avail_in) + 16);
+
+		stream_.next_out = (Bytef*)output.data() + offset;
+		stream_.avail_out = output.size() - offset;
+
+		if (deflate(&stream_, Z_SYNC_FLUSH) == Z_STREAM_ERROR) {
+			throw std::runtime_error("zlib stream error");
 		}
+
+		output.resize(output.size() - stream_.avail_out);
+	} while (stream_.avail_out == 0);
+
+	return output;
+}
+
+ZRLEEncoder::ZRLEEncoder(const FB_PixelFormat& format, const RectangleShape& shape, ZlibStream &stream) : Encoder(format, shape), stream_(stream), cpixel_shift_(0)
+{
+	// Pixels are sent in three bytes when the colour bits all fit in either
+	// the least or the most significant three bytes of a 32 bit pixel
+	uint32_t colour_bits = (format.red_max << format.red_shift) | (format.green_max << format.green_shift) | (format.blue_max << format.blue_shift);
+	compact_pixels_ = format.true_color && format.bits_per_pixel == 32 && format.depth <= 24;
+	if (colour_bits < (1 << 24)) {
+		cpixel_shift_ = 0;
+	} else if ((colour_bits & 0xff) == 0) {
+		cpixel_shift_ = 8;
+	} else {
+		compact_pixels_ = false;
 	}
+}
+
+void ZRLEEncoder::AppendCPixel(std::vector<char> &data, uint32_t pixel) const
+{
+	if (compact_pixels_) {
+		uint32_t value = pixel >> cpixel_shift_;
+		if (GetFormat().big_endian) {
+			data.push_back(value >> 16);
+			data.push_back(value >> 8);
+			data.push_back(value);
+		} else {
+			data.push_back(value);
+			data.push_back(value >> 8);
+			data.push_back(value >> 16);
+		}
+	} else {
+		AppendPixel(data, pixel);
+	}
+}
+
+std::vector<char> ZRLEEncoder::Encode(const std::vector<uint32_t> &pixels)
+{
+	std::vector<char> tiles;
+	std::vector<uint32_t> tile;
+
+	for (uint32_t y = 0; y < GetShape().Height; y += kTileSize) {
+		for (uint32_t x = 0; x < GetShape().Width; x += kTileSize) {
+			uint32_t width = std::min<uint32_t>(kTileSize, GetShape().Width - x);
+			uint32_t height = std::min<uint32_t>(kTileSize, GetShape().Height - y);
+
+			tile.clear();
+			for (uint32_t j = y; j < y + height; ++j) {
+				auto row = pixels.begin() + j * GetShape().Width + x;
+				tile.insert(tile.end(), row, row + width);
+			}
+
+			EncodeTile(tiles, tile, width);
+		}
+	}
+
+	std::vector<char> compressed = stream_.Compress(tiles);
+
+	std::vector<char> data;
+	data.reserve(4 + compressed.size());
+	uint32_t length = compressed.size();
+	data.push_back(length >> 24);
+	data.push_back(length >> 16);
+	data.push_back(length >> 8);
+	data.push_back(length);
+	data.insert(data.end(), compressed.begin(), compressed.end());
 
 	return data;
 }
+
+enum ZRLESubencoding {
+	ZRLE_Raw = 0,
+	ZRLE_Solid = 1,
+	ZRLE_PlainRLE = 128,
+
+	// Plus the palette size
+	ZRLE_PaletteRLE = 128
+};
+
+static void AppendRunLength(std::vector<char> &data, uint32_t length)
+{
+	length -= 1;
+	while (length >= 255) {
+		data.push_back((char)255);
+		length -= 255;
+	}
+	data.push_back(length);
+}
+
+void ZRLEEncoder::EncodeTile(std::vector<char> &data, const std::vector<uint32_t> &pixels, uint32_t tile_width)
+{
+	const uint32_t kMaxPaletteSize = 16;
+
+	std::vector<uint32_t> palette;
+	uint32_t runs = 0;
+	uint32_t run_length_bytes = 0;
+	uint32_t single_runs = 0;
+
+	for (uint32_t i = 0; i < pixels.size();) {
+		uint32_t length = 1;
+		while (i + length < pixels.size() && pixels[i + length] == pixels[i]) {
+			length++;
+		}
+
+		runs++;
+		run_length_bytes += (length - 1) / 255 + 1;
+		if (length == 1) {
+			single_runs++;
+		}
+
+		if (palette.size() <= kMaxPaletteSize && std::find(palette.begin(), palette.end(), pixels[i]) == palette.end()) {
+			palette.push_back(pixels[i]);
+		}
+
+		i += length;
+	}
+
+	if (palette.size() == 1) {
+		data.push_back(ZRLE_Solid);
+		AppendCPixel(data, pixels[0]);
+		return;
+	}
+
+	uint32_t pixel_size = compact_pixels_ ? 3 : GetFormat().bits_per_pixel / 8;
+	uint32_t tile_height = pixels.size() / tile_width;
+
+	uint32_t raw_size = pixels.size() * pixel_size;
+	uint32_t plain_rle_size = runs * pixel_size + run_length_bytes;
+
+	bool use_palette = palette.size() <= kMaxPaletteSize;
+	uint32_t index_bits = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : 4;
+	uint32_t packed_size = palette.size() * pixel_size + tile_height * ((tile_width * index_bits + 7) / 8);
+	uint32_t palette_rle_size = palette.size() * pixel_size + runs + (run_length_bytes - single_runs);
+
+	if (use_palette && packed_size <= palette_rle_size && packed_size <= raw_size) {
+		data.push_back(palette.size());
+		for (auto colour : palette) {
+			AppendCPixel(data, colour);
+		}
+
+		for (uint32_t y = 0; y < tile_height; ++y) {
+			uint8_t byte = 0;
+			uint32_t bits = 0;
+			for (uint32_t x = 0; x < tile_width; ++x) {
+				uint32_t index = std::find(palette.begin(), palette.end(), pixels[y * tile_width + x]) - palette.begin();
+				byte |= index << (8 - index_bits - bits);
+				bits += index_bits;
+				if (bits == 8) {
+					data.push_back(byte);
+					byte = 0;
+					bits = 0;
+				}
+			}
+			if (bits != 0) {
+				data.push_back(byte);
+			}
+		}
+	} else if (use_palette && palette_rle_size <= raw_size) {
+		data.push_back((char)(ZRLE_PaletteRLE + palette.size()));
+		for (auto colour : palette) {
+			AppendCPixel(data, colour);
+		}
+
+		for (uint32_t i = 0; i < pixels.size();) {
+			uint32_t length = 1;
+			while (i + length < pixels.size() && pixels[i + length] == pixels[i]) {
+				length++;
+			}
+
+			uint8_t index = std::find(palette.begin(), palette.end(), pixels[i]) - palette.begin();
+			if (length == 1) {
+				data.push_back(index);
+			} else {
+				data.push_back(index | 128);
+				AppendRunLength(data, length);
+			}
+
+			i += length;
+		}
+	} else if (plain_rle_size < raw_size) {
+		data.push_back((char)ZRLE_PlainRLE);
+
+		for (uint32_t i = 0; i < pixels.size();) {
+			uint32_t length = 1;
+			while (i + length < pixels.size() && pixels[i + length] == pixels[i]) {
+				length++;
+			}
+
+			AppendCPixel(data, pixels[i]);
+			AppendRunLength(data, length);
+
+			i += length;
+		}
+	} else {
+		data.push_back(ZRLE_Raw);
+		for (auto pixel : pixels) {
+			AppendCPixel(data, pixel);
+		}
+	}
+}
@@ -3,9 +3,11 @@
 #include "libgvnc/Encoder.h"
 #include "libgvnc/ClientConnection.h"
 
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <cmath>
+#include <cstring>
 
 using namespace libgvnc;
 
@@ -14,31 +16,38 @@ Framebuffer::Framebuffer(uint16_t width, uint16_t height, FB_PixelFormat format)
 
 }
 
-std::vector<Rectangle> Framebuffer::ServeRequest(const struct fb_update_request& request, const struct FB_PixelFormat& target_format)
+std::vector<Rectangle> Framebuffer::ServeRequest(const std::vector<RectangleShape> &shapes, const struct FB_PixelFormat& target_format, EncodingType encoding, EncoderState &state)
 {
 	std::vector<Rectangle> results;
+	results.reserve(shapes.size());
 
-	// For now, just create one big rectangle to return
-	Rectangle output;
-	output.Shape.X = request.x_pos;
-	output.Shape.Y = request.y_pos;
-	output.Shape.Width = request.width;
-	output.Shape.Height = request.height;
-	output.Encoding = EncodingType::Raw;
+	for (const auto &shape : shapes) {
+		Rectangle output;
+		output.Shape = shape;
+		output.Encoding = encoding;
 
-	FillRectangle(output, target_format, EncodingType::Raw);
+		FillRectangle(output, target_format, encoding, state);
 
-	results.push_back(output);
+		results.push_back(std::move(output));
+	}
 
 	return results;
 }
 
-using encoder_factory_t = Encoder*(const FB_PixelFormat& format, const RectangleShape& shape);
+using encoder_factory_t = Encoder*(const FB_PixelFormat& format, const RectangleShape& shape, EncoderState &state);
 
 static std::map<EncodingType, std::function<encoder_factory_t>> encoders {
-	std::make_pair(EncodingType::Raw, [](const FB_PixelFormat& format, const RectangleShape & shape)
+	std::make_pair(EncodingType::Raw, [](const FB_PixelFormat& format, const RectangleShape & shape, EncoderState &state)
 	{
 		return(Encoder*)new RawEncoder(format, shape);
+	}),
+	std::make_pair(EncodingType::Hextile, [](const FB_PixelFormat& format, const RectangleShape & shape, EncoderState &state)
+	{
+		return(Encoder*)new HextileEncoder(format, shape);
+	}),
+	std::make_pair(EncodingType::ZRLE, [](const FB_PixelFormat& format, const RectangleShape & shape, EncoderState &state)
+	{
+		return(Encoder*)new ZRLEEncoder(format, shape, state.GetZRLEStream());
 	})
 };
 
@@ -88,9 +97,9 @@ uint32_t Framebuffer::GetPixel(uint32_t x, uint32_t y) const
 	return data;
 }
 
-void Framebuffer::FillRectangle(Rectangle& rect, const FB_PixelFormat& target_format, EncodingType encoding)
+void Framebuffer::FillRectangle(Rectangle& rect, const FB_PixelFormat& target_format, EncodingType encoding, EncoderState &state)
 {
-	Encoder *encoder = encoders[encoding](target_format, rect.Shape);
+	Encoder *encoder = encoders[encoding](target_format, rect.Shape, state);
 	PixelConverter converter(GetPixelFormat(), target_format);
 
 	std::vector<uint32_t> pixels;
@@ -98,7 +107,7 @@ void Framebuffer::FillRectangle(Rectangle& rect, const FB_PixelFormat& target_fo
 
 	for (int y = 0; y < rect.Shape.Height; ++y) {
 		for (int x = 0; x < rect.Shape.Width; ++x) {
-			uint32_t pixeldata = GetPixel(x, y);
+			uint32_t pixeldata = GetPixel(rect.Shape.X + x, rect.Shape.Y + y);
 			pixels.push_back(pixeldata);
 		}
 	}
@@ -111,3 +120,108 @@ void Framebuffer::FillRectangle(Rectangle& rect, const FB_PixelFormat& target_fo
 
 	delete encoder;
 }
+
+uint64_t Framebuffer::HashRectangle(const RectangleShape &shape) const
+{
+	const uint64_t kPrime = 0x100000001b3ULL;
+
+	uint32_t pixel_size = GetPixelFormat().bits_per_pixel / 8;
+	uint32_t stride = GetWidth() * pixel_size;
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (uint32_t y = shape.Y; y < (uint32_t)shape.Y + shape.Height; ++y) {
+		const uint8_t *row = (const uint8_t*)data_ + y * stride + shape.X * pixel_size;
+		size_t size = shape.Width * pixel_size;
+
+		// FNV-1a, a word at a time with an extra mix so that high bits
+		// reach the low ones
+		while (size >= 8) {
+			uint64_t word;
+			memcpy(&word, row, sizeof(word));
+			hash = (hash ^ word) * kPrime;
+			hash ^= hash >> 29;
+			row += 8;
+			size -= 8;
+		}
+		while (size > 0) {
+			hash = (hash ^ *row++) * kPrime;
+			size--;
+		}
+	}
+
+	return hash;
+}
+
+const uint16_t DamageTracker::kTileSize;
+
+DamageTracker::DamageTracker(const Framebuffer &fb) : fb_(fb)
+{
+	tiles_x_ = (fb.GetWidth() + kTileSize - 1) / kTileSize;
+	tiles_y_ = (fb.GetHeight() + kTileSize - 1) / kTileSize;
+
+	hashes_.resize(tiles_x_ * tiles_y_);
+	valid_.resize(tiles_x_ * tiles_y_, false);
+}
+
+std::vector<RectangleShape> DamageTracker::Update(const RectangleShape &region, bool incremental)
+{
+	std::vector<RectangleShape> damage;
+
+	uint32_t region_x1 = std::min<uint32_t>(region.X + region.Width, fb_.GetWidth());
+	uint32_t region_y1 = std::min<uint32_t>(region.Y + region.Height, fb_.GetHeight());
+	if (region.X >= region_x1 || region.Y >= region_y1) {
+		return damage;
+	}
+
+	for (uint32_t tile_y = region.Y / kTileSize; tile_y * kTileSize < region_y1; ++tile_y) {
+		uint32_t y0 = tile_y * kTileSize;
+		uint32_t y1 = std::min<uint32_t>(y0 + kTileSize, fb_.GetHeight());
+
+		bool in_run = false;
+		RectangleShape run;
+
+		for (uint32_t tile_x = region.X / kTileSize; tile_x * kTileSize < region_x1; ++tile_x) {
+			uint32_t x0 = tile_x * kTileSize;
+			uint32_t x1 = std::min<uint32_t>(x0 + kTileSize, fb_.GetWidth());
+
+			RectangleShape tile;
+			tile.X = x0;
+			tile.Y = y0;
+			tile.Width = x1 - x0;
+			tile.Height = y1 - y0;
+
+			uint32_t index = tile_y * tiles_x_ + tile_x;
+			uint64_t hash = fb_.HashRectangle(tile);
+			bool changed = !incremental || !valid_[index] || hashes_[index] != hash;
+
+			// Only part of a tile which straddles the edge of the region is
+			// sent, so the client's copy of the rest of it is still unknown
+			RectangleShape clipped;
+			clipped.X = std::max<uint32_t>(x0, region.X);
+			clipped.Y = std::max<uint32_t>(y0, region.Y);
+			clipped.Width = std::min(x1, region_x1) - clipped.X;
+			clipped.Height = std::min(y1, region_y1) - clipped.Y;
+
+			if (changed) {
+				hashes_[index] = hash;
+				valid_[index] = clipped.Width == tile.Width && clipped.Height == tile.Height;
+			}
+
+			if (changed && in_run) {
+				run.Width += clipped.Width;
+			} else if (changed) {
+				run = clipped;
+				in_run = true;
+			} else if (in_run) {
+				damage.push_back(run);
+				in_run = false;
+			}
+		}
+
+		if (in_run) {
+			damage.push_back(run);
+		}
+	}
+
+	return damage;
+}
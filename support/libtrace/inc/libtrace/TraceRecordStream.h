@@ -24,6 +24,8 @@ namespace libtrace
 	class RecordBufferInterface
 	{
 	public:
+		virtual ~RecordBufferInterface() {}
+
 		virtual bool Get(size_t i, Record &r) = 0;
 		virtual uint64_t Size() = 0;
 	};
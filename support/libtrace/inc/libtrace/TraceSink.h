@@ -33,6 +33,18 @@ namespace libtrace
 		virtual int Open() = 0;
 		virtual void SinkPackets(int id, const TraceRecord *start, const TraceRecord *end) = 0;
 		virtual void Flush() = 0;
+
+		// Sinks which can take records without copying them return a buffer
+		// for the source to fill. When the buffer is full (or flushed), the
+		// source submits it and carries on with the buffer which is returned.
+		virtual TraceRecord *AcquireBuffer(int id, size_t &capacity)
+		{
+			return nullptr;
+		}
+		virtual TraceRecord *SubmitBuffer(int id, size_t count)
+		{
+			return nullptr;
+		}
 	};
 
 	class BinaryFileTraceSink : public TraceSink
@@ -245,6 +245,9 @@ namespace libtrace
 		TraceRecord *packet_buffer_pos_;
 		TraceRecord *packet_buffer_end_;
 
+		// True if the packet buffer belongs to the sink
+		bool sink_buffers_;
+
 		bool is_terminated_;
 		bool aggressive_flushing_;
 
@@ -0,0 +1,108 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   CompressedRecordFile.h
+ *
+ * Record files made up of independently LZ4-compressed blocks of records,
+ * followed by an index of the blocks, so that a reader can find any record
+ * by decompressing only the block which contains it.
+ *
+ * Layout:
+ *   CompressedFileHeader
+ *   for each block: CompressedBlockHeader, then the block data
+ *   CompressedIndexEntry for each block
+ *   CompressedFileFooter
+ *
+ * A block whose data is as large as its uncompressed records is stored
+ * uncompressed.
+ */
+
+#ifndef COMPRESSEDRECORDFILE_H
+#define COMPRESSEDRECORDFILE_H
+
+#include "libtrace/RecordTypes.h"
+#include "libtrace/TraceRecordStream.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+namespace libtrace
+{
+
+	struct CompressedFileHeader {
+		char Magic[8];
+		uint32_t Version;
+		uint32_t RecordSize;
+	};
+
+	struct CompressedBlockHeader {
+		uint32_t DataSize;
+		uint32_t RecordCount;
+	};
+
+	struct CompressedIndexEntry {
+		uint64_t Offset;
+		uint64_t FirstRecord;
+	};
+
+	struct CompressedFileFooter {
+		uint64_t IndexOffset;
+		uint64_t BlockCount;
+		uint64_t RecordCount;
+		char Magic[8];
+	};
+
+	class CompressedRecordFile : public RecordBufferInterface
+	{
+	public:
+		static const char kMagic[8];
+		static const uint32_t kVersion = 1;
+
+		// The largest number of records which a block can hold
+		static const uint32_t kMaxBlockRecords = 1 << 16;
+
+		CompressedRecordFile(FILE *f);
+		virtual ~CompressedRecordFile() {}
+
+		// Returns true if the file starts with a compressed record file header
+		static bool IsCompressed(FILE *f);
+
+		bool IsValid() const
+		{
+			return valid_;
+		}
+
+		bool Get(size_t i, Record &r) override;
+		uint64_t Size() override
+		{
+			return count_;
+		}
+
+		// Compress a block of records into out, which must be at least
+		// GetMaxBlockSize(count) bytes long. Returns the size of the data.
+		static uint32_t CompressBlock(const Record *records, uint32_t count, char *out);
+		static bool DecompressBlock(const char *data, uint32_t size, Record *records, uint32_t count);
+		static uint32_t GetMaxBlockSize(uint32_t count);
+
+	private:
+		bool loadBlock(size_t block);
+
+		FILE *file_;
+		bool valid_;
+		uint64_t count_;
+		std::vector<CompressedIndexEntry> index_;
+
+		size_t cached_block_;
+		std::vector<Record> cache_;
+		std::vector<char> compressed_;
+	};
+
+	// Open a record file in either the raw or the compressed format. Returns
+	// null if a compressed file is damaged (for example, if it was never
+	// flushed).
+	RecordBufferInterface *OpenRecordFile(FILE *f);
+
+}
+
+#endif /* COMPRESSEDRECORDFILE_H */
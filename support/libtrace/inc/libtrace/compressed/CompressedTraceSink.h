@@ -0,0 +1,88 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   CompressedTraceSink.h
+ *
+ * A trace sink which writes compressed record files (see
+ * CompressedRecordFile.h). Each trace source fills one of a pair of buffers
+ * owned by the sink, while the other is compressed and written out on a
+ * background writer thread, so the simulating threads never copy, compress
+ * or write records themselves.
+ */
+
+#ifndef COMPRESSEDTRACESINK_H
+#define COMPRESSEDTRACESINK_H
+
+#include "libtrace/TraceSink.h"
+#include "libtrace/compressed/CompressedRecordFile.h"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libtrace
+{
+
+	class CompressedFileTraceSink : public TraceSink
+	{
+	public:
+		CompressedFileTraceSink(const std::string &pattern);
+		~CompressedFileTraceSink();
+
+		int Open() override;
+		void SinkPackets(int id, const TraceRecord* start, const TraceRecord* end) override;
+		void Flush() override;
+
+		TraceRecord *AcquireBuffer(int id, size_t &capacity) override;
+		TraceRecord *SubmitBuffer(int id, size_t count) override;
+
+	private:
+		static const uint32_t kBufferRecords = CompressedRecordFile::kMaxBlockRecords;
+
+		struct Stream {
+			FILE *File;
+			uint64_t BlocksEnd;
+			uint64_t RecordCount;
+			std::vector<CompressedIndexEntry> Index;
+
+			TraceRecord *Buffers[2];
+			bool BufferBusy[2];
+			int Filling;
+
+			// Records copied in by SinkPackets, rather than written
+			// directly by the source
+			size_t Copied;
+		};
+
+		struct Job {
+			int Id;
+			int Buffer;
+			size_t Count;
+		};
+
+		void WriterThread();
+		void writeBlock(Stream &stream, const TraceRecord *records, size_t count);
+		void writeIndex(Stream &stream);
+
+		std::string pattern_;
+		std::vector<std::unique_ptr<Stream>> streams_;
+
+		std::mutex lock_;
+		std::condition_variable jobs_cv_;
+		std::condition_variable done_cv_;
+		std::deque<Job> jobs_;
+		bool writing_;
+		bool terminate_;
+		std::thread writer_;
+
+		// Only used by the writer thread
+		std::vector<char> compressed_;
+	};
+
+}
+
+#endif /* COMPRESSEDTRACESINK_H */
@@ -0,0 +1,79 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   MappedRecordFile.h
+ *
+ * A raw record file which is mapped into memory rather than read through a
+ * buffer, so that any number of threads can read any part of it at once.
+ * Compressed record files can't be mapped, and are left invalid.
+ */
+
+#ifndef MAPPEDRECORDFILE_H
+#define MAPPEDRECORDFILE_H
+
+#include "libtrace/RecordTypes.h"
+#include "libtrace/TraceRecordStream.h"
+
+#include <cstdint>
+#include <string>
+
+namespace libtrace
+{
+
+	class MappedRecordFile : public RecordBufferInterface
+	{
+	public:
+		MappedRecordFile(const std::string &filename);
+		virtual ~MappedRecordFile();
+
+		MappedRecordFile(const MappedRecordFile &) = delete;
+		MappedRecordFile &operator=(const MappedRecordFile &) = delete;
+
+		bool IsValid() const
+		{
+			return valid_;
+		}
+
+		// True if the file could not be mapped because it is compressed, in
+		// which case it has to be read through OpenRecordFile instead
+		bool IsCompressed() const
+		{
+			return compressed_;
+		}
+
+		bool Get(size_t i, Record &r) override
+		{
+			if(i >= count_) return false;
+			r = records_[i];
+			return true;
+		}
+
+		uint64_t Size() override
+		{
+			return count_;
+		}
+
+		uint64_t GetCount() const
+		{
+			return count_;
+		}
+
+		const TraceRecord &operator[](uint64_t i) const
+		{
+			return *(const TraceRecord *)&records_[i];
+		}
+
+		// Returns the index of the first instruction header at or after
+		// record i, or the number of records if there isn't one.
+		uint64_t FindPacketStart(uint64_t i) const;
+
+	private:
+		const Record *records_;
+		uint64_t count_;
+		bool valid_;
+		bool compressed_;
+	};
+
+}
+
+#endif /* MAPPEDRECORDFILE_H */
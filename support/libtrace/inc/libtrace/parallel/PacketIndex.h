@@ -0,0 +1,74 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   PacketIndex.h
+ *
+ * Splits a mapped record file into chunks which each start at an
+ * instruction packet, so that the chunks can be processed in parallel, and
+ * optionally counts the instructions in each chunk so that instructions can
+ * be found by number.
+ */
+
+#ifndef PACKETINDEX_H
+#define PACKETINDEX_H
+
+#include "libtrace/parallel/MappedRecordFile.h"
+#include "libtrace/parallel/ThreadPool.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace libtrace
+{
+
+	struct PacketChunk {
+		uint64_t FirstRecord;
+		uint64_t EndRecord;
+
+		// Only valid once instructions have been counted
+		uint64_t FirstInstruction;
+		uint64_t InstructionCount;
+	};
+
+	class PacketIndex
+	{
+	public:
+		static const uint64_t kDefaultChunkRecords = 1 << 20;
+
+		// Only the first chunk may start with records which are not part
+		// of an instruction packet.
+		PacketIndex(const MappedRecordFile &file, uint64_t chunk_records = kDefaultChunkRecords);
+
+		const std::vector<PacketChunk> &GetChunks() const
+		{
+			return chunks_;
+		}
+
+		// Count the instructions in every chunk, using the pool
+		void CountInstructions(ThreadPool &pool);
+
+		bool IsCounted() const
+		{
+			return counted_;
+		}
+
+		uint64_t GetInstructionCount() const
+		{
+			return instruction_count_;
+		}
+
+		// Returns the index of the header record of instruction n (counting
+		// from zero), or the number of records if there are not that many
+		// instructions. The instructions must have been counted.
+		uint64_t FindInstruction(uint64_t n) const;
+
+	private:
+		const MappedRecordFile &file_;
+		std::vector<PacketChunk> chunks_;
+		bool counted_;
+		uint64_t instruction_count_;
+	};
+
+}
+
+#endif /* PACKETINDEX_H */
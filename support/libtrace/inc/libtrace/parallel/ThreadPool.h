@@ -0,0 +1,125 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+
+/*
+ * File:   ThreadPool.h
+ *
+ * A fixed set of worker threads for the trace analysis tools.
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace libtrace
+{
+
+	class ThreadPool
+	{
+	public:
+		// Uses one thread per host CPU if threads is zero
+		ThreadPool(unsigned threads = 0);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		unsigned GetThreadCount() const
+		{
+			return threads_.size();
+		}
+
+		void Submit(std::function<void()> task);
+
+		/**
+		 * Run work(0) to work(count - 1) on the pool, and pass each result
+		 * to merge on the calling thread in order of index, so the merged
+		 * result does not depend on the order in which the work finishes.
+		 * Only a few jobs per thread are run ahead of the merge, which
+		 * bounds the memory held by unmerged results.
+		 *
+		 * If merge returns false, no more work is started and MapOrdered
+		 * returns false once the work already running has finished.
+		 */
+		template<typename Result> bool MapOrdered(size_t count, std::function<Result(size_t)> work, std::function<bool(size_t, Result &)> merge)
+		{
+			struct Slot {
+				Result Value;
+				bool Done;
+			};
+
+			size_t window = GetThreadCount() * 4;
+			std::vector<std::unique_ptr<Slot>> slots (window);
+			for(auto &slot : slots) {
+				slot.reset(new Slot());
+			}
+
+			std::mutex lock;
+			std::condition_variable done;
+
+			auto start = [&](size_t i) {
+				Slot *slot = slots[i % window].get();
+				{
+					std::lock_guard<std::mutex> lg(lock);
+					slot->Done = false;
+				}
+
+				Submit([&work, &lock, &done, slot, i]() {
+					Result value = work(i);
+
+					std::lock_guard<std::mutex> lg(lock);
+					slot->Value = std::move(value);
+					slot->Done = true;
+					done.notify_all();
+				});
+			};
+
+			size_t started = 0;
+			while(started < count && started < window) {
+				start(started++);
+			}
+
+			bool ok = true;
+			for(size_t merged = 0; merged < started; ++merged) {
+				Slot *slot = slots[merged % window].get();
+				{
+					std::unique_lock<std::mutex> lg(lock);
+					while(!slot->Done) {
+						done.wait(lg);
+					}
+				}
+
+				// Once stopped, carry on waiting for the work which is still
+				// running, since it refers to this stack frame
+				if(ok) {
+					ok = merge(merged, slot->Value);
+				}
+				slot->Value = Result();
+
+				if(ok && started < count) {
+					start(started++);
+				}
+			}
+
+			return ok;
+		}
+
+	private:
+		void Worker();
+
+		std::vector<std::thread> threads_;
+		std::deque<std::function<void()>> tasks_;
+		std::mutex lock_;
+		std::condition_variable tasks_cv_;
+		bool terminate_;
+	};
+
+}
+
+#endif /* THREADPOOL_H */
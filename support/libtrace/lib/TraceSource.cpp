@@ -34,6 +34,7 @@ TraceSource::TraceSource(uint32_t BufferSize)
 	is_terminated_(false),
 	sink_(nullptr),
 	aggressive_flushing_(true),
+	sink_buffers_(false),
 	packet_open_(false),
 	skip_(0)
 {
@@ -45,17 +46,39 @@ TraceSource::TraceSource(uint32_t BufferSize)
 TraceSource::~TraceSource()
 {
 	assert(is_terminated_);
+	if(!sink_buffers_) {
+		free(packet_buffer_);
+	}
 }
 
 void TraceSource::SetSink(TraceSink* sink)
 {
 	sink_ = sink;
 	id_ = sink->Open();
+
+	// If the sink can give us a buffer, write records straight into it.
+	// Records are then handed over a buffer at a time, so flushing after
+	// every record would only waste the buffer.
+	size_t capacity;
+	TraceRecord *buffer = sink->AcquireBuffer(id_, capacity);
+	if(buffer != nullptr) {
+		free(packet_buffer_);
+		packet_buffer_ = packet_buffer_pos_ = buffer;
+		packet_buffer_end_ = buffer + capacity;
+		sink_buffers_ = true;
+		aggressive_flushing_ = false;
+	}
 }
 
 void TraceSource::EmitPackets()
 {
-	sink_->SinkPackets(id_, packet_buffer_, packet_buffer_pos_);
+	if(sink_buffers_) {
+		size_t capacity = packet_buffer_end_ - packet_buffer_;
+		packet_buffer_ = sink_->SubmitBuffer(id_, packet_buffer_pos_ - packet_buffer_);
+		packet_buffer_end_ = packet_buffer_ + capacity;
+	} else {
+		sink_->SinkPackets(id_, packet_buffer_, packet_buffer_pos_);
+	}
 	packet_buffer_pos_ = packet_buffer_;
 }
 
@@ -0,0 +1,139 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/compressed/CompressedRecordFile.h"
+#include "libtrace/RecordFile.h"
+
+#include "lz4.h"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace libtrace;
+
+const char CompressedRecordFile::kMagic[8] = { 'G', 'T', 'R', 'C', 'L', 'Z', '4', 0 };
+const uint32_t CompressedRecordFile::kVersion;
+const uint32_t CompressedRecordFile::kMaxBlockRecords;
+
+CompressedRecordFile::CompressedRecordFile(FILE *f) : file_(f), valid_(false), count_(0), cached_block_(-1)
+{
+	CompressedFileHeader header;
+	CompressedFileFooter footer;
+
+	if(fseek(f, 0, SEEK_SET) || fread(&header, sizeof(header), 1, f) != 1) {
+		return;
+	}
+	if(memcmp(header.Magic, kMagic, sizeof(kMagic)) || header.Version != kVersion || header.RecordSize != sizeof(Record)) {
+		return;
+	}
+
+	if(fseek(f, -(long)sizeof(footer), SEEK_END) || fread(&footer, sizeof(footer), 1, f) != 1) {
+		return;
+	}
+	if(memcmp(footer.Magic, kMagic, sizeof(kMagic))) {
+		return;
+	}
+
+	index_.resize(footer.BlockCount);
+	if(fseek(f, footer.IndexOffset, SEEK_SET) || fread(index_.data(), sizeof(CompressedIndexEntry), index_.size(), f) != index_.size()) {
+		return;
+	}
+
+	count_ = footer.RecordCount;
+	valid_ = true;
+}
+
+bool CompressedRecordFile::IsCompressed(FILE *f)
+{
+	CompressedFileHeader header;
+
+	bool compressed = !fseek(f, 0, SEEK_SET) && fread(&header, sizeof(header), 1, f) == 1 && !memcmp(header.Magic, kMagic, sizeof(kMagic));
+	fseek(f, 0, SEEK_SET);
+
+	return compressed;
+}
+
+bool CompressedRecordFile::Get(size_t i, Record &r)
+{
+	if(i >= count_) {
+		return false;
+	}
+
+	if(cached_block_ >= index_.size() || i < index_[cached_block_].FirstRecord || i >= index_[cached_block_].FirstRecord + cache_.size()) {
+		auto entry = std::upper_bound(index_.begin(), index_.end(), i, [](size_t i, const CompressedIndexEntry &entry) {
+			return i < entry.FirstRecord;
+		});
+
+		if(!loadBlock((entry - index_.begin()) - 1)) {
+			return false;
+		}
+	}
+
+	r = cache_[i - index_[cached_block_].FirstRecord];
+	return true;
+}
+
+bool CompressedRecordFile::loadBlock(size_t block)
+{
+	CompressedBlockHeader header;
+
+	if(fseek(file_, index_.at(block).Offset, SEEK_SET) || fread(&header, sizeof(header), 1, file_) != 1) {
+		return false;
+	}
+
+	compressed_.resize(header.DataSize);
+	if(fread(compressed_.data(), 1, header.DataSize, file_) != header.DataSize) {
+		return false;
+	}
+
+	cache_.resize(header.RecordCount);
+	if(!DecompressBlock(compressed_.data(), header.DataSize, cache_.data(), header.RecordCount)) {
+		return false;
+	}
+
+	cached_block_ = block;
+	return true;
+}
+
+uint32_t CompressedRecordFile::GetMaxBlockSize(uint32_t count)
+{
+	return LZ4_compressBound(count * sizeof(Record));
+}
+
+uint32_t CompressedRecordFile::CompressBlock(const Record *records, uint32_t count, char *out)
+{
+	uint32_t size = count * sizeof(Record);
+	int compressed_size = LZ4_compress((const char*)records, out, size);
+
+	// Incompressible blocks are stored as they are
+	if(compressed_size <= 0 || (uint32_t)compressed_size >= size) {
+		memcpy(out, records, size);
+		return size;
+	}
+
+	return compressed_size;
+}
+
+bool CompressedRecordFile::DecompressBlock(const char *data, uint32_t size, Record *records, uint32_t count)
+{
+	uint32_t records_size = count * sizeof(Record);
+
+	if(size == records_size) {
+		memcpy(records, data, size);
+		return true;
+	}
+
+	return LZ4_uncompress_unknownOutputSize(data, (char*)records, size, records_size) == (int)records_size;
+}
+
+RecordBufferInterface *libtrace::OpenRecordFile(FILE *f)
+{
+	if(CompressedRecordFile::IsCompressed(f)) {
+		CompressedRecordFile *file = new CompressedRecordFile(f);
+		if(!file->IsValid()) {
+			delete file;
+			return nullptr;
+		}
+		return file;
+	}
+
+	return new RecordFile(f);
+}
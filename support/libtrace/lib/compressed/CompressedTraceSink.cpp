@@ -0,0 +1,208 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/compressed/CompressedTraceSink.h"
+
+#include <cstring>
+#include <sstream>
+
+using namespace libtrace;
+
+const uint32_t CompressedFileTraceSink::kBufferRecords;
+
+CompressedFileTraceSink::CompressedFileTraceSink(const std::string &pattern) : TraceSink(), pattern_(pattern), writing_(false), terminate_(false)
+{
+	compressed_.resize(CompressedRecordFile::GetMaxBlockSize(kBufferRecords));
+	writer_ = std::thread([this]() {
+		WriterThread();
+	});
+}
+
+CompressedFileTraceSink::~CompressedFileTraceSink()
+{
+	Flush();
+
+	{
+		std::lock_guard<std::mutex> lg(lock_);
+		terminate_ = true;
+		jobs_cv_.notify_all();
+	}
+	writer_.join();
+
+	for(auto &stream : streams_) {
+		fclose(stream->File);
+		delete [] stream->Buffers[0];
+		delete [] stream->Buffers[1];
+	}
+}
+
+int CompressedFileTraceSink::Open()
+{
+	std::lock_guard<std::mutex> lg(lock_);
+
+	int new_id = streams_.size();
+	std::stringstream str;
+	str << pattern_ << new_id;
+
+	std::unique_ptr<Stream> stream (new Stream());
+	stream->File = fopen(str.str().c_str(), "w");
+	stream->RecordCount = 0;
+	stream->Buffers[0] = new TraceRecord[kBufferRecords];
+	stream->Buffers[1] = new TraceRecord[kBufferRecords];
+	stream->BufferBusy[0] = stream->BufferBusy[1] = false;
+	stream->Filling = 0;
+	stream->Copied = 0;
+
+	CompressedFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.Magic, CompressedRecordFile::kMagic, sizeof(header.Magic));
+	header.Version = CompressedRecordFile::kVersion;
+	header.RecordSize = sizeof(Record);
+	fwrite(&header, sizeof(header), 1, stream->File);
+	stream->BlocksEnd = sizeof(header);
+
+	streams_.push_back(std::move(stream));
+	return new_id;
+}
+
+TraceRecord *CompressedFileTraceSink::AcquireBuffer(int id, size_t &capacity)
+{
+	std::lock_guard<std::mutex> lg(lock_);
+
+	Stream &stream = *streams_.at(id);
+	capacity = kBufferRecords;
+	return stream.Buffers[stream.Filling];
+}
+
+TraceRecord *CompressedFileTraceSink::SubmitBuffer(int id, size_t count)
+{
+	std::unique_lock<std::mutex> lg(lock_);
+
+	Stream &stream = *streams_.at(id);
+	if(count == 0) {
+		return stream.Buffers[stream.Filling];
+	}
+
+	jobs_.push_back({ id, stream.Filling, count });
+	stream.BufferBusy[stream.Filling] = true;
+	jobs_cv_.notify_one();
+
+	// Carry on with the other buffer, once the writer has finished with it
+	int next = stream.Filling ^ 1;
+	while(stream.BufferBusy[next]) {
+		done_cv_.wait(lg);
+	}
+
+	stream.Filling = next;
+	return stream.Buffers[next];
+}
+
+void CompressedFileTraceSink::SinkPackets(int id, const TraceRecord* start, const TraceRecord* end)
+{
+	while(start < end) {
+		TraceRecord *buffer;
+		size_t copied;
+		{
+			std::lock_guard<std::mutex> lg(lock_);
+			Stream &stream = *streams_.at(id);
+			buffer = stream.Buffers[stream.Filling];
+			copied = stream.Copied;
+		}
+
+		size_t count = std::min<size_t>(end - start, kBufferRecords - copied);
+		memcpy((void*)(buffer + copied), (const void*)start, count * sizeof(*start));
+		start += count;
+		copied += count;
+
+		if(copied == kBufferRecords) {
+			SubmitBuffer(id, copied);
+			copied = 0;
+		}
+
+		std::lock_guard<std::mutex> lg(lock_);
+		streams_.at(id)->Copied = copied;
+	}
+}
+
+void CompressedFileTraceSink::Flush()
+{
+	// Write out anything which was copied in...
+	for(size_t id = 0; id < streams_.size(); ++id) {
+		size_t copied;
+		{
+			std::lock_guard<std::mutex> lg(lock_);
+			copied = streams_[id]->Copied;
+			streams_[id]->Copied = 0;
+		}
+		SubmitBuffer(id, copied);
+	}
+
+	// ...wait for the writer to catch up, and then make each file readable
+	// as it stands. The index is overwritten by the next block, and written
+	// again at the next flush.
+	std::unique_lock<std::mutex> lg(lock_);
+	while(!jobs_.empty() || writing_) {
+		done_cv_.wait(lg);
+	}
+
+	for(auto &stream : streams_) {
+		writeIndex(*stream);
+	}
+}
+
+void CompressedFileTraceSink::WriterThread()
+{
+	std::unique_lock<std::mutex> lg(lock_);
+
+	while(true) {
+		if(jobs_.empty()) {
+			if(terminate_) {
+				break;
+			}
+			jobs_cv_.wait(lg);
+			continue;
+		}
+
+		Job job = jobs_.front();
+		jobs_.pop_front();
+		writing_ = true;
+
+		Stream &stream = *streams_.at(job.Id);
+		lg.unlock();
+
+		writeBlock(stream, stream.Buffers[job.Buffer], job.Count);
+
+		lg.lock();
+		stream.BufferBusy[job.Buffer] = false;
+		writing_ = false;
+		done_cv_.notify_all();
+	}
+}
+
+void CompressedFileTraceSink::writeBlock(Stream &stream, const TraceRecord *records, size_t count)
+{
+	CompressedBlockHeader header;
+	header.RecordCount = count;
+	header.DataSize = CompressedRecordFile::CompressBlock(records, count, compressed_.data());
+
+	fseek(stream.File, stream.BlocksEnd, SEEK_SET);
+	fwrite(&header, sizeof(header), 1, stream.File);
+	fwrite(compressed_.data(), 1, header.DataSize, stream.File);
+
+	stream.Index.push_back({ stream.BlocksEnd, stream.RecordCount });
+	stream.BlocksEnd += sizeof(header) + header.DataSize;
+	stream.RecordCount += count;
+}
+
+void CompressedFileTraceSink::writeIndex(Stream &stream)
+{
+	CompressedFileFooter footer;
+	memset(&footer, 0, sizeof(footer));
+	footer.IndexOffset = stream.BlocksEnd;
+	footer.BlockCount = stream.Index.size();
+	footer.RecordCount = stream.RecordCount;
+	memcpy(footer.Magic, CompressedRecordFile::kMagic, sizeof(footer.Magic));
+
+	fseek(stream.File, stream.BlocksEnd, SEEK_SET);
+	fwrite(stream.Index.data(), sizeof(CompressedIndexEntry), stream.Index.size(), stream.File);
+	fwrite(&footer, sizeof(footer), 1, stream.File);
+	fflush(stream.File);
+}
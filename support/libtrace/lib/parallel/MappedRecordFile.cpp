@@ -0,0 +1,73 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/parallel/MappedRecordFile.h"
+#include "libtrace/compressed/CompressedRecordFile.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace libtrace;
+
+MappedRecordFile::MappedRecordFile(const std::string &filename) : records_(nullptr), count_(0), valid_(false), compressed_(false)
+{
+	// A compressed file would otherwise be read as garbage records
+	FILE *f = fopen(filename.c_str(), "r");
+	if(f == nullptr) {
+		return;
+	}
+	compressed_ = CompressedRecordFile::IsCompressed(f);
+	fclose(f);
+
+	if(compressed_) {
+		return;
+	}
+
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0) {
+		return;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st)) {
+		close(fd);
+		return;
+	}
+
+	count_ = st.st_size / sizeof(Record);
+	if(count_ == 0) {
+		close(fd);
+		valid_ = true;
+		return;
+	}
+
+	void *map = mmap(nullptr, count_ * sizeof(Record), PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+
+	if(map == MAP_FAILED) {
+		count_ = 0;
+		return;
+	}
+
+	// Most tools read each chunk of the file from start to end
+	madvise(map, count_ * sizeof(Record), MADV_SEQUENTIAL);
+
+	records_ = (const Record *)map;
+	valid_ = true;
+}
+
+MappedRecordFile::~MappedRecordFile()
+{
+	if(records_ != nullptr) {
+		munmap((void *)records_, count_ * sizeof(Record));
+	}
+}
+
+uint64_t MappedRecordFile::FindPacketStart(uint64_t i) const
+{
+	while(i < count_ && (*this)[i].GetType() != InstructionHeader) {
+		i++;
+	}
+	return i;
+}
@@ -0,0 +1,79 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/parallel/PacketIndex.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace libtrace;
+
+const uint64_t PacketIndex::kDefaultChunkRecords;
+
+PacketIndex::PacketIndex(const MappedRecordFile &file, uint64_t chunk_records) : file_(file), counted_(false), instruction_count_(0)
+{
+	uint64_t count = file.GetCount();
+	uint64_t start = 0;
+
+	while(start < count) {
+		// End the chunk at the first packet after its nominal end, which is
+		// found by looking at only a few records
+		uint64_t end = file.FindPacketStart(std::min(count, start + chunk_records));
+		chunks_.push_back({ start, end, 0, 0 });
+		start = end;
+	}
+}
+
+void PacketIndex::CountInstructions(ThreadPool &pool)
+{
+	if(counted_) {
+		return;
+	}
+
+	uint64_t first_instruction = 0;
+
+	pool.MapOrdered<uint64_t>(chunks_.size(), [this](size_t i) {
+		const PacketChunk &chunk = chunks_[i];
+
+		uint64_t instructions = 0;
+		for(uint64_t r = chunk.FirstRecord; r < chunk.EndRecord; ++r) {
+			if(file_[r].GetType() == InstructionHeader) {
+				instructions++;
+			}
+		}
+		return instructions;
+	}, [this, &first_instruction](size_t i, uint64_t &instructions) {
+		chunks_[i].FirstInstruction = first_instruction;
+		chunks_[i].InstructionCount = instructions;
+		first_instruction += instructions;
+		return true;
+	});
+
+	instruction_count_ = first_instruction;
+	counted_ = true;
+}
+
+uint64_t PacketIndex::FindInstruction(uint64_t n) const
+{
+	assert(counted_);
+
+	if(n >= instruction_count_) {
+		return file_.GetCount();
+	}
+
+	// Find the last chunk which starts at or before the instruction
+	auto chunk = std::upper_bound(chunks_.begin(), chunks_.end(), n, [](uint64_t n, const PacketChunk &chunk) {
+		return n < chunk.FirstInstruction;
+	});
+	assert(chunk != chunks_.begin());
+	--chunk;
+
+	// Empty chunks share their first instruction with the next chunk
+	while(chunk->InstructionCount == 0 || n >= chunk->FirstInstruction + chunk->InstructionCount) {
+		++chunk;
+	}
+
+	uint64_t r = file_.FindPacketStart(chunk->FirstRecord);
+	for(uint64_t skip = n - chunk->FirstInstruction; skip > 0; --skip) {
+		r = file_.FindPacketStart(r + 1);
+	}
+	return r;
+}
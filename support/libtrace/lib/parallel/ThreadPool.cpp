@@ -0,0 +1,62 @@
+/* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
+#include "libtrace/parallel/ThreadPool.h"
+
+using namespace libtrace;
+
+ThreadPool::ThreadPool(unsigned threads) : terminate_(false)
+{
+	if(threads == 0) {
+		threads = std::thread::hardware_concurrency();
+	}
+	if(threads == 0) {
+		threads = 1;
+	}
+
+	for(unsigned i = 0; i < threads; ++i) {
+		threads_.push_back(std::thread([this]() {
+			Worker();
+		}));
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lg(lock_);
+		terminate_ = true;
+		tasks_cv_.notify_all();
+	}
+
+	for(auto &thread : threads_) {
+		thread.join();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	std::lock_guard<std::mutex> lg(lock_);
+	tasks_.push_back(std::move(task));
+	tasks_cv_.notify_one();
+}
+
+void ThreadPool::Worker()
+{
+	std::unique_lock<std::mutex> lg(lock_);
+
+	while(true) {
+		if(tasks_.empty()) {
+			if(terminate_) {
+				break;
+			}
+			tasks_cv_.wait(lg);
+			continue;
+		}
+
+		std::function<void()> task = std::move(tasks_.front());
+		tasks_.pop_front();
+
+		lg.unlock();
+		task();
+		lg.lock();
+	}
+}
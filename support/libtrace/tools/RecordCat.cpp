@@ -1,5 +1,6 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordFile.h"
+#include "libtrace/compressed/CompressedRecordFile.h"
 #include "libtrace/InstructionPrinter.h"
 #include "libtrace/disasm/CapstoneDisassembler.h"
 
@@ -50,12 +51,17 @@ int main(int argc, char **argv)
 	}
 #endif
 
-	RecordFile rf (rfile);
-	RecordBufferStreamAdaptor rbsa (&rf);
+	RecordBufferInterface *rf = OpenRecordFile(rfile);
+	if(rf == nullptr) {
+		fprintf(stderr, "Could not read record file\n");
+		return 1;
+	}
+
+	RecordBufferStreamAdaptor rbsa (rf);
 	TracePacketStreamAdaptor tpsa(&rbsa);
 
-	auto begin = rf.begin();
-	auto end = rf.end();
+	auto begin = RecordIterator(rf, 0);
+	auto end = RecordIterator(rf, rf->Size());
 
 	InstructionPrinter ip;
 	ip.SetDisassembler(disassembler);
@@ -71,5 +77,6 @@ int main(int argc, char **argv)
 	}
 
 	delete disassembler;
+	delete rf;
 	return 0;
 }
@@ -1,6 +1,7 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
 #include "libtrace/RecordStream.h"
+#include "libtrace/compressed/CompressedRecordFile.h"
 
 #include <vector>
 
@@ -19,13 +20,24 @@ int main(int argc, char **argv)
 
 	if(!f) return 1;
 
+	// Compressed files have to be read through their index, which is only
+	// possible if the file can be seeked
+	RecordBufferInterface *crf = nullptr;
+	if(f != stdin && CompressedRecordFile::IsCompressed(f)) {
+		crf = OpenRecordFile(f);
+		if(crf == nullptr) return 1;
+	}
+
 	RecordStream rf(f);
+	uint64_t index = 0;
 
 	uint64_t count = strtol(argv[2], NULL, 0);
 
 	std::vector<Record> buffer;
-	while(count > 0 && rf.good()) {
-		Record r = rf.next();
+	while(count > 0 && (crf ? index < crf->Size() : rf.good())) {
+		Record r;
+		if(crf) crf->Get(index++, r);
+		else r = rf.next();
 		TraceRecord *tr = (TraceRecord *)&r;
 
 		if(tr->GetType() == InstructionHeader) count--;
@@ -40,5 +52,6 @@ int main(int argc, char **argv)
 	fwrite(buffer.data(), sizeof(Record), buffer.size(), stdout);
 	buffer.clear();
 
+	delete crf;
 	return 0;
 }
@@ -1,33 +1,103 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
-#include "libtrace/RecordFile.h"
+#include "libtrace/compressed/CompressedRecordFile.h"
+#include "libtrace/parallel/MappedRecordFile.h"
+#include "libtrace/parallel/PacketIndex.h"
+#include "libtrace/parallel/ThreadPool.h"
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 
 using namespace libtrace;
 
-TraceRecord TR(Record r)
+InstructionHeaderRecord IH(const TraceRecord &r)
 {
-	return *(TraceRecord*)&r;
+	return *(const InstructionHeaderRecord*)&r;
 }
 
-InstructionHeaderRecord IH(Record r)
+// The number of instructions compared by each job
+static const uint64_t kJobInstructions = 1 << 20;
+
+// Instructions from the start of the comparison, or -1 if there was no
+// divergence
+typedef int64_t Divergence;
+
+// Moves i on to the next instruction header in the file, returning false if
+// there are no more
+static bool NextInstruction(RecordBufferInterface &file, uint64_t &i)
 {
-	return *(InstructionHeaderRecord*)&r;
+	Record r;
+	while(file.Get(i, r)) {
+		if(((TraceRecord*)&r)->GetType() == InstructionHeader) {
+			return true;
+		}
+		i++;
+	}
+	return false;
 }
 
-int main(int argc, char **argv)
+// Compressed files can't be mapped, so are diffed one instruction at a time
+// through their block index instead
+static int DiffIndexed(const char *filename1, const char *filename2, uint64_t start1, uint64_t start2)
 {
-	FILE *f1 = fopen(argv[1], "r");
-	FILE *f2 = fopen(argv[2], "r");
-
+	FILE *f1 = fopen(filename1, "r");
+	FILE *f2 = fopen(filename2, "r");
 	if(!f1 || !f2) {
 		return 1;
 	}
 
-	RecordFile rf1 (f1);
-	RecordFile rf2 (f2);
+	RecordBufferInterface *rf1 = OpenRecordFile(f1);
+	RecordBufferInterface *rf2 = OpenRecordFile(f2);
+	if(rf1 == nullptr || rf2 == nullptr) {
+		fprintf(stderr, "Could not read record file\n");
+		return 1;
+	}
+
+	uint64_t it1 = 0, it2 = 0;
+	bool good = NextInstruction(*rf1, it1) && NextInstruction(*rf2, it2);
+	for(uint64_t i = 0; good && i < start1; ++i) {
+		good = NextInstruction(*rf1, ++it1);
+	}
+	for(uint64_t i = 0; good && i < start2; ++i) {
+		good = NextInstruction(*rf2, ++it2);
+	}
+
+	uint64_t total = 0;
+	while(good) {
+		Record r1, r2;
+		rf1->Get(it1, r1);
+		rf2->Get(it2, r2);
+
+		if(IH(*(TraceRecord*)&r1).GetPC() != IH(*(TraceRecord*)&r2).GetPC()) {
+			printf("Divergence detected at instruction %lu %lu\n", start1 + total + 1, start2 + total + 1);
+			return 1;
+		}
+
+		total++;
+		if((total % 10000000) == 0) printf("%lu...\n", total);
+
+		good = NextInstruction(*rf1, ++it1) && NextInstruction(*rf2, ++it2);
+	}
+
+	printf("No divergence detected in %lu instructions\n", total);
+
+	delete rf1;
+	delete rf2;
+	fclose(f1);
+	fclose(f2);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 3 && argc != 5) {
+		fprintf(stderr, "Usage: %s [record file 1] [record file 2] <start 1> <start 2>\n", argv[0]);
+		return 1;
+	}
+
+	MappedRecordFile rf1 (argv[1]);
+	MappedRecordFile rf2 (argv[2]);
 
 	uint64_t start1 = 0;
 	uint64_t start2 = 0;
@@ -37,44 +107,64 @@ int main(int argc, char **argv)
 		start2 = atoi(argv[4]);
 	}
 
-	auto it1 = rf1.begin();
-	auto it2 = rf2.begin();
-
-	uint64_t ctr1 = start1, ctr2 = start2;
-
-	// seek to starts
-	while(start1) {
-		if(TR(*it1).GetType() == InstructionHeader) start1--;
-		it1++;
+	if(rf1.IsCompressed() || rf2.IsCompressed()) {
+		return DiffIndexed(argv[1], argv[2], start1, start2);
 	}
 
-	while(start2) {
-		if(TR(*it2).GetType() == InstructionHeader) start2--;
-		it2++;
+	if(!rf1.IsValid() || !rf2.IsValid()) {
+		return 1;
 	}
 
+	ThreadPool pool;
+	PacketIndex index1 (rf1);
+	PacketIndex index2 (rf2);
+	index1.CountInstructions(pool);
+	index2.CountInstructions(pool);
+
+	uint64_t remaining1 = index1.GetInstructionCount() - std::min(start1, index1.GetInstructionCount());
+	uint64_t remaining2 = index2.GetInstructionCount() - std::min(start2, index2.GetInstructionCount());
+	uint64_t total = std::min(remaining1, remaining2);
+	uint64_t jobs = (total + kJobInstructions - 1) / kJobInstructions;
+
+	// Each job finds its own starting point in both files, and scans
+	// until PC divergence
 	uint64_t diffed_count = 0;
+	Divergence divergence = -1;
 
-	// scan until PC divergence
-	while(true) {
+	pool.MapOrdered<Divergence>(jobs, [&](size_t job) -> Divergence {
+		uint64_t first = job * kJobInstructions;
+		uint64_t count = std::min(kJobInstructions, total - first);
 
-		// make sure we are at an instruction header
-		while(TR(*it1).GetType() != InstructionHeader) it1++;
-		while(TR(*it2).GetType() != InstructionHeader) it2++;
+		uint64_t it1 = index1.FindInstruction(start1 + first);
+		uint64_t it2 = index2.FindInstruction(start2 + first);
 
-		ctr1++;
-		ctr2++;
-		diffed_count++;
+		for(uint64_t i = 0; i < count; ++i) {
+			if(IH(rf1[it1]).GetPC() != IH(rf2[it2]).GetPC()) {
+				return first + i;
+			}
 
-		if((diffed_count % 10000000) == 0) printf("%lu...\n", diffed_count);
+			it1 = rf1.FindPacketStart(it1 + 1);
+			it2 = rf2.FindPacketStart(it2 + 1);
+		}
 
-		if(IH(*it1).GetPC() != IH(*it2).GetPC()) {
-			printf("Divergence detected at instruction %lu %lu\n", ctr1, ctr2);
-			return 1;
+		return -1;
+	}, [&](size_t job, Divergence &result) {
+		if(result >= 0) {
+			divergence = result;
+			return false;
 		}
 
-		it1++;
-		it2++;
+		uint64_t prev_count = diffed_count;
+		diffed_count += std::min(kJobInstructions, total - job * kJobInstructions);
+		if(diffed_count / 10000000 != prev_count / 10000000) printf("%lu...\n", (diffed_count / 10000000) * 10000000);
+		return true;
+	});
+
+	if(divergence >= 0) {
+		printf("Divergence detected at instruction %lu %lu\n", start1 + divergence + 1, start2 + divergence + 1);
+		return 1;
 	}
 
+	printf("No divergence detected in %lu instructions\n", total);
+	return 0;
 }
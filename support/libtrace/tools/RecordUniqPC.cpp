@@ -1,10 +1,15 @@
 /* This file is Copyright University of Edinburgh 2018. For license details, see LICENSE. */
 #include "libtrace/RecordTypes.h"
 #include "libtrace/RecordStream.h"
+#include "libtrace/compressed/CompressedRecordFile.h"
+#include "libtrace/parallel/MappedRecordFile.h"
+#include "libtrace/parallel/PacketIndex.h"
+#include "libtrace/parallel/ThreadPool.h"
 
 #include <cstdlib>
 #include <cstdio>
 #include <cstring>
+#include <vector>
 
 using namespace libtrace;
 
@@ -17,25 +22,15 @@ InstructionHeaderRecord IHR(Record r)
 	return *(InstructionHeaderRecord*)&r;
 }
 
-int main(int argc, char **argv)
+// Reads records one at a time from next(), which returns false at the end
+template<typename NextFn> static int UniqRecords(NextFn next)
 {
-	FILE *f;
-	if(!strcmp(argv[1], "-")) f = stdin;
-	else f = fopen(argv[1], "r");
-
-	if(!f) {
-		fprintf(stderr, "Could not open file\n");
-		return 1;
-	}
-
-	RecordStream rf(f);
-
 	uint32_t prev_pc = 0xffffffff;
 	uint64_t count = 0;
 
 	bool print = true;
-	while(rf.good()) {
-		Record r = rf.next();
+	Record r;
+	while(next(r)) {
 		if(TR(r).GetType() == InstructionHeader) {
 			count++;
 			if((count % 10000000) == 0) fprintf(stderr, "Uniq'd %lu instructions\n", count);
@@ -57,3 +52,120 @@ int main(int argc, char **argv)
 
 	return 0;
 }
+
+static int UniqStream(FILE *f)
+{
+	RecordStream rf(f);
+
+	return UniqRecords([&](Record &r) {
+		if(!rf.good()) return false;
+		r = rf.next();
+		return true;
+	});
+}
+
+// Compressed files can't be mapped, so are read in order through their
+// block index instead
+static int UniqIndexed(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if(!f) {
+		fprintf(stderr, "Could not open file\n");
+		return 1;
+	}
+
+	RecordBufferInterface *rf = OpenRecordFile(f);
+	if(rf == nullptr) {
+		fprintf(stderr, "Could not read record file\n");
+		return 1;
+	}
+
+	uint64_t index = 0;
+	int result = UniqRecords([&](Record &r) {
+		return rf->Get(index++, r);
+	});
+
+	delete rf;
+	fclose(f);
+	return result;
+}
+
+struct UniqChunk {
+	std::vector<Record> Output;
+	uint64_t Instructions;
+};
+
+static int UniqMapped(const char *filename)
+{
+	MappedRecordFile file (filename);
+	if(file.IsCompressed()) {
+		return UniqIndexed(filename);
+	}
+	if(!file.IsValid()) {
+		fprintf(stderr, "Could not open file\n");
+		return 1;
+	}
+
+	ThreadPool pool;
+	PacketIndex index (file);
+	const std::vector<PacketChunk> &chunks = index.GetChunks();
+
+	uint64_t count = 0;
+	pool.MapOrdered<UniqChunk>(chunks.size(), [&file, &chunks](size_t i) {
+		const PacketChunk &chunk = chunks[i];
+		UniqChunk result;
+		result.Instructions = 0;
+
+		// Pick up the PC of the last instruction in the previous chunk
+		uint32_t prev_pc = 0xffffffff;
+		for(uint64_t r = chunk.FirstRecord; r > 0; --r) {
+			if(file[r - 1].GetType() == InstructionHeader) {
+				prev_pc = IHR(file[r - 1]).GetPC();
+				break;
+			}
+		}
+
+		bool print = true;
+		for(uint64_t r = chunk.FirstRecord; r < chunk.EndRecord; ++r) {
+			const TraceRecord &tr = file[r];
+			if(tr.GetType() == InstructionHeader) {
+				result.Instructions++;
+
+				if(IHR(tr).GetPC() == prev_pc) {
+					print = false;
+				} else {
+					print = true;
+					prev_pc = IHR(tr).GetPC();
+				}
+			}
+
+			if(print || (tr.GetType() != InstructionHeader && tr.GetType() != InstructionCode)) {
+				result.Output.push_back(tr);
+			}
+		}
+
+		return result;
+	}, [&count](size_t i, UniqChunk &result) {
+		fwrite(result.Output.data(), sizeof(Record), result.Output.size(), stdout);
+
+		uint64_t prev_count = count;
+		count += result.Instructions;
+		if(count / 10000000 != prev_count / 10000000) fprintf(stderr, "Uniq'd %lu instructions\n", (count / 10000000) * 10000000);
+		return true;
+	});
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 2) {
+		fprintf(stderr, "Usage: %s [record file | -]\n", argv[0]);
+		return 1;
+	}
+
+	// Pipes can't be mapped, so are read a record at a time
+	if(!strcmp(argv[1], "-")) return UniqStream(stdin);
+
+	return UniqMapped(argv[1]);
+}
@@ -37,6 +37,8 @@ def main():
 	parser = ArgumentParser()
 	parser.add_argument("-e", "--zimage", dest="zimage")
 	parser.add_argument("-v", "--verbose", dest="verbose", type=int, choices=[1,0])
+	parser.add_argument("-f", "--flags", dest="flags", default="")
+	parser.add_argument("-t", "--timeout", dest="timeout", type=int, default=30)
 	command_line_args = parser.parse_args()
 	
 	args='virtio_mmio.device=1K@0x10200000:34 earlyprintk=serial console=ttyAMA0 root=/dev/vda1 rw norandmaps verbose text'
@@ -52,13 +54,13 @@ def main():
 	# If we use Popen with shell=True and then try and kill the process,
 	# the shell will be killed but the process will live on. So, use 'exec'
 	# (which replaces the shell with the child process) to avoid this.
-	command="exec " + archsim + " " + model_flags + " " + kernel_flags 
+	command="exec " + archsim + " " + model_flags + " " + kernel_flags + " " + command_line_args.flags
 
 	print("Running command " + command)
 
 	final_line = '---[ end Kernel panic - not syncing: VFS: Unable to mount root fs on unknown-block(0,0)'
 	process = subprocess.Popen(command, shell=True, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.DEVNULL)
-	result = wait_for_line(process, final_line, 30)
+	result = wait_for_line(process, final_line, command_line_args.timeout)
 	
 	exitcode = 0
 	